@@ -1,3 +1,13 @@
 Import("env")
 
-env.Replace(PROGNAME="%s" % env.GetProjectOption("prog_name"))
\ No newline at end of file
+env.Replace(PROGNAME="%s" % env.GetProjectOption("prog_name"))
+
+# generate precompiled RAM routines from IHX text headers, see tools/ram_blobs.py
+import glob
+WEDIR  = "include/RAM_Routines/write_erase"
+CRCDIR = "include/RAM_Routines/verify_CRC32"
+WE_SRC = ["%s/erase_write_%s_inc.h" % (WEDIR, vers) for vers in
+  ("verL_8k_1.0", "ver_32k_1.0", "ver_32k_1.2", "ver_32k_1.3", "ver_128k_2.0", "ver_128k_2.1", "ver_128k_2.2")]
+CRC_SRC = sorted(glob.glob("%s/verify_CRC32_*.h" % CRCDIR))
+env.Execute('"$PYTHONEXE" tools/ram_blobs.py -o %s/ram_write_erase.h %s' % (WEDIR, " ".join(WE_SRC)))
+env.Execute('"$PYTHONEXE" tools/ram_blobs.py -o %s/ram_verify_crc32.h %s' % (CRCDIR, " ".join(CRC_SRC)))
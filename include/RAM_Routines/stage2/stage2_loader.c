@@ -0,0 +1,414 @@
+/**
+  \file stage2_loader.c
+
+  \author G. Icking-Konert
+
+  \brief second-stage RAM loader for stm8gal (STM8 side)
+
+  Uploaded by stm8gal via ROM bootloader to RAM and started via GO, see
+  src/stage2.c and include/stage2.h for the host side and protocol constants.
+  The loader takes over the UART configured by the ROM bootloader, switches to
+  the baudrate passed in the parameter block and programs received frames to
+  flash or EEPROM. Frames are received into 2 buffers, i.e. the next frame is
+  received while the previous one is programmed. Each frame is read back after
+  programming and only acknowledged if the content matches.
+
+  Limitations: 16-bit addresses only (flash up to 0xFFFF), no option bytes,
+  requires >=2kB RAM.
+
+  Build with SDCC (no startup code, entry at S2_ADDR_START):
+    sdcc -mstm8 --opt-code-size --no-std-crt0 --code-loc 0x00A4 --data-loc 0x0400 stage2_loader.c
+  The resulting stage2_loader.ihx is passed to stm8gal via '-S stage2_loader.ihx [baud]'.
+*/
+
+#include <stdint.h>
+
+// protocol constants, see include/stage2.h
+#define S2_ADDR_PARAM     0x00A0
+#define S2_VERSION        0x10
+#define S2_SYNC           0x7F
+#define S2_SOF            0xA5
+#define S2_ACK            0x79
+#define S2_NACK           0x1F
+#define S2_CMD_WRITE      0x31
+#define S2_CMD_WRITE_LZ   0x32
+#define S2_CMD_GO         0x21
+#define S2_FRAME_MAX      256
+#define S2_OVERHEAD       10
+
+// register access
+#define REG(addr)         (*(volatile uint8_t*) (addr))
+
+// UART register offsets (identical for STM8S UART1/2/3 and STM8L USART1)
+#define UART_SR           0
+#define UART_DR           1
+#define UART_BRR1         2
+#define UART_BRR2         3
+#define UART_CR2          5
+#define UART_CR5          8
+#define SR_TXE            0x80
+#define SR_TC             0x40
+#define SR_RXNE           0x20
+#define CR2_TEN_REN       0x0C
+#define CR5_HDSEL         0x08
+
+// flash control
+#define IAPSR_WR_PG_DIS   0x01
+#define IAPSR_EOP         0x04
+#define CR2_PRG           0x01
+
+
+// parameter block written by host
+typedef struct {
+  uint8_t   brr1;
+  uint8_t   brr2;
+  uint8_t   family;       // 1=STM8S, 2=STM8L
+  uint8_t   blocksize;    // flash block size [B]
+} Param_s;
+#define PARAM             (*(volatile Param_s*) S2_ADDR_PARAM)
+
+// no initialized globals without startup code -> all set in main()
+static volatile uint8_t   *uart;              // UART used by ROM bootloader
+static uint8_t            halfDuplex;         // 1-wire mode: discard own echo
+static volatile uint8_t   *regCR2, *regNCR2, *regIAPSR;
+static uint8_t            dummyNCR2;          // STM8L has no FLASH_NCR2
+static uint8_t            buf[2][S2_FRAME_MAX+S2_OVERHEAD];
+static uint8_t            unpacked[S2_FRAME_MAX];   // decompressed frame data
+static uint8_t            ready[2], crcOk[2];
+static uint8_t            rxBuf, rxBad, *rxPtr;
+static uint16_t           rxIdx, rxLen, rxCrc;
+
+
+// entry point at start of code -> jump to main()
+void loader_entry(void) __naked
+{
+  __asm
+    sim
+    jp    _main
+  __endasm;
+}
+
+
+// update CRC16-CCITT (polynomial 0x1021, MSB first) without table
+static uint16_t crc16(uint16_t crc, uint8_t data)
+{
+  uint8_t x = (uint8_t) (crc >> 8) ^ data;
+  x ^= x >> 4;
+  return (crc << 8) ^ ((uint16_t) x << 12) ^ ((uint16_t) x << 5) ^ x;
+}
+
+
+// receive state machine. Called frequently, handles max. 1 byte per call
+static void poll(void)
+{
+  uint8_t   b;
+
+  if (!(uart[UART_SR] & SR_RXNE))
+    return;
+  b = uart[UART_DR];
+
+  // idle: wait for start of frame in free buffer. Answer handshake
+  if (rxIdx == 0)
+  {
+    if (b == S2_SYNC)
+    {
+      uint8_t i;
+      for (i=0; i<2; i++)
+      {
+        while (!(uart[UART_SR] & SR_TXE));
+        uart[UART_DR] = i ? S2_VERSION : S2_ACK;
+        if (halfDuplex)
+        {
+          while (!(uart[UART_SR] & SR_RXNE));
+          b = uart[UART_DR];
+        }
+      }
+    }
+    else if ((b == S2_SOF) && (!ready[rxBuf]))
+    {
+      rxPtr = buf[rxBuf];
+      rxPtr[0] = b;
+      rxIdx = 1;
+      rxLen = S2_OVERHEAD;
+      rxCrc = 0xFFFF;
+      rxBad = 0;
+    }
+    return;
+  }
+
+  // store byte and update CRC over sequence number to data
+  rxPtr[rxIdx] = b;
+  if (rxIdx < rxLen-2)
+    rxCrc = crc16(rxCrc, b);
+  rxIdx++;
+
+  // header complete -> get frame length
+  if (rxIdx == 8)
+  {
+    rxLen = ((uint16_t) rxPtr[6] << 8) | rxPtr[7];
+    if (rxLen > S2_FRAME_MAX)
+    {
+      rxLen = 0;
+      rxBad = 1;
+    }
+    rxLen += S2_OVERHEAD;
+  }
+
+  // frame complete -> hand over to main loop and switch buffer
+  else if (rxIdx == rxLen)
+  {
+    crcOk[rxBuf] = (!rxBad) && (rxCrc == (((uint16_t) rxPtr[rxLen-2] << 8) | rxPtr[rxLen-1]));
+    ready[rxBuf] = 1;
+    rxBuf ^= 1;
+    rxIdx = 0;
+  }
+}
+
+
+// send response while continuing to receive
+static void reply(uint8_t code, uint8_t seq)
+{
+  uint8_t   i;
+
+  for (i=0; i<2; i++)
+  {
+    while (!(uart[UART_SR] & SR_TXE))
+      poll();
+    uart[UART_DR] = i ? seq : code;
+
+    // 1-wire: receiver sees own byte -> discard
+    if (halfDuplex)
+    {
+      while (!(uart[UART_SR] & SR_RXNE));
+      (void) uart[UART_DR];
+    }
+  }
+}
+
+
+// wait until flash programming completed. Return 0 on write protection
+static uint8_t wait_eop(void)
+{
+  uint8_t   s;
+
+  do {
+    s = *regIAPSR;
+    poll();
+  } while (!(s & (IAPSR_EOP | IAPSR_WR_PG_DIS)));
+
+  return !(s & IAPSR_WR_PG_DIS);
+}
+
+
+// decompress frame data into buffer 'unpacked', see src/lz.c. Return length, 0 on corrupt data
+static uint16_t unpack(uint8_t *src, uint16_t len)
+{
+  uint16_t  n = 0, off, cnt;
+  uint8_t   c;
+
+  while (len > 0)
+  {
+    c = *src++;
+    len--;
+
+    // literals
+    if (c < 0x80)
+    {
+      cnt = (uint16_t) c + 1;
+      if ((cnt > len) || (n + cnt > S2_FRAME_MAX))
+        return 0;
+      len -= cnt;
+      while (cnt--)
+      {
+        unpacked[n++] = *src++;
+        poll();
+      }
+    }
+
+    // copy from output, byte-wise for overlapping source
+    else
+    {
+      if (len == 0)
+        return 0;
+      off = (uint16_t) (*src++) + 1;
+      len--;
+      cnt = (uint16_t) (c & 0x7F) + 3;
+      if ((off > n) || (n + cnt > S2_FRAME_MAX))
+        return 0;
+      while (cnt--)
+      {
+        unpacked[n] = unpacked[n-off];
+        n++;
+        poll();
+      }
+    }
+  }
+
+  return n;
+}
+
+
+// program data to flash or EEPROM and read back. Return 1 on success
+static uint8_t program(uint16_t addr, uint8_t *data, uint16_t len)
+{
+  uint16_t  n, i;
+  uint8_t   blocksize = PARAM.blocksize;
+
+  while (len > 0)
+  {
+    // part of data within current flash block
+    n = blocksize - (addr & (blocksize-1));
+    if (n > len)
+      n = len;
+
+    // complete block -> standard block programming (erase + write)
+    if (n == blocksize)
+    {
+      *regCR2  = CR2_PRG;
+      *regNCR2 = (uint8_t) ~CR2_PRG;
+      for (i=0; i<n; i++)
+      {
+        REG(addr+i) = data[i];
+        poll();
+      }
+      if (!wait_eop())
+        return 0;
+    }
+
+    // partial block -> byte programming
+    else
+    {
+      for (i=0; i<n; i++)
+      {
+        REG(addr+i) = data[i];
+        if (!wait_eop())
+          return 0;
+      }
+    }
+
+    // read back
+    for (i=0; i<n; i++)
+    {
+      if (REG(addr+i) != data[i])
+        return 0;
+      poll();
+    }
+
+    addr += n;
+    data += n;
+    len  -= n;
+  }
+
+  return 1;
+}
+
+
+void main(void)
+{
+  uint8_t   cur, expect, *p;
+  uint16_t  addr, len;
+
+  // find UART enabled by ROM bootloader
+  uart = (volatile uint8_t*) 0x5230;
+  if ((uart[UART_CR2] & CR2_TEN_REN) != CR2_TEN_REN)
+    uart = (volatile uint8_t*) 0x5240;
+  halfDuplex = (uart[UART_CR5] & CR5_HDSEL) ? 1 : 0;
+
+  // flash registers of family
+  if (PARAM.family == 2)
+  {
+    regCR2   = &REG(0x5051);
+    regNCR2  = &dummyNCR2;
+    regIAPSR = &REG(0x5054);
+    REG(0x5052) = 0x56;     // unlock P-flash
+    REG(0x5052) = 0xAE;
+    REG(0x5053) = 0xAE;     // unlock EEPROM
+    REG(0x5053) = 0x56;
+  }
+  else
+  {
+    regCR2   = &REG(0x505B);
+    regNCR2  = &REG(0x505C);
+    regIAPSR = &REG(0x505F);
+    REG(0x5062) = 0x56;     // unlock P-flash
+    REG(0x5062) = 0xAE;
+    REG(0x5064) = 0xAE;     // unlock EEPROM
+    REG(0x5064) = 0x56;
+  }
+
+  // init receive state
+  ready[0] = ready[1] = 0;
+  rxBuf = 0;
+  rxIdx = 0;
+  cur = 0;
+  expect = 0;
+
+  // wait until GO acknowledge of ROM bootloader is sent, then switch baudrate (BRR2 first)
+  while (!(uart[UART_SR] & SR_TC));
+  uart[UART_BRR2] = PARAM.brr2;
+  uart[UART_BRR1] = PARAM.brr1;
+
+  // process frames in order of reception
+  for (;;)
+  {
+    poll();
+    if (!ready[cur])
+      continue;
+    p = buf[cur];
+    addr = ((uint16_t) p[4] << 8) | p[5];
+    len  = ((uint16_t) p[6] << 8) | p[7];
+
+    // corrupted frame -> request retransmission
+    if (!crcOk[cur])
+      reply(S2_NACK, expect);
+
+    // repeated frame after lost acknowledge -> acknowledge again
+    else if (p[1] == (uint8_t) (expect-1))
+      reply(S2_ACK, p[1]);
+
+    // frame after rejected frame -> discard, host resends window
+    else if (p[1] != expect)
+      ;
+
+    // 16-bit address space only
+    else if (p[3] != 0)
+      reply(S2_NACK, expect);
+
+    // program frame
+    else if (p[2] == S2_CMD_WRITE)
+    {
+      if (program(addr, p+8, len))
+        reply(S2_ACK, expect++);
+      else
+        reply(S2_NACK, expect);
+    }
+
+    // decompress and program frame
+    else if (p[2] == S2_CMD_WRITE_LZ)
+    {
+      len = unpack(p+8, len);
+      if ((len > 0) && program(addr, unpacked, len))
+        reply(S2_ACK, expect++);
+      else
+        reply(S2_NACK, expect);
+    }
+
+    // jump to application after acknowledge is sent
+    else if (p[2] == S2_CMD_GO)
+    {
+      reply(S2_ACK, expect);
+      while (!(uart[UART_SR] & SR_TC));
+      ((void (*)(void)) addr)();
+    }
+
+    // unknown command
+    else
+      reply(S2_NACK, expect);
+
+    // release buffer
+    ready[cur] = 0;
+    cur ^= 1;
+  }
+}
+
+// end of file
@@ -0,0 +1,32 @@
+/**
+  \file autospeed.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of automatic link speed selection
+
+  declaration of routines to find the fastest reliable baudrate of a port by
+  probing candidate rates, and to cache the result per port and adapter.
+*/
+
+// for including file only once
+#ifndef _AUTOSPEED_H_
+#define _AUTOSPEED_H_
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+
+// probe parameters
+#define AUTOSPEED_ROUNDS      2         // number of read rounds per candidate rate
+#define AUTOSPEED_ADDR        0x8000    // start address of probe read (flash)
+#define AUTOSPEED_LEN         256       // size of probe read [B]
+#define AUTOSPEED_MAX         64        // max. number of ports in cache file
+#define AUTOSPEED_NAMELEN     256       // max. length of port name or adapter serial number
+
+/// find fastest reliable baudrate for port. Start with cached rate, if available. Return selected baudrate
+uint32_t autospeed_select(const char *portname, uint8_t physInterface, uint8_t uartMode, uint8_t resetSTM8, const char *cacheFile, uint8_t verbose);
+
+#endif // _AUTOSPEED_H_
+
+// end of file
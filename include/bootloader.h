@@ -41,17 +41,112 @@
 
 #define PFLASH_START      0x8000    //< starting address of flash (same for all STM8 devices)
 #define PFLASH_BLOCKSIZE  1024      //< size of flash block for erase or block write (same for all STM8 devices)
+#define PFLASH_PAGESIZE   128       //< size of flash page for fast block programming (see UM0560 section 3.4)
+#define RAM_END           0x0FFF    //< addresses up to here are written as RAM, i.e. without flash programming time and with pipelining. Actual RAM size is device specific (1kB..6kB)
+
+// transfer modes for bsl_memWrite()
+#define WRITE_LOCKSTEP    0         //< wait for ACK of each frame before sending next frame (default)
+#define WRITE_PIPELINED   1         //< send WRITE frames back-to-back and collect ACKs in bulk (UART duplex only)
+#define PIPELINE_WINDOW   4         //< max. number of RAM pages in flight for pipelined write
+
+// polling of BSL response after flash write/erase, see bsl_pollAck()
+#define POLL_MIN              1     //< initial poll interval [ms] via SPI, is doubled after each BUSY
+#define POLL_MAX              50    //< max. poll interval [ms] via SPI
+#define DEADLINE_WRITE        2000  //< max. duration [ms] of WRITE (unaligned flash page ~1.1s)
+#define DEADLINE_ERASE_SECTOR 1200  //< max. duration [ms] of single sector erase
+#define DEADLINE_ERASE_MASS   10000 //< max. duration [ms] of mass erase (measured 3.3s for 128kB)
+
+// batched sector erase, see bsl_flashSectorsErase()
+#define ERASE_MAX_SECTORS     32    //< max. number of sectors per ERASE command
+#define ERASE_TIME_SECTOR     30    //< typ. erase time [ms] per sector (see UM0560)
+
+// retry of failed WRITE, READ or ERASE transactions, see bsl_resync()
+#define RETRY_DEFAULT         3     //< default max. number of retries per transaction (UART only)
+#define RETRY_MAX             10    //< upper limit for number of retries
+#define RESYNC_TIMEOUT        50    //< timeout [ms] for BSL response during resync. Plus get_port_latency()
+#define RESYNC_MAX            300   //< max. number of 0xFF bytes to complete a pending frame (longest frame 1+128+1)
+#define RESYNC_CHUNK          16    //< 0xFF bytes per chunk in UART duplex mode
+
+// short responses, e.g. SYNC, UART mode check and device probes. Includes USB-serial latency (FTDI default 16ms)
+#define PROBE_TIMEOUT         50   //< timeout [ms] for BSL response to probe commands. Plus get_port_latency()
+
+// fast connect after reset, see bsl_syncFast()
+#define CONNECT_QUIET         5     //< port is quiet if no data is received for this time [ms]
+#define CONNECT_DRAIN         100   //< max. time [ms] to drain port, e.g. noise after reset
+#define CONNECT_INTERVAL      5     //< response timeout [ms] per SYNCH, i.e. SYNCH repetition interval
+#define CONNECT_WINDOW        1000  //< max. time [ms] for synchronization (BSL activation window after reset)
+
+// check of RAM routines uploaded before, see bsl_uploadWriteErase()
+#define ROUTINE_SIGNATURE     8     //< bytes per routine block read back to check if block is intact
+
+// fill methods for bsl_memAlign()
+#define ALIGN_NONE        0         //< don't align, write data as is (default)
+#define ALIGN_PAD         1         //< fill partial flash pages with pad value
+#define ALIGN_READ        2         //< fill partial flash pages with device content (read-modify-write)
+
+
+/// consecutive block of precompiled RAM routine
+typedef struct {
+  MEMIMAGE_ADDR_T     address;      //< start address in RAM
+  int                 length;       //< number of bytes
+  const uint8_t       *data;        //< block data
+} RamBlock_s;
+
+/// precompiled RAM routine, generated at build time from IHX text by tools/ram_blobs.py
+typedef struct {
+  const char          *name;        //< name of routine
+  int                 numBlocks;    //< number of consecutive blocks
+  const RamBlock_s    *blocks;      //< consecutive memory blocks
+  int                 numBytes;     //< total size [B]
+  uint32_t            crc32;        //< CRC32 over data of all blocks
+} RamRoutine_s;
+
+/// device table entry for selecting RAM routines, see bsl_findRoutine()
+typedef struct {
+  uint8_t             family;       //< STM8 family (STM8S=1, STM8L=2) or 0 for any
+  int                 flashsize;    //< size of flash [kB]
+  uint8_t             versBSL;      //< BSL version
+  const RamRoutine_s  *routine;     //< matching RAM routine
+} RamDevice_s;
+
+
+/// progress callback for bsl_memRead() and bsl_memWrite() with stage ("read" or "write"), bytes done and total
+typedef void (*bsl_progress_t)(void *arg, const char *stage, uint32_t done, uint32_t total);
+
+/// set (or clear with NULL) progress callback for calling thread
+void bsl_setProgress(bsl_progress_t callback, void *arg);
+
+/// page acknowledge callback for bsl_memWrite() with start address and length of written page
+typedef void (*bsl_pageDone_t)(void *arg, MEMIMAGE_ADDR_T addrPage, int lenPage);
+
+/// set (or clear with NULL) page acknowledge callback for calling thread
+void bsl_setPageDone(bsl_pageDone_t callback, void *arg);
+
+/// get number of retried transactions of calling thread
+uint32_t bsl_getRetryCount(void);
 
 
 /// synchronize to microcontroller BSL
 uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose);
 
+/// synchronize to microcontroller BSL directly after reset, without fixed delays
+uint8_t bsl_syncFast(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose);
+
 /// determine UART mode
 uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose);
 
 /// get microcontroller type and BSL version
 uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int *flashsize, uint8_t *versBSL, uint8_t *family, uint8_t verbose);
 
+/// confirm known device identity with fewer probes than bsl_getInfo()
+uint8_t bsl_checkInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int flashsize, uint8_t versBSL, uint8_t family, uint8_t verbose);
+
+/// find RAM routine for device in table. Return NULL if device is not supported
+const RamRoutine_s* bsl_findRoutine(const RamDevice_s *table, int numEntries, uint8_t family, int flashsize, uint8_t versBSL);
+
+/// convert precompiled RAM routine to memory image
+void bsl_routineImage(const RamRoutine_s *routine, MemoryImage_s *image);
+
 /// upload RAM routines required for flash write & erase
 uint8_t bsl_uploadWriteErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int flashsize, uint8_t versBSL, uint8_t family, uint8_t verbose);
 
@@ -64,11 +159,17 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ME
 /// erase microcontroller flash sector
 uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addr, uint8_t verbose);
 
+/// erase multiple microcontroller flash sectors
+uint8_t bsl_flashSectorsErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const uint8_t *sectors, int numSectors, uint8_t verbose);
+
 /// mass erase microcontroller P- and D-flash
 uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t verbose);
 
+/// widen partial flash pages to full aligned pages
+uint8_t bsl_memAlign(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, uint8_t alignMode, uint8_t alignPad, uint8_t verbose);
+
 /// upload to microcontroller flash or RAM
-uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t verbose);
+uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t writeMode, uint8_t verbose);
 
 /// verify microcontroller memory content vs. or RAM image
 uint8_t bsl_memVerifyRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t verbose);
@@ -0,0 +1,31 @@
+/**
+  \file delta.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of delta flashing
+
+  declaration of routines to remove flash blocks from a memory image, which
+  already have identical content in the device.
+*/
+
+// for including file only once
+#ifndef _DELTA_H_
+#define _DELTA_H_
+
+// include files
+#include <stdint.h>
+#include "serial_comm.h"
+#include "memory_image.h"
+
+// block sizes for delta flashing
+#define DELTA_OFF       0         // write complete image (default)
+#define DELTA_PAGE      128       // compare in 128B flash pages
+#define DELTA_SECTOR    1024      // compare in 1kB flash sectors
+
+/// remove flash blocks with identical device content from memory image
+uint8_t delta_filter(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, int blockSize, uint8_t verbose);
+
+#endif // _DELTA_H_
+
+// end of file
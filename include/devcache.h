@@ -0,0 +1,32 @@
+/**
+  \file devcache.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of device identity cache
+
+  declaration of routines to store the identity of the device connected to a
+  port in a cache file, to shorten device identification on next connect.
+*/
+
+// for including file only once
+#ifndef _DEVCACHE_H_
+#define _DEVCACHE_H_
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+
+// cache parameters
+#define DEVCACHE_MAX        64    // max. number of ports in cache file
+#define DEVCACHE_NAMELEN    256   // max. length of port name
+
+/// get cached device identity for port. Return false if port is not in cache
+bool devcache_load(const char *filename, const char *portname, int *flashsize, uint8_t *versBSL, uint8_t *family);
+
+/// store device identity for port in cache file
+void devcache_store(const char *filename, const char *portname, int flashsize, uint8_t versBSL, uint8_t family);
+
+#endif // _DEVCACHE_H_
+
+// end of file
@@ -0,0 +1,60 @@
+/**
+  \file discover.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of STM8 bootloader discovery
+
+  declaration of routines to find serial ports with an STM8 in bootloader mode.
+  Candidate ports are enumerated (Linux via sysfs incl. USB IDs) and probed
+  concurrently with a short SYNCH/GET exchange.
+*/
+
+// for including file only once
+#ifndef _DISCOVER_H_
+#define _DISCOVER_H_
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "misc.h"
+#include "serial_comm.h"
+
+/// max. number of probed ports
+#define DISCOVER_MAX          64
+
+/// max. length of port names and adapter serial numbers
+#define DISCOVER_NAMELEN      256
+
+
+/// candidate port and result of probe
+typedef struct {
+  char          portname[DISCOVER_NAMELEN]; //< name of port, e.g. /dev/ttyUSB0 or COM3
+  uint16_t      vid;                //< USB vendor ID, 0 if unknown
+  uint16_t      pid;                //< USB product ID, 0 if unknown
+  char          serial[DISCOVER_NAMELEN];   //< serial number of USB adapter, '-' if unknown
+  uint32_t      baudrate;           //< probe baudrate
+  uint8_t       resetSTM8;          //< reset method: 0=skip, 2=DTR, 6=RTS
+  bool          lowLatency;         //< reduce latency of USB-serial adapter
+  pthread_t     thread;             //< probe thread
+  HANDLE        ptrPort;            //< port handle during probe
+  bool          found;              //< STM8 bootloader responded
+  uint8_t       uartMode;           //< UART mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  uint8_t       family;             //< device family
+  int           flashsize;          //< size of flash [kB]
+  uint8_t       versBSL;            //< BSL version
+  char          errMsg[ERRMSG_LEN]; //< error message if not found
+  uint64_t      tStart, tStop;      //< start and stop time [ms]
+} DiscoverPort_s;
+
+
+/// get candidate ports. Enumerate serial devices for "all", else comma separated names or patterns
+int discover_ports(const char *list, DiscoverPort_s *ports, int maxPorts);
+
+/// probe all ports concurrently and print responding targets. Return number of found targets
+int discover_run(DiscoverPort_s *ports, int numPorts, uint32_t baudrate, uint8_t resetSTM8, uint8_t verbose);
+
+#endif // _DISCOVER_H_
+
+// end of file
@@ -0,0 +1,41 @@
+/**
+  \file erase_plan.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of flash erase planner
+
+  declaration of routines to erase the flash sectors covered by a memory image
+  with a minimum number of ERASE commands.
+*/
+
+// for including file only once
+#ifndef _ERASE_PLAN_H_
+#define _ERASE_PLAN_H_
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_comm.h"
+#include "memory_image.h"
+
+// erase planner modes (cumulative)
+#define ERASE_PLAN_OFF      0     // don't erase before upload (default)
+#define ERASE_PLAN_SECTORS  1     // erase all flash sectors completely covered by image
+#define ERASE_PLAN_BLANK    2     // as ERASE_PLAN_SECTORS, but skip sectors which are already blank
+#define ERASE_PLAN_MASS     3     // as ERASE_PLAN_BLANK, but use mass erase if faster. Note: also erases EEPROM!
+
+// erased flash value and erase time estimates
+#define ERASE_VALUE         0x00  // value of erased STM8 flash
+#define ERASE_TIME_FRAME    5     // est. overhead [ms] of one ERASE command
+#define ERASE_TIME_MASS     26    // est. mass erase time [ms] per kB flash (measured 3.3s for 128kB)
+
+/// mark P-flash sectors completely covered by memory image. Return number of marked sectors
+int erase_plan_sectors(const MemoryImage_s *image, int flashsize, bool *plan, int *numPartial);
+
+/// erase flash sectors covered by memory image
+uint8_t erase_plan(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t mode, uint8_t verbose);
+
+#endif // _ERASE_PLAN_H_
+
+// end of file
@@ -0,0 +1,63 @@
+/**
+  \file gang.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of gang programming
+
+  declaration of routines for programming several STM8 devices on separate
+  UART ports concurrently. The memory image is imported only once and shared
+  read-only between worker threads, which use the library API (see stm8gal.h).
+*/
+
+// for including file only once
+#ifndef _GANG_H_
+#define _GANG_H_
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "misc.h"
+#include "memory_image.h"
+#include "stm8gal.h"
+
+/// max. number of ports in gang
+#define GANG_MAX_PORTS    32
+
+/// max. length of port names in gang
+#define GANG_NAMELEN      256
+
+
+/// gang job. Identical for all ports and read-only during programming
+typedef struct {
+  const MemoryImage_s *image;       //< memory image to upload (shared)
+  stm8gal_config_s  config;         //< session parameters for all ports
+  bool      massErase;              //< mass erase flash before upload
+  uint64_t  jumpAddr;               //< address to jump to after upload, 0xFFFFFFFFFFFFFFFF=skip
+} GangJob_s;
+
+
+/// gang session of a single port
+typedef struct {
+  char          portname[GANG_NAMELEN]; //< name of communication port
+  const GangJob_s *job;             //< job to execute (shared)
+  pthread_t     thread;             //< worker thread
+  uint8_t       result;             //< 0=passed, 1=failed
+  char          errMsg[ERRMSG_LEN]; //< error message if failed
+  int           flashsize;          //< size of flash [kB]
+  uint8_t       versBSL;            //< BSL version
+  uint8_t       family;             //< device family
+  uint64_t      tStart, tStop;      //< start and stop time [ms]
+} GangSession_s;
+
+
+/// get list of ports from comma separated names or patterns
+int gang_ports(const char *list, char ports[][GANG_NAMELEN], int maxPorts);
+
+/// program all ports concurrently, return number of failed sessions
+int gang_run(char ports[][GANG_NAMELEN], int numPorts, const GangJob_s *job, uint8_t verbose);
+
+#endif // _GANG_H_
+
+// end of file
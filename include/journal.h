@@ -0,0 +1,57 @@
+/**
+  \file journal.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of progress journal
+
+  declaration of routines to record the progress of a flash upload in a
+  journal file and to resume an interrupted upload from it.
+*/
+
+// for including file only once
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+// include files
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_comm.h"
+#include "memory_image.h"
+
+// journal parameters
+#define JOURNAL_NAMELEN     256   // max. length of journal file name
+#define JOURNAL_BATCH       32    // number of acknowledged pages per journal write
+#define JOURNAL_LINELEN     40    // max. length of a journal line
+
+/// state of progress journal for one memory image
+typedef struct {
+  char            filename[JOURNAL_NAMELEN];  //< name of journal file
+  FILE            *fp;                        //< journal file, opened by journal_begin()
+  uint32_t        hash;                       //< CRC32 of imported memory image (before alignment)
+  MemoryImage_s   confirmed;                  //< pages acknowledged in previous run (data is dummy)
+  bool            erased;                     //< sectors covered by image were erased in previous run
+  char            buf[JOURNAL_BATCH*JOURNAL_LINELEN];  //< pending page lines
+  int             lenBuf;                     //< length of pending lines
+  int             numPending;                 //< number of pending pages
+} Journal_s;
+
+/// open journal file for imported memory image. Load progress of previous run for same image and options
+uint8_t journal_begin(Journal_s *journal, const char *filename, const MemoryImage_s *image, uint8_t erasePlan, uint8_t alignMode, uint8_t alignPad, uint8_t verbose);
+
+/// verify pages confirmed in previous run against device and remove them from memory image
+uint8_t journal_resume(Journal_s *journal, HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, uint8_t verbose);
+
+/// record flash sectors covered by memory image as erased
+void journal_erased(Journal_s *journal, const MemoryImage_s *image, int flashsize);
+
+/// record page acknowledged by BSL. Callback for bsl_setPageDone()
+void journal_pageDone(void *arg, MEMIMAGE_ADDR_T addrPage, int lenPage);
+
+/// flush and close journal. After successful upload delete journal file
+void journal_end(Journal_s *journal, bool complete);
+
+#endif // _JOURNAL_H_
+
+// end of file
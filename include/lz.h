@@ -0,0 +1,34 @@
+/**
+  \file lz.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of LZ compression for flash frames
+
+  declaration of a byte oriented LZ77 variant for compressing upload frames.
+  The format is designed for a small decompressor on the STM8, see
+  include/RAM_Routines/stage2. Both routines are pure, i.e. without I/O.
+*/
+
+// for including file only once
+#ifndef _LZ_H_
+#define _LZ_H_
+
+// include files
+#include <stdint.h>
+
+// format: control byte c<0x80 -> c+1 literals follow; c>=0x80 -> copy (c&0x7F)+3 bytes from offset byte+1 back
+#define LZ_MAX_LITERAL    128       //< max. number of literals per control byte
+#define LZ_MIN_MATCH      3         //< min. length of match
+#define LZ_MAX_MATCH      130       //< max. length of match
+#define LZ_WINDOW         256       //< max. match offset
+
+/// compress buffer. Return compressed length, or -1 if result exceeds maxDst
+int lz_compress(const uint8_t *src, int lenSrc, uint8_t *dst, int maxDst);
+
+/// decompress buffer. Return decompressed length, or -1 if data is corrupt or result exceeds maxDst
+int lz_decompress(const uint8_t *src, int lenSrc, uint8_t *dst, int maxDst);
+
+#endif // _LZ_H_
+
+// end of file
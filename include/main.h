@@ -73,6 +73,18 @@ global bool           g_pauseOnExit;
 /// optimize for background operation, e.g. skip prompts and console colors
 global bool           g_backgroundOperation;
 
+/// max. number of retries of a failed WRITE, READ or ERASE transaction (UART only, see bootloader.c). Per thread for library sessions
+global __thread uint8_t g_retryMax;
+
+/// reduce latency of USB-serial adapters in init_port() (Linux, see serial_comm.c). Per thread for library sessions
+global __thread bool    g_lowLatency;
+
+/// use I/O thread with ring buffers for port access (Posix, see serial_comm.c). Per thread for library sessions
+global __thread bool    g_ioThread;
+
+/// connect without fixed delays after reset, see bsl_syncFast(). Per thread for library sessions
+global __thread bool    g_fastConnect;
+
 // undefine global keyword
 #undef global
 
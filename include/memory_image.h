@@ -102,6 +102,14 @@ void MemoryImage_print(const MemoryImage_s* image, FILE* fp);
 /// @return operation successful
 bool MemoryImage_addData(MemoryImage_s* image, const MEMIMAGE_ADDR_T address, const uint8_t data);
 
+/// @brief add consecutive bytes starting at specified address in memory image. Existing data is overwritten
+/// @param      image     pointer to memory image
+/// @param[in]  address   address of first byte
+/// @param[in]  data      data to add
+/// @param[in]  len       number of bytes to add
+/// @return operation successful
+bool MemoryImage_addBlock(MemoryImage_s* image, const MEMIMAGE_ADDR_T address, const uint8_t *data, const size_t len);
+
 /// @brief remove byte from specified address in memory image
 /// @param      image     pointer to memory image
 /// @param[in]  address   address to remove entry from
@@ -21,6 +21,8 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <setjmp.h>
+#include "memory_image.h"
 
 
 // color codes 
@@ -34,6 +36,21 @@
 #define PRM_COLOR_YELLOW        7
 
 
+/// max. length of error message stored in error trap
+#define ERRMSG_LEN              200
+
+/// max. number of buffers owned by a thread at the same time, see ownBuffer()
+#define OWNED_MAX               16
+
+/// error trap. If set for the calling thread, Error() stores the message and returns to setjmp() instead of terminating
+typedef struct ErrorTrap_s {
+  jmp_buf             env;              //< context to return to via longjmp()
+  char                msg[ERRMSG_LEN];  //< error message
+  struct ErrorTrap_s  *prev;            //< enclosing error trap, i.e. next on stack of active traps (set by setErrorTrap())
+  int                 numOwned;         //< number of owned buffers when trap was set (set by setErrorTrap())
+} ErrorTrap_s;
+
+
 // system specific delay routines [ms]
 #if defined(WIN32) || defined(WIN64)
   #include <windows.h>
@@ -52,6 +69,18 @@ void Error(const char *format, ...);
 /// terminate program after cleaning up
 void Exit(uint8_t code, uint8_t pause);
 
+/// set (or clear with NULL) error trap for calling thread, return previous trap
+ErrorTrap_s* setErrorTrap(ErrorTrap_s *trap);
+
+/// register malloc()'ed buffer to be released if Error() returns to an error trap
+void ownBuffer(void *buf);
+
+/// register memory image to be released if Error() returns to an error trap
+void ownImage(MemoryImage_s *image);
+
+/// unregister buffer or memory image after regular release
+void disown(void *ptr);
+
 /// strip path from application name
 void stripPath(char *in, char *out);
 
@@ -38,11 +38,35 @@
   #include <string.h>
   #include <sys/ioctl.h>
   #include <unistd.h>
+  #include <poll.h>
 
 #else
   #error OS not supported
 #endif
 
+// low-latency mode (Posix only)
+#define PORT_CONTEXT_MAX    256     // max. file descriptor with cached port attributes. Higher use termios calls
+#define PORT_LATENCY        1       // latency timer [ms] of USB-serial adapter in low-latency mode
+#define PORT_ECHO_MAX       300     // max. pending 1-wire echo [B], checked with next receive_port(). Longest frame 266B (stage-2)
+
+// optional I/O thread with lock-free ring buffers (Posix only). Sizes must be powers of 2
+#define PORT_IO_RX_SIZE     65536   // size of receive ring [B]
+#define PORT_IO_TX_SIZE     16384   // size of transmit ring [B]
+#define PORT_IO_CHUNK       4096    // max. bytes per read() or write() of I/O thread
+
+// network serial servers via port name 'tcp://host:port' or 'rfc2217://host:port' (Posix only)
+#define PORT_SERIAL         0       // local serial port
+#define PORT_TCP            1       // raw TCP, e.g. ser2net raw mode. No baudrate or DTR/RTS control
+#define PORT_RFC2217        2       // TCP with telnet COM port control (RFC 2217) for baudrate, parity and DTR/RTS
+#define PORT_TCP_CONNECT    3000    // max. time [ms] to establish TCP connection
+#define PORT_TCP_LATENCY    50      // assumed max. round trip time [ms] via network incl. delayed ACK, for short timeouts
+
+// arbitrary baudrates via termios2/BOTHER (Linux with generic termios layout only)
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__) || defined(__arm__) || defined(__aarch64__) || defined(__riscv))
+  #define USE_TERMIOS2
+#endif
+#define PORT_BAUD_TOL       3       // max. deviation [%] of actual from requested baudrate
+
 
 /// list all available comm ports
 void        list_ports(void);
@@ -86,6 +110,15 @@ uint32_t    receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *R
 /// flush port buffers
 void        flush_port(HANDLE fpCom);
 
+/// read and discard data until port is quiet. Return number of discarded bytes
+uint32_t    drain_port(HANDLE fpCom, uint32_t quiet, uint32_t maxTime);
+
+/// get additional round trip time [ms] of port, e.g. 0 for local serial port
+uint32_t    get_port_latency(HANDLE fpCom);
+
+/// get number of bytes and time [us] received in UART reply mode (Posix only)
+void        get_reply_stats(HANDLE fpCom, uint32_t *numBytes, uint64_t *duration);
+
 #endif // _SERIAL_COMM_H_
 
 // end of file
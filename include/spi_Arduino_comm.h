@@ -24,6 +24,8 @@
 #define ARDUINO_BAUDRATE             115200 //< USB speed to Arduino
 #define ARDUINO_RESET_PIN            8      //< Arduino pin used for STM8 reset
 #define ARDUINO_CSN_PIN              10     //< Arduino pin used for chip select
+#define ARDUINO_BOOT_MAX             3000   //< max. duration [ms] of Arduino bootloader after opening port
+#define ARDUINO_PING_TIMEOUT         50     //< response timeout [ms] while waiting for Arduino
 
 #define ARDUINO_CMD_CONFIG_SPI       0x00   //< configure SPI, e.g. baudrate and poratity
 #define ARDUINO_CMD_SET_PIN          0x01   //< set state of pin, e.g chip select or reset
@@ -51,6 +53,9 @@ void      configSPI_Arduino(HANDLE fp, uint32_t baudrateSPI, uint8_t bitOrder, u
 /// set pin on Arduino SPI bridge
 void      setPin_Arduino(HANDLE fp, uint8_t pin, uint8_t state);
 
+/// wait until Arduino SPI bridge responds after opening port. Return wait time [ms]
+uint32_t  waitReady_Arduino(HANDLE fp);
+
 /// send/receive SPI frames via Arduino USB<->SPI bridge
 uint32_t  sendReceiveSPI_Arduino(HANDLE fp, uint8_t pin, uint32_t lenFrame, char *bufTx, char *bufRx);
 
@@ -49,6 +49,19 @@
     #error OS not supported
   #endif
   
+  // batched transactions, see transfer_spi_spidev()
+  #define SPIDEV_SEGMENTS_MAX   8       //< max. number of segments per SPI message
+  #define SPIDEV_DELAY_ACK      50      //< delay [us] after frame until BSL response is read
+  #define SPIDEV_DELAY_FRAME    10      //< delay [us] after response until next frame is sent
+  
+  /// segment of a batched SPI transaction. Chip select is released after each segment
+  typedef struct {
+    char        *Tx;            //< bytes to send, or NULL to send dummy bytes
+    char        *Rx;            //< buffer for received bytes, or NULL to discard
+    uint32_t    len;            //< number of bytes
+    uint16_t    delay;          //< delay [us] after segment
+  } SpidevSegment_s;
+  
   
   /// init SPI port
   HANDLE      init_spi_spidev(const char *port, uint32_t baudrate);
@@ -65,6 +78,9 @@
   /// send & receive data via SPI (parallel send)
   void        spi_transfer(HANDLE fp, int len, uint8_t *Tx, uint8_t *Rx);
   
+  /// send & receive multiple segments in a single SPI message. Return number of transferred bytes
+  uint32_t    transfer_spi_spidev(HANDLE fp, int numSeg, const SpidevSegment_s *seg);
+  
 #endif // USE_SPIDEV
   
 #endif // _SPI_SPIDEV_COMM_H_
@@ -0,0 +1,71 @@
+/**
+  \file stage2.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of second-stage RAM loader protocol
+
+  declaration of routines to upload a second-stage loader to STM8 RAM via the
+  ROM bootloader, switch to a higher baudrate and stream CRC protected frames
+  to it with windowed acknowledge. See include/RAM_Routines/stage2 for the
+  STM8 side of the protocol.
+*/
+
+// for including file only once
+#ifndef _STAGE2_H_
+#define _STAGE2_H_
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_comm.h"
+#include "memory_image.h"
+
+// RAM layout of loader. Replaces the w/e routines of the ROM bootloader
+#define S2_ADDR_PARAM     0x00A0    //< parameter block written by host: BRR1, BRR2, family, flash block size
+#define S2_ADDR_START     0x00A4    //< entry address of loader code
+#define S2_FMASTER        16000000  //< STM8 master clock [Hz] while ROM bootloader is active (HSI)
+#define S2_BAUD_TOL       2         //< max. baudrate deviation [%] due to BRR resolution
+#define S2_OPT_START      0x4800    //< first option byte, not programmed by loader
+#define S2_OPT_END        0x48FF    //< last option byte, not programmed by loader
+#define S2_ADDR_MAX       0xFFFF    //< highest address supported by loader (16-bit pointers)
+
+// protocol constants
+#define S2_VERSION        0x10      //< protocol version reported by loader
+#define S2_SYNC           0x7F      //< handshake byte, loader replies with S2_ACK + S2_VERSION
+#define S2_SOF            0xA5      //< start of frame
+#define S2_ACK            0x79      //< frame acknowledge, followed by sequence number
+#define S2_NACK           0x1F      //< frame rejected (CRC or verify failure), followed by expected sequence number
+#define S2_CMD_WRITE      0x31      //< program data to flash or EEPROM
+#define S2_CMD_WRITE_LZ   0x32      //< decompress data (see lz.h) and program to flash or EEPROM
+#define S2_CMD_GO         0x21      //< jump to address
+
+// frame format: SOF, seq, cmd, addr[3], len[2], data[len], crc16[2] (CRC16-CCITT over seq..data)
+#define S2_FRAME_MAX      256       //< max. data per frame. Frames never cross a multiple of this size
+#define S2_OVERHEAD       10        //< frame bytes beside data
+#define S2_WINDOW         2         //< max. frames in flight (loader has 2 receive buffers)
+#define S2_DEADLINE       2000      //< max. duration [ms] until frame is acknowledged (byte programming 256B)
+#define S2_SYNC_RETRY     10        //< max. number of handshake attempts after baudrate switch
+
+/// state of stage-2 loader session
+typedef struct {
+  bool            active;         //< loader is running, ROM bootloader no longer available
+  HANDLE          port;           //< communication port
+  uint8_t         uartMode;       //< UART mode: 0=duplex, 1=1-wire
+  uint32_t        baudrate;       //< baudrate of loader
+  uint8_t         seq;            //< sequence number of next frame
+  int             window;         //< max. frames in flight (1 for 1-wire)
+} Stage2_s;
+
+/// upload stage-2 loader from IHX file, start it and switch to its baudrate
+uint8_t stage2_start(Stage2_s *stage2, HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const char *filename, uint32_t baudrate, uint8_t family, int flashsize, uint8_t verbose);
+
+/// upload memory image to flash or EEPROM via stage-2 loader
+uint8_t stage2_memWrite(Stage2_s *stage2, const MemoryImage_s *image, bool compress, uint8_t verbose);
+
+/// jump to flash or RAM via stage-2 loader
+uint8_t stage2_jumpTo(Stage2_s *stage2, MEMIMAGE_ADDR_T addr, uint8_t verbose);
+
+#endif // _STAGE2_H_
+
+// end of file
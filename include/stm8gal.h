@@ -0,0 +1,105 @@
+/**
+  \file stm8gal.h
+
+  \author G. Icking-Konert
+
+  \brief declaration of stm8gal library API
+
+  declaration of a reentrant API for embedding STM8 bootloader access into other
+  applications, see 'make library'. Each connected device is handled by an opaque
+  session. Errors are returned as codes instead of terminating the process.
+  Sessions are independent and may be used concurrently from different threads.
+  Calls on the same session are serialized.
+*/
+
+// for including file only once
+#ifndef _STM8GAL_H_
+#define _STM8GAL_H_
+
+// include files
+#include <stdint.h>
+#include <stdbool.h>
+#include "memory_image.h"
+
+
+/// return codes of library functions
+typedef enum {
+  STM8GAL_OK = 0,           //< success
+  STM8GAL_ERR_PARAM,        //< invalid parameter or session
+  STM8GAL_ERR_PORT,         //< cannot open or access port
+  STM8GAL_ERR_SYNC,         //< no response from bootloader
+  STM8GAL_ERR_COMM,         //< communication failed, e.g. NACK or timeout
+  STM8GAL_ERR_FILE,         //< cannot import file
+  STM8GAL_ERR_VERIFY,       //< verify after write failed
+  STM8GAL_ERR_MEMORY        //< out of memory
+} stm8gal_error_t;
+
+
+/// session parameters. Initialize with stm8gal_defaultConfig()
+typedef struct {
+  uint8_t   physInterface;  //< bootloader interface: 0=UART, 1=SPI via Arduino, 2=SPI via spidev
+  uint32_t  baudrate;       //< communication baudrate [Baud]
+  uint8_t   uartMode;       //< UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply, other=auto-detect
+  uint8_t   resetSTM8;      //< reset STM8: 0=skip, 2=DTR line, 3=send 'Re5eT!', 4=Arduino pin 8, 6=RTS line
+  uint8_t   writeMode;      //< transfer mode for write: 0=lock-step, 1=pipelined (see bootloader.h)
+  uint8_t   verifyUpload;   //< verify method after write (0=skip, 1=CRC32, 2=read-out)
+  uint8_t   alignMode;      //< align partial flash pages before write (see bootloader.h)
+  uint8_t   alignPad;       //< pad value for alignMode==ALIGN_PAD
+  uint8_t   erasePlan;      //< erase sectors covered by write (see erase_plan.h)
+  int       deltaBlock;     //< only write flash blocks with changed content (see delta.h)
+  uint8_t   retry;          //< max. number of retries per failed WRITE/READ/ERASE transaction (UART only)
+  bool      lowLatency;     //< reduce latency of USB-serial adapter (Linux only, see serial_comm.c)
+  bool      ioThread;       //< access port via I/O thread with ring buffers (Posix only, see serial_comm.c)
+  bool      fastConnect;    //< connect without fixed delays after reset (see bsl_syncFast())
+} stm8gal_config_s;
+
+
+/// opaque session handle
+typedef struct stm8gal_session_s stm8gal_session_s;
+
+/// progress callback with stage ("read" or "write"), bytes done and total
+typedef void (*stm8gal_progress_t)(void *arg, const char *stage, uint32_t done, uint32_t total);
+
+
+/// set default session parameters
+void stm8gal_defaultConfig(stm8gal_config_s *config);
+
+/// open port, synchronize with bootloader and prepare flash write. Always release session with stm8gal_close()
+stm8gal_error_t stm8gal_open(stm8gal_session_s **session, const char *port, const stm8gal_config_s *config);
+
+/// close port and release session
+void stm8gal_close(stm8gal_session_s *session);
+
+/// get message of last error in session
+const char* stm8gal_errorMessage(const stm8gal_session_s *session);
+
+/// set (or clear with NULL) progress callback of session
+void stm8gal_setProgress(stm8gal_session_s *session, stm8gal_progress_t callback, void *arg);
+
+/// get device family, flash size [kB] and BSL version
+stm8gal_error_t stm8gal_getInfo(stm8gal_session_s *session, uint8_t *family, int *flashsize, uint8_t *versBSL);
+
+/// write memory image to device and optionally verify
+stm8gal_error_t stm8gal_writeImage(stm8gal_session_s *session, const MemoryImage_s *image);
+
+/// import file (*.s19, *.hex, *.ihx, *.txt, *.bin) and write to device
+stm8gal_error_t stm8gal_writeFile(stm8gal_session_s *session, const char *filename, uint64_t addrOffset);
+
+/// read device memory into image
+stm8gal_error_t stm8gal_read(stm8gal_session_s *session, uint64_t addrStart, uint64_t addrStop, MemoryImage_s *image);
+
+/// erase flash sector containing address
+stm8gal_error_t stm8gal_eraseSector(stm8gal_session_s *session, uint64_t addr);
+
+/// mass erase P- and D-flash
+stm8gal_error_t stm8gal_eraseMass(stm8gal_session_s *session);
+
+/// jump to address, e.g. start application. Reconnect session afterwards
+stm8gal_error_t stm8gal_jump(stm8gal_session_s *session, uint64_t addr);
+
+/// reset and re-synchronize session, e.g. after stm8gal_jump() or for next device on same port
+stm8gal_error_t stm8gal_reconnect(stm8gal_session_s *session);
+
+#endif // _STM8GAL_H_
+
+// end of file
@@ -14,6 +14,7 @@
 
 // include files
 #include <stdint.h>
+#include <stdbool.h>
 #include "serial_comm.h"
 #include "memory_image.h"
 
@@ -23,6 +24,15 @@
 #define ADDR_STOP_CRC32   0x2F8    // location of CRC32 stop address (@ 0x2F8 - 0x2FB)
 #define RESULT_CRC32      0x2FC    // location of calculated CRC32 checksum (@ 0x2FC - 0x2FF)
 
+/// check if CRC32 RAM routine is available for device
+bool support_crc32(uint8_t family, int flashsize, uint8_t versBSL);
+
+/// upload device dependent CRC32 RAM routine
+uint8_t upload_crc32_code(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode);
+
+/// calculate CRC32 over microcontroller memory range via RAM routine. Code must be uploaded before
+uint8_t calc_crc32(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, uint32_t *CRC32);
+
 /// compare CRC32 over microcontroller memory vs. CRC32 over RAM image
 uint8_t verify_crc32(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t verbose);
 
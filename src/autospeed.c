@@ -0,0 +1,341 @@
+/**
+  \file autospeed.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of automatic link speed selection
+
+  implementation of routines to find the fastest reliable baudrate of a port.
+  Candidate rates are probed from fast to slow via the library API (see
+  stm8gal.c), i.e. a failed probe returns an error instead of terminating the
+  program. Each probe connects at the candidate rate (UART: reset and bsl_sync()
+  auto-baud; SPI: host sets clock, e.g. SPI_IOC_WR_MAX_SPEED_HZ for spidev) and
+  reads back flash several times. The rate is accepted if all reads succeed
+  with identical CRC32. The result is cached per port and adapter serial number,
+  so that the next run starts with the known-good rate.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "main.h"
+#include "misc.h"
+#include "serial_comm.h"
+#include "bootloader.h"
+#include "memory_image.h"
+#include "stm8gal.h"
+#include "autospeed.h"
+
+
+/// candidate UART baudrates, fastest first. Without termios2 Posix only supports standard rates up to 230400 (see set_port_attribute())
+#if defined(USE_TERMIOS2) || defined(WIN32) || defined(WIN64)
+  static const uint32_t s_rateUART[] = {1000000, 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600};
+#else
+  static const uint32_t s_rateUART[] = {230400, 115200, 57600, 38400, 19200, 9600};
+#endif
+
+/// candidate SPI clocks, fastest first
+static const uint32_t s_rateSPI[]  = {8000000, 4000000, 2000000, 1000000, 500000, 250000};
+
+
+/// cache entry for one port and adapter
+typedef struct {
+  char      portname[AUTOSPEED_NAMELEN];  //< name of port
+  char      serial[AUTOSPEED_NAMELEN];    //< serial number of adapter, '-' if unknown
+  uint32_t  baudrate;                     //< fastest reliable baudrate
+} AutoSpeedEntry_s;
+
+
+
+/**
+  \fn static void autospeed_adapter(const char *portname, char *serial)
+
+  \param[in]  portname    name of port
+  \param[out] serial      serial number of USB adapter, or '-' if unknown (buffer size AUTOSPEED_NAMELEN)
+
+  Get serial number of USB adapter of port from sysfs (Linux only). Resolves
+  links like /dev/serial/by-id/... to the tty device
+*/
+static void autospeed_adapter(const char *portname, char *serial)
+{
+  strcpy(serial, "-");
+
+  #if defined(__linux__)
+    char        real[PATH_MAX], path[PATH_MAX+64];
+    const char  *name;
+    FILE        *fp;
+
+    if (realpath(portname, real) == NULL)
+      return;
+    name = strrchr(real, '/');
+    name = (name != NULL) ? name+1 : real;
+
+    // USB serial numbers are stored with USB device, i.e. above interface (ttyACM) or above interface and port (ttyUSB)
+    const char *parent[] = {"..", "../.."};
+    for (int i = 0; i < 2; i++)
+    {
+      snprintf(path, sizeof(path), "/sys/class/tty/%s/device/%s/serial", name, parent[i]);
+      fp = fopen(path, "r");
+      if (fp == NULL)
+        continue;
+      if (fscanf(fp, "%255s", serial) != 1)
+        strcpy(serial, "-");
+      fclose(fp);
+      return;
+    }
+  #else
+    (void) portname;
+  #endif
+
+} // autospeed_adapter
+
+
+
+/**
+  \fn static int autospeed_read(const char *filename, AutoSpeedEntry_s *entries)
+
+  \param[in]  filename    name of cache file
+  \param[out] entries     cache entries (max. AUTOSPEED_MAX)
+
+  \return number of entries
+
+  Read all entries of cache file. Skip comments and malformed lines
+*/
+static int autospeed_read(const char *filename, AutoSpeedEntry_s *entries)
+{
+  FILE      *fp;
+  char      line[2*AUTOSPEED_NAMELEN+50];
+  int       numEntries = 0;
+
+  // no cache file yet
+  fp = fopen(filename, "r");
+  if (fp == NULL)
+    return 0;
+
+  // one port and adapter per line
+  while ((numEntries < AUTOSPEED_MAX) && (fgets(line, sizeof(line), fp) != NULL))
+  {
+    AutoSpeedEntry_s *entry = &(entries[numEntries]);
+    if (line[0] == '#')
+      continue;
+    if ((sscanf(line, "%255s %255s %u", entry->portname, entry->serial, &(entry->baudrate)) != 3) || (entry->baudrate == 0))
+      continue;
+    numEntries++;
+  }
+  fclose(fp);
+
+  return numEntries;
+
+} // autospeed_read
+
+
+
+/**
+  \fn static void autospeed_store(const char *filename, const char *portname, const char *serial, uint32_t baudrate)
+
+  \param[in]  filename    name of cache file
+  \param[in]  portname    name of port
+  \param[in]  serial      serial number of adapter
+  \param[in]  baudrate    fastest reliable baudrate
+
+  Store baudrate for port and adapter in cache file. If cache is full, replace oldest entry
+*/
+static void autospeed_store(const char *filename, const char *portname, const char *serial, uint32_t baudrate)
+{
+  AutoSpeedEntry_s  entries[AUTOSPEED_MAX];
+  int               numEntries, idx;
+  FILE              *fp;
+
+  // replace entry of port & adapter or append new entry
+  numEntries = autospeed_read(filename, entries);
+  for (idx = 0; (idx < numEntries) && (strcmp(entries[idx].portname, portname) || strcmp(entries[idx].serial, serial)); idx++)
+    ;
+  if (idx == AUTOSPEED_MAX)
+  {
+    memmove(entries, entries+1, (AUTOSPEED_MAX-1)*sizeof(AutoSpeedEntry_s));
+    idx = AUTOSPEED_MAX-1;
+  }
+  else if (idx == numEntries)
+    numEntries++;
+  strncpy(entries[idx].portname, portname, AUTOSPEED_NAMELEN-1);
+  entries[idx].portname[AUTOSPEED_NAMELEN-1] = '\0';
+  strncpy(entries[idx].serial, serial, AUTOSPEED_NAMELEN-1);
+  entries[idx].serial[AUTOSPEED_NAMELEN-1] = '\0';
+  entries[idx].baudrate = baudrate;
+
+  // rewrite cache file
+  fp = fopen(filename, "w");
+  if (fp == NULL)
+    Error("in 'autospeed_store()': cannot write speed cache '%s'", filename);
+  fprintf(fp, "# stm8gal speed cache: port, adapter serial number, baudrate\n");
+  for (int i = 0; i < numEntries; i++)
+    fprintf(fp, "%s %s %u\n", entries[i].portname, entries[i].serial, (unsigned) entries[i].baudrate);
+  fclose(fp);
+
+} // autospeed_store
+
+
+
+/**
+  \fn static bool autospeed_probe(const char *portname, const stm8gal_config_s *config, uint8_t verbose)
+
+  \param[in]  portname    name of port
+  \param[in]  config      session parameters incl. candidate baudrate
+  \param[in]  verbose     verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  \return true if rate is reliable, else false
+
+  Connect at candidate baudrate and read flash AUTOSPEED_ROUNDS times. Rate is
+  reliable if all reads succeed and have the same CRC32
+*/
+static bool autospeed_probe(const char *portname, const stm8gal_config_s *config, uint8_t verbose)
+{
+  stm8gal_session_s   *lib;
+  stm8gal_error_t     result;
+  MemoryImage_s       image;
+  uint32_t            crc = 0;
+  bool                mismatch = false;
+
+  // print message
+  if (verbose >= INFORM) {
+    if (config->baudrate < 1000000L)
+      printf("  probe %gkBaud ... ", (float) config->baudrate / 1000.0);
+    else
+      printf("  probe %gMBaud ... ", (float) config->baudrate / 1000000.0);
+  }
+  fflush(stdout);
+
+  // connect and read same flash range several times
+  result = stm8gal_open(&lib, portname, config);
+  for (int round = 0; (result == STM8GAL_OK) && (round < AUTOSPEED_ROUNDS); round++)
+  {
+    MemoryImage_init(&image);
+    result = stm8gal_read(lib, AUTOSPEED_ADDR, AUTOSPEED_ADDR+AUTOSPEED_LEN-1, &image);
+    if (result == STM8GAL_OK) {
+      uint32_t crcRound = (image.numEntries == AUTOSPEED_LEN) ? MemoryImage_checksum_crc32(&image, 0, image.numEntries-1) : 0;
+      mismatch = (image.numEntries != AUTOSPEED_LEN) || ((round > 0) && (crcRound != crc));
+      crc = crcRound;
+      if (mismatch)
+        result = STM8GAL_ERR_COMM;
+    }
+    MemoryImage_free(&image);
+  }
+
+  // print result
+  if (verbose >= INFORM) {
+    if (result == STM8GAL_OK)
+      printf("ok\n");
+    else if (mismatch)
+      printf("failed (read data mismatch)\n");
+    else
+      printf("failed (%s)\n", stm8gal_errorMessage(lib));
+  }
+  fflush(stdout);
+  stm8gal_close(lib);
+
+  return (result == STM8GAL_OK);
+
+} // autospeed_probe
+
+
+
+/**
+  \fn uint32_t autospeed_select(const char *portname, uint8_t physInterface, uint8_t uartMode, uint8_t resetSTM8, const char *cacheFile, uint8_t verbose)
+
+  \param[in]  portname      name of port
+  \param[in]  physInterface bootloader interface: 0=UART, 1=SPI via Arduino, 2=SPI via spidev
+  \param[in]  uartMode      UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply, other=auto-detect
+  \param[in]  resetSTM8     reset method (see main.c). UART requires automatic reset between probes
+  \param[in]  cacheFile     name of speed cache file, or empty string for no cache
+  \param[in]  verbose       verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  \return selected baudrate
+
+  Find fastest reliable baudrate for port. If a rate is cached for port and
+  adapter, probe it first. Else probe all candidates from fast to slow and
+  cache the first reliable rate. Device is left in bootloader mode, i.e. the
+  caller must reset it again before connecting (UART auto-baud)
+*/
+uint32_t autospeed_select(const char *portname, uint8_t physInterface, uint8_t uartMode, uint8_t resetSTM8, const char *cacheFile, uint8_t verbose)
+{
+  stm8gal_config_s    config;
+  char                serial[AUTOSPEED_NAMELEN];
+  const uint32_t      *rate;
+  int                 numRate;
+
+  // UART BSL locks baudrate at first SYNC -> requires automatic reset before each probe
+  if ((physInterface == UART) && (resetSTM8 != 2) && (resetSTM8 != 3) && (resetSTM8 != 6))
+    Error("automatic baudrate via UART requires reset method 2, 3 or 6");
+  if (physInterface == UART) {
+    rate    = s_rateUART;
+    numRate = sizeof(s_rateUART) / sizeof(s_rateUART[0]);
+  }
+  else {
+    rate    = s_rateSPI;
+    numRate = sizeof(s_rateSPI) / sizeof(s_rateSPI[0]);
+  }
+
+  // print message
+  if (verbose == SILENT)
+    printf("  select baudrate ... ");
+  else if (verbose > SILENT)
+    printf("  select baudrate for '%s'\n", portname);
+  fflush(stdout);
+
+  // probe parameters. Arduino reset via pin 8 is done by library
+  stm8gal_defaultConfig(&config);
+  config.physInterface = physInterface;
+  config.uartMode      = uartMode;
+  config.resetSTM8     = resetSTM8;
+  config.retry         = 0;
+  config.lowLatency    = g_lowLatency;
+  config.ioThread      = g_ioThread;
+  config.fastConnect   = g_fastConnect;
+  autospeed_adapter(portname, serial);
+
+  // start with cached rate of port & adapter
+  if (strlen(cacheFile) != 0) {
+    AutoSpeedEntry_s  entries[AUTOSPEED_MAX];
+    int               numEntries = autospeed_read(cacheFile, entries);
+    for (int i = 0; i < numEntries; i++) {
+      if ((!strcmp(entries[i].portname, portname)) && (!strcmp(entries[i].serial, serial))) {
+        config.baudrate = entries[i].baudrate;
+        if (autospeed_probe(portname, &config, verbose)) {
+          if (verbose == SILENT)
+            printf("done (%gkBaud, cached)\n", (float) config.baudrate / 1000.0);
+          else if (verbose > SILENT)
+            printf("  use cached %gkBaud\n", (float) config.baudrate / 1000.0);
+          fflush(stdout);
+          return config.baudrate;
+        }
+        break;
+      }
+    }
+  }
+
+  // probe candidates from fast to slow. Each failed rate costs a sync timeout
+  for (int i = 0; i < numRate; i++)
+  {
+    config.baudrate = rate[i];
+    if (autospeed_probe(portname, &config, verbose)) {
+      if (strlen(cacheFile) != 0)
+        autospeed_store(cacheFile, portname, serial, config.baudrate);
+      if (verbose == SILENT)
+        printf("done (%gkBaud)\n", (float) config.baudrate / 1000.0);
+      else if (verbose > SILENT)
+        printf("  use %gkBaud (adapter %s)\n", (float) config.baudrate / 1000.0, serial);
+      fflush(stdout);
+      return config.baudrate;
+    }
+  }
+
+  // no reliable rate found
+  Error("no reliable baudrate found for port '%s'", portname);
+  return 0;
+
+} // autospeed_select
+
+
+// end of file
@@ -20,14 +20,425 @@
   #include <wiringPi.h>
 #endif
 
-// device dependent flash w/e routines (from https://github.com/basilhussain/stm8-bootloader-erase-write)
-#include "erase_write_verL_8k_1.0_inc.h"
-#include "erase_write_ver_32k_1.0_inc.h"
-#include "erase_write_ver_32k_1.2_inc.h"
-#include "erase_write_ver_32k_1.3_inc.h"
-#include "erase_write_ver_128k_2.0_inc.h"
-#include "erase_write_ver_128k_2.1_inc.h"
-#include "erase_write_ver_128k_2.2_inc.h"
+// device dependent flash w/e routines (from https://github.com/basilhussain/stm8-bootloader-erase-write). Generated at build time by tools/ram_blobs.py
+#include "ram_write_erase.h"
+
+// w/e RAM routines per device (family 0 = any). STM8L >8kB have w/e routines in ROM
+static const RamDevice_s weTable[] = {
+  { 0,   8, 0x10, &ram_erase_write_verL_8k_1_0 },
+  { 0,  32, 0x10, &ram_erase_write_ver_32k_1_0 },
+  { 0,  32, 0x12, &ram_erase_write_ver_32k_1_2 },
+  { 0,  32, 0x13, &ram_erase_write_ver_32k_1_3 },
+  { 0,  64, 0x20, &ram_erase_write_ver_128k_2_0 },
+  { 0, 128, 0x20, &ram_erase_write_ver_128k_2_0 },
+  { 0,  64, 0x21, &ram_erase_write_ver_128k_2_1 },
+  { 0, 128, 0x21, &ram_erase_write_ver_128k_2_1 },
+  { 0,  64, 0x22, &ram_erase_write_ver_128k_2_2 },
+  { 0, 128, 0x22, &ram_erase_write_ver_128k_2_2 },
+};
+
+
+// durations [ms] measured during session. Used to delay first poll via SPI, see bsl_pollAck(). Per thread for gang mode
+static __thread uint32_t  tLearnWriteAligned   = 0;   //< write 128B aligned flash page
+static __thread uint32_t  tLearnWriteUnaligned = 0;   //< write partial flash page (byte/word programming)
+static __thread uint32_t  tLearnEraseSector    = 0;   //< erase single flash sector
+static __thread uint32_t  tLearnEraseMass      = 0;   //< mass erase
+
+// progress callback of calling thread, see bsl_setProgress()
+static __thread bsl_progress_t  progressCallback = NULL;
+static __thread void            *progressArg     = NULL;
+
+// page acknowledge callback of calling thread, see bsl_setPageDone()
+static __thread bsl_pageDone_t  pageDoneCallback = NULL;
+static __thread void            *pageDoneArg     = NULL;
+
+// w/e RAM routines last uploaded by calling thread, see bsl_uploadWriteErase()
+static __thread HANDLE          wePort           = 0;
+static __thread uint32_t        weCrc32          = 0;
+
+// number of retried transactions of calling thread, see bsl_retryNext()
+static __thread uint32_t        retryCount       = 0;
+
+
+/**
+  \fn static uint32_t bsl_send(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint32_t lenTx, char *Tx)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  lenTx          number of bytes to send
+  \param[in]  Tx             array of bytes to send
+
+  \return number of sent bytes
+
+  send frame to BSL via the selected physical interface
+*/
+static uint32_t bsl_send(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint32_t lenTx, char *Tx)
+{
+  uint32_t  len = 0;
+
+  if (physInterface == UART)
+    len = send_port(ptrPort, uartMode, lenTx, Tx);
+  else if (physInterface == SPI_ARDUINO)
+    len = send_spi_Arduino(ptrPort, lenTx, Tx);
+  #if defined(USE_SPIDEV)
+    else if (physInterface == SPI_SPIDEV)
+      len = send_spi_spidev(ptrPort, lenTx, Tx);
+  #endif
+
+  return len;
+
+} // bsl_send
+
+
+
+/**
+  \fn static uint32_t bsl_receive(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint32_t lenRx, char *Rx)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  lenRx          number of bytes to receive
+  \param[out] Rx             array containing bytes received
+
+  \return number of received bytes
+
+  receive response from BSL via the selected physical interface
+*/
+static uint32_t bsl_receive(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint32_t lenRx, char *Rx)
+{
+  uint32_t  len = 0;
+
+  if (physInterface == UART)
+    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+  else if (physInterface == SPI_ARDUINO)
+    len = receive_spi_Arduino(ptrPort, lenRx, Rx);
+  #if defined(USE_SPIDEV)
+    else if (physInterface == SPI_SPIDEV)
+      len = receive_spi_spidev(ptrPort, lenRx, Rx);
+  #endif
+
+  return len;
+
+} // bsl_receive
+
+
+
+/**
+  \fn static int bsl_frameWrite(const MemoryImage_s *image, MEMIMAGE_ADDR_T addrPage, int lenPage, char *Tx)
+
+  \param[in]  image          memory image containing data to write
+  \param[in]  addrPage       first address of page
+  \param[in]  lenPage        number of bytes in page (1..128)
+  \param[out] Tx             buffer for frame (min. lenPage+2 bytes)
+
+  \return length of frame
+
+  construct WRITE data frame consisting of number of bytes, data and checksum
+*/
+static int bsl_frameWrite(const MemoryImage_s *image, MEMIMAGE_ADDR_T addrPage, int lenPage, char *Tx)
+{
+  int       lenTx = 0, j;
+  uint8_t   chk;
+
+  // construct number of bytes + data + checksum
+  Tx[lenTx++] = lenPage-1;     // -1 from BSL
+  chk         = lenPage-1;
+  for (j=0; j<lenPage; j++)
+  {
+    MemoryImage_getData(image, addrPage+j, (uint8_t*) (Tx+lenTx));
+    chk ^= Tx[lenTx];
+    lenTx++;
+  }
+  Tx[lenTx++] = chk;
+
+  return lenTx;
+
+} // bsl_frameWrite
+
+
+
+/**
+  \fn static int bsl_frameAddress(MEMIMAGE_ADDR_T addr, char *Tx)
+
+  \param[in]  addr           address to send
+  \param[out] Tx             buffer for frame (min. 5 bytes)
+
+  \return length of frame
+
+  construct address frame consisting of 4B address (MSB first) and checksum
+*/
+static int bsl_frameAddress(MEMIMAGE_ADDR_T addr, char *Tx)
+{
+  // construct address + checksum (XOR over address)
+  Tx[0] = (char) (addr >> 24);
+  Tx[1] = (char) (addr >> 16);
+  Tx[2] = (char) (addr >> 8);
+  Tx[3] = (char) (addr);
+  Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
+
+  return 5;
+
+} // bsl_frameAddress
+
+
+
+#if defined(USE_SPIDEV)
+
+/**
+  \fn static void bsl_transactSpidev(HANDLE ptrPort, char cmd, MEMIMAGE_ADDR_T addr, char *Tx, int lenTx, char *Rx, int lenRx, const char *caller)
+
+  \param[in]  ptrPort        handle to spidev port
+  \param[in]  cmd            BSL command, e.g. WRITE or READ
+  \param[in]  addr           address for address frame
+  \param[in]  Tx             3rd frame, e.g. number of bytes + data + checksum for WRITE
+  \param[in]  lenTx          length of 3rd frame
+  \param[out] Rx             received ACK1, ACK2 and optionally the response to the 3rd frame
+  \param[in]  lenRx          number of bytes to receive after 3rd frame, e.g. ACK + data for READ. 0=skip
+  \param[in]  caller         name of calling function for error messages
+
+  send BSL transaction via spidev in a single SPI message: command, ACK1 read, address, ACK2 read,
+  3rd frame and optional response read. Each frame is followed by SPIDEV_DELAY_ACK for the BSL to
+  prepare its response. ACKs are checked by the caller. A flash write is not finished within a
+  fixed delay, therefore ACK3 of WRITE is polled separately via bsl_pollAck()
+*/
+static void bsl_transactSpidev(HANDLE ptrPort, char cmd, MEMIMAGE_ADDR_T addr, char *Tx, int lenTx, char *Rx, int lenRx, const char *caller)
+{
+  SpidevSegment_s   seg[6];
+  char              Cmd[2], Addr[5];
+  int               numSeg = 0;
+  uint32_t          len, lenTotal = 0;
+
+  // construct command and address frames
+  Cmd[0] = cmd;
+  Cmd[1] = (cmd ^ 0xFF);
+  bsl_frameAddress(addr, Addr);
+
+  // command, ACK1, address, ACK2, 3rd frame, response (optional)
+  seg[numSeg++] = (SpidevSegment_s) {Cmd,  NULL,   2,     SPIDEV_DELAY_ACK};
+  seg[numSeg++] = (SpidevSegment_s) {NULL, Rx,     1,     SPIDEV_DELAY_FRAME};
+  seg[numSeg++] = (SpidevSegment_s) {Addr, NULL,   5,     SPIDEV_DELAY_ACK};
+  seg[numSeg++] = (SpidevSegment_s) {NULL, Rx+1,   1,     SPIDEV_DELAY_FRAME};
+  seg[numSeg++] = (SpidevSegment_s) {Tx,   NULL,   lenTx, SPIDEV_DELAY_ACK};
+  if (lenRx > 0)
+    seg[numSeg++] = (SpidevSegment_s) {NULL, Rx+2, lenRx, 0};
+  for (int i=0; i<numSeg; i++)
+    lenTotal += seg[i].len;
+
+  // send & receive in a single ioctl
+  len = transfer_spi_spidev(ptrPort, numSeg, seg);
+  if (len != lenTotal)
+    Error("in '%s()': at 0x%04" PRIX64 " SPI transfer failed (expect %d, transferred %d)", caller, (uint64_t) addr, (int) lenTotal, (int) len);
+
+} // bsl_transactSpidev
+
+#endif // USE_SPIDEV
+
+
+
+/**
+  \fn static uint32_t bsl_pollAck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, char *Rx, uint32_t *tLearn, uint32_t deadline)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[out] Rx             received response (1B)
+  \param      tLearn         duration [ms] of last identical operation, is updated on success. NULL: don't learn
+  \param[in]  deadline       max. time [ms] to wait for response
+
+  \return number of received bytes (0 on timeout)
+
+  wait for ACK/NACK after flash write or erase. For UART the response is received with a timeout of
+  deadline, i.e. without dead time. For SPI the BSL returns BUSY until the operation has finished.
+  Here the response is polled with exponentially increasing intervals (POLL_MIN..POLL_MAX) until
+  ACK/NACK is received or the deadline expires. To reduce SPI traffic the first poll is delayed by
+  3/4 of the duration measured for the last identical operation in this session
+*/
+static uint32_t bsl_pollAck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, char *Rx, uint32_t *tLearn, uint32_t deadline)
+{
+  uint64_t  tStart, tNow;
+  uint32_t  len, interval;
+
+  // UART: wait for response with timeout. Is returned as soon as BSL responds
+  if (physInterface == UART)
+  {
+    if (deadline > TIMEOUT)
+      set_timeout(ptrPort, deadline);
+    len = receive_port(ptrPort, uartMode, 1, Rx);
+    if (deadline > TIMEOUT)
+      set_timeout(ptrPort, TIMEOUT);
+    return len;
+  }
+
+  // SPI: skip most of the known duration
+  tStart = millis();
+  if ((tLearn != NULL) && (*tLearn > POLL_MIN))
+    SLEEP((*tLearn * 3) / 4);
+
+  // SPI: poll until response is not BUSY or deadline expired
+  interval = POLL_MIN;
+  while (true)
+  {
+    len = bsl_receive(ptrPort, physInterface, uartMode, 1, Rx);
+    tNow = millis();
+    if ((len == 1) && ((Rx[0] == ACK) || (Rx[0] == NACK)))
+    {
+      if (tLearn != NULL)
+        *tLearn = (uint32_t) (tNow - tStart);
+      return len;
+    }
+    if (tNow - tStart > deadline)
+      return 0;
+
+    // wait with backoff before next poll
+    SLEEP(interval);
+    interval *= 2;
+    if (interval > POLL_MAX)
+      interval = POLL_MAX;
+  }
+
+} // bsl_pollAck
+
+
+
+/**
+  \fn static void bsl_resync(HANDLE ptrPort, uint8_t uartMode)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+
+  re-synchronize BSL command state machine after a failed transaction (UART only). Drain stale
+  responses, then send 0xFF until BSL responds with NACK. A pending frame is completed with a
+  wrong checksum, and 0xFF+0xFF is an invalid command. Unlike 0x00 (see calc_crc32()), 0xFF
+  never yields a valid address frame. Finally send single 0xFF until NACK to leave BSL idle
+*/
+static void bsl_resync(HANDLE ptrPort, uint8_t uartMode)
+{
+  char      Tx[RESYNC_CHUNK], Rx[RESYNC_CHUNK];
+  int       lenChunk, len, i, j;
+  bool      synced = false;
+
+  // use short timeout. 1-wire and reply mode require single bytes
+  set_timeout(ptrPort, RESYNC_TIMEOUT + get_port_latency(ptrPort));
+  lenChunk = (uartMode == 0) ? RESYNC_CHUNK : 1;
+  memset(Tx, 0xFF, RESYNC_CHUNK);
+
+  // drain stale response, e.g. delayed ACK after flash write
+  while (receive_port(ptrPort, uartMode, lenChunk, Rx) > 0)
+    ;
+
+  // complete pending frame until BSL responds with NACK
+  for (i=0; (i<RESYNC_MAX) && (!synced); i+=lenChunk)
+  {
+    send_port(ptrPort, uartMode, lenChunk, Tx);
+    len = receive_port(ptrPort, uartMode, lenChunk, Rx);
+    for (j=0; j<len; j++)
+      synced |= (Rx[j] == NACK);
+  }
+
+  // BSL may wait for complement of a trailing 0xFF -> send single 0xFF until NACK
+  if (synced)
+  {
+    synced = false;
+    while (receive_port(ptrPort, uartMode, lenChunk, Rx) > 0)
+      ;
+    for (i=0; (i<3) && (!synced); i++)
+    {
+      send_port(ptrPort, uartMode, 1, Tx);
+      len = receive_port(ptrPort, uartMode, 1, Rx);
+      synced = ((len == 1) && (Rx[0] == NACK));
+    }
+  }
+
+  // restore default timeout
+  set_timeout(ptrPort, TIMEOUT);
+  if (!synced)
+    Error("in 'bsl_resync()': no response from BSL");
+
+} // bsl_resync
+
+
+
+/**
+  \fn static void bsl_retryNext(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const ErrorTrap_s *trap, ErrorTrap_s *prev, int numRetry)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  trap           error trap of failed transaction
+  \param[in]  prev           error trap of caller
+  \param[in]  numRetry       number of retries so far
+
+  prepare retry of failed transaction by re-synchronizing BSL. If retry is not possible,
+  restore error trap of caller and forward the error message
+*/
+static void bsl_retryNext(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const ErrorTrap_s *trap, ErrorTrap_s *prev, int numRetry)
+{
+  // retry limit reached or not supported -> forward error to caller
+  if ((physInterface != UART) || (numRetry >= g_retryMax))
+  {
+    setErrorTrap(prev);
+    if (numRetry > 0)
+      Error("%s (after %d retries)", trap->msg, numRetry);
+    else
+      Error("%s", trap->msg);
+  }
+
+  // resync BSL for next attempt
+  retryCount++;
+  bsl_resync(ptrPort, uartMode);
+
+} // bsl_retryNext
+
+
+
+/**
+  \fn void bsl_setProgress(bsl_progress_t callback, void *arg)
+
+  \param[in]  callback       function called periodically by bsl_memRead() and bsl_memWrite(), or NULL
+  \param[in]  arg            user argument passed to callback
+
+  set progress callback for the calling thread, e.g. for library sessions (see stm8gal.c)
+*/
+void bsl_setProgress(bsl_progress_t callback, void *arg)
+{
+  progressCallback = callback;
+  progressArg      = arg;
+
+} // bsl_setProgress
+
+
+
+/**
+  \fn void bsl_setPageDone(bsl_pageDone_t callback, void *arg)
+
+  \param[in]  callback       function called by bsl_memWrite() for each page acknowledged by BSL, or NULL
+  \param[in]  arg            user argument passed to callback
+
+  set page acknowledge callback for the calling thread, e.g. for progress journal (see journal.c)
+*/
+void bsl_setPageDone(bsl_pageDone_t callback, void *arg)
+{
+  pageDoneCallback = callback;
+  pageDoneArg      = arg;
+
+} // bsl_setPageDone
+
+
+
+/**
+  \fn uint32_t bsl_getRetryCount(void)
+
+  \return number of retried transactions of calling thread since program start
+
+  get number of WRITE, READ or ERASE transactions which were retried after a failure (see bsl_retryNext())
+*/
+uint32_t bsl_getRetryCount(void)
+{
+  return retryCount;
+
+} // bsl_getRetryCount
+
 
 
 /**
@@ -64,7 +475,7 @@ uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose)
   if (physInterface == UART)
   {
     flush_port(ptrPort);
-    set_timeout(ptrPort, 100);
+    set_timeout(ptrPort, PROBE_TIMEOUT + get_port_latency(ptrPort));
   }
 
   // construct SYNC command. Note: SYNC has even parity -> works in all UART modes
@@ -147,6 +558,111 @@ uint8_t bsl_sync(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose)
 
 
 
+/**
+  \fn uint8_t bsl_syncFast(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  \return synchronization status (0=ok, 1=fail)
+
+  synchronize with microcontroller bootloader directly after reset. Like bsl_sync(), but
+  drain the port until quiet instead of flushing with fixed delays, and repeat SYNCH with
+  short response timeout until the BSL answers within its activation window. Print the
+  connect latency, i.e. time until ACK or NACK
+*/
+uint8_t bsl_syncFast(HANDLE ptrPort, uint8_t physInterface, uint8_t verbose)
+{
+  int       len = 0;
+  char      Tx[1], Rx[1];
+  uint64_t  tStart, latency;
+  uint32_t  delay = 0;
+
+  // print message
+  if (verbose >= SILENT)
+    printf("  synchronize ... ");
+  fflush(stdout);
+
+  // check if port is open
+  if (!ptrPort)
+    Error("in 'bsl_syncFast()': port not open");
+
+  // discard noise after reset and set short receive timeout. Extend for network round trip
+  tStart = micros();
+  if (physInterface == UART)
+  {
+    delay = get_port_latency(ptrPort);
+    drain_port(ptrPort, CONNECT_QUIET + delay, CONNECT_DRAIN + delay);
+    set_timeout(ptrPort, CONNECT_INTERVAL + delay);
+  }
+
+  // send SYNCH until ACK or NACK is received or activation window has passed. Note: SYNC has even parity -> works in all UART modes
+  Tx[0] = SYNCH;
+  Rx[0] = 0;
+  do
+  {
+    // send command
+    if (physInterface == UART)
+      len = send_port(ptrPort, 0, 1, Tx);
+    else if (physInterface == SPI_ARDUINO)
+      len = send_spi_Arduino(ptrPort, 1, Tx);
+    #if defined(USE_SPIDEV)
+      else if (physInterface == SPI_SPIDEV)
+        len = send_spi_spidev(ptrPort, 1, Tx);
+    #endif
+    if (len != 1)
+      Error("in 'bsl_syncFast()': sending command failed (expect 1, sent %d)", len);
+
+    // receive response. For UART skip 1-wire echo
+    if (physInterface == UART)
+    {
+      len = receive_port(ptrPort, 0, 1, Rx);
+      if ((len==1) && (Rx[0]==Tx[0]))
+        len = receive_port(ptrPort, 0, 1, Rx);
+    }
+    else if (physInterface == SPI_ARDUINO)
+      len = receive_spi_Arduino(ptrPort, 1, Rx);
+    #if defined(USE_SPIDEV)
+      else if (physInterface == SPI_SPIDEV)
+        len = receive_spi_spidev(ptrPort, 1, Rx);
+    #endif
+
+    // SPI returns immediately -> avoid flooding the STM8
+    if ((physInterface != UART) && ((len!=1) || ((Rx[0]!=ACK) && (Rx[0]!=NACK))))
+      SLEEP(1);
+
+  } while (((len!=1) || ((Rx[0]!=ACK) && (Rx[0]!=NACK))) && ((micros() - tStart) < (uint64_t) CONNECT_WINDOW * 1000LL));
+  latency = micros() - tStart;
+
+  // check if ok
+  if ((len==1) && ((Rx[0]==ACK) || (Rx[0]==NACK)))
+  {
+    if (verbose == SILENT)
+      printf("done\n");
+    else if (verbose > SILENT)
+      printf("done (%s after %1.1fms)\n", (Rx[0]==ACK) ? "ACK" : "NACK", (float) latency / 1000.0);
+  }
+  else if (len==1)
+    Error("in 'bsl_syncFast()': wrong response 0x%02" PRIX8 " from BSL", (uint8_t) (Rx[0]));
+  else
+    Error("in 'bsl_syncFast()': no response from BSL within %dms", CONNECT_WINDOW);
+  fflush(stdout);
+
+  // discard responses to surplus SYNCH and restore receive timeout
+  if (physInterface == UART)
+  {
+    drain_port(ptrPort, CONNECT_QUIET + delay, CONNECT_DRAIN + delay);
+    set_timeout(ptrPort, TIMEOUT);
+  }
+
+  // return success
+  return 0;
+
+} // bsl_syncFast
+
+
+
 /**
   \fn uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose)
 
@@ -170,7 +686,7 @@ uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose)
   fflush(stdout);
 
   // reduce timeout for faster check
-  set_timeout(ptrPort, 100);
+  set_timeout(ptrPort, PROBE_TIMEOUT + get_port_latency(ptrPort));
 
   // detect UART mode
   set_parity(ptrPort, 2);
@@ -229,112 +745,183 @@ uint8_t bsl_getUartMode(HANDLE ptrPort, uint8_t verbose)
 
 
 /**
-  \fn uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int *flashsize, uint8_t *vers, uint8_t *family, uint8_t verbose)
+  \fn const RamRoutine_s* bsl_findRoutine(const RamDevice_s *table, int numEntries, uint8_t family, int flashsize, uint8_t versBSL)
 
-  \param[in]  ptrPort        handle to communication port
-  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
-  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
-  \param[out] flashsize      size of flashsize in kB (required for correct W/E routines)
-  \param[out] vers           BSL version number (required for correct W/E routines)
-  \param[out] family         STM8 family (STM8S=1, STM8L=2)
-  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+  \param[in]  table          device table
+  \param[in]  numEntries     number of entries in table
+  \param[in]  family         STM8 family (STM8S=1, STM8L=2)
+  \param[in]  flashsize      size of flash in kB
+  \param[in]  versBSL        BSL version number
 
-  \return communication status (0=ok, 1=fail)
+  \return matching RAM routine, or NULL if device is not supported
 
-  upload RAM routines required for flash write & erase. Respective RAM routines depend on device family, bootloader version and flash size.
-  Used RAM routines under OSS license are from https://github.com/basilhussain/stm8-bootloader-erase-write.
-  Optionally proprietary STM RAM routines are available from http://www.st.com/web/catalog/tools/FM147/CL1794/SC1807/SS1754/PF258008
+  find RAM routine for device in table. Entries with family 0 match any family
 */
-uint8_t bsl_uploadWriteErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int flashsize, uint8_t versBSL, uint8_t family, uint8_t verbose)
+const RamRoutine_s* bsl_findRoutine(const RamDevice_s *table, int numEntries, uint8_t family, int flashsize, uint8_t versBSL)
 {
-  char            *ptrRAM = NULL;                 // pointer to array with RAM routines
-  int             lenRAM;                         // length of RAM array
-  MemoryImage_s   image;                       // memory image for RAM routines
+  for (int i=0; i<numEntries; i++)
+  {
+    if (((table[i].family == 0) || (table[i].family == family)) && (table[i].flashsize == flashsize) && (table[i].versBSL == versBSL))
+      return table[i].routine;
+  }
 
-  // initialize memory image
-  MemoryImage_init(&image);
+  return NULL;
 
-  // STM8L >8kB does not need to upload RAM routines -> Skip
-  if ((family == STM8L) && (flashsize>8))
-    return 0;
+} // bsl_findRoutine
 
-  // for STM8S and STM8L 8kB identify device dependent RAM routines
-  if ((flashsize==8) && (versBSL==0x10))
-  {
-    #ifdef DEBUG
-      printf("header STM8_Routines_E_W_ROUTINEs_8K_verL_1_0_s19 \n");
-    #endif
-    ptrRAM = (char*) bin_erase_write_verL_8k_1_0_ihx;
-    lenRAM = bin_erase_write_verL_8k_1_0_ihx_len;
-  }
-  else if ((flashsize==32) && (versBSL==0x10))
-  {
-    #ifdef DEBUG
-      printf("header STM8_Routines_E_W_ROUTINEs_32K_ver_1_0_s19 \n");
-    #endif
-    ptrRAM = (char*) bin_erase_write_ver_32k_1_0_ihx;
-    lenRAM = bin_erase_write_ver_32k_1_0_ihx_len;
-  }
-  else if ((flashsize==32) && (versBSL==0x12))
-  {
-    #ifdef DEBUG
-      printf("header STM8_Routines_E_W_ROUTINEs_32K_ver_1_2_s19 \n");
-    #endif
-    ptrRAM = (char*) bin_erase_write_ver_32k_1_2_ihx;
-    lenRAM = bin_erase_write_ver_32k_1_2_ihx_len;
-  }
-  else if ((flashsize==32) && (versBSL==0x13))
-  {
-    #ifdef DEBUG
-      printf("header STM8_Routines_E_W_ROUTINEs_32K_ver_1_3_s19 \n");
-    #endif
-    ptrRAM = (char*) bin_erase_write_ver_32k_1_3_ihx;
-    lenRAM = bin_erase_write_ver_32k_1_3_ihx_len;
-  }
-  else if (((flashsize==64) || (flashsize==128)) && (versBSL==0x20))
-  {
-    #ifdef DEBUG
-      printf("header STM8_Routines_E_W_ROUTINEs_128K_ver_2_0_s19 \n");
-    #endif
-    ptrRAM = (char*) bin_erase_write_ver_128k_2_0_ihx;
-    lenRAM = bin_erase_write_ver_128k_2_0_ihx_len;
-  }
-  else if (((flashsize==64) || (flashsize==128)) && (versBSL==0x21))
+
+
+/**
+  \fn void bsl_routineImage(const RamRoutine_s *routine, MemoryImage_s *image)
+
+  \param[in]  routine        precompiled RAM routine
+  \param[out] image          memory image to add routine to
+
+  convert precompiled RAM routine to memory image for bsl_memWrite()
+*/
+void bsl_routineImage(const RamRoutine_s *routine, MemoryImage_s *image)
+{
+  for (int i=0; i<routine->numBlocks; i++)
   {
-    #ifdef DEBUG
-      printf("header STM8_Routines_E_W_ROUTINEs_128K_ver_2_1_s19 \n");
-    #endif
-    ptrRAM = (char*) bin_erase_write_ver_128k_2_1_ihx;
-    lenRAM = bin_erase_write_ver_128k_2_1_ihx_len;
+    if (!MemoryImage_addBlock(image, routine->blocks[i].address, routine->blocks[i].data, routine->blocks[i].length))
+      Error("in 'bsl_routineImage()': cannot add block 0x%04" PRIX64 " of '%s'", (uint64_t) routine->blocks[i].address, routine->name);
   }
-  else if (((flashsize==64) || (flashsize==128)) && (versBSL==0x22))
+
+} // bsl_routineImage
+
+
+
+/**
+  \fn static int bsl_cutIntact(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const RamRoutine_s *routine, MemoryImage_s *image)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  routine        RAM routine uploaded before
+  \param[in,out] image       memory image of routine. Intact blocks are removed
+
+  \return number of remaining (overwritten) blocks
+
+  read back the first ROUTINE_SIGNATURE bytes of each routine block and remove blocks with matching signature from image.
+  A short READ per block costs only a fraction of the re-upload
+*/
+static int bsl_cutIntact(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const RamRoutine_s *routine, MemoryImage_s *image)
+{
+  MemoryImage_s       readImage;
+  const RamBlock_s    *block;
+  MEMIMAGE_ADDR_T     addrEnd;
+  int                 lenSig, numChanged = 0;
+  uint8_t             data;
+  bool                intact;
+
+  // loop over routine blocks
+  for (int i = 0; i < routine->numBlocks; i++)
   {
-    #ifdef DEBUG
-      printf("header STM8_Routines_E_W_ROUTINEs_128K_ver_2_2_s19 \n");
-    #endif
-    ptrRAM = (char*) bin_erase_write_ver_128k_2_2_ihx;
-    lenRAM = bin_erase_write_ver_128k_2_2_ihx_len;
+    block   = &(routine->blocks[i]);
+    lenSig  = (block->length < ROUTINE_SIGNATURE) ? block->length : ROUTINE_SIGNATURE;
+    addrEnd = block->address + block->length - 1;
+
+    // read signature of block and compare
+    MemoryImage_init(&readImage);
+    ownImage(&readImage);
+    bsl_memRead(ptrPort, physInterface, uartMode, block->address, block->address + lenSig - 1, &readImage, MUTE);
+    intact = true;
+    for (int j = 0; j < lenSig; j++)
+    {
+      if ((!MemoryImage_getData(&readImage, block->address + j, &data)) || (data != block->data[j]))
+      {
+        intact = false;
+        break;
+      }
+    }
+    MemoryImage_free(&readImage);
+    disown(&readImage);
+
+    // remove intact block from image
+    if (intact)
+      MemoryImage_cut(image, block->address, addrEnd);
+    else
+      numChanged++;
   }
-  else
-    Error("unsupported device");
 
+  return numChanged;
 
-  // convert matching RAM array containing ihx file to RAM image. Assert C-string termination
-  ptrRAM[lenRAM] = '\0';
-  import_buffer_ihx((uint8_t*) ptrRAM, &image, MUTE);
+} // bsl_cutIntact
 
-  // upload RAM routines to STM8
+
+
+/**
+  \fn uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int *flashsize, uint8_t *vers, uint8_t *family, uint8_t verbose)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[out] flashsize      size of flashsize in kB (required for correct W/E routines)
+  \param[out] vers           BSL version number (required for correct W/E routines)
+  \param[out] family         STM8 family (STM8S=1, STM8L=2)
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  \return communication status (0=ok, 1=fail)
+
+  upload RAM routines required for flash write & erase. Respective RAM routines depend on device family, bootloader version and flash size.
+  Used RAM routines under OSS license are from https://github.com/basilhussain/stm8-bootloader-erase-write.
+  Optionally proprietary STM RAM routines are available from http://www.st.com/web/catalog/tools/FM147/CL1794/SC1807/SS1754/PF258008
+*/
+uint8_t bsl_uploadWriteErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int flashsize, uint8_t versBSL, uint8_t family, uint8_t verbose)
+{
+  const RamRoutine_s  *routine;             // precompiled RAM routines
+  MemoryImage_s       image;                // memory image for RAM routines
+  int                 numBlocks;            // number of overwritten blocks
+
+  // STM8L >8kB does not need to upload RAM routines -> Skip
+  if ((family == STM8L) && (flashsize>8))
+    return 0;
+
+  // for STM8S and STM8L 8kB identify device dependent RAM routines
+  routine = bsl_findRoutine(weTable, sizeof(weTable)/sizeof(weTable[0]), family, flashsize, versBSL);
+  if (routine == NULL)
+    Error("unsupported device");
+  #ifdef DEBUG
+    printf("RAM routine %s\n", routine->name);
+  #endif
+
+  // convert precompiled RAM routines to memory image
+  MemoryImage_init(&image);
+  ownImage(&image);
+  bsl_routineImage(routine, &image);
+
+  // same routines were uploaded before via this port -> only re-upload blocks with overwritten signature, e.g. by ROM-BL after GO
   if (verbose == CHATTY)
     printf("  upload RAM routines ... ");
   fflush(stdout);
-  bsl_memWrite(ptrPort, physInterface, uartMode, &image, MUTE);
-  if (verbose == CHATTY)
-    printf("done (%dB in 0x%04" PRIX64 " - 0x%04" PRIX64 ")\n", (int) image.numEntries, 
-      (uint64_t) image.memoryEntries[0].address, (uint64_t) image.memoryEntries[image.numEntries-1].address);
-  fflush(stdout);
+  if ((wePort == ptrPort) && (weCrc32 == routine->crc32))
+  {
+    numBlocks = bsl_cutIntact(ptrPort, physInterface, uartMode, routine, &image);
+    if (verbose == CHATTY)
+    {
+      if (numBlocks == 0)
+        printf("skipped (intact)\n");
+      else
+        printf("done (%d blocks changed) ", numBlocks);
+    }
+    fflush(stdout);
+  }
+
+  // upload RAM routines to STM8
+  if (image.numEntries > 0)
+  {
+    bsl_memWrite(ptrPort, physInterface, uartMode, &image, WRITE_LOCKSTEP, MUTE);
+    if (verbose == CHATTY)
+      printf("done (%dB in 0x%04" PRIX64 " - 0x%04" PRIX64 ")\n", (int) image.numEntries, 
+        (uint64_t) image.memoryEntries[0].address, (uint64_t) image.memoryEntries[image.numEntries-1].address);
+    fflush(stdout);
+  }
+  wePort  = ptrPort;
+  weCrc32 = routine->crc32;
     
   // release memory image
   MemoryImage_free(&image);
+  disown(&image);
 
   // return success
   return 0;
@@ -342,6 +929,90 @@ uint8_t bsl_uploadWriteErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
 } // bsl_uploadWriteErase
 
 
+/**
+  \fn static uint8_t bsl_getVersion(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+
+  \return BSL version number
+
+  query BSL version via GET command and check command codes
+*/
+static uint8_t bsl_getVersion(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode)
+{
+  int   lenTx, lenRx, len = 0;
+  char  Tx[1000], Rx[1000];
+
+  // construct command
+  lenTx = 2;
+  Tx[0] = GET;
+  Tx[1] = (Tx[0] ^ 0xFF);
+  lenRx = 9;
+
+  // send command
+  if (physInterface == UART)
+    len = send_port(ptrPort, uartMode, lenTx, Tx);
+  else if (physInterface == SPI_ARDUINO)
+    len = send_spi_Arduino(ptrPort, lenTx, Tx);
+  #if defined(USE_SPIDEV)
+    else if (physInterface == SPI_SPIDEV)
+      len = send_spi_spidev(ptrPort, lenTx, Tx);
+  #endif
+  if (len != lenTx)
+    Error("in 'bsl_getVersion()': sending command failed (expect %d, sent %d)", (int) lenTx, (int) len);
+
+  // receive response
+  if (physInterface == UART)
+    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+  else if (physInterface == SPI_ARDUINO)
+    len = receive_spi_Arduino(ptrPort, lenRx, Rx);
+  #if defined(USE_SPIDEV)
+    else if (physInterface == SPI_SPIDEV)
+      len = receive_spi_spidev(ptrPort, lenRx, Rx);
+  #endif
+  if (len != lenRx)
+    Error("in 'bsl_getVersion()': ACK timeout (expect %d, received %d)", (int) lenRx, (int) len);
+
+  // check 2x ACKs
+  if (Rx[0]!=ACK)
+    Error("in 'bsl_getVersion()': start ACK failure (expect 0x%02" PRIX8 ", read 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[0]));
+  if (Rx[8]!=ACK)
+    Error("in 'bsl_getVersion()': end ACK failure (expect 0x%02" PRIX8 ", read 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[8]));
+
+
+  // check if command codes are correct (just to be sure)
+  if (Rx[3] != GET)
+    Error("in 'bsl_getVersion()': wrong GET code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) GET, (uint8_t) (Rx[3]));
+  if (Rx[4] != READ)
+    Error("in 'bsl_getVersion()': wrong READ code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) READ, (uint8_t) (Rx[4]));
+  if (Rx[5] != GO)
+    Error("in 'bsl_getVersion()': wrong GO code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) GO, (uint8_t) (Rx[5]));
+  if (Rx[6] != WRITE)
+    Error("in 'bsl_getVersion()': wrong WRITE code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) WRITE, (uint8_t) (Rx[6]));
+  if (Rx[7] != ERASE)
+    Error("in 'bsl_getVersion()': wrong ERASE code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) ERASE, (uint8_t) (Rx[7]));
+
+// print BSL data
+#ifdef DEBUG
+  printf("    version 0x%02" PRIX8 "\n", (uint8_t) (Rx[2]));
+  printf("    command codes:\n");
+  printf("      GET   0x%02" PRIX8 "\n", (uint8_t) (Rx[3]));
+  printf("      READ  0x%02" PRIX8 "\n", (uint8_t) (Rx[4]));
+  printf("      GO    0x%02" PRIX8 "\n", (uint8_t) (Rx[5]));
+  printf("      WRITE 0x%02" PRIX8 "\n", (uint8_t) (Rx[6]));
+  printf("      ERASE 0x%02" PRIX8 "\n", (uint8_t) (Rx[7]));
+  fflush(stdout);
+#endif
+
+  // return version number
+  return (uint8_t) Rx[2];
+
+} // bsl_getVersion
+
+
+
 /**
   \fn uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int *flashsize, uint8_t *versBSL, uint8_t *family, uint8_t verbose)
 
@@ -360,19 +1031,11 @@ uint8_t bsl_uploadWriteErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
 */
 uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int *flashsize, uint8_t *versBSL, uint8_t *family, uint8_t verbose)
 {
-  int   i;
-  int   lenTx, lenRx, len = 0;
-  char  Tx[1000], Rx[1000];
-
   // print message
   if (verbose >= SILENT)
     printf("  get device info ... ");
   fflush(stdout);
 
-  // init receive buffer
-  for (i=0; i<1000; i++)
-    Rx[i] = 0;
-
   // check if port is open
   if (!ptrPort)
     Error("in 'bsl_getInfo()': port not open");
@@ -388,7 +1051,7 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
   // reduce timeout for faster check
   if (physInterface == UART)
   {
-    set_timeout(ptrPort, 200);
+    set_timeout(ptrPort, PROBE_TIMEOUT + get_port_latency(ptrPort));
   }
 
   // check address of EEPROM. STM8L starts at 0x1000, STM8S starts at 0x4000
@@ -437,70 +1100,8 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
   /////////
   // get BSL version
   /////////
+  *versBSL = bsl_getVersion(ptrPort, physInterface, uartMode);
 
-  // construct command
-  lenTx = 2;
-  Tx[0] = GET;
-  Tx[1] = (Tx[0] ^ 0xFF);
-  lenRx = 9;
-
-  // send command
-  if (physInterface == UART)
-    len = send_port(ptrPort, uartMode, lenTx, Tx);
-  else if (physInterface == SPI_ARDUINO)
-    len = send_spi_Arduino(ptrPort, lenTx, Tx);
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = send_spi_spidev(ptrPort, lenTx, Tx);
-  #endif
-  if (len != lenTx)
-    Error("in 'bsl_getInfo()': sending command failed (expect %d, sent %d)", (int) lenTx, (int) len);
-
-  // receive response
-  if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
-  else if (physInterface == SPI_ARDUINO)
-    len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = receive_spi_spidev(ptrPort, lenRx, Rx);
-  #endif
-  if (len != lenRx)
-    Error("in 'bsl_getInfo()': ACK timeout (expect %d, received %d)", (int) lenRx, (int) len);
-
-  // check 2x ACKs
-  if (Rx[0]!=ACK)
-    Error("in 'bsl_getInfo()': start ACK failure (expect 0x%02" PRIX8 ", read 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[0]));
-  if (Rx[8]!=ACK)
-    Error("in 'bsl_getInfo()': end ACK failure (expect 0x%02" PRIX8 ", read 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[8]));
-
-
-  // check if command codes are correct (just to be sure)
-  if (Rx[3] != GET)
-    Error("in 'bsl_getInfo()': wrong GET code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) GET, (uint8_t) (Rx[3]));
-  if (Rx[4] != READ)
-    Error("in 'bsl_getInfo()': wrong READ code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) READ, (uint8_t) (Rx[4]));
-  if (Rx[5] != GO)
-    Error("in 'bsl_getInfo()': wrong GO code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) GO, (uint8_t) (Rx[5]));
-  if (Rx[6] != WRITE)
-    Error("in 'bsl_getInfo()': wrong WRITE code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) WRITE, (uint8_t) (Rx[6]));
-  if (Rx[7] != ERASE)
-    Error("in 'bsl_getInfo()': wrong ERASE code (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) ERASE, (uint8_t) (Rx[7]));
-
-// print BSL data
-#ifdef DEBUG
-  printf("    version 0x%02" PRIX8 "\n", (uint8_t) (Rx[2]));
-  printf("    command codes:\n");
-  printf("      GET   0x%02" PRIX8 "\n", (uint8_t) (Rx[3]));
-  printf("      READ  0x%02" PRIX8 "\n", (uint8_t) (Rx[4]));
-  printf("      GO    0x%02" PRIX8 "\n", (uint8_t) (Rx[5]));
-  printf("      WRITE 0x%02" PRIX8 "\n", (uint8_t) (Rx[6]));
-  printf("      ERASE 0x%02" PRIX8 "\n", (uint8_t) (Rx[7]));
-  fflush(stdout);
-#endif
-
-  // copy version number
-  *versBSL = Rx[2];
 
   // print message
   if (*family == STM8S)
@@ -531,77 +1132,191 @@ uint8_t bsl_getInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int
 
 
 /**
-  \fn uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrStop, MemoryImage_s *image, uint8_t verbose)
+  \fn uint8_t bsl_checkInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int flashsize, uint8_t versBSL, uint8_t family, uint8_t verbose)
 
   \param[in]  ptrPort        handle to communication port
   \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
   \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
-  \param[in]  addrStart      first address to read
-  \param[in]  addrStop       last address to read
-  \param[out] imageBuf       read memory image
+  \param[in]  flashsize      expected size of flash in kB, e.g. from device cache
+  \param[in]  versBSL        expected BSL version number
+  \param[in]  family         expected STM8 family (STM8S=1, STM8L=2)
   \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
 
-  \return communication status (0=ok, 1=fail)
+  \return 0 if device matches, 1 if device differs (then call bsl_getInfo())
 
-  read from microcontroller memory via READ command.
+  confirm a known device identity with fewer probes than bsl_getInfo(). Only the probes
+  which distinguish the expected device from its neighbours are read: family EEPROM,
+  last flash address and last address of next larger flash size
 */
-uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrStop, MemoryImage_s *image, uint8_t verbose)
+uint8_t bsl_checkInfo(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int flashsize, uint8_t versBSL, uint8_t family, uint8_t verbose)
 {
-  int               i, lenTx, lenRx, len = 0;
-  char              Tx[1000], Rx[1000];
-  MEMIMAGE_ADDR_T   addr, addrStep;
-  int               numBytes, countBytes;
+  const int               sizes[]   = {8, 32, 64, 128, 256};
+  const MEMIMAGE_ADDR_T   addrTop[] = {0x009FFF, 0x00FFFF, 0x017FFF, 0x027FFF, 0x047FFF};
+  const int               numSizes  = sizeof(sizes)/sizeof(sizes[0]);
+  bool                    match;
+  int                     idx;
 
-  // simple checks of scan window
-  if (addrStart > addrStop)
-    Error("start address 0x%04" PRIX64 " higher than end address 0x%04" PRIX64, (uint64_t) addrStart, (uint64_t) addrStop);
-  
-  // get number of bytes to read
-  numBytes = addrStop - addrStart + 1;
+  // check if port is open
+  if (!ptrPort)
+    Error("in 'bsl_checkInfo()': port not open");
+
+  // unknown flash size or family -> full identification required
+  for (idx=0; (idx<numSizes) && (sizes[idx]!=flashsize); idx++)
+    ;
+  if ((idx == numSizes) || ((family != STM8S) && (family != STM8L)))
+    return 1;
 
   // print message
-  if (verbose == SILENT)
+  if (verbose >= SILENT)
+    printf("  check device info ... ");
+  fflush(stdout);
+
+  // purge input buffer
+  flush_port(ptrPort);
+
+  // BSL version is a single GET command -> check first
+  match = (bsl_getVersion(ptrPort, physInterface, uartMode) == versBSL);
+
+  // reduce timeout for faster check
+  if (physInterface == UART)
+    set_timeout(ptrPort, PROBE_TIMEOUT + get_port_latency(ptrPort));
+
+  // check family with same probe order as bsl_getInfo(). STM8L requires STM8S probe to fail
+  if (match)
   {
-    if (numBytes > 1024)
-      printf("  read %1.1fkB ", (float) numBytes/1024.0);
+    if (family == STM8S)
+      match = bsl_memCheck(ptrPort, physInterface, uartMode, 0x004000, SILENT);
     else
-      printf("  read %dB ", (int) numBytes);
+      match = (!bsl_memCheck(ptrPort, physInterface, uartMode, 0x004000, SILENT)) && bsl_memCheck(ptrPort, physInterface, uartMode, 0x00100, SILENT);
   }
-  else if (verbose == INFORM)
+
+  // check last flash address exists, and last address of next larger size doesn't
+  if (match)
+    match = bsl_memCheck(ptrPort, physInterface, uartMode, addrTop[idx], SILENT);
+  if (match && (idx+1 < numSizes))
+    match = !bsl_memCheck(ptrPort, physInterface, uartMode, addrTop[idx+1], SILENT);
+
+  // restore timeout to avoid timeouts during flash operation
+  if (physInterface == UART)
+    set_timeout(ptrPort, TIMEOUT);
+
+  // print message
+  if (!match)
   {
-    if (numBytes > 1024)
-      printf("  read %1.1fkB ", (float) numBytes/1024.0);
-    else
-      printf("  read %dB ", (int) numBytes);
+    if (verbose >= SILENT)
+      printf("changed\n");
   }
+  else if (verbose == SILENT)
+    printf("done (%s; %dkB)\n", (family == STM8S) ? "STM8S" : "STM8L", flashsize);
+  else if (verbose == INFORM)
+    printf("done (%s; %dkB flash)\n", (family == STM8S) ? "STM8S" : "STM8L", flashsize);
   else if (verbose == CHATTY)
-  {
-    if (numBytes > 1024)
-      printf("  read %1.1fkB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ", (float) numBytes/1024.0, (uint64_t) addrStart, (uint64_t) addrStop);
-    else
-      printf("  read %dB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ", (int) numBytes, (uint64_t) addrStart, (uint64_t) addrStop);
-  }
+    printf("done (%s; %dkB flash; BSL v%x.%x; cached)\n", (family == STM8S) ? "STM8S" : "STM8L", flashsize, (uint8_t) ((versBSL&0xF0)>>4), (uint8_t) (versBSL & 0x0F));
   fflush(stdout);
 
-  // init receive buffer
-  for (i=0; i<1000; i++)
-    Rx[i] = 0;
+  // return 0 if device matches
+  return (match ? 0 : 1);
 
-  // check if port is open
-  if (!ptrPort)
-    Error("in 'bsl_memRead()': port not open");
+} // bsl_checkInfo
 
 
-  // loop over addresses in 128B steps (required by SPI via Arduino)
-  countBytes = 0;
-  addrStep = 128;
-  for (addr=addrStart; addr<=addrStop; addr+=addrStep)
+
+/**
+  \fn static void bsl_readChunk(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addr, int lenRead, bool pipelined, uint8_t *dest)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  addr           first address to read
+  \param[in]  lenRead        number of bytes to read (1..256)
+  \param[in]  pipelined      send command, address and length frames in a single burst (UART duplex only)
+  \param[out] dest           buffer for read data
+
+  read single chunk via READ command, see bsl_memRead(). For spidev the complete READ transaction
+  is sent in a single SPI message, see bsl_transactSpidev()
+*/
+static void bsl_readChunk(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addr, int lenRead, bool pipelined, uint8_t *dest)
+{
+  int       lenTx, lenRx, len = 0;
+  char      Tx[1000], Rx[1000], *data;
+
+  /////
+  // UART duplex: send command, address and number of bytes in a single burst
+  /////
+  if (pipelined)
   {
-    // if addr too close to end of range reduce stepsize
-    if (addr+128 > addrStop)
-      addrStep = addrStop - addr + 1;
+    // construct command + address + number of bytes
+    lenTx = 0;
+    Tx[lenTx++] = READ;
+    Tx[lenTx++] = (READ ^ 0xFF);
+    lenTx += bsl_frameAddress(addr, Tx+lenTx);
+    Tx[lenTx++] = lenRead-1;     // -1 from BSL
+    Tx[lenTx++] = ((lenRead-1) ^ 0xFF);
+    lenRx = 3 + lenRead;
+
+    // send burst
+    len = send_port(ptrPort, uartMode, lenTx, Tx);
+    if (len != lenTx)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " sending command failed (expect %d, sent %d)", (uint64_t) addr, (int) lenTx, (int) len);
+
+    // receive 3 ACKs and data in a single read
+    len = receive_port(ptrPort, uartMode, lenRx, Rx);
+
+    // check acknowledges
+    if (len < 1)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK1 timeout", (uint64_t) addr);
+    if (Rx[0]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
+    if (len < 2)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK2 timeout (expect %d, received %d)", (uint64_t) addr, (int) lenRx, (int) len);
+    if (Rx[1]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[1]));
+    if (len != lenRx)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " data timeout (expect %d, received %d)", (uint64_t) addr, (int) lenRx, (int) len);
+    if (Rx[2]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK3 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[2]));
 
+    // data follows 3 ACKs
+    data = Rx+3;
 
+  } // pipelined
+
+
+  /////
+  // spidev: send command, address and number of bytes in a single SPI message
+  /////
+  #if defined(USE_SPIDEV)
+  else if (physInterface == SPI_SPIDEV)
+  {
+    // construct number of bytes + checksum
+    lenTx = 2;
+    Tx[0] = lenRead-1;     // -1 from BSL
+    Tx[1] = (Tx[0] ^ 0xFF);
+    lenRx = lenRead + 1;
+
+    // receive ACK1, ACK2, ACK3 and data
+    bsl_transactSpidev(ptrPort, READ, addr, Tx, lenTx, Rx, lenRx, "bsl_memRead");
+
+    // check acknowledges
+    if (Rx[0]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
+    if (Rx[1]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[1]));
+    if (Rx[2]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK3 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[2]));
+
+    // data follows 3 ACKs
+    data = Rx+3;
+
+  } // spidev
+  #endif // USE_SPIDEV
+
+
+  /////
+  // other interfaces: wait for ACK after each frame
+  /////
+  else
+  {
     /////
     // send read command
     /////
@@ -613,32 +1328,18 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEM
     lenRx = 1;
 
     // send command
-    if (physInterface == UART)
-      len = send_port(ptrPort, uartMode, lenTx, Tx);
-    else if (physInterface == SPI_ARDUINO)
-      len = send_spi_Arduino(ptrPort, lenTx, Tx);
-    #if defined(USE_SPIDEV)
-      else if (physInterface == SPI_SPIDEV)
-        len = send_spi_spidev(ptrPort, lenTx, Tx);
-    #endif
+    len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
     if (len != lenTx)
       Error("in 'bsl_memRead()': at 0x%04" PRIX64 " sending command failed (expect %d, sent %d)", (uint64_t) addr, (int) lenTx, (int) len);
 
     // receive response
-    if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
-    else if (physInterface == SPI_ARDUINO)
-      len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-    #if defined(USE_SPIDEV)
-      else if (physInterface == SPI_SPIDEV)
-        len = receive_spi_spidev(ptrPort, lenRx, Rx);
-    #endif
+    len = bsl_receive(ptrPort, physInterface, uartMode, lenRx, Rx);
     if (len != lenRx)
-      Error("in 'bsl_memRead()': at at 0x%04" PRIX64 " ACK1 timeout", (uint64_t) addr);
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK1 timeout", (uint64_t) addr);
 
     // check acknowledge
     if (Rx[0]!=ACK)
-      Error("in 'bsl_memRead()': at at 0x%04" PRIX64 " ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
 
 
     /////
@@ -646,95 +1347,169 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEM
     /////
 
     // construct address + checksum (XOR over address)
-    lenTx = 5;
-    Tx[0] = (char) (addr >> 24);
-    Tx[1] = (char) (addr >> 16);
-    Tx[2] = (char) (addr >> 8);
-    Tx[3] = (char) (addr);
-    Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
+    lenTx = bsl_frameAddress(addr, Tx);
     lenRx = 1;
 
     // send command
-    if (physInterface == UART)
-      len = send_port(ptrPort, uartMode, lenTx, Tx);
-    else if (physInterface == SPI_ARDUINO)
-      len = send_spi_Arduino(ptrPort, lenTx, Tx);
-    #if defined(USE_SPIDEV)
-      else if (physInterface == SPI_SPIDEV)
-        len = send_spi_spidev(ptrPort, lenTx, Tx);
-    #endif
+    len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
     if (len != lenTx)
       Error("in 'bsl_memRead()': at 0x%04" PRIX64 " sending address failed (expect %d, sent %d)", (uint64_t) addr, (int) lenTx, (int) len);
 
     // receive response
-    if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
-    else if (physInterface == SPI_ARDUINO)
-      len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-    #if defined(USE_SPIDEV)
-      else if (physInterface == SPI_SPIDEV)
-        len = receive_spi_spidev(ptrPort, lenRx, Rx);
-    #endif
+    len = bsl_receive(ptrPort, physInterface, uartMode, lenRx, Rx);
     if (len != lenRx)
       Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK2 timeout (expect %d, received %d)", (uint64_t) addr, (int) lenRx, (int) len);
 
-    // check acknowledge
-    if (Rx[0]!=ACK)
-      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
+    // check acknowledge
+    if (Rx[0]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
+
+
+    /////
+    // send number of bytes
+    /////
+
+    // construct number of bytes + checksum
+    lenTx = 2;
+    Tx[0] = lenRead-1;     // -1 from BSL
+    Tx[1] = (Tx[0] ^ 0xFF);
+    lenRx = lenRead + 1;
+
+    // send command
+    len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
+    if (len != lenTx)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " sending range failed (expect %d, sent %d)", (uint64_t) addr, (int) lenTx, (int) len);
+
+    // receive response
+    len = bsl_receive(ptrPort, physInterface, uartMode, lenRx, Rx);
+    if (len != lenRx)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " data timeout (expect %d, received %d)", (uint64_t) addr, (int) lenRx, (int) len);
+
+    // check acknowledge
+    if (Rx[0]!=ACK)
+      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK3 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
+
+    // data follows ACK
+    data = Rx+1;
+
+  } // lock-step
+
+  // copy data to buffer
+  memcpy(dest, data, lenRead);
+
+} // bsl_readChunk
+
+
+
+/**
+  \fn static void bsl_readChunkRetry(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addr, int lenRead, bool pipelined, uint8_t *dest)
+
+  read single chunk via READ command (see bsl_readChunk()). On failure resync BSL and retry up to g_retryMax times
+*/
+static void bsl_readChunkRetry(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addr, int lenRead, bool pipelined, uint8_t *dest)
+{
+  ErrorTrap_s     trap, *prev;
+  volatile int    numRetry = 0;
+
+  // on error Error() returns here with setjmp() != 0
+  prev = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    bsl_retryNext(ptrPort, physInterface, uartMode, &trap, prev, numRetry++);
+  bsl_readChunk(ptrPort, physInterface, uartMode, addr, lenRead, pipelined, dest);
+  setErrorTrap(prev);
+
+} // bsl_readChunkRetry
+
+
+
+/**
+  \fn uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrStop, MemoryImage_s *image, uint8_t verbose)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  addrStart      first address to read
+  \param[in]  addrStop       last address to read
+  \param[out] imageBuf       read memory image
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  \return communication status (0=ok, 1=fail)
+
+  read from microcontroller memory via READ command. Reads max. 256B per READ (128B for SPI via
+  Arduino). Data is collected in a contiguous buffer which is inserted into the image in one step.
+  For UART duplex mode the command, address and length frames of a READ are sent in a single burst
+*/
+uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrStop, MemoryImage_s *image, uint8_t verbose)
+{
+  MEMIMAGE_ADDR_T   addr, addrStep, maxRead;
+  int               numBytes, countBytes;
+  uint8_t           *buf;                         // contiguous buffer for read data
+  bool              pipelined;                    // send READ frames without waiting for ACK
+
+  // simple checks of scan window
+  if (addrStart > addrStop)
+    Error("start address 0x%04" PRIX64 " higher than end address 0x%04" PRIX64, (uint64_t) addrStart, (uint64_t) addrStop);
+  
+  // get number of bytes to read
+  numBytes = addrStop - addrStart + 1;
 
+  // print message
+  if (verbose == SILENT)
+  {
+    if (numBytes > 1024)
+      printf("  read %1.1fkB ", (float) numBytes/1024.0);
+    else
+      printf("  read %dB ", (int) numBytes);
+  }
+  else if (verbose == INFORM)
+  {
+    if (numBytes > 1024)
+      printf("  read %1.1fkB ", (float) numBytes/1024.0);
+    else
+      printf("  read %dB ", (int) numBytes);
+  }
+  else if (verbose == CHATTY)
+  {
+    if (numBytes > 1024)
+      printf("  read %1.1fkB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ", (float) numBytes/1024.0, (uint64_t) addrStart, (uint64_t) addrStop);
+    else
+      printf("  read %dB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ", (int) numBytes, (uint64_t) addrStart, (uint64_t) addrStop);
+  }
+  fflush(stdout);
 
-    /////
-    // send number of bytes
-    /////
+  // check if port is open
+  if (!ptrPort)
+    Error("in 'bsl_memRead()': port not open");
 
-    // construct number of bytes + checksum
-    lenTx = 2;
-    Tx[0] = addrStep-1;     // -1 from BSL
-    Tx[1] = (Tx[0] ^ 0xFF);
-    lenRx = addrStep + 1;
+  // allocate buffer for read data
+  buf = (uint8_t*) malloc(numBytes);
+  if (buf == NULL)
+    Error("in 'bsl_memRead()': cannot allocate %dB buffer", (int) numBytes);
+  ownBuffer(buf);
 
-    // send command
-    if (physInterface == UART)
-      len = send_port(ptrPort, uartMode, lenTx, Tx);
-    else if (physInterface == SPI_ARDUINO)
-      len = send_spi_Arduino(ptrPort, lenTx, Tx);
-    #if defined(USE_SPIDEV)
-      else if (physInterface == SPI_SPIDEV)
-        len = send_spi_spidev(ptrPort, lenTx, Tx);
-    #endif
-    if (len != lenTx)
-      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " sending range failed (expect %d, sent %d)", (uint64_t) addr, (int) lenTx, (int) len);
+  // max. length of READ is 256B, but SPI via Arduino is limited to 128B frames
+  if (physInterface == SPI_ARDUINO)
+    maxRead = 128;
+  else
+    maxRead = 256;
 
+  // combine frames of a READ for UART duplex mode. 1-wire would collide with BSL response, reply mode requires echo
+  pipelined = ((physInterface == UART) && (uartMode == 0));
 
-    // receive response
-    if (physInterface == UART)
-      len = receive_port(ptrPort, uartMode, lenRx, Rx);
-    else if (physInterface == SPI_ARDUINO)
-    {
-      len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-      //fprintf(stderr, "%d\n", (int) lenRx);
-    }
-    #if defined(USE_SPIDEV)
-      else if (physInterface == SPI_SPIDEV)
-      {
-        len = receive_spi_spidev(ptrPort, lenRx, Rx);
-        //fprintf(stderr, "%d\n", (int) lenRx);
-      }
-    #endif
-    if (len != lenRx)
-      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " data timeout (expect %d, received %d)", (uint64_t) addr, (int) lenRx, (int) len);
 
-    // check acknowledge
-    if (Rx[0]!=ACK)
-      Error("in 'bsl_memRead()': at 0x%04" PRIX64 " ACK3 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addr, (uint8_t) ACK, (uint8_t) (Rx[0]));
+  // loop over address range in steps of max. READ length
+  countBytes = 0;
+  for (addr=addrStart; addr<=addrStop; addr+=addrStep)
+  {
+    // if addr too close to end of range reduce stepsize
+    addrStep = maxRead;
+    if (addrStep > addrStop - addr + 1)
+      addrStep = addrStop - addr + 1;
 
-    // copy data to buffer
-    for (i=1; i<lenRx; i++)
-    {
-      assert(MemoryImage_addData(image, addr+i-1, Rx[i]));
-      //printf("%d 0x%02" PRIX8 "\n", i, (uint8_t) (Rx[i])); fflush(stdout); getchar();
-      countBytes++;
-    }
+
+    // read chunk. On failure resync and retry
+    bsl_readChunkRetry(ptrPort, physInterface, uartMode, addr, addrStep, pipelined, buf+countBytes);
+    countBytes += addrStep;
 
     // print progress
     if ((countBytes % 1024) == 0)
@@ -760,10 +1535,24 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEM
           printf("%c  read %dB / %dB from 0x%" PRIX64 " to 0x%" PRIX64 " ", '\r', (int) countBytes, (int) numBytes, (uint64_t) addrStart, (uint64_t) addrStop);
       }
       fflush(stdout);
+
+      // optional progress callback
+      if (progressCallback != NULL)
+        progressCallback(progressArg, "read", countBytes, numBytes);
     }
 
   } // loop over address range
 
+  // final progress callback
+  if (progressCallback != NULL)
+    progressCallback(progressArg, "read", countBytes, numBytes);
+
+  // insert read data into memory image in one step
+  if (!MemoryImage_addBlock(image, addrStart, buf, countBytes))
+    Error("in 'bsl_memRead()': cannot add data to memory image");
+  disown(buf);
+  free(buf);
+
 
   // print message
   if (verbose == SILENT)
@@ -948,6 +1737,97 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ME
 
 
 
+/**
+  \fn static void bsl_eraseFrames(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const char *Codes, int lenCodes, uint32_t *tLearn, uint32_t deadline, const char *caller)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  Codes          ERASE payload incl. checksum, i.e. N-1, sector codes, XOR or 0xFF+0x00 for mass erase
+  \param[in]  lenCodes       length of payload
+  \param[in,out] tLearn      learned erase duration [ms], see bsl_pollAck()
+  \param[in]  deadline       max. erase duration [ms]
+  \param[in]  caller         name of calling function for error messages
+
+  single ERASE transaction: send command, wait for ACK, send payload and wait until erase is finished
+*/
+static void bsl_eraseFrames(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const char *Codes, int lenCodes, uint32_t *tLearn, uint32_t deadline, const char *caller)
+{
+  int       lenTx, lenRx, len = 0;
+  char      Tx[1000], Rx[1000];
+
+
+  /////
+  // send erase command
+  /////
+
+  // construct command
+  lenTx = 2;
+  Tx[0] = ERASE;
+  Tx[1] = (Tx[0] ^ 0xFF);
+  lenRx = 1;
+
+  // send command
+  len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
+  if (len != lenTx)
+    Error("in '%s()': sending command failed (expect %d, sent %d)", caller, (int) lenTx, (int) len);
+
+  // receive response
+  len = bsl_receive(ptrPort, physInterface, uartMode, lenRx, Rx);
+  if (len != lenRx)
+    Error("in '%s()': ACK1 timeout (expect %d, received %d)", caller, (int) lenRx, (int) len);
+
+  // check acknowledge
+  if (Rx[0]!=ACK)
+    Error("in '%s()': ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", caller, (uint8_t) ACK, (uint8_t) (Rx[0]));
+
+
+  /////
+  // send payload and wait until erase is finished
+  /////
+
+  // send payload
+  lenTx = lenCodes;
+  memcpy(Tx, Codes, lenTx);
+  len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
+  if (len != lenTx)
+    Error("in '%s()': sending sectors failed (expect %d, sent %d)", caller, (int) lenTx, (int) len);
+
+  // wait for ACK (sector erase typ. 30ms, see UM0560. Mass erase measured 3.3s for 128kB STM8)
+  len = bsl_pollAck(ptrPort, physInterface, uartMode, Rx, tLearn, deadline);
+  if (len != lenRx)
+    Error("in '%s()': ACK2 timeout (expect %d, received %d)", caller, (int) lenRx, (int) len);
+
+  // check acknowledge
+  if (Rx[0]!=ACK)
+    Error("in '%s()': ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", caller, (uint8_t) ACK, (uint8_t) (Rx[0]));
+
+} // bsl_eraseFrames
+
+
+
+/**
+  \fn static void bsl_eraseFramesRetry(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const char *Codes, int lenCodes, uint32_t *tLearn, uint32_t deadline, const char *caller)
+
+  single ERASE transaction (see bsl_eraseFrames()). On failure resync BSL and retry up to g_retryMax times.
+  Erase is idempotent, i.e. repeating a partially executed ERASE is harmless
+*/
+static void bsl_eraseFramesRetry(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const char *Codes, int lenCodes, uint32_t *tLearn, uint32_t deadline, const char *caller)
+{
+  ErrorTrap_s     trap, *prev;
+  volatile int    numRetry = 0;
+
+  // on error Error() returns here with setjmp() != 0
+  prev = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    bsl_retryNext(ptrPort, physInterface, uartMode, &trap, prev, numRetry++);
+  bsl_eraseFrames(ptrPort, physInterface, uartMode, Codes, lenCodes, tLearn, deadline, caller);
+  setErrorTrap(prev);
+
+} // bsl_eraseFramesRetry
+
+
+
 /**
   \fn uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addr, uint8_t verbose)
 
@@ -963,9 +1843,7 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, ME
 */
 uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addr, uint8_t verbose)
 {
-  int       i;
-  int       lenTx, lenRx, len = 0;
-  char      Tx[1000], Rx[1000];
+  char      Codes[3];
   uint8_t   sector;
   uint64_t  tStart, tStop;        // measure time [ms] for erase (for COMM timeout)
 
@@ -983,136 +1861,171 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
   }
   else if (verbose == CHATTY)
   {
-    if (addr>0xFFFFFF)
-      printf("  erase flash sector %d at 0x%" PRIX64 " ... ", (int) sector, (uint64_t) addr);
-    else if (addr>0xFFFF)
-      printf("  erase flash sector %d at 0x%" PRIX64 " ... ", (int) sector, (uint64_t) addr);
-    else
-      printf("  erase flash sector %d at 0x%" PRIX64 " ... ", (int) sector, (uint64_t) addr);
+    printf("  erase flash sector %d at 0x%" PRIX64 " ... ", (int) sector, (uint64_t) addr);
   }
   fflush(stdout);
 
+  // check if port is open
+  if (!ptrPort)
+    Error("in 'bsl_flashSectorErase()': port not open");
+
+  // construct number of sectors -1 (here only 1 sector), sector code and checksum
+  Codes[0] = 0x00;
+  Codes[1] = sector;
+  Codes[2] = (Codes[0] ^ Codes[1]);
+
+  // measure time for sector erase
+  tStart = millis();
+
+  // erase sector with retry on failure
+  bsl_eraseFramesRetry(ptrPort, physInterface, uartMode, Codes, 3, &tLearnEraseSector, DEADLINE_ERASE_SECTOR, "bsl_flashSectorErase");
+
+  // measure time for sector erase
+  tStop = millis();
 
 
   // print message
+  if (verbose == SILENT)
+  {
+    printf("done\n");
+  }
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+  {
+    printf("done, time %dms\n", (int)(tStop-tStart));
+  }
   fflush(stdout);
 
-  // init receive buffer
-  for (i=0; i<1000; i++)
-    Rx[i] = 0;
+  // avoid compiler warnings
+  return 0;
 
-  // check if port is open
-  if (!ptrPort)
-    Error("in 'bsl_flashSectorErase()': port not open");
+} // bsl_flashSectorErase
 
 
-  /////
-  // send erase command
-  /////
 
-  // construct command
-  lenTx = 2;
-  Tx[0] = ERASE;
-  Tx[1] = (Tx[0] ^ 0xFF);
-  lenRx = 1;
+/**
+  \fn uint8_t bsl_flashSectorsErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const uint8_t *sectors, int numSectors, uint8_t verbose)
 
-  // send command
-  if (physInterface == UART)
-    len = send_port(ptrPort, uartMode, lenTx, Tx);
-  else if (physInterface == SPI_ARDUINO)
-    len = send_spi_Arduino(ptrPort, lenTx, Tx);
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = send_spi_spidev(ptrPort, lenTx, Tx);
-  #endif
-  if (len != lenTx)
-    Error("in 'bsl_flashSectorErase()': sending command failed (expect %d, sent %d)", (int) lenTx, (int) len);
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  sectors        codes of flash sectors to erase
+  \param[in]  numSectors     number of sectors to erase
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
 
+  \return communication status (0=ok, 1=fail)
 
-  // receive response
-  if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
-  else if (physInterface == SPI_ARDUINO)
-    len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = receive_spi_spidev(ptrPort, lenRx, Rx);
-  #endif
-  if (len != lenRx)
-    Error("in 'bsl_flashSectorErase()': ACK1 timeout (expect %d, received %d)", (int) lenRx, (int) len);
+  erase multiple flash sectors. Sectors are erased in batches of max. ERASE_MAX_SECTORS
+  per ERASE command to minimize protocol overhead
+*/
+uint8_t bsl_flashSectorsErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const uint8_t *sectors, int numSectors, uint8_t verbose)
+{
+  int       lenCodes;
+  char      Codes[ERASE_MAX_SECTORS+2];
+  int       idx, numBatch, j;
+  uint32_t  tLearn;               // expected duration [ms] of batch
+  uint64_t  tStart, tStop;        // measure time [ms] for erase
 
-  // check acknowledge
-  if (Rx[0]!=ACK)
-    Error("in 'bsl_flashSectorErase()': ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[0]));
+  // print message
+  if (verbose == SILENT)
+    printf("  erase sectors ... ");
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("  erase %d flash sectors ... ", numSectors);
+  fflush(stdout);
 
+  // check if port is open
+  if (!ptrPort)
+    Error("in 'bsl_flashSectorsErase()': port not open");
 
-  /////
-  // send code of sector to erase
-  /////
+  // measure time for erase
+  tStart = millis();
 
-  // increase timeout for long erase
-  set_timeout(ptrPort, 1200);
+  // loop over sectors in batches
+  for (idx=0; idx<numSectors; idx+=numBatch)
+  {
+    // number of sectors in this ERASE command
+    numBatch = numSectors - idx;
+    if (numBatch > ERASE_MAX_SECTORS)
+      numBatch = ERASE_MAX_SECTORS;
+
+    // construct number of sectors -1, sector codes and checksum
+    lenCodes = 0;
+    Codes[lenCodes++] = numBatch-1;
+    for (j=0; j<numBatch; j++)
+      Codes[lenCodes++] = sectors[idx+j];
+    Codes[lenCodes] = 0x00;
+    for (j=0; j<lenCodes; j++)
+      Codes[lenCodes] ^= Codes[j];
+    lenCodes++;
+
+    // erase batch with retry on failure. Learned time is per sector
+    tLearn = tLearnEraseSector * numBatch;
+    bsl_eraseFramesRetry(ptrPort, physInterface, uartMode, Codes, lenCodes, &tLearn, DEADLINE_ERASE_SECTOR + numBatch*ERASE_TIME_SECTOR, "bsl_flashSectorsErase");
+    if (physInterface != UART)
+      tLearnEraseSector = tLearn / numBatch;
+
+  } // loop over batches
+
+  // measure time for erase
+  tStop = millis();
 
-  // construct pattern
-  lenTx = 3;
-  Tx[0] = 0x00;      // number of sectors to erase -1 (here only 1 sector)
-  Tx[1] = sector;
-  Tx[2] = (Tx[0] ^ Tx[1]);
-  lenRx = 1;
+  // print message
+  if (verbose == SILENT)
+    printf("done\n");
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done, time %dms\n", (int)(tStop-tStart));
+  fflush(stdout);
 
-  // debug: construct pattern for sector N & (N+1)
-  /*
-  lenTx = 4;
-  Tx[0] = 0x01;      // number of sectors to erase -1 (here 2 sectors)
-  Tx[1] = sector;
-  Tx[2] = sector+1;
-  Tx[3] = (Tx[0] ^ Tx[1] ^ Tx[2]);
-  lenRx = 1;
-  */
+  // avoid compiler warnings
+  return 0;
 
-  // measure time for sector erase
-  tStart = millis();
+} // bsl_flashSectorsErase
 
-  // send command
-  if (physInterface == UART)
-    len = send_port(ptrPort, uartMode, lenTx, Tx);
-  else if (physInterface == SPI_ARDUINO)
-    len = send_spi_Arduino(ptrPort, lenTx, Tx);
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = send_spi_spidev(ptrPort, lenTx, Tx);
-  #endif
-  if (len != lenTx)
-    Error("in 'bsl_flashSectorErase()': sending sector failed (expect %d, sent %d)", (int) lenTx, (int) len);
 
 
-  // receive response
-  if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
-  else if (physInterface == SPI_ARDUINO)
+/**
+  \fn uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t verbose)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
+
+  \return communication status (0=ok, 1=fail)
+
+  mass erase microcontroller P-flash and D-flash/EEPROM. Use with care!
+*/
+uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t verbose)
+{
+  char      Codes[2];
+  uint64_t  tStart, tStop;        // measure time [ms] for erase (for COMM timeout)
+
+  // print message
+  if (verbose == SILENT)
   {
-    SLEEP(40);                              // wait >30ms*(N=0+1) for sector erase before requesting response (see UM0560, SPI timing)
-    len = receive_spi_Arduino(ptrPort, lenRx, Rx);
+    printf("  mass erase ... ");
   }
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-    {
-      SLEEP(40);                              // wait >30ms*(N=0+1) for sector erase before requesting response (see UM0560, SPI timing)
-      len = receive_spi_spidev(ptrPort, lenRx, Rx);
-    }
-  #endif
-  if (len != lenRx)
-    Error("in 'bsl_flashSectorErase()': ACK2 timeout (expect %d, received %d)", (int) lenTx, (int) len);
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+  {
+    printf("  flash mass erase ... ");
+  }
+  fflush(stdout);
 
-  // check acknowledge
-  if (Rx[0]!=ACK)
-    Error("in 'bsl_flashSectorErase()': ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[0]));
+  // check if port is open
+  if (!ptrPort)
+    Error("in 'bsl_flashMassErase()': port not open");
 
-  // measure time for sector erase
-  tStop = millis();
+  // 0xFF+0x00 triggers mass erase
+  Codes[0] = 0xFF;
+  Codes[1] = 0x00;
 
-  // restore timeout
-  set_timeout(ptrPort, TIMEOUT);
+  // measure time for mass erase
+  tStart = millis();
+
+  // mass erase with retry on failure
+  bsl_eraseFramesRetry(ptrPort, physInterface, uartMode, Codes, 2, &tLearnEraseMass, DEADLINE_ERASE_MASS, "bsl_flashMassErase");
+
+  // measure time for mass erase
+  tStop = millis();
 
 
   // print message
@@ -1122,196 +2035,370 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
   }
   else if ((verbose == INFORM) || (verbose == CHATTY))
   {
-    printf("done, time %dms\n", (int)(tStop-tStart));
+    printf("done, time %1.1fs\n", (float)(tStop-tStart)/1000.0);
   }
   fflush(stdout);
 
   // avoid compiler warnings
   return 0;
 
-} // bsl_flashSectorErase
+} // bsl_flashMassErase
 
 
 
 /**
-  \fn uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t verbose)
+  \fn uint8_t bsl_memAlign(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, uint8_t alignMode, uint8_t alignPad, uint8_t verbose)
 
   \param[in]  ptrPort        handle to communication port
   \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
   \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param      image          memory image to align
+  \param[in]  alignMode      fill method for missing bytes: 0=no alignment, 1=pad value, 2=read from device
+  \param[in]  alignPad       pad value for alignMode==ALIGN_PAD
   \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
 
   \return communication status (0=ok, 1=fail)
 
-  mass erase microcontroller P-flash and D-flash/EEPROM. Use with care!
+  widen partial P-flash pages in image to full 128B aligned pages. Missing bytes are taken from
+  a pad value or read from the device (read-modify-write). This allows fast block programming
+  for all pages (see UM0560 section 3.4). RAM, EEPROM and option bytes are not modified.
 */
-uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t verbose)
+uint8_t bsl_memAlign(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, uint8_t alignMode, uint8_t alignPad, uint8_t verbose)
 {
-  int       i, lenTx, lenRx, len = 0;
-  char      Tx[1000], Rx[1000];
-  uint64_t  tStart, tStop;        // measure time [ms] for erase (for COMM timeout)
+  MEMIMAGE_ADDR_T   addrPage;
+  size_t            idx, idxNext;
+  uint8_t           page[PFLASH_PAGESIZE];          // content of aligned page
+  MemoryImage_s     readImage;                      // device content for read-modify-write
+  int               countPages, countBytes, j;
+
+  // nothing to do
+  if ((alignMode == ALIGN_NONE) || (image->numEntries == 0))
+    return 0;
 
   // print message
-  if (verbose == SILENT)
+  if ((verbose == SILENT) || (verbose == INFORM))
+    printf("  align flash pages ... ");
+  else if (verbose == CHATTY)
   {
-    printf("  mass erase ... ");
+    if (alignMode == ALIGN_READ)
+      printf("  align flash pages to %dB (fill from device) ... ", (int) PFLASH_PAGESIZE);
+    else
+      printf("  align flash pages to %dB (fill 0x%02" PRIX8 ") ... ", (int) PFLASH_PAGESIZE, alignPad);
   }
-  else if ((verbose == INFORM) || (verbose == CHATTY))
+  fflush(stdout);
+
+  // check if port is open
+  if ((alignMode == ALIGN_READ) && (!ptrPort))
+    Error("in 'bsl_memAlign()': port not open");
+
+  // skip RAM, EEPROM and option bytes
+  MemoryImage_getIndex(image, PFLASH_START, &idx);
+
+  // loop over all pages containing data
+  countPages = 0;
+  countBytes = 0;
+  MemoryImage_init(&readImage);
+  ownImage(&readImage);
+  while (idx < image->numEntries)
   {
-    printf("  flash mass erase ... ");
-  }
+    // get aligned page and index of next page
+    addrPage = image->memoryEntries[idx].address - (image->memoryEntries[idx].address % PFLASH_PAGESIZE);
+    MemoryImage_getIndex(image, addrPage+PFLASH_PAGESIZE, &idxNext);
+
+    // page is only partially defined -> fill missing bytes
+    if (idxNext - idx < PFLASH_PAGESIZE)
+    {
+      // optionally read page content from device (don't print)
+      if (alignMode == ALIGN_READ)
+      {
+        MemoryImage_free(&readImage);
+        bsl_memRead(ptrPort, physInterface, uartMode, addrPage, addrPage+PFLASH_PAGESIZE-1, &readImage, MUTE);
+      }
+
+      // merge image data with fill data
+      for (j=0; j<PFLASH_PAGESIZE; j++)
+      {
+        if (!MemoryImage_getData(image, addrPage+j, &(page[j])))
+        {
+          if (alignMode == ALIGN_READ)
+            MemoryImage_getData(&readImage, addrPage+j, &(page[j]));
+          else
+            page[j] = alignPad;
+          countBytes++;
+        }
+      }
+
+      // replace partial page by full page
+      if (!MemoryImage_addBlock(image, addrPage, page, PFLASH_PAGESIZE))
+        Error("in 'bsl_memAlign()': cannot add data to memory image");
+      countPages++;
+
+      // index of next page has changed
+      MemoryImage_getIndex(image, addrPage+PFLASH_PAGESIZE, &idxNext);
+    }
+
+    // go to next page
+    idx = idxNext;
+
+  } // loop over pages
+  MemoryImage_free(&readImage);
+  disown(&readImage);
+
+  // print message
+  if (verbose == SILENT)
+    printf("done\n");
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (%d pages, %dB added)\n", countPages, countBytes);
   fflush(stdout);
 
+  // avoid compiler warnings
+  return 0;
 
-  // init receive buffer
-  for (i=0; i<1000; i++)
-    Rx[i] = 0;
+} // bsl_memAlign
 
-  // check if port is open
-  if (!ptrPort)
-    Error("in 'bsl_flashMassErase()': port not open");
 
 
-  /////
-  // send erase command
-  /////
+/**
+  \fn static void bsl_writePage(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, MEMIMAGE_ADDR_T addrPage, int lenPage)
 
-  // construct command
-  lenTx = 2;
-  Tx[0] = ERASE;
-  Tx[1] = (Tx[0] ^ 0xFF);
-  lenRx = 1;
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  image          memory image containing data to write
+  \param[in]  addrPage       first address of page
+  \param[in]  lenPage        number of bytes in page (1..128)
 
-  // send command
-  if (physInterface == UART)
-    len = send_port(ptrPort, uartMode, lenTx, Tx);
-  else if (physInterface == SPI_ARDUINO)
-    len = send_spi_Arduino(ptrPort, lenTx, Tx);
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = send_spi_spidev(ptrPort, lenTx, Tx);
-  #endif
-  if (len != lenTx)
-    Error("in 'bsl_flashMassErase()': sending command failed (expect %d, sent %d)", (int) lenTx, (int) len);
+  write single page via WRITE command in lock-step, i.e. wait for ACK after each frame. For spidev
+  command, address and data frames are sent in a single SPI message, see bsl_transactSpidev()
+*/
+static void bsl_writePage(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, MEMIMAGE_ADDR_T addrPage, int lenPage)
+{
+  char      Tx[1000], Rx[1000];                 // communication buffers
+  int       lenTx, lenRx, len = 0;              // frame lengths
 
-  // receive response
-  if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
-  else if (physInterface == SPI_ARDUINO)
-    len = receive_spi_Arduino(ptrPort, lenRx, Rx);
+
+  /////
+  // spidev: send command, address and data frames in a single SPI message
+  /////
   #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = receive_spi_spidev(ptrPort, lenRx, Rx);
-  #endif
-  if (len != lenRx)
-    Error("in 'bsl_flashMassErase()': ACK1 timeout (expect %d, received %d)", (int) lenRx, (int) len);
+  if (physInterface == SPI_SPIDEV)
+  {
+    // construct number of bytes + data + checksum
+    lenTx = bsl_frameWrite(image, addrPage, lenPage, Tx);
+    lenRx = 1;
 
-  // check acknowledge
-  if (Rx[0]!=ACK)
-    Error("in 'bsl_flashMassErase()': ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    // send frames and receive ACK1 and ACK2
+    bsl_transactSpidev(ptrPort, WRITE, addrPage, Tx, lenTx, Rx, 0, "bsl_memWrite");
 
+    // check acknowledges
+    if (Rx[0]!=ACK)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[0]));
+    if (Rx[1]!=ACK)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[1]));
+
+  } // spidev
+  else
+  #endif // USE_SPIDEV
 
   /////
-  // send 0xFF+0x00 to trigger mass erase
+  // other interfaces: wait for ACK after each frame
   /////
+  {
+    /////
+    // send write command
+    /////
 
-  // increase timeout for long erase. Measured 3.3s for 128kB STM8 -> set to 5s
-  set_timeout(ptrPort, 10000);
+    // construct command
+    lenTx = 2;
+    Tx[0] = WRITE;
+    Tx[1] = (Tx[0] ^ 0xFF);
+    lenRx = 1;
 
-  // construct pattern
-  lenTx = 2;
-  Tx[0] = 0xFF;
-  Tx[1] = 0x00;
-  lenRx = 1;
+    // send command
+    len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
+    if (len != lenTx)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " sending command failed (expect %d, sent %d)", (uint64_t) addrPage, (int) lenTx, (int) len);
 
-  // measure time for mass erase
-  tStart = millis();
+    // receive response
+    len = bsl_receive(ptrPort, physInterface, uartMode, lenRx, Rx);
+    if (len != lenRx)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK1 timeout (expect %d, received %d)", (uint64_t) addrPage, (int) lenRx, (int) len);
 
-  // send command
-  if (physInterface == UART)
-    len = send_port(ptrPort, uartMode, lenTx, Tx);
-  else if (physInterface == SPI_ARDUINO)
-    len = send_spi_Arduino(ptrPort, lenTx, Tx);
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-      len = send_spi_spidev(ptrPort, lenTx, Tx);
-  #endif
-  if (len != lenTx)
-    Error("in 'bsl_flashMassErase()': sending trigger failed (expect %d, sent %d)", (int) lenTx, (int) len);
+    // check acknowledge
+    if (Rx[0]!=ACK)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[0]));
 
 
-  // receive response
+    /////
+    // send address
+    /////
+
+    // construct address + checksum (XOR over address)
+    lenTx = bsl_frameAddress(addrPage, Tx);
+    lenRx = 1;
+
+    // send command
+    len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
+    if (len != lenTx)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " sending address failed (expect %d, sent %d)", (uint64_t) addrPage, (int) lenTx, (int) len);
+
+    // receive response
+    len = bsl_receive(ptrPort, physInterface, uartMode, lenRx, Rx);
+    if (len != lenRx)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK2 timeout (expect %d, received %d)", (uint64_t) addrPage, (int) lenRx, (int) len);
+
+    // check acknowledge
+    if (Rx[0]!=ACK)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[0]));
+
+
+    /////
+    // send number of bytes and data
+    /////
+
+    // construct number of bytes + data + checksum
+    lenTx = bsl_frameWrite(image, addrPage, lenPage, Tx);
+    lenRx = 1;
+
+    // send command
+    len = bsl_send(ptrPort, physInterface, uartMode, lenTx, Tx);
+    if (len != lenTx)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " sending data failed (expect %d, sent %d)", (uint64_t) addrPage, (int) lenTx, (int) len);
+
+  } // lock-step
+
+  // receive response. For SPI poll until flash write is finished (see UM0560, SPI timing)
   if (physInterface == UART)
-    len = receive_port(ptrPort, uartMode, lenRx, Rx);
-  else if (physInterface == SPI_ARDUINO)
-  {
-    SLEEP(1100);                              // wait >30ms*(N=32+1) for sector erase before requesting response (see UM0560, SPI timing)
-    len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-  }
-  #if defined(USE_SPIDEV)
-    else if (physInterface == SPI_SPIDEV)
-    {
-      SLEEP(1100);                              // wait >30ms*(N=32+1) for sector erase before requesting response (see UM0560, SPI timing)
-      len = receive_spi_spidev(ptrPort, lenRx, Rx);
-    }
-  #endif
+    len = bsl_receive(ptrPort, physInterface, uartMode, lenRx, Rx);
+  else if (addrPage <= RAM_END)
+    len = bsl_pollAck(ptrPort, physInterface, uartMode, Rx, NULL, DEADLINE_WRITE);
+  else if ((addrPage % PFLASH_PAGESIZE) || (lenPage != PFLASH_PAGESIZE))
+    len = bsl_pollAck(ptrPort, physInterface, uartMode, Rx, &tLearnWriteUnaligned, DEADLINE_WRITE);
+  else
+    len = bsl_pollAck(ptrPort, physInterface, uartMode, Rx, &tLearnWriteAligned, DEADLINE_WRITE);
   if (len != lenRx)
-    Error("in 'bsl_flashMassErase()': ACK2 timeout (expect %d, received %d)", (int) lenRx, (int) len);
+    Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK3 timeout (expect %d, received %d)", (uint64_t) addrPage, (int) lenRx, (int) len);
 
   // check acknowledge
   if (Rx[0]!=ACK)
-    Error("in 'bsl_flashMassErase()': ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) ACK, (uint8_t) (Rx[0]));
+    Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK3 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[0]));
 
-  // measure time for mass erase
-  tStop = millis();
+} // bsl_writePage
 
-  // restore timeout
-  set_timeout(ptrPort, TIMEOUT);
 
 
-  // print message
-  if (verbose == SILENT)
-  {
-    printf("done\n");
-  }
-  else if ((verbose == INFORM) || (verbose == CHATTY))
+/**
+  \fn static void bsl_writePageRetry(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, MEMIMAGE_ADDR_T addrPage, int lenPage)
+
+  write single page in lock-step (see bsl_writePage()). On failure resync BSL and retry up to g_retryMax times
+*/
+static void bsl_writePageRetry(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, MEMIMAGE_ADDR_T addrPage, int lenPage)
+{
+  ErrorTrap_s     trap, *prev;
+  volatile int    numRetry = 0;
+
+  // on error Error() returns here with setjmp() != 0
+  prev = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    bsl_retryNext(ptrPort, physInterface, uartMode, &trap, prev, numRetry++);
+  bsl_writePage(ptrPort, physInterface, uartMode, image, addrPage, lenPage);
+  setErrorTrap(prev);
+
+} // bsl_writePageRetry
+
+
+
+/**
+  \fn static void bsl_writeBurst(HANDLE ptrPort, uint8_t uartMode, char *Burst, int lenBurst, MEMIMAGE_ADDR_T *addrQueue, int numQueue)
+
+  \param[in]  ptrPort        handle to communication port
+  \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
+  \param[in]  Burst          queued WRITE transactions (command, address and data frames)
+  \param[in]  lenBurst       total length of queued frames
+  \param[in]  addrQueue      start addresses of queued pages (for error messages)
+  \param[in]  numQueue       number of queued pages
+
+  send queued WRITE transactions without waiting for intermediate ACKs, then collect
+  all ACKs (3 per page) in a single read. A NACK or missing ACK is attributed to the
+  respective page and phase. Only for UART duplex mode, see bsl_memWrite()
+*/
+static void bsl_writeBurst(HANDLE ptrPort, uint8_t uartMode, char *Burst, int lenBurst, MEMIMAGE_ADDR_T *addrQueue, int numQueue)
+{
+  char      Rx[3*PIPELINE_WINDOW];
+  int       lenRx, len, i;
+
+  // send all queued frames at once
+  len = send_port(ptrPort, uartMode, lenBurst, Burst);
+  if (len != lenBurst)
+    Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " sending burst failed (expect %d, sent %d)", (uint64_t) addrQueue[0], (int) lenBurst, (int) len);
+
+  // collect ACKs for all phases of all queued pages
+  lenRx = 3*numQueue;
+  len = receive_port(ptrPort, uartMode, lenRx, Rx);
+
+  // check acknowledges and attribute failure to page and phase
+  for (i=0; i<lenRx; i++)
   {
-    printf("done, time %1.1fs\n", (float)(tStop-tStart)/1000.0);
+    if (i >= len)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK%d timeout (expect %d, received %d)", (uint64_t) addrQueue[i/3], (int) (i%3+1), (int) lenRx, (int) len);
+    if (Rx[i] != ACK)
+      Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK%d failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrQueue[i/3], (int) (i%3+1), (uint8_t) ACK, (uint8_t) (Rx[i]));
   }
-  fflush(stdout);
 
-  // avoid compiler warnings
-  return 0;
+} // bsl_writeBurst
 
-} // bsl_flashMassErase
+
+
+/**
+  \fn static void bsl_writeBurstRetry(HANDLE ptrPort, uint8_t uartMode, char *Burst, int lenBurst, MEMIMAGE_ADDR_T *addrQueue, int numQueue)
+
+  send queued WRITE transactions (see bsl_writeBurst()). On failure resync BSL and retry complete burst up to g_retryMax times
+*/
+static void bsl_writeBurstRetry(HANDLE ptrPort, uint8_t uartMode, char *Burst, int lenBurst, MEMIMAGE_ADDR_T *addrQueue, int numQueue)
+{
+  ErrorTrap_s     trap, *prev;
+  volatile int    numRetry = 0;
+
+  // on error Error() returns here with setjmp() != 0
+  prev = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    bsl_retryNext(ptrPort, UART, uartMode, &trap, prev, numRetry++);
+  bsl_writeBurst(ptrPort, uartMode, Burst, lenBurst, addrQueue, numQueue);
+  setErrorTrap(prev);
+
+} // bsl_writeBurstRetry
 
 
 
 /**
-  \fn uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint16_t *imageBuf, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrStop, uint8_t verbose)
+  \fn uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t writeMode, uint8_t verbose)
 
   \param[in]  ptrPort        handle to communication port
   \param[in]  physInterface  bootloader interface: 0=UART (default), 1=SPI via Arduino, 2=SPI via SPIDEV
   \param[in]  uartMode       UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply
-  \param[out] imageBuf       memory image of data to write
-  \param[in]  addrStart      first address to write to
-  \param[in]  addrStop       last address to write to
+  \param[in]  image          memory image of data to write
+  \param[in]  writeMode      transfer mode: WRITE_LOCKSTEP or WRITE_PIPELINED
   \param[in]  verbose        verbosity level (0=SILENT, 1=INFORM, 2=CHATTY)
 
   \return communication status (0=ok, 1=fail)
 
-  upload data to microcontroller memory via WRITE command
+  upload data to microcontroller memory via WRITE command. Transfer mode is selected via writeMode:
+    - WRITE_LOCKSTEP: wait for ACK after each of the 3 frames per page
+    - WRITE_PIPELINED: send command, address and data frames of a page back-to-back and collect ACKs
+      in bulk. For RAM up to PIPELINE_WINDOW pages are in flight. Only for UART duplex mode, else lock-step
 */
-uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t verbose)
+uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t writeMode, uint8_t verbose)
 {
   int               countBytes, countPage;              // size of memory image
   const int         maxPage = 128;                      // max. length of write (aka page)
   MEMIMAGE_ADDR_T   addrBlock, addrPage, addrStart, addrEnd;
   size_t            idxStart, idxEnd;
-  char              Tx[1000], Rx[1000];                 // communication buffers
-  int               lenTx, lenRx, len = 0;              // frame lengths
-  uint8_t           chk;                                // frame checksum
-  int               i, j;
+  bool              pipelined;                          // send frames without waiting for ACK
+  char              Burst[PIPELINE_WINDOW*(2+5+maxPage+2)];  // queued frames for pipelined write
+  int               lenBurst, numQueue;                 // length and number of pages in burst
+  MEMIMAGE_ADDR_T   addrQueue[PIPELINE_WINDOW];         // page addresses in burst
+  int               lenQueue[PIPELINE_WINDOW];          // page lengths in burst
+  uint64_t          tStart, tStop;                      // measure time [ms] for write
 
 
   // print message
@@ -1352,19 +2439,22 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, co
   }
   fflush(stdout);
 
-  // init receive buffer
-  for (i=0; i<1000; i++)
-    Rx[i] = 0;
-
   // check if port is open
   if (!ptrPort)
     Error("in 'bsl_memWrite()': port not open");
 
+  // pipelining requires full duplex. SPI requires polling and 1-wire UART would collide with BSL response
+  pipelined = ((writeMode == WRITE_PIPELINED) && (physInterface == UART) && (uartMode == 0));
+
+  // measure time for write
+  tStart = millis();
 
   // loop over consecutive memory blocks in image
   addrBlock = 0x00;
   countBytes = 0;
   countPage = 0;
+  lenBurst = 0;
+  numQueue = 0;
   while (MemoryImage_getMemoryBlock(image, addrBlock, &idxStart, &idxEnd)) {
 
     addrStart = image->memoryEntries[idxStart].address;
@@ -1381,147 +2471,40 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, co
         lenPage++;
       //printf("0x%04" PRIX64 "  %d\n", (uint64_t) addrPage, lenPage);
 
-      /////
-      // send write command
-      /////
-
-      // construct command
-      lenTx = 2;
-      Tx[0] = WRITE;
-      Tx[1] = (Tx[0] ^ 0xFF);
-      lenRx = 1;
-
-      // send command
-      if (physInterface == UART)
-        len = send_port(ptrPort, uartMode, lenTx, Tx);
-      else if (physInterface == SPI_ARDUINO)
-        len = send_spi_Arduino(ptrPort, lenTx, Tx);
-      #if defined(USE_SPIDEV)
-        else if (physInterface == SPI_SPIDEV)
-          len = send_spi_spidev(ptrPort, lenTx, Tx);
-      #endif
-      if (len != lenTx)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " sending command failed (expect %d, sent %d)", (uint64_t) addrPage, (int) lenTx, (int) len);
-
-      // receive response
-      if (physInterface == UART)
-        len = receive_port(ptrPort, uartMode, lenRx, Rx);
-      else if (physInterface == SPI_ARDUINO)
-        len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-      #if defined(USE_SPIDEV)
-        else if (physInterface == SPI_SPIDEV)
-          len = receive_spi_spidev(ptrPort, lenRx, Rx);
-      #endif
-      if (len != lenRx)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK1 timeout (expect %d, received %d)", (uint64_t) addrPage, (int) lenRx, (int) len);
-
-      // check acknowledge
-      if (Rx[0]!=ACK)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK1 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[0]));
-
-
-      /////
-      // send address
-      /////
-
-      // construct address + checksum (XOR over address)
-      lenTx = 5;
-      Tx[0] = (char) (addrPage >> 24);
-      Tx[1] = (char) (addrPage >> 16);
-      Tx[2] = (char) (addrPage >> 8);
-      Tx[3] = (char) (addrPage);
-      Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
-      lenRx = 1;
-
-      // send command
-      if (physInterface == UART)
-        len = send_port(ptrPort, uartMode, lenTx, Tx);
-      else if (physInterface == SPI_ARDUINO)
-        len = send_spi_Arduino(ptrPort, lenTx, Tx);
-      #if defined(USE_SPIDEV)
-        else if (physInterface == SPI_SPIDEV)
-          len = send_spi_spidev(ptrPort, lenTx, Tx);
-      #endif
-      if (len != lenTx)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " sending address failed (expect %d, sent %d)", (uint64_t) addrPage, (int) lenTx, (int) len);
-
-
-      // receive response
-      if (physInterface == UART)
-        len = receive_port(ptrPort, uartMode, lenRx, Rx);
-      else if (physInterface == SPI_ARDUINO)
-        len = receive_spi_Arduino(ptrPort, lenRx, Rx);
-      #if defined(USE_SPIDEV)
-        else if (physInterface == SPI_SPIDEV)
-          len = receive_spi_spidev(ptrPort, lenRx, Rx);
-      #endif
-      if (len != lenRx)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK2 timeout (expect %d, received %d)", (uint64_t) addrPage, (int) lenRx, (int) len);
-
-      // check acknowledge
-      if (Rx[0]!=ACK)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK2 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[0]));
-
-
-      /////
-      // send number of bytes and data
-      /////
-
-      // construct number of bytes + data + checksum
-      lenTx = 0;
-      Tx[lenTx++] = lenPage-1;     // -1 from BSL
-      chk         = lenPage-1;
-      for (j=0; j<lenPage; j++)
+      // pipelined write: queue command, address and data frames
+      if (pipelined)
       {
-        MemoryImage_getData(image, addrPage+j, (uint8_t*) (Tx+lenTx));
-        chk ^= Tx[lenTx];
-        lenTx++;
-        countBytes++;
+        Burst[lenBurst++] = WRITE;
+        Burst[lenBurst++] = (WRITE ^ 0xFF);
+        lenBurst += bsl_frameAddress(addrPage, Burst+lenBurst);
+        lenBurst += bsl_frameWrite(image, addrPage, lenPage, Burst+lenBurst);
+        addrQueue[numQueue] = addrPage;
+        lenQueue[numQueue++] = lenPage;
+
+        // send burst if window is full, for flash (BSL is blocked during programming) or at end of block
+        if ((numQueue == PIPELINE_WINDOW) || (addrPage > RAM_END) || (addrPage+lenPage > addrEnd))
+        {
+          bsl_writeBurstRetry(ptrPort, uartMode, Burst, lenBurst, addrQueue, numQueue);
+          if (pageDoneCallback != NULL)
+          {
+            for (int i=0; i<numQueue; i++)
+              pageDoneCallback(pageDoneArg, addrQueue[i], lenQueue[i]);
+          }
+          lenBurst = 0;
+          numQueue = 0;
+        }
       }
-      Tx[lenTx++] = chk;
-      lenRx = 1;
-
-
-      // send command
-      if (physInterface == UART)
-        len = send_port(ptrPort, uartMode, lenTx, Tx);
-      else if (physInterface == SPI_ARDUINO)
-        len = send_spi_Arduino(ptrPort, lenTx, Tx);
-      #if defined(USE_SPIDEV)
-        else if (physInterface == SPI_SPIDEV)
-          len = send_spi_spidev(ptrPort, lenTx, Tx);
-      #endif
-      if (len != lenTx)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " sending data failed (expect %d, sent %d)", (uint64_t) addrPage, (int) lenTx, (int) len);
-
-
-      // receive response
-      if (physInterface == UART)
-        len = receive_port(ptrPort, uartMode, lenRx, Rx);
-      else if (physInterface == SPI_ARDUINO)
+
+      // lock-step write: wait for ACK after each frame
+      else
       {
-        if ((addrBlock >= PFLASH_START) && (addrBlock % 128))  // wait for flash write finished before requesting response (see UM0560, SPI timing)
-          SLEEP(1200);                               // for not 128-aligned data wait >1.1s
-        else
-          SLEEP(20);                                 // for 128-aligned data wait >8.5ms
-        len = receive_spi_Arduino(ptrPort, lenRx, Rx);
+        bsl_writePageRetry(ptrPort, physInterface, uartMode, image, addrPage, lenPage);
+        if (pageDoneCallback != NULL)
+          pageDoneCallback(pageDoneArg, addrPage, lenPage);
       }
-      #if defined(USE_SPIDEV)
-        else if (physInterface == SPI_SPIDEV)
-        {
-          if ((addrBlock >= PFLASH_START) && (addrBlock % 128))  // wait for flash write finished before requesting response (see UM0560, SPI timing)
-            SLEEP(1200);                               // for not 128-aligned data wait >1.1s
-          else
-            SLEEP(20);                                 // for 128-aligned data wait >8.5ms
-          len = receive_spi_spidev(ptrPort, lenRx, Rx);
-        }
-      #endif
-      if (len != lenRx)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK3 timeout (expect %d, received %d)", (uint64_t) addrPage, (int) lenRx, (int) len);
 
-      // check acknowledge
-      if (Rx[0]!=ACK)
-        Error("in 'bsl_memWrite()': at 0x%04" PRIX64 " ACK3 failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint64_t) addrPage, (uint8_t) ACK, (uint8_t) (Rx[0]));
+      // update byte counter
+      countBytes += lenPage;
 
       // print progress
       if (((++countPage) % 8) == 0)
@@ -1549,6 +2532,10 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, co
               (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address);
         }
         fflush(stdout);
+
+        // optional progress callback
+        if (progressCallback != NULL)
+          progressCallback(progressArg, "write", countBytes, image->numEntries);
       }
 
       // go to next page
@@ -1561,6 +2548,13 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, co
 
   } // loop over memory blocks in image
 
+  // final progress callback
+  if (progressCallback != NULL)
+    progressCallback(progressArg, "write", countBytes, image->numEntries);
+
+  // measure time for write
+  tStop = millis();
+
   // print message
   if (verbose == SILENT)
     printf(" done\n");
@@ -1574,11 +2568,13 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, co
   else if (verbose == CHATTY)
   {
     if (image->numEntries > 1024)
-      printf("%c  write %1.1fkB / %1.1fkB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ... done   \n", '\r', (float) countBytes/1024.0, (float) image->numEntries/1024.0, 
-        (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address);
+      printf("%c  write %1.1fkB / %1.1fkB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ... done, %s %1.1fkB/s   \n", '\r', (float) countBytes/1024.0, (float) image->numEntries/1024.0, 
+        (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address,
+        (pipelined ? "pipelined" : "lock-step"), (float) countBytes/1.024/(float) (tStop-tStart+1));
     else
-      printf("%c  write %dB / %dB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ... done   \n", '\r', (int) countBytes, (int) image->numEntries, 
-        (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address);
+      printf("%c  write %dB / %dB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ... done, %s %1.1fkB/s   \n", '\r', (int) countBytes, (int) image->numEntries, 
+        (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address,
+        (pipelined ? "pipelined" : "lock-step"), (float) countBytes/1.024/(float) (tStop-tStart+1));
   }
 
   // avoid compiler warnings
@@ -1609,6 +2605,7 @@ uint8_t bsl_memVerifyRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMod
   // initialize temporary memory image for flash read 
   MemoryImage_s tmpImage;
   MemoryImage_init(&tmpImage);
+  ownImage(&tmpImage);
 
   // loop over consecutive memory blocks in image
   addrBlock = 0x00;
@@ -1648,6 +2645,7 @@ uint8_t bsl_memVerifyRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMod
 
   // release temporary memory image
   MemoryImage_free(&tmpImage);
+  disown(&tmpImage);
 
   // avoid compiler warnings
   return 0;
@@ -0,0 +1,191 @@
+/**
+  \file delta.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of delta flashing
+
+  implementation of routines to remove flash blocks from a memory image, which
+  already have identical content in the device. Device content is compared via
+  the CRC32 RAM routine (see verify_CRC32.c) or, if not available, via read-back.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "main.h"
+#include "bootloader.h"
+#include "misc.h"
+#include "verify_CRC32.h"
+#include "delta.h"
+
+
+/// compare device vs. image CRC32 over contiguous range. Bisect mismatching ranges down to block size and remove unchanged parts from image
+static void delta_crc32(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd, int blockSize, int *numChanged)
+{
+  size_t            idxStart, idxEnd;
+  uint32_t          crc32_uC, crc32_PC;
+  MEMIMAGE_ADDR_T   addrSplit;
+
+  // calculate CRC32 over range in image and device
+  MemoryImage_getIndex(image, addrStart, &idxStart);
+  MemoryImage_getIndex(image, addrEnd, &idxEnd);
+  crc32_PC = MemoryImage_checksum_crc32(image, idxStart, idxEnd);
+  calc_crc32(ptrPort, physInterface, uartMode, addrStart, addrEnd, &crc32_uC);
+
+  // range is unchanged -> don't write
+  if (crc32_uC == crc32_PC)
+  {
+    MemoryImage_cut(image, addrStart, addrEnd);
+    return;
+  }
+
+  // range within single block is changed -> write block
+  if ((addrStart / blockSize) == (addrEnd / blockSize))
+  {
+    (*numChanged)++;
+    return;
+  }
+
+  // split range at block boundary next to center and check both halves
+  addrSplit = ((addrStart + (addrEnd - addrStart) / 2) / blockSize) * blockSize;
+  if (addrSplit <= addrStart)
+    addrSplit += blockSize;
+  delta_crc32(ptrPort, physInterface, uartMode, image, addrStart, addrSplit-1, blockSize, numChanged);
+  delta_crc32(ptrPort, physInterface, uartMode, image, addrSplit, addrEnd, blockSize, numChanged);
+
+} // delta_crc32()
+
+
+/// compare device vs. image via read-back. Remove unchanged blocks from image
+static void delta_read(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd, int blockSize, int *numChanged)
+{
+  MemoryImage_s     readImage;
+  MEMIMAGE_ADDR_T   addrBlock, addrFirst, addrLast;
+  size_t            idxImage, idxRead;
+  bool              changed;
+
+  // read device content of range
+  MemoryImage_init(&readImage);
+  ownImage(&readImage);
+  bsl_memRead(ptrPort, physInterface, uartMode, addrStart, addrEnd, &readImage, MUTE);
+
+  // loop over blocks in range and compare content
+  for (addrBlock = addrStart - (addrStart % blockSize); addrBlock <= addrEnd; addrBlock += blockSize)
+  {
+    addrFirst = (addrBlock > addrStart) ? addrBlock : addrStart;
+    addrLast  = (addrBlock + blockSize - 1 < addrEnd) ? addrBlock + blockSize - 1 : addrEnd;
+    MemoryImage_getIndex(image, addrFirst, &idxImage);
+    MemoryImage_getIndex(&readImage, addrFirst, &idxRead);
+    changed = false;
+    for (size_t i = 0; i <= (size_t) (addrLast - addrFirst); i++)
+    {
+      if (image->memoryEntries[idxImage+i].data != readImage.memoryEntries[idxRead+i].data)
+      {
+        changed = true;
+        break;
+      }
+    }
+
+    // remove unchanged block from image
+    if (changed)
+      (*numChanged)++;
+    else
+      MemoryImage_cut(image, addrFirst, addrLast);
+  }
+
+  // release memory image
+  MemoryImage_free(&readImage);
+  disown(&readImage);
+
+} // delta_read()
+
+
+/// remove flash blocks with identical device content from memory image
+uint8_t delta_filter(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, int blockSize, uint8_t verbose)
+{
+  MEMIMAGE_ADDR_T   addrBlock, addrStart, addrEnd, addrFlashEnd;
+  size_t            idxStart, idxEnd;
+  bool              useCRC32;
+  int               numBlocks, numChanged;
+  uint64_t          tStart, tStop;        // measure time [ms] for check
+
+  // nothing to do
+  if ((blockSize == DELTA_OFF) || (image->numEntries == 0))
+    return 0;
+
+  // print message
+  if (verbose != MUTE)
+    printf("  delta check ... ");
+  fflush(stdout);
+
+  // measure time for check
+  tStart = millis();
+
+  // count P-flash blocks containing data
+  addrFlashEnd = PFLASH_START + (MEMIMAGE_ADDR_T) flashsize*1024 - 1;
+  numBlocks = 0;
+  addrBlock = 0;
+  for (size_t i = 0; i < image->numEntries; i++)
+  {
+    MEMIMAGE_ADDR_T addr = image->memoryEntries[i].address;
+    if ((addr >= PFLASH_START) && (addr <= addrFlashEnd) && ((numBlocks == 0) || (addr / blockSize != addrBlock)))
+    {
+      addrBlock = addr / blockSize;
+      numBlocks++;
+    }
+  }
+
+  // prefer CRC32 RAM routine if available for device, else read back
+  useCRC32 = support_crc32(family, flashsize, versBSL);
+  if (useCRC32 && (numBlocks > 0))
+    upload_crc32_code(ptrPort, family, flashsize, versBSL, physInterface, uartMode);
+
+  // loop over consecutive P-flash ranges in image. RAM, EEPROM and option bytes are always written
+  numChanged = 0;
+  addrBlock = PFLASH_START;
+  while ((numBlocks > 0) && MemoryImage_getMemoryBlock(image, addrBlock, &idxStart, &idxEnd))
+  {
+    addrStart = image->memoryEntries[idxStart].address;
+    addrEnd   = image->memoryEntries[idxEnd].address;
+    if (addrStart > addrFlashEnd)
+      break;
+    if (addrEnd > addrFlashEnd)
+      addrEnd = addrFlashEnd;
+
+    // compare range and remove unchanged blocks from image
+    if (useCRC32)
+      delta_crc32(ptrPort, physInterface, uartMode, image, addrStart, addrEnd, blockSize, &numChanged);
+    else
+      delta_read(ptrPort, physInterface, uartMode, image, addrStart, addrEnd, blockSize, &numChanged);
+
+    // start address for searching next range
+    addrBlock = addrEnd + 1;
+  }
+
+  // CRC32 routine uses ROM-BL GO command which clears w/e routines -> re-upload
+  if (useCRC32 && (numBlocks > 0))
+    bsl_uploadWriteErase(ptrPort, physInterface, uartMode, flashsize, versBSL, family, MUTE);
+
+  // measure time for check
+  tStop = millis();
+
+  // print message
+  if (verbose == SILENT)
+    printf("done\n");
+  else if (verbose == INFORM)
+    printf("done (%d of %d blocks changed)\n", numChanged, numBlocks);
+  else if (verbose == CHATTY)
+    printf("done (%d of %d blocks of %dB changed, %s, time %dms)\n", numChanged, numBlocks, blockSize, useCRC32 ? "CRC32" : "read-back", (int) (tStop-tStart));
+  fflush(stdout);
+
+  // avoid compiler warnings
+  return 0;
+
+} // delta_filter()
+
+
+// end of file
@@ -0,0 +1,131 @@
+/**
+  \file devcache.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of device identity cache
+
+  implementation of routines to store the identity of the device connected to a
+  port in a cache file, to shorten device identification on next connect. The
+  cache is a text file with one line per port: name, family, flash size [kB] and
+  BSL version. A cached identity is only a hint and is confirmed via
+  bsl_checkInfo() before use.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "bootloader.h"
+#include "misc.h"
+#include "devcache.h"
+
+
+/// cache entry for one port
+typedef struct {
+  char      portname[DEVCACHE_NAMELEN];   //< name of port
+  uint8_t   family;                       //< STM8 family (STM8S=1, STM8L=2)
+  int       flashsize;                    //< size of flash [kB]
+  unsigned  versBSL;                      //< BSL version
+} DevCacheEntry_s;
+
+
+/// read all entries of cache file. Return number of entries
+static int devcache_read(const char *filename, DevCacheEntry_s *entries)
+{
+  FILE      *fp;
+  char      line[DEVCACHE_NAMELEN+50], family[10];
+  int       numEntries = 0;
+
+  // no cache file yet
+  fp = fopen(filename, "r");
+  if (fp == NULL)
+    return 0;
+
+  // read one port per line, skip comments and malformed lines
+  while ((numEntries < DEVCACHE_MAX) && (fgets(line, sizeof(line), fp) != NULL))
+  {
+    DevCacheEntry_s *entry = &(entries[numEntries]);
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%255s %9s %d %x", entry->portname, family, &(entry->flashsize), &(entry->versBSL)) != 4)
+      continue;
+    if (!strcmp(family, "STM8S"))
+      entry->family = STM8S;
+    else if (!strcmp(family, "STM8L"))
+      entry->family = STM8L;
+    else
+      continue;
+    numEntries++;
+  }
+  fclose(fp);
+
+  return numEntries;
+
+} // devcache_read()
+
+
+/// get cached device identity for port. Return false if port is not in cache
+bool devcache_load(const char *filename, const char *portname, int *flashsize, uint8_t *versBSL, uint8_t *family)
+{
+  DevCacheEntry_s   entries[DEVCACHE_MAX];
+  int               numEntries;
+
+  // search port in cache
+  numEntries = devcache_read(filename, entries);
+  for (int i = 0; i < numEntries; i++)
+  {
+    if (!strcmp(entries[i].portname, portname))
+    {
+      *flashsize = entries[i].flashsize;
+      *versBSL   = (uint8_t) entries[i].versBSL;
+      *family    = entries[i].family;
+      return true;
+    }
+  }
+
+  // port not found
+  return false;
+
+} // devcache_load()
+
+
+/// store device identity for port in cache file
+void devcache_store(const char *filename, const char *portname, int flashsize, uint8_t versBSL, uint8_t family)
+{
+  DevCacheEntry_s   entries[DEVCACHE_MAX];
+  int               numEntries, idx;
+  FILE              *fp;
+
+  // replace entry of port or append new entry. If cache is full, replace oldest entry
+  numEntries = devcache_read(filename, entries);
+  for (idx = 0; (idx < numEntries) && strcmp(entries[idx].portname, portname); idx++)
+    ;
+  if (idx == DEVCACHE_MAX)
+  {
+    memmove(entries, entries+1, (DEVCACHE_MAX-1)*sizeof(DevCacheEntry_s));
+    idx = DEVCACHE_MAX-1;
+  }
+  else if (idx == numEntries)
+    numEntries++;
+  strncpy(entries[idx].portname, portname, DEVCACHE_NAMELEN-1);
+  entries[idx].portname[DEVCACHE_NAMELEN-1] = '\0';
+  entries[idx].family    = family;
+  entries[idx].flashsize = flashsize;
+  entries[idx].versBSL   = versBSL;
+
+  // rewrite cache file
+  fp = fopen(filename, "w");
+  if (fp == NULL)
+    Error("in 'devcache_store()': cannot write device cache '%s'", filename);
+  fprintf(fp, "# stm8gal device cache: port, family, flash [kB], BSL version\n");
+  for (int i = 0; i < numEntries; i++)
+    fprintf(fp, "%s %s %d 0x%02X\n", entries[i].portname, (entries[i].family == STM8S) ? "STM8S" : "STM8L", entries[i].flashsize, entries[i].versBSL);
+  fclose(fp);
+
+} // devcache_store()
+
+
+// end of file
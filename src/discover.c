@@ -0,0 +1,394 @@
+/**
+  \file discover.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of STM8 bootloader discovery
+
+  implementation of routines to find serial ports with an STM8 in bootloader
+  mode. Under Linux candidate ports are enumerated via /sys/class/tty, which
+  also provides USB vendor/product ID and serial number of the adapter. All
+  candidates are probed concurrently, each on its own thread: optional reset,
+  SYNCH (see bsl_syncFast()), UART mode check and GET. Errors are trapped per
+  port, i.e. the discovery takes about one sync timeout, independent of the
+  number of ports.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#if defined(__APPLE__) || defined(__unix__)
+  #include <dirent.h>
+#endif
+#if defined(__linux__)
+  #include <linux/serial.h>   // for TIOCGSERIAL
+#endif
+#include "main.h"
+#include "bootloader.h"
+#include "gang.h"
+#include "discover.h"
+
+
+
+/**
+  \fn static int discover_compare(const void *a, const void *b)
+
+  \param[in]  a     first port
+  \param[in]  b     second port
+
+  \return result of strcmp() of port names
+
+  compare function for sorting ports by name via qsort()
+*/
+static int discover_compare(const void *a, const void *b)
+{
+  return strcmp(((const DiscoverPort_s*) a)->portname, ((const DiscoverPort_s*) b)->portname);
+
+} // discover_compare
+
+
+
+/**
+  \fn static void discover_usbInfo(DiscoverPort_s *port)
+
+  \param[in,out] port   port to get USB vendor/product ID and serial number for
+
+  Get USB IDs and serial number of adapter from sysfs (Linux only). These are stored
+  with the USB device, i.e. above interface (ttyACM) or above interface and port (ttyUSB).
+  Resolves links like /dev/serial/by-id/... to the tty device
+*/
+static void discover_usbInfo(DiscoverPort_s *port)
+{
+  port->vid = 0;
+  port->pid = 0;
+  strcpy(port->serial, "-");
+
+  #if defined(__linux__)
+    char        real[PATH_MAX], path[PATH_MAX+64];
+    const char  *name;
+    const char  *parent[] = {"..", "../.."};
+    FILE        *fp;
+    unsigned    vid, pid;
+
+    if (realpath(port->portname, real) == NULL)
+      return;
+    name = strrchr(real, '/');
+    name = (name != NULL) ? name+1 : real;
+
+    for (int i = 0; i < 2; i++)
+    {
+      // vendor and product ID identify USB device
+      snprintf(path, sizeof(path), "/sys/class/tty/%s/device/%s/idVendor", name, parent[i]);
+      fp = fopen(path, "r");
+      if (fp == NULL)
+        continue;
+      if (fscanf(fp, "%x", &vid) == 1)
+        port->vid = (uint16_t) vid;
+      fclose(fp);
+      snprintf(path, sizeof(path), "/sys/class/tty/%s/device/%s/idProduct", name, parent[i]);
+      fp = fopen(path, "r");
+      if (fp != NULL) {
+        if (fscanf(fp, "%x", &pid) == 1)
+          port->pid = (uint16_t) pid;
+        fclose(fp);
+      }
+
+      // serial number is optional
+      snprintf(path, sizeof(path), "/sys/class/tty/%s/device/%s/serial", name, parent[i]);
+      fp = fopen(path, "r");
+      if (fp != NULL) {
+        if (fscanf(fp, "%255s", port->serial) != 1)
+          strcpy(port->serial, "-");
+        fclose(fp);
+      }
+      return;
+    }
+  #endif // __linux__
+
+} // discover_usbInfo
+
+
+
+/**
+  \fn static int discover_enumerate(DiscoverPort_s *ports, int maxPorts)
+
+  \param[out] ports       list of ports
+  \param[in]  maxPorts    max. number of ports in list
+
+  \return number of ports found
+
+  Enumerate serial devices. Linux: all entries of /sys/class/tty with a hardware
+  device, skipping unused legacy UARTs. Other Posix: /dev entries as in list_ports().
+  Windows: COM ports which can be opened
+*/
+static int discover_enumerate(DiscoverPort_s *ports, int maxPorts)
+{
+  int   numPorts = 0;
+
+/////////
+// Linux
+/////////
+#if defined(__linux__)
+
+  struct dirent   *ent;
+  DIR             *dir = opendir("/sys/class/tty");
+  char            path[PATH_MAX];
+
+  if (dir == NULL)
+    Error("in 'discover_enumerate': cannot list /sys/class/tty");
+  while (((ent = readdir(dir)) != NULL) && (numPorts < maxPorts))
+  {
+    // virtual terminals and ptys have no device
+    if (ent->d_name[0] == '.')
+      continue;
+    snprintf(path, sizeof(path), "/sys/class/tty/%.200s/device", ent->d_name);
+    if (access(path, F_OK) != 0)
+      continue;
+
+    // legacy UARTs (ttyS) always exist, skip if no hardware is detected
+    if (!strncmp(ent->d_name, "ttyS", 4)) {
+      struct serial_struct  info;
+      int                   fd;
+      snprintf(path, sizeof(path), "/dev/%.200s", ent->d_name);
+      fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+      if (fd < 0)
+        continue;
+      if ((ioctl(fd, TIOCGSERIAL, &info) != 0) || (info.type == PORT_UNKNOWN)) {
+        close(fd);
+        continue;
+      }
+      close(fd);
+    }
+
+    // add device
+    snprintf(ports[numPorts].portname, DISCOVER_NAMELEN, "/dev/%.200s", ent->d_name);
+    numPorts++;
+  }
+  closedir(dir);
+
+/////////
+// other Posix
+/////////
+#elif defined(__APPLE__) || defined(__unix__)
+
+  struct dirent   *ent;
+  DIR             *dir = opendir("/dev");
+  const char      *pattern[] = {"tty.usbserial", "tty.usbmodem", "tty.PL2303", "ttyUSB", "ttyACM", "ttyAMA", "serial0"};
+
+  if (dir == NULL)
+    Error("in 'discover_enumerate': cannot list /dev");
+  while (((ent = readdir(dir)) != NULL) && (numPorts < maxPorts))
+  {
+    for (int i = 0; i < (int) (sizeof(pattern)/sizeof(pattern[0])); i++) {
+      if (strstr(ent->d_name, pattern[i]) != NULL) {
+        snprintf(ports[numPorts].portname, DISCOVER_NAMELEN, "/dev/%.200s", ent->d_name);
+        numPorts++;
+        break;
+      }
+    }
+  }
+  closedir(dir);
+
+/////////
+// Windows
+/////////
+#elif defined(WIN32) || defined(WIN64)
+
+  HANDLE  fpCom;
+  char    name[50];
+
+  for (int i = 1; (i <= 255) && (numPorts < maxPorts); i++)
+  {
+    snprintf(name, sizeof(name), "\\\\.\\COM%d", i);
+    fpCom = CreateFile(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (fpCom != INVALID_HANDLE_VALUE) {
+      CloseHandle(fpCom);
+      snprintf(ports[numPorts].portname, DISCOVER_NAMELEN, "%s", name);
+      numPorts++;
+    }
+  }
+
+#endif
+
+  // return number of ports
+  return numPorts;
+
+} // discover_enumerate
+
+
+
+/**
+  \fn int discover_ports(const char *list, DiscoverPort_s *ports, int maxPorts)
+
+  \param[in]  list        "all" to enumerate serial devices, else comma separated port names or patterns (see gang_ports())
+  \param[out] ports       list of ports incl. USB IDs and serial number (Linux only)
+  \param[in]  maxPorts    max. number of ports in list
+
+  \return number of ports found
+
+  Get candidate ports for discovery, sorted by name
+*/
+int discover_ports(const char *list, DiscoverPort_s *ports, int maxPorts)
+{
+  int   numPorts;
+
+  // clear list
+  memset(ports, 0, maxPorts * sizeof(DiscoverPort_s));
+
+  // enumerate all serial devices
+  if (!strcmp(list, "all"))
+    numPorts = discover_enumerate(ports, maxPorts);
+
+  // given ports
+  else {
+    char  (*names)[GANG_NAMELEN] = malloc(maxPorts * GANG_NAMELEN);
+    if (names == NULL)
+      Error("in 'discover_ports': cannot allocate %d ports", maxPorts);
+    numPorts = gang_ports(list, names, maxPorts);
+    for (int i = 0; i < numPorts; i++)
+      snprintf(ports[i].portname, DISCOVER_NAMELEN, "%s", names[i]);
+    free(names);
+  }
+
+  // sort by name and get adapter info
+  qsort(ports, numPorts, sizeof(DiscoverPort_s), discover_compare);
+  for (int i = 0; i < numPorts; i++)
+    discover_usbInfo(&(ports[i]));
+
+  // return number of ports
+  return numPorts;
+
+} // discover_ports
+
+
+
+/**
+  \fn static void *discover_session(void *arg)
+
+  \param[in,out] arg      port to probe (DiscoverPort_s*)
+
+  \return NULL
+
+  Probe thread for a single port: open, optional reset, SYNCH, UART mode check
+  and GET. Errors are stored in port instead of terminating. The STM8 remains in
+  bootloader mode
+*/
+static void *discover_session(void *arg)
+{
+  DiscoverPort_s    *port = (DiscoverPort_s*) arg;
+  ErrorTrap_s       trap;
+
+  // per-thread parameters. Probe only, no retries
+  g_retryMax   = 0;
+  g_lowLatency = port->lowLatency;
+  g_ioThread   = false;
+
+  // probe port. On error Error() returns here with setjmp() != 0
+  port->tStart = millis();
+  setErrorTrap(&trap);
+  if (setjmp(trap.env) == 0)
+  {
+    port->ptrPort = init_port(port->portname, port->baudrate, TIMEOUT, 8, 0, 1, 0, 0);
+    if (port->resetSTM8 == 2)
+      pulse_DTR(port->ptrPort, 10);
+    else if (port->resetSTM8 == 6)
+      pulse_RTS(port->ptrPort, 10);
+    bsl_syncFast(port->ptrPort, UART, MUTE);
+    port->uartMode = bsl_getUartMode(port->ptrPort, MUTE);
+    bsl_getInfo(port->ptrPort, UART, port->uartMode, &(port->flashsize), &(port->versBSL), &(port->family), MUTE);
+    port->found = true;
+  }
+  else
+    snprintf(port->errMsg, ERRMSG_LEN, "%s", trap.msg);
+
+  // close port and ignore errors
+  if ((port->ptrPort) && (setjmp(trap.env) == 0))
+    close_port(&(port->ptrPort));
+  setErrorTrap(NULL);
+  port->tStop = millis();
+
+  return NULL;
+
+} // discover_session
+
+
+
+/**
+  \fn int discover_run(DiscoverPort_s *ports, int numPorts, uint32_t baudrate, uint8_t resetSTM8, uint8_t verbose)
+
+  \param[in,out] ports    list of ports, see discover_ports()
+  \param[in]  numPorts    number of ports in list
+  \param[in]  baudrate    probe baudrate
+  \param[in]  resetSTM8   reset method: 0=skip, 2=DTR line, 6=RTS line
+  \param[in]  verbose     verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  \return number of ports with responding STM8 bootloader
+
+  Probe all ports concurrently on separate threads. Print one line per responding
+  target to stdout: port, USB vendor:product ID, adapter serial number, family,
+  flash size [kB], BSL version and UART mode. Other lines start with '#'.
+  With CHATTY also print ports without response as comment
+*/
+int discover_run(DiscoverPort_s *ports, int numPorts, uint32_t baudrate, uint8_t resetSTM8, uint8_t verbose)
+{
+  int         numFound = 0;
+  uint64_t    tStart, tStop;
+  const char  *mode[] = {"duplex", "1-wire", "reply"};
+
+  // print message
+  if (verbose != MUTE)
+    printf("# discover %d ports ... ", numPorts);
+  fflush(stdout);
+
+  // start probe threads
+  tStart = millis();
+  for (int i = 0; i < numPorts; i++)
+  {
+    ports[i].baudrate   = baudrate;
+    ports[i].resetSTM8  = resetSTM8;
+    ports[i].lowLatency = g_lowLatency;
+    if (pthread_create(&(ports[i].thread), NULL, discover_session, &(ports[i])) != 0)
+      Error("in 'discover_run': cannot start thread for port '%s'", ports[i].portname);
+  }
+
+  // wait for all probes to finish
+  for (int i = 0; i < numPorts; i++)
+  {
+    pthread_join(ports[i].thread, NULL);
+    if (ports[i].found)
+      numFound++;
+  }
+  tStop = millis();
+
+  // print summary
+  if (verbose == SILENT)
+    printf("done (%d found)\n", numFound);
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (%d found, time %dms)\n", numFound, (int) (tStop-tStart));
+  if ((verbose != MUTE) && (numFound > 0))
+    printf("# port vid:pid serial family flash[kB] BSL mode\n");
+
+  // print responding targets in machine-readable format
+  for (int i = 0; i < numPorts; i++)
+  {
+    DiscoverPort_s *p = &(ports[i]);
+    if (p->found) {
+      char  usb[20] = "-";
+      if ((p->vid != 0) || (p->pid != 0))
+        snprintf(usb, sizeof(usb), "%04x:%04x", (int) p->vid, (int) p->pid);
+      printf("%s %s %s %s %d %x.%x %s\n", p->portname, usb, p->serial, (p->family == STM8S) ? "STM8S" : "STM8L",
+        p->flashsize, (int) (p->versBSL >> 4), (int) (p->versBSL & 0x0F), mode[(p->uartMode <= 2) ? p->uartMode : 0]);
+    }
+    else if (verbose == CHATTY)
+      printf("# %s: no bootloader after %dms: %s\n", p->portname, (int) (p->tStop-p->tStart), p->errMsg);
+  }
+  fflush(stdout);
+
+  // return number of found targets
+  return numFound;
+
+} // discover_run
+
+// end of file
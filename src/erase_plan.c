@@ -0,0 +1,197 @@
+/**
+  \file erase_plan.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of flash erase planner
+
+  implementation of routines to erase the flash sectors covered by a memory image
+  with a minimum number of ERASE commands. Sectors only partly covered by the image
+  are not erased, because the other bytes of the sector would be lost.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "main.h"
+#include "bootloader.h"
+#include "misc.h"
+#include "verify_CRC32.h"
+#include "erase_plan.h"
+
+
+/// check if flash range is blank, either via CRC32 RAM routine (if uploaded) or read-back
+static bool check_blank(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, bool useCRC32, uint64_t addrStart, uint64_t addrStop)
+{
+  MemoryImage_s   image;
+  uint32_t        crc32_uC, crc32_blank;
+  bool            blank = true;
+
+  // initialize memory image
+  MemoryImage_init(&image);
+  ownImage(&image);
+
+  // compare CRC32 over STM8 memory with CRC32 over blank range
+  if (useCRC32)
+  {
+    calc_crc32(ptrPort, physInterface, uartMode, addrStart, addrStop, &crc32_uC);
+    MemoryImage_fillValue(&image, (MEMIMAGE_ADDR_T) addrStart, (MEMIMAGE_ADDR_T) addrStop, ERASE_VALUE);
+    crc32_blank = MemoryImage_checksum_crc32(&image, 0, image.numEntries-1);
+    blank = (crc32_uC == crc32_blank);
+  }
+
+  // read back memory and check for erased value
+  else
+  {
+    bsl_memRead(ptrPort, physInterface, uartMode, (MEMIMAGE_ADDR_T) addrStart, (MEMIMAGE_ADDR_T) addrStop, &image, MUTE);
+    for (size_t i = 0; i < image.numEntries; i++)
+    {
+      if (image.memoryEntries[i].data != ERASE_VALUE)
+      {
+        blank = false;
+        break;
+      }
+    }
+  }
+
+  // release memory image
+  MemoryImage_free(&image);
+  disown(&image);
+
+  return blank;
+
+} // check_blank()
+
+
+/// mark P-flash sectors completely covered by memory image. Return number of marked sectors
+int erase_plan_sectors(const MemoryImage_s *image, int flashsize, bool *plan, int *numPartial)
+{
+  int   numTotal, numPlan, code, count[256];
+
+  // count image bytes per P-flash sector (max. 256kB flash)
+  numTotal = flashsize;
+  if (numTotal > 256)
+    numTotal = 256;
+  for (code=0; code<numTotal; code++)
+    count[code] = 0;
+  for (size_t i = 0; i < image->numEntries; i++)
+  {
+    MEMIMAGE_ADDR_T addr = image->memoryEntries[i].address;
+    if ((addr >= PFLASH_START) && (addr < PFLASH_START + (MEMIMAGE_ADDR_T) numTotal*PFLASH_BLOCKSIZE))
+      count[(addr - PFLASH_START) / PFLASH_BLOCKSIZE]++;
+  }
+
+  // only erase sectors without bytes outside image. Addresses in image are unique
+  numPlan = 0;
+  *numPartial = 0;
+  for (code=0; code<numTotal; code++)
+  {
+    plan[code] = (count[code] == PFLASH_BLOCKSIZE);
+    numPlan += plan[code];
+    *numPartial += ((count[code] > 0) && (!plan[code]));
+  }
+
+  return numPlan;
+
+} // erase_plan_sectors()
+
+
+/// erase flash sectors covered by memory image
+uint8_t erase_plan(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t mode, uint8_t verbose)
+{
+  bool            plan[256];          // sectors to erase (max. 256kB flash)
+  uint8_t         sectors[256];       // codes of sectors to erase
+  int             numTotal, numPlan, numPartial, numBlank, numSectors;
+  int             first, last, code;
+  bool            useCRC32;
+  uint32_t        tSectors, tMass;    // estimated erase time [ms]
+
+  // nothing to do
+  if ((mode == ERASE_PLAN_OFF) || (image->numEntries == 0))
+    return 0;
+
+  // print message
+  if (verbose != MUTE)
+    printf("  plan erase ... ");
+  fflush(stdout);
+
+  // mark P-flash sectors completely covered by image. Partly covered sectors are only written
+  numTotal = (flashsize > 256) ? 256 : flashsize;
+  numPlan = erase_plan_sectors(image, flashsize, plan, &numPartial);
+
+  // optionally skip blank sectors. Check contiguous runs of sectors at once to minimize CRC32/read overhead
+  numBlank = 0;
+  if ((mode >= ERASE_PLAN_BLANK) && (numPlan > 0))
+  {
+    // prefer CRC32 RAM routine if available for device, else read back
+    useCRC32 = support_crc32(family, flashsize, versBSL);
+    if (useCRC32)
+      upload_crc32_code(ptrPort, family, flashsize, versBSL, physInterface, uartMode);
+
+    // loop over runs of consecutive sectors
+    for (first=0; first<numTotal; first=last+1)
+    {
+      // find next run
+      while ((first < numTotal) && (!plan[first]))
+        first++;
+      if (first >= numTotal)
+        break;
+      last = first;
+      while ((last+1 < numTotal) && (plan[last+1]))
+        last++;
+
+      // if complete run is blank, skip it
+      if (check_blank(ptrPort, physInterface, uartMode, useCRC32, PFLASH_START + (uint64_t) first*PFLASH_BLOCKSIZE, PFLASH_START + (uint64_t) (last+1)*PFLASH_BLOCKSIZE - 1))
+      {
+        for (code=first; code<=last; code++)
+          plan[code] = false;
+        numBlank += last - first + 1;
+      }
+    }
+
+    // CRC32 routine uses ROM-BL GO command which clears w/e routines -> re-upload
+    if (useCRC32)
+      bsl_uploadWriteErase(ptrPort, physInterface, uartMode, flashsize, versBSL, family, MUTE);
+  }
+
+  // collect remaining sectors to erase
+  numSectors = 0;
+  for (code=0; code<numTotal; code++)
+  {
+    if (plan[code])
+      sectors[numSectors++] = (uint8_t) code;
+  }
+
+  // estimate erase times for batched sector erase and mass erase
+  tSectors = numSectors*ERASE_TIME_SECTOR + ((numSectors+ERASE_MAX_SECTORS-1)/ERASE_MAX_SECTORS)*ERASE_TIME_FRAME;
+  tMass    = numTotal*ERASE_TIME_MASS;
+
+  // print message
+  if (verbose == SILENT)
+    printf("done\n");
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (%d of %d sectors covered, %d blank, %d partly covered kept)\n", numPlan, numTotal, numBlank, numPartial);
+  fflush(stdout);
+
+  // nothing to erase
+  if (numSectors == 0)
+    return 0;
+
+  // mass erase if faster (also erases EEPROM)
+  if ((mode >= ERASE_PLAN_MASS) && (tMass <= tSectors))
+    bsl_flashMassErase(ptrPort, physInterface, uartMode, verbose);
+
+  // erase sectors in batches
+  else
+    bsl_flashSectorsErase(ptrPort, physInterface, uartMode, sectors, numSectors, verbose);
+
+  // avoid compiler warnings
+  return 0;
+
+} // erase_plan()
+
+
+// end of file
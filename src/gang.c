@@ -0,0 +1,205 @@
+/**
+  \file gang.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of gang programming
+
+  implementation of routines for programming several STM8 devices on separate
+  UART ports concurrently. Each port is handled by a worker thread using the
+  library API (see stm8gal.c), i.e. errors are reported per port instead of
+  terminating the program.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#if defined(__APPLE__) || defined(__unix__)
+  #include <glob.h>
+#endif
+#include "main.h"
+#include "bootloader.h"
+#include "gang.h"
+
+
+/**
+  \fn int gang_ports(const char *list, char ports[][GANG_NAMELEN], int maxPorts)
+
+  \param[in]  list        comma separated port names. Under Posix may contain wildcards, e.g. '/dev/ttyUSB*'
+  \param[out] ports       list of port names
+  \param[in]  maxPorts    max. number of ports in list
+
+  \return number of ports found
+
+  Get list of ports for gang programming from comma separated names or patterns
+*/
+int gang_ports(const char *list, char ports[][GANG_NAMELEN], int maxPorts)
+{
+  char    buf[STRLEN];
+  char    *name;
+  int     numPorts = 0;
+
+  // split list at commas. Note: strtok() is ok, as only called from main thread
+  strncpy(buf, list, STRLEN-1);
+  buf[STRLEN-1] = '\0';
+  for (name = strtok(buf, ","); name != NULL; name = strtok(NULL, ","))
+  {
+    #if defined(__APPLE__) || defined(__unix__)
+
+      // expand pattern, e.g. '/dev/ttyUSB*'. Keep name if no match
+      glob_t  match;
+      if (glob(name, 0, NULL, &match) == 0)
+      {
+        for (size_t i = 0; i < match.gl_pathc; i++)
+        {
+          if (numPorts >= maxPorts)
+            Error("in 'gang_ports': max. %d ports supported", maxPorts);
+          strncpy(ports[numPorts], match.gl_pathv[i], GANG_NAMELEN-1);
+          ports[numPorts++][GANG_NAMELEN-1] = '\0';
+        }
+        globfree(&match);
+        continue;
+      }
+
+    #endif // __APPLE__ || __unix__
+
+    if (numPorts >= maxPorts)
+      Error("in 'gang_ports': max. %d ports supported", maxPorts);
+    strncpy(ports[numPorts], name, GANG_NAMELEN-1);
+    ports[numPorts++][GANG_NAMELEN-1] = '\0';
+  }
+
+  // return number of ports
+  return numPorts;
+
+} // gang_ports
+
+
+
+/**
+  \fn static void *gang_session(void *arg)
+
+  \param[in,out] arg      gang session (GangSession_s*)
+
+  \return NULL
+
+  Worker thread for a single port. Execute job via library API: connect, erase,
+  write, verify and jump. Errors are reported in session instead of terminating
+*/
+static void *gang_session(void *arg)
+{
+  GangSession_s       *session = (GangSession_s*) arg;
+  const GangJob_s     *job = session->job;
+  stm8gal_session_s   *lib;
+  stm8gal_error_t     result;
+
+  // execute job
+  session->tStart = millis();
+  result = stm8gal_open(&lib, session->portname, &(job->config));
+  if ((result == STM8GAL_OK) && (job->massErase))
+    result = stm8gal_eraseMass(lib);
+  if (result == STM8GAL_OK)
+    result = stm8gal_writeImage(lib, job->image);
+  if ((result == STM8GAL_OK) && (job->jumpAddr != 0xFFFFFFFFFFFFFFFF))
+    result = stm8gal_jump(lib, job->jumpAddr);
+  session->tStop = millis();
+
+  // store result
+  session->result = (result == STM8GAL_OK) ? 0 : 1;
+  strncpy(session->errMsg, stm8gal_errorMessage(lib), ERRMSG_LEN-1);
+  stm8gal_getInfo(lib, &(session->family), &(session->flashsize), &(session->versBSL));
+
+  // close port and release session
+  stm8gal_close(lib);
+
+  return NULL;
+
+} // gang_session
+
+
+
+/**
+  \fn int gang_run(char ports[][GANG_NAMELEN], int numPorts, const GangJob_s *job, uint8_t verbose)
+
+  \param[in]  ports       list of port names
+  \param[in]  numPorts    number of ports in list
+  \param[in]  job         job to execute for all ports
+  \param[in]  verbose     verbosity level (0=MUTE, 1=SILENT, 2=INFORM, 3=CHATTY)
+
+  \return number of failed sessions
+
+  Program all ports concurrently on worker threads and print results per port
+*/
+int gang_run(char ports[][GANG_NAMELEN], int numPorts, const GangJob_s *job, uint8_t verbose)
+{
+  GangSession_s   *sessions;
+  int             numFailed = 0;
+  uint64_t        tStart, tStop;
+
+  // print message
+  if (verbose != MUTE)
+    printf("  gang program %d ports ... ", numPorts);
+  fflush(stdout);
+
+  // allocate and initialize sessions
+  sessions = (GangSession_s*) calloc(numPorts, sizeof(GangSession_s));
+  if (sessions == NULL)
+    Error("in 'gang_run': cannot allocate %d sessions", numPorts);
+
+  // start worker threads
+  tStart = millis();
+  for (int i = 0; i < numPorts; i++)
+  {
+    strncpy(sessions[i].portname, ports[i], GANG_NAMELEN-1);
+    sessions[i].job = job;
+    if (pthread_create(&(sessions[i].thread), NULL, gang_session, &(sessions[i])) != 0)
+      Error("in 'gang_run': cannot start thread for port '%s'", ports[i]);
+  }
+
+  // wait for all sessions to finish
+  for (int i = 0; i < numPorts; i++)
+  {
+    pthread_join(sessions[i].thread, NULL);
+    if (sessions[i].result != 0)
+      numFailed++;
+  }
+  tStop = millis();
+
+  // print summary
+  if (verbose == SILENT)
+    printf("done (%d of %d passed)\n", numPorts-numFailed, numPorts);
+  else if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (%d of %d passed, time %dms)\n", numPorts-numFailed, numPorts, (int) (tStop-tStart));
+  fflush(stdout);
+
+  // print result per port. Always report failures
+  for (int i = 0; i < numPorts; i++)
+  {
+    GangSession_s *s = &(sessions[i]);
+    if (s->result != 0) {
+      fflush(stdout);
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "    %s: failed after %dms: %s\n", s->portname, (int) (s->tStop-s->tStart), s->errMsg);
+      setConsoleColor(PRM_COLOR_DEFAULT);
+    }
+    else if (verbose == INFORM)
+      printf("    %s: passed (%dms)\n", s->portname, (int) (s->tStop-s->tStart));
+    else if (verbose == CHATTY)
+      printf("    %s: passed (%s, %dkB, v%x.%x, %dms)\n", s->portname, (s->family == STM8S) ? "STM8S" : "STM8L",
+        s->flashsize, (int) (s->versBSL >> 4), (int) (s->versBSL & 0x0F), (int) (s->tStop-s->tStart));
+  }
+  fflush(stdout);
+  fflush(stderr);
+
+  // release memory
+  free(sessions);
+
+  // return number of failed sessions
+  return numFailed;
+
+} // gang_run
+
+
+// end of file
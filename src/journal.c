@@ -0,0 +1,327 @@
+/**
+  \file journal.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of progress journal
+
+  implementation of routines to record the progress of a flash upload in a
+  journal file and to resume an interrupted upload from it. The journal is a
+  text file with the image checksum, the options affecting the written pages,
+  the erased sectors and the pages acknowledged by the BSL. Page records are written in batches to keep the
+  write loop fast. On resume, confirmed pages are verified against the device
+  via the CRC32 RAM routine (see verify_CRC32.c) or, if not available, via
+  read-back, and only then removed from the memory image.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#if defined(WIN32) || defined(WIN64)
+  #include <io.h>
+#endif
+#if defined(__APPLE__) || defined(__unix__)
+  #include <unistd.h>
+#endif
+#include "main.h"
+#include "bootloader.h"
+#include "misc.h"
+#include "verify_CRC32.h"
+#include "erase_plan.h"
+#include "journal.h"
+
+
+/// write pending page lines to journal file and commit to disk
+static void journal_flush(Journal_s *journal)
+{
+  // nothing to do
+  if (journal->fp == NULL)
+    return;
+
+  // write pending lines in one go
+  if ((journal->lenBuf > 0) && (fwrite(journal->buf, 1, journal->lenBuf, journal->fp) != (size_t) journal->lenBuf))
+    Error("in 'journal_flush()': writing journal file '%s' failed", journal->filename);
+  journal->lenBuf = 0;
+  journal->numPending = 0;
+
+  // commit to disk to survive host power loss
+  fflush(journal->fp);
+  #if defined(WIN32) || defined(WIN64)
+    _commit(_fileno(journal->fp));
+  #endif
+  #if defined(__APPLE__) || defined(__unix__)
+    fsync(fileno(journal->fp));
+  #endif
+
+} // journal_flush()
+
+
+/// compare device vs. image content of range via CRC32 RAM routine or read-back
+static bool journal_verify(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd, size_t idxStart, size_t idxEnd, bool useCRC32)
+{
+  MemoryImage_s     readImage;
+  uint32_t          crc32_uC, crc32_PC;
+  size_t            idxRead;
+  bool              match = true;
+
+  // compare CRC32 checksums
+  if (useCRC32)
+  {
+    crc32_PC = MemoryImage_checksum_crc32(image, idxStart, idxEnd);
+    calc_crc32(ptrPort, physInterface, uartMode, addrStart, addrEnd, &crc32_uC);
+    return (crc32_uC == crc32_PC);
+  }
+
+  // read back and compare
+  MemoryImage_init(&readImage);
+  ownImage(&readImage);
+  bsl_memRead(ptrPort, physInterface, uartMode, addrStart, addrEnd, &readImage, MUTE);
+  MemoryImage_getIndex(&readImage, addrStart, &idxRead);
+  for (size_t i = 0; i <= idxEnd - idxStart; i++)
+  {
+    if (image->memoryEntries[idxStart+i].data != readImage.memoryEntries[idxRead+i].data)
+    {
+      match = false;
+      break;
+    }
+  }
+  MemoryImage_free(&readImage);
+  disown(&readImage);
+
+  return match;
+
+} // journal_verify()
+
+
+/// open journal file for imported memory image. Load progress of previous run for same image and options
+uint8_t journal_begin(Journal_s *journal, const char *filename, const MemoryImage_s *image, uint8_t erasePlan, uint8_t alignMode, uint8_t alignPad, uint8_t verbose)
+{
+  FILE              *fp;
+  char              line[JOURNAL_LINELEN];
+  uint32_t          hash;
+  unsigned long     numEntries;
+  uint64_t          addr;
+  int               len, optErase, optAlign, optPad;
+  bool              match = false, matchOptions = false;
+
+  // init journal state
+  strncpy(journal->filename, filename, JOURNAL_NAMELEN-1);
+  journal->filename[JOURNAL_NAMELEN-1] = '\0';
+  journal->fp = NULL;
+  MemoryImage_init(&(journal->confirmed));
+  journal->erased = false;
+  journal->lenBuf = 0;
+  journal->numPending = 0;
+
+  // image checksum identifies journal
+  journal->hash = 0x00;
+  if (image->numEntries > 0)
+    journal->hash = MemoryImage_checksum_crc32(image, 0, image->numEntries-1);
+
+  // load progress of previous run. Header must match image, else start new journal.
+  // Options must match as well, else erase or alignment could destroy confirmed pages
+  fp = fopen(filename, "r");
+  if (fp != NULL)
+  {
+    while (fgets(line, JOURNAL_LINELEN, fp) != NULL)
+    {
+      if (line[0] == '#')
+        continue;
+      else if (sscanf(line, "image %" SCNx32 " %lu", &hash, &numEntries) == 2)
+      {
+        match = ((hash == journal->hash) && (numEntries == (unsigned long) image->numEntries));
+        if (!match)
+          break;
+      }
+      else if (!match)
+        break;
+      else if (sscanf(line, "options erase %d align %d %x", &optErase, &optAlign, &optPad) == 3)
+        matchOptions = ((optErase == erasePlan) && (optAlign == alignMode) && ((alignMode != ALIGN_PAD) || (optPad == alignPad)));
+      else if (!matchOptions)
+        break;
+      else if (!strncmp(line, "erase", 5))
+        journal->erased = true;
+      else if ((sscanf(line, "page %" SCNx64 " %d", &addr, &len) == 2) && (len > 0))
+        MemoryImage_fillValue(&(journal->confirmed), (MEMIMAGE_ADDR_T) addr, (MEMIMAGE_ADDR_T) (addr+len-1), 0x00);
+    }
+    fclose(fp);
+  }
+
+  // same image with different options -> refuse to resume
+  if (match && (!matchOptions))
+  {
+    MemoryImage_free(&(journal->confirmed));
+    Error("in 'journal_begin()': journal '%s' was recorded with different options -P/-a. Use same options or delete journal", filename);
+  }
+
+  // discard progress of different image
+  if (!match)
+  {
+    MemoryImage_free(&(journal->confirmed));
+    journal->erased = false;
+  }
+
+  // append to matching journal, else start new journal
+  journal->fp = fopen(filename, match ? "a" : "w");
+  if (journal->fp == NULL)
+    Error("in 'journal_begin()': cannot open journal file '%s'", filename);
+  if (!match)
+  {
+    fprintf(journal->fp, "# stm8gal progress journal\n");
+    fprintf(journal->fp, "image %08" PRIX32 " %lu\n", journal->hash, (unsigned long) image->numEntries);
+    fprintf(journal->fp, "options erase %d align %d %02X\n", (int) erasePlan, (int) alignMode, (int) alignPad);
+    journal_flush(journal);
+  }
+
+  // print message
+  if (verbose == CHATTY)
+  {
+    if (match)
+      printf("  continue journal '%s' (%1.1fkB confirmed)\n", filename, (float) journal->confirmed.numEntries/1024.0);
+    else
+      printf("  start journal '%s'\n", filename);
+  }
+  fflush(stdout);
+
+  // avoid compiler warnings
+  return 0;
+
+} // journal_begin()
+
+
+/// verify pages confirmed in previous run against device and remove them from memory image
+uint8_t journal_resume(Journal_s *journal, HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, MemoryImage_s *image, uint8_t verbose)
+{
+  MEMIMAGE_ADDR_T   addrBlock, addrStart, addrEnd, addrFlashEnd;
+  size_t            idxStart, idxEnd, idxImageStart, idxImageEnd;
+  bool              useCRC32;
+  int               numSkip;
+  uint64_t          tStart, tStop;        // measure time [ms] for check
+
+  // nothing to resume
+  if (journal->confirmed.numEntries == 0)
+    return 0;
+
+  // print message
+  if (verbose != MUTE)
+    printf("  resume upload ... ");
+  fflush(stdout);
+
+  // measure time for check
+  tStart = millis();
+
+  // prefer CRC32 RAM routine if available for device, else read back
+  useCRC32 = support_crc32(family, flashsize, versBSL);
+  if (useCRC32)
+    upload_crc32_code(ptrPort, family, flashsize, versBSL, physInterface, uartMode);
+
+  // loop over consecutive confirmed P-flash ranges. RAM is lost on reset, EEPROM and option bytes are always written
+  addrFlashEnd = PFLASH_START + (MEMIMAGE_ADDR_T) flashsize*1024 - 1;
+  numSkip = 0;
+  addrBlock = PFLASH_START;
+  while (MemoryImage_getMemoryBlock(&(journal->confirmed), addrBlock, &idxStart, &idxEnd))
+  {
+    addrStart = journal->confirmed.memoryEntries[idxStart].address;
+    addrEnd   = journal->confirmed.memoryEntries[idxEnd].address;
+    if (addrStart > addrFlashEnd)
+      break;
+    if (addrEnd > addrFlashEnd)
+      addrEnd = addrFlashEnd;
+
+    // range must be contiguous in image. Remove range from image if device content matches
+    if (MemoryImage_getIndex(image, addrStart, &idxImageStart) && MemoryImage_getIndex(image, addrEnd, &idxImageEnd) &&
+        ((idxImageEnd - idxImageStart) == (size_t) (addrEnd - addrStart)) &&
+        journal_verify(ptrPort, physInterface, uartMode, image, addrStart, addrEnd, idxImageStart, idxImageEnd, useCRC32))
+    {
+      MemoryImage_cut(image, addrStart, addrEnd);
+      numSkip += (int) (addrEnd - addrStart + 1);
+    }
+
+    // start address for searching next range
+    addrBlock = addrEnd + 1;
+  }
+
+  // CRC32 routine uses ROM-BL GO command which clears w/e routines -> re-upload
+  if (useCRC32)
+    bsl_uploadWriteErase(ptrPort, physInterface, uartMode, flashsize, versBSL, family, MUTE);
+
+  // measure time for check
+  tStop = millis();
+
+  // print message
+  if (verbose == SILENT)
+    printf("done\n");
+  else if (verbose == INFORM)
+    printf("done (%1.1fkB already written)\n", (float) numSkip/1024.0);
+  else if (verbose == CHATTY)
+    printf("done (%1.1fkB of %1.1fkB confirmed, %s, time %dms)\n", (float) numSkip/1024.0, (float) journal->confirmed.numEntries/1024.0,
+      useCRC32 ? "CRC32" : "read-back", (int) (tStop-tStart));
+  fflush(stdout);
+
+  // avoid compiler warnings
+  return 0;
+
+} // journal_resume()
+
+
+/// record flash sectors covered by memory image as erased
+void journal_erased(Journal_s *journal, const MemoryImage_s *image, int flashsize)
+{
+  bool              plan[256] = {false};
+  int               numPartial;
+
+  // record sectors selected by erase planner (see erase_plan.c)
+  erase_plan_sectors(image, flashsize, plan, &numPartial);
+  for (int sector = 0; sector < 256; sector++)
+  {
+    if (plan[sector])
+      fprintf(journal->fp, "erase %d\n", sector);
+  }
+
+  // erase is done only once -> commit immediately
+  journal->erased = true;
+  journal_flush(journal);
+
+} // journal_erased()
+
+
+/// record page acknowledged by BSL. Callback for bsl_setPageDone()
+void journal_pageDone(void *arg, MEMIMAGE_ADDR_T addrPage, int lenPage)
+{
+  Journal_s   *journal = (Journal_s*) arg;
+
+  // queue page line
+  journal->lenBuf += snprintf(journal->buf + journal->lenBuf, JOURNAL_LINELEN, "page %" PRIX64 " %d\n", (uint64_t) addrPage, lenPage);
+
+  // write batch to journal
+  if (++(journal->numPending) >= JOURNAL_BATCH)
+    journal_flush(journal);
+
+} // journal_pageDone()
+
+
+/// flush and close journal. After successful upload delete journal file
+void journal_end(Journal_s *journal, bool complete)
+{
+  // write pending pages and close file
+  if (journal->fp != NULL)
+  {
+    journal_flush(journal);
+    fclose(journal->fp);
+    journal->fp = NULL;
+  }
+
+  // release confirmed ranges of previous run
+  MemoryImage_free(&(journal->confirmed));
+
+  // upload completed -> journal no longer required
+  if (complete)
+    remove(journal->filename);
+
+} // journal_end()
+
+
+// end of file
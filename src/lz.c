@@ -0,0 +1,126 @@
+/**
+  \file lz.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of LZ compression for flash frames
+
+  implementation of a byte oriented LZ77 variant for compressing upload
+  frames of up to a few 100B. Matches may overlap the current position, i.e.
+  fill patterns like 0xFF are coded as 1 literal plus a copy with offset 1.
+  The compressor uses a greedy search over the complete window, which is
+  fast enough for frame sizes. lz_decompress() is the reference for the
+  STM8 decompressor of the stage-2 loader.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdint.h>
+#include "lz.h"
+
+
+/// write pending literals to output. Return new output length, or -1 on overflow
+static int lz_flushLiterals(const uint8_t *src, int start, int num, uint8_t *dst, int lenDst, int maxDst)
+{
+  while (num > 0)
+  {
+    int n = (num > LZ_MAX_LITERAL) ? LZ_MAX_LITERAL : num;
+    if (lenDst + 1 + n > maxDst)
+      return -1;
+    dst[lenDst++] = (uint8_t) (n - 1);
+    for (int i = 0; i < n; i++)
+      dst[lenDst++] = src[start+i];
+    start += n;
+    num -= n;
+  }
+
+  return lenDst;
+
+} // lz_flushLiterals()
+
+
+/// compress buffer. Return compressed length, or -1 if result exceeds maxDst
+int lz_compress(const uint8_t *src, int lenSrc, uint8_t *dst, int maxDst)
+{
+  int   pos = 0, lenDst = 0;
+  int   litStart = 0;                     // start of pending literals
+
+  while (pos < lenSrc)
+  {
+    int bestLen = 0, bestOff = 0;
+
+    // find longest match in window. Prefer nearest offset for equal length
+    for (int off = 1; (off <= LZ_WINDOW) && (off <= pos); off++)
+    {
+      int len = 0;
+      while ((len < LZ_MAX_MATCH) && (pos + len < lenSrc) && (src[pos+len] == src[pos+len-off]))
+        len++;
+      if (len > bestLen)
+      {
+        bestLen = len;
+        bestOff = off;
+        if (len == LZ_MAX_MATCH)
+          break;
+      }
+    }
+
+    // code match, else add to literals
+    if (bestLen >= LZ_MIN_MATCH)
+    {
+      lenDst = lz_flushLiterals(src, litStart, pos - litStart, dst, lenDst, maxDst);
+      if ((lenDst < 0) || (lenDst + 2 > maxDst))
+        return -1;
+      dst[lenDst++] = (uint8_t) (0x80 | (bestLen - LZ_MIN_MATCH));
+      dst[lenDst++] = (uint8_t) (bestOff - 1);
+      pos += bestLen;
+      litStart = pos;
+    }
+    else
+      pos++;
+  }
+
+  // remaining literals
+  return lz_flushLiterals(src, litStart, pos - litStart, dst, lenDst, maxDst);
+
+} // lz_compress()
+
+
+/// decompress buffer. Return decompressed length, or -1 if data is corrupt or result exceeds maxDst
+int lz_decompress(const uint8_t *src, int lenSrc, uint8_t *dst, int maxDst)
+{
+  int   pos = 0, lenDst = 0;
+
+  while (pos < lenSrc)
+  {
+    uint8_t c = src[pos++];
+
+    // literals
+    if (c < 0x80)
+    {
+      int n = c + 1;
+      if ((pos + n > lenSrc) || (lenDst + n > maxDst))
+        return -1;
+      for (int i = 0; i < n; i++)
+        dst[lenDst++] = src[pos++];
+    }
+
+    // copy from output. Byte-wise, as source may overlap destination
+    else
+    {
+      if (pos >= lenSrc)
+        return -1;
+      int off = src[pos++] + 1;
+      int n = (c & 0x7F) + LZ_MIN_MATCH;
+      if ((off > lenDst) || (lenDst + n > maxDst))
+        return -1;
+      for (int i = 0; i < n; i++, lenDst++)
+        dst[lenDst] = dst[lenDst-off];
+    }
+  }
+
+  return lenDst;
+
+} // lz_decompress()
+
+
+// end of file
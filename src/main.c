@@ -24,10 +24,16 @@
 #include "spi_Arduino_comm.h"
 #include "bootloader.h"
 #include "verify_CRC32.h"
+#include "erase_plan.h"
+#include "delta.h"
+#include "journal.h"
+#include "devcache.h"
+#include "gang.h"
+#include "stage2.h"
+#include "autospeed.h"
+#include "discover.h"
 #include "version.h"
-#define _MAIN_
-  #include "main.h"
-#undef _MAIN_
+#include "main.h"
 
 
 /**
@@ -51,12 +57,27 @@ int main(int argc, char ** argv) {
   char            tmp[STRLEN+106];      // misc string buffer
   int             physInterface;        // bootloader interface: 0=UART (default), 1=SPI_ARDUINO, 2=SPI_SPIDEV
   char            portname[STRLEN]="";  // name of communication port
+  char            gangPorts[STRLEN]=""; // comma separated ports for gang programming (empty=off)
+  char            discoverPorts[STRLEN]=""; // ports to probe for STM8 bootloader, 'all' for enumeration (empty=off)
+  char            journalFile[STRLEN]="";  // progress journal for resuming interrupted upload (empty=off)
+  char            cacheFile[STRLEN]="";    // device identity cache per port (empty=off)
+  char            stage2File[STRLEN]="";   // second-stage RAM loader for upload (empty=off)
+  int             stage2Baud = 0;          // baudrate of second-stage loader [Baud]
+  Stage2_s        stage2;                  // second-stage loader session
+  bool            compressUpload = false;  // compress frames for stage-2 loader
+  bool            verifySet = false;       // verify method was set via commandline
   HANDLE          ptrPort = 0;          // handle to communication port
-  int             baudrate;             // communication baudrate [Baud]
+  int             baudrate;             // communication baudrate [Baud], 0=auto-select
   int             uartMode;             // UART bootloader mode: 0=duplex, 1=1-wire, 2=2-wire reply, other=auto-detect
   int             resetSTM8;            // reset STM8: 0=skip, 1=manual, 2=DTR line (RS232), 3=send 'Re5eT!' @ 115.2kBaud, 4=Arduino pin 8, 5=Raspi pin 12, 6=RTS line (RS232) (default: manual)
   int             verifyUpload;         // verify method after upload (0=skip, 1=CRC32, 2=read-out)
+  uint8_t         writeMode;            // transfer mode for write (0=lock-step, 1=pipelined)
+  uint8_t         alignMode;            // align partial flash pages before upload (0=off, 1=pad value, 2=read from device)
+  uint8_t         alignPad;             // pad value for alignMode==1
+  uint8_t         erasePlan;            // erase sectors covered by upload (0=off, 1=sectors, 2=skip blank sectors, 3=allow mass erase)
+  int             deltaBlock;           // only write flash blocks with changed content (0=off, else block size [B])
   uint64_t        jumpAddr;             // address to jump to before exit program
+  uint64_t        tConnect;             // start time [us] of connect, for latency measurement
   int             i, j;                 // loop variables
 
   // STM8 device properties
@@ -68,6 +89,10 @@ int main(int argc, char ** argv) {
   // initialize global variables
   g_pauseOnExit         = false;  // no wait for <return> before terminating (dummy)
   g_backgroundOperation = false;  // assume foreground application
+  g_retryMax            = RETRY_DEFAULT;   // retry failed transactions after resync
+  g_lowLatency          = false;           // keep USB-serial latency (system-wide setting)
+  g_ioThread            = false;           // access port directly
+  g_fastConnect         = false;           // fixed delays after reset
 
   // initialize default arguments
   portname[0]    = '\0';          // no default port name
@@ -77,6 +102,11 @@ int main(int argc, char ** argv) {
   verbose        = INFORM;        // verbosity level medium
   resetSTM8      = 1;             // manual reset of STM8
   verifyUpload   = 2;             // read back memory after upload  (0=skip, 1=CRC32, 2=read-out)
+  writeMode      = WRITE_LOCKSTEP;  // wait for ACK after each frame (see bootloader.h)
+  alignMode      = ALIGN_NONE;    // write data as is (see bootloader.h)
+  alignPad       = 0x00;          // pad value for aligning flash pages
+  erasePlan      = ERASE_PLAN_OFF;  // don't erase before upload (see erase_plan.h)
+  deltaBlock     = DELTA_OFF;     // write complete image (see delta.h)
   jumpAddr       = PFLASH_START;  // by default jump to start of P-flash (see bootloader.h)
 
 
@@ -243,21 +273,74 @@ int main(int argc, char ** argv) {
     } // port
 
 
+    // gang programming: comma separated list of ports or patterns
+    else if ((!strcmp(argv[i], "-g")) || (!strcmp(argv[i], "-gang"))) {
+
+      // get port list
+      if (i+1<argc) {
+        i+=1;
+        strncpy(gangPorts, argv[i], STRLEN-1);
+      }
+      else {
+        printf("\ncommand '-g/-gang' requires a list of ports\n");
+        printHelp = i;
+        break;
+      }
+
+    } // gang
+
+
+    // discover ports with STM8 bootloader: 'all' or comma separated list of ports or patterns
+    else if ((!strcmp(argv[i], "-D")) || (!strcmp(argv[i], "-discover"))) {
+
+      // get port list
+      if (i+1<argc) {
+        i+=1;
+        strncpy(discoverPorts, argv[i], STRLEN-1);
+      }
+      else {
+        printf("\ncommand '-D/-discover' requires 'all' or a list of ports\n");
+        printHelp = i;
+        break;
+      }
+
+    } // discover
+
+
+    // cache device identity per port
+    else if ((!strcmp(argv[i], "-c")) || (!strcmp(argv[i], "-cache"))) {
+
+      // get cache file name
+      if (i+1<argc) {
+        i+=1;
+        strncpy(cacheFile, argv[i], STRLEN-1);
+      }
+      else {
+        printf("\ncommand '-c/-cache' requires a file name\n");
+        printHelp = i;
+        break;
+      }
+
+    } // cache
+
+
     // communication baudrate
     else if ((!strcmp(argv[i], "-b")) || (!strcmp(argv[i], "-baudrate"))) {
 
-      // get communication baudrate
+      // get communication baudrate or 'auto'
       if (i+1<argc) {
         i++;
-        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0))
+        if (!strcmp(argv[i], "auto"))
+          j = 0;
+        else if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || (j <= 0))
         {
-          printf("\ncommand '-b/-baudrate' requires a decimal parameter\n");
+          printf("\ncommand '-b/-baudrate' requires a decimal parameter or 'auto'\n");
           printHelp = i;
           break;
         }
       }
       else {
-        printf("\ncommand '-b/-baudrate' requires a decimal parameter\n");
+        printf("\ncommand '-b/-baudrate' requires a decimal parameter or 'auto'\n");
         printHelp = i;
         break;
       }
@@ -285,10 +368,246 @@ int main(int argc, char ** argv) {
         break;
       }
       verifyUpload = j;
+      verifySet = true;
 
     } // verify method
 
 
+    // set transfer mode for memory write
+    else if ((!strcmp(argv[i], "-m")) || (!strcmp(argv[i], "-write-mode"))) {
+
+      // get write mode
+      if (i+1<argc) {
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || (j < 0) || (j > 1))
+        {
+          printf("\ncommand '-m/-write-mode' requires a decimal parameter (0..1)\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-m/-write-mode' requires a decimal parameter (0..1)\n");
+        printHelp = i;
+        break;
+      }
+      writeMode = j;
+
+    } // write mode
+
+
+    // align partial flash pages before upload. Fill with pad value or device content
+    else if ((!strcmp(argv[i], "-a")) || (!strcmp(argv[i], "-align"))) {
+
+      // get pad value or 'read'
+      if (i+1<argc) {
+        i++;
+        if (!strcmp(argv[i], "read"))
+          alignMode = ALIGN_READ;
+        else if ((isHexString(argv[i]) && (sscanf(argv[i], "%x", &j) > 0) && (j >= 0) && (j <= 255)) ||
+                 (isDecString(argv[i]) && (sscanf(argv[i], "%d", &j) > 0) && (j >= 0) && (j <= 255))) {
+          alignMode = ALIGN_PAD;
+          alignPad  = j;
+        }
+        else {
+          printf("\ncommand '-a/-align' requires a hex or decimal pad value (0..255) or 'read'\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-a/-align' requires a hex or decimal pad value (0..255) or 'read'\n");
+        printHelp = i;
+        break;
+      }
+
+    } // align
+
+
+    // erase flash sectors covered by upload
+    else if ((!strcmp(argv[i], "-P")) || (!strcmp(argv[i], "-erase-plan"))) {
+
+      // get planner mode
+      if (i+1<argc) {
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || (j < 0) || (j > 3))
+        {
+          printf("\ncommand '-P/-erase-plan' requires a decimal parameter (0..3)\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-P/-erase-plan' requires a decimal parameter (0..3)\n");
+        printHelp = i;
+        break;
+      }
+      erasePlan = j;
+
+    } // erase plan
+
+
+    // only write flash blocks with changed content
+    else if ((!strcmp(argv[i], "-d")) || (!strcmp(argv[i], "-delta"))) {
+
+      // get block size
+      if (i+1<argc) {
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || ((j != DELTA_OFF) && (j != DELTA_PAGE) && (j != DELTA_SECTOR)))
+        {
+          printf("\ncommand '-d/-delta' requires a decimal parameter (0, 128, 1024)\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-d/-delta' requires a decimal parameter (0, 128, 1024)\n");
+        printHelp = i;
+        break;
+      }
+      deltaBlock = j;
+
+    } // delta
+
+
+    // max. number of retries per failed transaction
+    else if ((!strcmp(argv[i], "-t")) || (!strcmp(argv[i], "-retry"))) {
+
+      // get number of retries
+      if (i+1<argc) {
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || (j < 0) || (j > RETRY_MAX))
+        {
+          printf("\ncommand '-t/-retry' requires a decimal parameter (0..%d)\n", RETRY_MAX);
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-t/-retry' requires a decimal parameter (0..%d)\n", RETRY_MAX);
+        printHelp = i;
+        break;
+      }
+      g_retryMax = j;
+
+    } // retry
+
+
+    // reduce latency of USB-serial adapter
+    else if ((!strcmp(argv[i], "-L")) || (!strcmp(argv[i], "-low-latency"))) {
+
+      // get mode
+      if (i+1<argc) {
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || (j < 0) || (j > 1))
+        {
+          printf("\ncommand '-L/-low-latency' requires a decimal parameter (0..1)\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-L/-low-latency' requires a decimal parameter (0..1)\n");
+        printHelp = i;
+        break;
+      }
+      g_lowLatency = (j != 0);
+
+    } // low latency
+
+
+    // use I/O thread with ring buffers for port access
+    else if ((!strcmp(argv[i], "-I")) || (!strcmp(argv[i], "-io-thread"))) {
+
+      // get mode
+      if (i+1<argc) {
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || (j < 0) || (j > 1))
+        {
+          printf("\ncommand '-I/-io-thread' requires a decimal parameter (0..1)\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-I/-io-thread' requires a decimal parameter (0..1)\n");
+        printHelp = i;
+        break;
+      }
+      g_ioThread = (j != 0);
+
+    } // I/O thread
+
+
+    // connect without fixed delays after reset
+    else if ((!strcmp(argv[i], "-F")) || (!strcmp(argv[i], "-fast-connect"))) {
+
+      // get mode
+      if (i+1<argc) {
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &j) <= 0) || (j < 0) || (j > 1))
+        {
+          printf("\ncommand '-F/-fast-connect' requires a decimal parameter (0..1)\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-F/-fast-connect' requires a decimal parameter (0..1)\n");
+        printHelp = i;
+        break;
+      }
+      g_fastConnect = (j != 0);
+
+    } // fast connect
+
+
+    // record upload progress in journal and resume interrupted upload
+    else if ((!strcmp(argv[i], "-J")) || (!strcmp(argv[i], "-resume"))) {
+
+      // get journal file name
+      if (i+1<argc) {
+        i+=1;
+        strncpy(journalFile, argv[i], STRLEN-1);
+      }
+      else {
+        printf("\ncommand '-J/-resume' requires a journal file name\n");
+        printHelp = i;
+        break;
+      }
+
+    } // resume
+
+
+    // upload via second-stage RAM loader with higher baudrate
+    else if ((!strcmp(argv[i], "-S")) || (!strcmp(argv[i], "-stage2"))) {
+
+      // get loader file name and baudrate
+      if (i+2<argc) {
+        strncpy(stage2File, argv[++i], STRLEN-1);
+        i++;
+        if ((!isDecString(argv[i])) || (sscanf(argv[i],"%d", &stage2Baud) <= 0))
+        {
+          printf("\ncommand '-S/-stage2' requires a loader file and a decimal baudrate\n");
+          printHelp = i;
+          break;
+        }
+      }
+      else {
+        printf("\ncommand '-S/-stage2' requires a loader file and a decimal baudrate\n");
+        printHelp = i;
+        break;
+      }
+
+    } // stage2
+
+
+    // compress upload frames for stage-2 loader
+    else if ((!strcmp(argv[i], "-z")) || (!strcmp(argv[i], "-compress"))) {
+      compressUpload = true;
+    } // compress
+
+
     // jump adress before program termination (-1 or 0xFFFFFFFF == skip jump)
     else if ((!strcmp(argv[i], "-j")) || (!strcmp(argv[i], "-jump-addr"))) {
 
@@ -467,9 +786,23 @@ int main(int argc, char ** argv) {
       printf("    -i/-interface [line]            communication interface: 0=UART, 1=SPI via Arduino (default: UART)\n");
     #endif
     printf("    -u/-uart-mode [mode]            UART mode: 0=duplex, 1=1-wire, 2=2-wire reply, other=auto-detect (default: auto-detect)\n");
-    printf("    -p/-port [name]                 communication port (default: list available ports)\n");
-    printf("    -b/-baudrate [speed]            communication baudrate in Baud (default: 115200)\n");
+    printf("    -p/-port [name]                 communication port, or network serial server 'tcp://host:port' (raw) or 'rfc2217://host:port' (Posix only) (default: list available ports)\n");
+    printf("    -g/-gang [ports]                program comma separated UART ports (or patterns) concurrently. Supports -w, -W, -E (default: off)\n");
+    printf("    -D/-discover [ports]            probe 'all' serial ports (or comma separated list/patterns) concurrently for STM8 bootloader, print responding targets and exit (default: off)\n");
+    printf("    -c/-cache [file]                cache device identity per port in file for faster connect (default: off)\n");
+    printf("    -b/-baudrate [speed]            communication baudrate in Baud, or 'auto' for fastest reliable rate. Auto requires reset 2/3/6 for UART, result is cached in '<file>.speed' with -c (default: 115200)\n");
     printf("    -V/-verify                      verify flash content after upload: 0=skip, 1=CRC32 checksum, 2=read back (default: read back)\n");
+    printf("    -m/-write-mode [mode]           write transfer mode: 0=lock-step, 1=pipelined (UART duplex only) (default: lock-step)\n");
+    printf("    -a/-align [fill]                widen partial flash pages to aligned 128B pages. Fill with value (as dec or hex) or 'read' from device. -W only supports 'read' (default: off)\n");
+    printf("    -P/-erase-plan [mode]           erase flash sectors completely covered by upload: 0=off, 1=all sectors, 2=skip blank sectors, 3=like 2, mass erase if faster (erases EEPROM!) (default: off)\n");
+    printf("    -d/-delta [size]                only write flash blocks of 128B or 1024B with changed content, 0=off. Compare via CRC32 or read back (default: off)\n");
+    printf("    -t/-retry [num]                 max. number of retries after a failed write, read or erase (UART only). 0=abort on first failure (default: %d)\n", RETRY_DEFAULT);
+    printf("    -L/-low-latency [on]            reduce USB-serial latency via tty driver and adapter latency timer (Linux only). Changes system-wide settings until exit. 0=off, 1=on (default: 0)\n");
+    printf("    -I/-io-thread [on]              access port via I/O thread with ring buffers, which reads ahead continuously (Posix only). 0=off, 1=on (default: 0)\n");
+    printf("    -F/-fast-connect [on]           synchronize directly after reset, drain port instead of fixed delays. Reports connect latency. 0=off, 1=on (default: 0)\n");
+    printf("    -J/-resume [file]               record upload progress in journal file. If upload was interrupted, resume with same image and -P/-a options (default: off)\n");
+    printf("    -S/-stage2 [file baud]          upload via second-stage RAM loader (*.ihx) with given baudrate. Loader verifies each frame, no -V 1/2 and no further BSL commands (default: off)\n");
+    printf("    -z/-compress                    LZ compress upload frames for second-stage loader, requires -S (default: off)\n");
     printf("    -j/-jump-addr [address]         jump to address (as dec or hex) before exit of %s, or -1 for skip (default: flash)\n", appname);
     printf("    -w/-write-file [file [addr]]    upload file from PC to uController. For binary file (*.bin) with address offset (as dec or hex)\n");
     printf("    -W/-write-byte [addr value]     change value at given address (both as dec or hex)\n");
@@ -511,6 +844,17 @@ int main(int argc, char ** argv) {
   if (g_backgroundOperation)
     g_pauseOnExit = false;
 
+  // compression requires decompressor of stage-2 loader
+  if ((compressUpload) && (strlen(stage2File) == 0))
+    Error("option '-z/-compress' requires '-S/-stage2'");
+
+  // stage-2 loader verifies each frame and has no read command -> no verify via ROM bootloader
+  if (strlen(stage2File) != 0) {
+    if ((verifySet) && (verifyUpload != 0))
+      Error("option '-V/-verify %d' not possible with '-S/-stage2', use '-V 0'", verifyUpload);
+    verifyUpload = 0;
+  }
+
   if (!g_backgroundOperation) {
     snprintf(tmp, sizeof(tmp), "%s (%s)", appname, version);
     setConsoleTitle(tmp);
@@ -526,6 +870,175 @@ int main(int argc, char ** argv) {
     printf("\n%s (%s)\n", appname, version);
 
 
+  ////////
+  // gang programming: import image once, then program all ports concurrently and exit
+  ////////
+  if (strlen(gangPorts) != 0) {
+
+    // intermediate variables
+    char      ports[GANG_MAX_PORTS][GANG_NAMELEN];  // names of ports
+    int       numPorts;                       // number of ports
+    GangJob_s job;                            // job for all ports
+
+    // only UART with per-port reset supported
+    if (physInterface != UART)
+      Error("gang programming only supported via UART");
+    if ((resetSTM8 == 4) || (resetSTM8 == 5))
+      Error("reset method %d not supported for gang programming (0=skip, 1=manual, 2=DTR line, 3=send 'Re5eT!', 6=RTS line)", resetSTM8);
+    if (baudrate == 0)
+      Error("automatic baudrate not supported for gang programming");
+
+    // get list of ports
+    numPorts = gang_ports(gangPorts, ports, GANG_MAX_PORTS);
+    if (numPorts == 0)
+      Error("no port found for gang '%s'", gangPorts);
+
+    // set job parameters
+    job.image        = &image;
+    stm8gal_defaultConfig(&(job.config));
+    job.config.baudrate     = baudrate;
+    job.config.uartMode     = uartMode;
+    job.config.resetSTM8    = resetSTM8;
+    job.config.writeMode    = writeMode;
+    job.config.verifyUpload = verifyUpload;
+    job.config.alignMode    = alignMode;
+    job.config.alignPad     = alignPad;
+    job.config.erasePlan    = erasePlan;
+    job.config.deltaBlock   = deltaBlock;
+    job.config.retry        = g_retryMax;
+    job.config.lowLatency   = g_lowLatency;
+    job.config.ioThread     = g_ioThread;
+    job.config.fastConnect  = g_fastConnect;
+    job.massErase    = false;
+    job.jumpAddr     = jumpAddr;
+
+    // import all files and values into single image. Parameters were checked in 1st pass
+    for (i=1; i<argc; i++) {
+
+      // import file
+      if ((!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "-write-file"))) {
+        char      infile[STRLEN]="";
+        uint64_t  addrStart = 0;
+        strncpy(infile, argv[++i], STRLEN-1);
+        char *p = strrchr(infile, '.');
+        if ((p != NULL ) && ((!strcmp(p, ".s19")) || (!strcmp(p, ".S19"))))
+          import_file_s19(infile, &image, verbose);
+        else if ((p != NULL ) && (!strcmp(p, ".hex") || (!strcmp(p, ".HEX")) || (!strcmp(p, ".ihx")) || (!strcmp(p, ".IHX"))))
+          import_file_ihx(infile, &image, verbose);
+        else if ((p != NULL ) && ((!strcmp(p, ".txt")) || (!strcmp(p, ".TXT"))))
+          import_file_txt(infile, &image, verbose);
+        else if ((p != NULL ) && ((!strcmp(p, ".bin")) || (!strcmp(p, ".BIN")))) {
+          strncpy(tmp, argv[++i], STRLEN-1);
+          sscanf(tmp, "%" SCNx64, &addrStart);
+          import_file_bin(infile, addrStart, &image, verbose);
+        }
+        else
+          Error("Input file %s has unsupported format (*.s19, *.hex, *.ihx, *.txt, *.bin)", infile);
+      }
+
+      // set single value
+      else if ((!strcmp(argv[i], "-W")) || (!strcmp(argv[i], "-write-byte"))) {
+        uint64_t  addr;
+        uint8_t   val;
+        strncpy(tmp, argv[++i], STRLEN-1);
+        if (isHexString(tmp))
+          sscanf(tmp, "%" SCNx64, &addr);
+        else
+          sscanf(tmp, "%" SCNu64, &addr);
+        strncpy(tmp, argv[++i], STRLEN-1);
+        if (isHexString(tmp))
+          sscanf(tmp, "%hhx", &val);
+        else
+          sscanf(tmp, "%" SCNu8, &val);
+        assert(MemoryImage_addData(&image, (MEMIMAGE_ADDR_T) addr, (uint8_t) val));
+      }
+
+      // mass erase prior to upload
+      else if ((!strcmp(argv[i], "-E")) || (!strcmp(argv[i], "-erase-full")))
+        job.massErase = true;
+
+      // other actions are not supported
+      else if ((!strcmp(argv[i], "-r")) || (!strcmp(argv[i], "-read")) || (!strcmp(argv[i], "-e")) || (!strcmp(argv[i], "-erase-sector")))
+        Error("command '%s' not supported for gang programming", argv[i]);
+
+    } // import loop
+
+    // manually reset all STM8 at once
+    if (resetSTM8 == 1) {
+      if (!g_backgroundOperation) {
+        printf("  reset all STM8 and press <return>");
+        fflush(stdout);
+        fflush(stdin);
+        getchar();
+      }
+      else {
+        printf("  reset all STM8 now\n");
+        fflush(stdout);
+      }
+    }
+
+    // program all ports concurrently
+    j = gang_run(ports, numPorts, &job, verbose);
+
+    // print message
+    if (verbose != MUTE)
+      printf("done with program\n");
+
+    // clear memory image and terminate program
+    MemoryImage_free(&image);
+    Exit((j != 0) ? 1 : 0, g_pauseOnExit);
+
+  } // gang programming
+
+
+  ////////
+  // discovery: probe ports concurrently for STM8 bootloader, print responding targets and exit
+  ////////
+  if (strlen(discoverPorts) != 0) {
+
+    // intermediate variables
+    DiscoverPort_s  *ports;                   // candidate ports and results
+    int             numPorts;                 // number of ports
+
+    // only UART with per-port reset supported
+    if (physInterface != UART)
+      Error("discovery only supported via UART");
+    if ((resetSTM8 != 0) && (resetSTM8 != 1) && (resetSTM8 != 2) && (resetSTM8 != 6))
+      Error("reset method %d not supported for discovery (0=skip, 1=manual, 2=DTR line, 6=RTS line)", resetSTM8);
+    if (baudrate == 0)
+      Error("automatic baudrate not supported for discovery");
+
+    // get candidate ports
+    ports = (DiscoverPort_s*) malloc(DISCOVER_MAX * sizeof(DiscoverPort_s));
+    if (ports == NULL)
+      Error("cannot allocate memory for discovery");
+    numPorts = discover_ports(discoverPorts, ports, DISCOVER_MAX);
+
+    // manually reset all STM8 at once
+    if (resetSTM8 == 1) {
+      if (!g_backgroundOperation) {
+        printf("# reset all STM8 and press <return>");
+        fflush(stdout);
+        fflush(stdin);
+        getchar();
+      }
+      else {
+        printf("# reset all STM8 now\n");
+        fflush(stdout);
+      }
+      resetSTM8 = 0;
+    }
+
+    // probe all ports concurrently and print responding targets
+    j = discover_run(ports, numPorts, baudrate, resetSTM8, verbose);
+
+    // release memory and terminate program
+    free(ports);
+    Exit((j != 0) ? 0 : 1, g_pauseOnExit);
+
+  } // discovery
+
+
   ////////
   // if no port name is given, list all available ports and query
   ////////
@@ -546,16 +1059,37 @@ int main(int argc, char ** argv) {
   } // if no comm port name
 
 
+  ////////
+  // optionally select fastest reliable baudrate. Probes reset the STM8 themselves
+  ////////
+  if (baudrate == 0) {
+    char  speedFile[STRLEN+10] = "";
+    if (strlen(cacheFile) != 0)
+      snprintf(speedFile, sizeof(speedFile), "%s.speed", cacheFile);
+    baudrate = (int) autospeed_select(portname, physInterface, uartMode, resetSTM8, speedFile, verbose);
+  }
+
+
   ////////
   // reset STM8
   // Note: prior to opening port to avoid flushing issue under Linux, see https://stackoverflow.com/questions/13013387/clearing-the-serial-ports-buffer
   ////////
 
+  // start of connect for latency measurement
+  tConnect = micros();
+
   // skip reset of STM8
   if (resetSTM8 == 0) {
 
   }
 
+  // fast connect: reset via DTR or RTS on port opened with target baudrate, see below
+  else if ((g_fastConnect) && (physInterface == UART) && ((resetSTM8 == 2) || (resetSTM8 == 6))) {
+
+    // dummy
+
+  }
+
   // manually reset STM8
   else if (resetSTM8 == 1) {
     if (!g_backgroundOperation) {
@@ -599,7 +1133,8 @@ int main(int argc, char ** argv) {
     if (verbose != MUTE)
       printf("ok\n");
     fflush(stdout);
-    SLEEP(20);                        // allow BSL to initialize
+    if (!g_fastConnect)
+      SLEEP(20);                      // allow BSL to initialize
   }
 
   // HW reset STM8 using Arduino pin 8 -> delay until Arduino port is open
@@ -619,7 +1154,8 @@ int main(int argc, char ** argv) {
       if (verbose != MUTE)
         printf("ok\n");
       fflush(stdout);
-      SLEEP(20);                      // allow BSL to initialize
+      if (!g_fastConnect)
+        SLEEP(20);                    // allow BSL to initialize
     }
   #endif // __ARMEL__ && USE_WIRING
 
@@ -665,6 +1201,20 @@ int main(int argc, char ** argv) {
       printf("done\n");
     fflush(stdout);
 
+    // fast connect: reset via DTR or RTS without re-opening port. BSL is synchronized directly afterwards
+    if ((g_fastConnect) && ((resetSTM8 == 2) || (resetSTM8 == 6))) {
+      if (verbose != MUTE)
+        printf("  reset via %s ... ", (resetSTM8 == 2) ? "DTR" : "RTS");
+      fflush(stdout);
+      if (resetSTM8 == 2)
+        pulse_DTR(ptrPort, 10);
+      else
+        pulse_RTS(ptrPort, 10);
+      if (verbose != MUTE)
+        printf("ok\n");
+      fflush(stdout);
+    }
+
   } // UART
 
   // SPI via Arduino
@@ -681,13 +1231,20 @@ int main(int argc, char ** argv) {
       printf("ok\n");
     fflush(stdout);
 
-    // wait until after Arduino bootloader
+    // wait until after Arduino bootloader. For fast connect until bridge responds
     if ((verbose == INFORM) || (verbose == CHATTY))
       printf("  wait for Arduino bootloader ... ");
     fflush(stdout);
-    SLEEP(2000);
-    if ((verbose == INFORM) || (verbose == CHATTY))
-      printf("ok\n");
+    if (g_fastConnect) {
+      uint32_t tWait = waitReady_Arduino(ptrPort);
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("ok (%dms)\n", (int) tWait);
+    }
+    else {
+      SLEEP(2000);
+      if ((verbose == INFORM) || (verbose == CHATTY))
+        printf("ok\n");
+    }
     fflush(stdout);
 
     // init SPI interface and set NSS pin to high
@@ -715,7 +1272,8 @@ int main(int argc, char ** argv) {
       if ((verbose == INFORM) || (verbose == CHATTY))
         printf("ok\n");
       fflush(stdout);
-      SLEEP(20);                      // allow BSL to initialize
+      if (!g_fastConnect)
+        SLEEP(20);                    // allow BSL to initialize
     }
 
   } // SPI via Arduino
@@ -770,12 +1328,18 @@ int main(int argc, char ** argv) {
   // communicate with STM8 bootloader
   ////////
 
-  // required to make flush work, for some reason
-  SLEEP(200);
-  flush_port(ptrPort);
-
   // synchronize with bootloader. For UART also sync baudrate
-  bsl_sync(ptrPort, physInterface, verbose);
+  if (g_fastConnect)
+    bsl_syncFast(ptrPort, physInterface, verbose);
+  else {
+    SLEEP(200);           // required to make flush work, for some reason
+    flush_port(ptrPort);
+    bsl_sync(ptrPort, physInterface, verbose);
+  }
+
+  // report connect latency from reset to synchronization (not for manual reset)
+  if ((verbose == CHATTY) && (resetSTM8 != 1))
+    printf("  connect time: %1.1fms\n", (float) (micros() - tConnect) / 1000.0);
 
   // for UART set or auto-detect UART mode (0=duplex, 1=1-wire, 2=2-wire reply, others=auto-detect)
   if (physInterface == UART) {
@@ -801,8 +1365,14 @@ int main(int argc, char ** argv) {
   } // UART interface
   fflush(stdout);
 
-  // get bootloader info for selecting RAM w/e routines for flash
-  bsl_getInfo(ptrPort, physInterface, uartMode, &flashsize, &versBSL, &family, verbose);
+  // get bootloader info for selecting RAM w/e routines for flash. Optionally confirm cached device identity with fewer probes
+  if ((strlen(cacheFile) == 0) || (!devcache_load(cacheFile, portname, &flashsize, &versBSL, &family)) ||
+      (bsl_checkInfo(ptrPort, physInterface, uartMode, flashsize, versBSL, family, verbose) != 0))
+  {
+    bsl_getInfo(ptrPort, physInterface, uartMode, &flashsize, &versBSL, &family, verbose);
+    if (strlen(cacheFile) != 0)
+      devcache_store(cacheFile, portname, flashsize, versBSL, family);
+  }
 
   // upload RAM routines for flash write & erase
   bsl_uploadWriteErase(ptrPort, physInterface, uartMode, flashsize, versBSL, family, verbose);
@@ -812,11 +1382,18 @@ int main(int argc, char ** argv) {
   // 2nd pass of commandline arguments: execute actions, e.g. upload and download files
   /////////////////
 
+  stage2.active = false;
   for (i=1; i<argc; i++) {
 
     // debug
     //printf("\nargv[%d] = '%s'\n", i, argv[i]);
 
+    // stage-2 loader has replaced ROM bootloader -> no further BSL commands
+    if ((stage2.active) && ((!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "-write-file")) || (!strcmp(argv[i], "-W")) || (!strcmp(argv[i], "-write-byte")) ||
+        (!strcmp(argv[i], "-r")) || (!strcmp(argv[i], "-read")) || (!strcmp(argv[i], "-e")) || (!strcmp(argv[i], "-erase-sector")) ||
+        (!strcmp(argv[i], "-E")) || (!strcmp(argv[i], "-erase-full"))))
+      Error("command '%s' not possible after upload via stage-2 loader", argv[i]);
+
     // skip print help (already treated in 1st pass)
     if ((!strcmp(argv[i], "-h")) || (!strcmp(argv[i], "-help"))) {
       i += 0;   // dummy
@@ -864,6 +1441,18 @@ int main(int argc, char ** argv) {
     }
 
 
+    // skip gang programming with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-g")) || (!strcmp(argv[i], "-gang"))) {
+      i += 1;
+    }
+
+
+    // skip discovery with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-D")) || (!strcmp(argv[i], "-discover"))) {
+      i += 1;
+    }
+
+
     // skip communication baudrate with 1 parameter, is handled in 1st run
     else if ((!strcmp(argv[i], "-b")) || (!strcmp(argv[i], "-baudrate"))) {
       i += 1;
@@ -876,6 +1465,78 @@ int main(int argc, char ** argv) {
     }
 
 
+    // skip write mode with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-m")) || (!strcmp(argv[i], "-write-mode"))) {
+      i += 1;
+    }
+
+
+    // skip page alignment with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-a")) || (!strcmp(argv[i], "-align"))) {
+      i += 1;
+    }
+
+
+    // skip erase planner with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-P")) || (!strcmp(argv[i], "-erase-plan"))) {
+      i += 1;
+    }
+
+
+    // skip delta flashing with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-d")) || (!strcmp(argv[i], "-delta"))) {
+      i += 1;
+    }
+
+
+    // skip number of retries with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-t")) || (!strcmp(argv[i], "-retry"))) {
+      i += 1;
+    }
+
+
+    // skip low-latency mode with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-L")) || (!strcmp(argv[i], "-low-latency"))) {
+      i += 1;
+    }
+
+
+    // skip I/O thread mode with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-I")) || (!strcmp(argv[i], "-io-thread"))) {
+      i += 1;
+    }
+
+
+    // skip fast connect mode with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-F")) || (!strcmp(argv[i], "-fast-connect"))) {
+      i += 1;
+    }
+
+
+    // skip device cache with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-c")) || (!strcmp(argv[i], "-cache"))) {
+      i += 1;
+    }
+
+
+    // skip journal file with 1 parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-J")) || (!strcmp(argv[i], "-resume"))) {
+      i += 1;
+    }
+
+
+    // skip stage-2 loader with 2 parameters, is handled in 1st run
+    else if ((!strcmp(argv[i], "-S")) || (!strcmp(argv[i], "-stage2"))) {
+      i += 2;
+    }
+
+
+    // skip compression without parameter, is handled in 1st run
+    else if ((!strcmp(argv[i], "-z")) || (!strcmp(argv[i], "-compress"))) {
+      i += 0;   // dummy
+    }
+
+
     // skip jump adress with 1 parameter, is handled in 1st run
     else if ((!strcmp(argv[i], "-j")) || (!strcmp(argv[i], "-jump-addr"))) {
       i += 1;
@@ -888,6 +1549,7 @@ int main(int argc, char ** argv) {
       // intermediate variables
       char      infile[STRLEN]="";     // name of input file
       uint64_t  addrStart;             // address offset for binary file
+      Journal_s journal;               // progress journal for resume
 
       // get file name
       strncpy(infile, argv[++i], STRLEN-1);
@@ -917,8 +1579,40 @@ int main(int argc, char ** argv) {
         Error("Input file %s has unsupported format (*.s19, *.hex, *.ihx, *.txt, *.bin)", infile);
       }
 
-      // upload memory image to STM8
-      bsl_memWrite(ptrPort, physInterface, uartMode, &image, verbose);
+      // optionally record progress in journal. Identify by imported image, as alignment via read depends on device content
+      if (strlen(journalFile) != 0)
+        journal_begin(&journal, journalFile, &image, erasePlan, alignMode, alignPad, verbose);
+
+      // optionally widen partial flash pages for fast block programming
+      bsl_memAlign(ptrPort, physInterface, uartMode, &image, alignMode, alignPad, verbose);
+
+      // optionally resume interrupted upload. Skip pages confirmed in journal and verified on device
+      if (strlen(journalFile) != 0)
+        journal_resume(&journal, ptrPort, family, flashsize, versBSL, physInterface, uartMode, &image, verbose);
+
+      // optionally skip unchanged flash blocks. Erase planner erases complete sectors -> compare sectors
+      delta_filter(ptrPort, family, flashsize, versBSL, physInterface, uartMode, &image, ((deltaBlock != DELTA_OFF) && (erasePlan != ERASE_PLAN_OFF)) ? DELTA_SECTOR : deltaBlock, verbose);
+
+      // optionally erase flash sectors covered by image. Skip if already done in interrupted upload
+      if ((strlen(journalFile) == 0) || (!journal.erased)) {
+        erase_plan(ptrPort, family, flashsize, versBSL, physInterface, uartMode, &image, erasePlan, verbose);
+        if ((strlen(journalFile) != 0) && (erasePlan != ERASE_PLAN_OFF))
+          journal_erased(&journal, &image, flashsize);
+      }
+
+      // upload via stage-2 loader. Each frame is verified by loader
+      if (strlen(stage2File) != 0) {
+        stage2_start(&stage2, ptrPort, physInterface, uartMode, stage2File, stage2Baud, family, flashsize, verbose);
+        stage2_memWrite(&stage2, &image, compressUpload, verbose);
+      }
+
+      // upload memory image to STM8. Record acknowledged pages in journal
+      else {
+        if (strlen(journalFile) != 0)
+          bsl_setPageDone(journal_pageDone, &journal);
+        bsl_memWrite(ptrPort, physInterface, uartMode, &image, writeMode, verbose);
+        bsl_setPageDone(NULL, NULL);
+      }
 
       // optionally verify upload
       if (verifyUpload == 0)        // skip verify
@@ -933,6 +1627,10 @@ int main(int argc, char ** argv) {
       else
         Error("Unknown memory verify method %d", verifyUpload);
 
+      // upload completed -> delete journal
+      if (strlen(journalFile) != 0)
+        journal_end(&journal, true);
+
       // clear memory image
       MemoryImage_free(&image);
 
@@ -969,8 +1667,15 @@ int main(int argc, char ** argv) {
       // store value in memory image for bsl_memWrite()
       assert(MemoryImage_addData(&image, (MEMIMAGE_ADDR_T) addr, (uint8_t) val));
 
+      // optionally widen flash page for fast block programming. Only with device content, a pad value would overwrite the other bytes
+      if (alignMode == ALIGN_READ)
+        bsl_memAlign(ptrPort, physInterface, uartMode, &image, alignMode, alignPad, verbose);
+
+      // optionally erase flash sectors covered by image. A single byte never covers a sector
+      erase_plan(ptrPort, family, flashsize, versBSL, physInterface, uartMode, &image, erasePlan, verbose);
+
       // upload memory image to STM8
-      bsl_memWrite(ptrPort, physInterface, uartMode, &image, verbose);
+      bsl_memWrite(ptrPort, physInterface, uartMode, &image, writeMode, verbose);
 
       // optionally verify upload
       if (verifyUpload == 0)        // skip verify
@@ -1075,6 +1780,16 @@ int main(int argc, char ** argv) {
   } // 2nd pass over commandline arguments
 
 
+  // throughput of UART reply mode, for comparison with other modes
+  if ((verbose == CHATTY) && (physInterface == UART) && (uartMode == 2)) {
+    uint32_t  numBytes;
+    uint64_t  duration;
+    get_reply_stats(ptrPort, &numBytes, &duration);
+    if (duration > 0)
+      printf("  reply mode: received %1.1fkB in %1.1fs (%1.1fkB/s)\n", (float) numBytes / 1024.0, (float) duration * 1e-6, (float) numBytes / 1024.0 / ((float) duration * 1e-6));
+  }
+
+
   ////////
   // jump to address prior to exit (default: beginning of P-flash=0x8000). Skip if 0xFFFFFFFFFFFFFFFF
   ////////
@@ -1090,11 +1805,18 @@ int main(int argc, char ** argv) {
     #endif
 
     // jump to application
-    bsl_jumpTo(ptrPort, physInterface, uartMode, jumpAddr, verbose);
+    if (stage2.active)
+      stage2_jumpTo(&stage2, jumpAddr, verbose);
+    else
+      bsl_jumpTo(ptrPort, physInterface, uartMode, jumpAddr, verbose);
 
   } // jump to STM8 address
 
 
+  // print number of retried transactions
+  if ((verbose != MUTE) && (bsl_getRetryCount() > 0))
+    printf("  recovered from %d failed transactions\n", (int) bsl_getRetryCount());
+
   // print message
   if (verbose != MUTE)
     printf("done with program\n");
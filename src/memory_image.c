@@ -170,6 +170,72 @@ bool MemoryImage_addData(MemoryImage_s* image, const MEMIMAGE_ADDR_T address, co
 } // MemoryImage_addData()
 
 
+bool MemoryImage_addBlock(MemoryImage_s* image, const MEMIMAGE_ADDR_T address, const uint8_t *data, const size_t len) {
+
+    // nothing to do
+    if (len == 0)
+        return true;
+
+    // optional debug output
+    #if defined(MEMIMAGE_DEBUG)
+        if (image->debug >= 1) {
+            fprintf(stderr, "MemoryImage_addBlock(): 0x%04" PRIX64 " %ldB\n", (uint64_t) address, (long) len);
+        }
+    #endif // MEMIMAGE_DEBUG
+
+    // get index range [idxStart;idxEnd) of existing entries within new block
+    size_t idxStart, idxEnd;
+    MemoryImage_getIndex(image, address, &idxStart);
+    if (MemoryImage_getIndex(image, address+len-1, &idxEnd))
+        idxEnd++;
+    size_t numOld = idxEnd - idxStart;
+    size_t numNew = image->numEntries - numOld + len;
+
+    // assert buffer size limit
+    if (numNew * sizeof(MemoryEntry_s) > MEMIMAGE_BUFFER_MAX) {
+        fprintf(stderr, "Error in MemoryImage_addBlock(): buffer size limit of %gMB reached\n", (float) MEMIMAGE_BUFFER_MAX/(1024.0*1024.0));
+        return false;
+    }
+
+    // expand memory buffer once, if required
+    if (numNew >= image->capacity) {
+        size_t newCapacity = MAX(numNew, MIN(ceil((float) image->capacity * (float) MEMIMAGE_BUFFER_MARGIN), MEMIMAGE_BUFFER_MAX));
+
+        // optional debug output
+        #if defined(MEMIMAGE_DEBUG)
+            if (image->debug >= 2) {
+                fprintf(stderr, "MemoryImage_addBlock(): resize %d to %d\n", (int) image->capacity, (int) newCapacity);
+            }
+        #endif // MEMIMAGE_DEBUG
+
+        // re-allocate memory buffer. Return on fail
+        image->memoryEntries = (MemoryEntry_s*)realloc(image->memoryEntries, newCapacity * sizeof(MemoryEntry_s));
+        if (image->memoryEntries == NULL) {
+            fprintf(stderr, "Error in MemoryImage_addBlock(): failed to reallocate %ldB\n", newCapacity * (long) sizeof(MemoryEntry_s));
+            return false;
+        }
+        image->capacity = newCapacity;
+
+    }
+
+    // shift higher addresses to make room for block (single move)
+    if ((numOld != len) && (idxEnd < image->numEntries)) {
+        memmove(&(image->memoryEntries[idxStart+len]), &(image->memoryEntries[idxEnd]), (image->numEntries - idxEnd) * (size_t) (sizeof(MemoryEntry_s)));
+    }
+
+    // copy block to correct location
+    for (size_t i = 0; i < len; i++) {
+        image->memoryEntries[idxStart+i].address = address + (MEMIMAGE_ADDR_T) i;
+        image->memoryEntries[idxStart+i].data = data[i];
+    }
+    image->numEntries = numNew;
+
+    // return success
+    return true;
+
+} // MemoryImage_addBlock()
+
+
 bool MemoryImage_deleteData(MemoryImage_s* image, const MEMIMAGE_ADDR_T address) {
 
     // search for address in memory image
@@ -504,18 +570,23 @@ bool MemoryImage_cut(MemoryImage_s* image, const MEMIMAGE_ADDR_T addrStart, cons
         }
     #endif // MEMIMAGE_DEBUG
 
-    // loop over image and remove data inside [addrStart;addrEnd]
-    size_t i = 0;
-    while (i != image->numEntries) {
-        MEMIMAGE_ADDR_T address = image->memoryEntries[i].address;
-        if ((address >= addrStart) && (address <= addrEnd)) {
-            result &= MemoryImage_deleteData(image, address);
-        } else {
-            i++;
-        }
+    // nothing to do
+    if (addrStart > addrEnd)
+        return result;
+
+    // get index range [idxStart;idxEnd) of data inside [addrStart;addrEnd]
+    size_t idxStart, idxEnd;
+    MemoryImage_getIndex(image, addrStart, &idxStart);
+    if (MemoryImage_getIndex(image, addrEnd, &idxEnd))
+        idxEnd++;
+
+    // remove data with a single move of higher addresses
+    if (idxEnd > idxStart) {
+        memmove(&(image->memoryEntries[idxStart]), &(image->memoryEntries[idxEnd]), (image->numEntries - idxEnd) * (size_t) (sizeof(MemoryEntry_s)));
+        image->numEntries -= idxEnd - idxStart;
     }
 
-    // return cumulated result
+    // return result
     return result;
 
 } // MemoryImage_cut()
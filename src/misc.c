@@ -13,9 +13,12 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include "misc.h"
-#include "main.h"
+#define _MAIN_          // define globals here, so they are also contained in library (see stm8gal.h)
+  #include "main.h"
+#undef _MAIN_
 #include "version.h"
 
 
@@ -65,6 +68,18 @@
 #endif // OS
 
 
+// error trap of calling thread, see setErrorTrap()
+static __thread ErrorTrap_s   *s_errorTrap = NULL;
+
+// buffers owned by calling thread, released by Error() before returning to an error trap. See ownBuffer()
+typedef struct {
+  void  (*release)(void*);      //< function to release buffer
+  void  *ptr;                   //< buffer or memory image
+} Owned_s;
+static __thread Owned_s       s_owned[OWNED_MAX];
+static __thread int           s_numOwned = 0;
+
+
 
 /**
   \fn void Error(const char *format, ...)
@@ -75,11 +90,26 @@
   Display error message and terminate program. Output format is identical to
   printf(). Prior to program termination query for \<return\> unless
   background operation is specified.
+  If an error trap is set for the calling thread, store message and return
+  to the trap via longjmp() instead, see setErrorTrap(). Before, release all
+  buffers registered since the trap was set, see ownBuffer().
 */
 void Error(const char *format, ...)
 {
   va_list vargs;
   va_start(vargs, format);
+
+  // error trap set for this thread -> store message, release owned buffers and return to setjmp()
+  if (s_errorTrap != NULL) {
+    vsnprintf(s_errorTrap->msg, ERRMSG_LEN, format, vargs);
+    va_end(vargs);
+    while (s_numOwned > s_errorTrap->numOwned) {
+      s_numOwned--;
+      s_owned[s_numOwned].release(s_owned[s_numOwned].ptr);
+    }
+    longjmp(s_errorTrap->env, 1);
+  }
+
   setConsoleColor(PRM_COLOR_RED);
   fprintf(stderr, "Error: ");
   vfprintf(stderr, format, vargs);
@@ -126,6 +156,131 @@ void Exit(uint8_t code, uint8_t pause) {
 
 
 
+/**
+  \fn ErrorTrap_s* setErrorTrap(ErrorTrap_s *trap)
+
+  \param[in] trap    error trap initialized with setjmp(), or NULL to terminate on error
+
+  \return previous error trap of calling thread (for nesting)
+
+  Set error trap for the calling thread. While set, Error() doesn't terminate the
+  program but stores the message in the trap and returns to the respective setjmp().
+  Used for independent sessions on worker threads and library calls, see stm8gal.c.
+  Active traps form a stack via ErrorTrap_s.prev. A trap already on this stack is
+  restored (incl. its set of owned buffers, see ownBuffer()), any other trap is pushed
+*/
+ErrorTrap_s* setErrorTrap(ErrorTrap_s *trap) {
+
+  ErrorTrap_s *prev = s_errorTrap;
+  ErrorTrap_s *active;
+
+  // search trap in stack of active traps
+  for (active = prev; (active != NULL) && (active != trap); active = active->prev);
+
+  // new trap -> push on stack and remember currently owned buffers
+  if ((trap != NULL) && (active == NULL)) {
+    trap->prev     = prev;
+    trap->numOwned = s_numOwned;
+  }
+  s_errorTrap = trap;
+  return prev;
+
+} // setErrorTrap
+
+
+
+/**
+  \fn static void releaseImage(void *image)
+
+  \param[in] image    memory image to release
+
+  release memory image registered via ownImage()
+*/
+static void releaseImage(void *image) {
+
+  MemoryImage_free((MemoryImage_s*) image);
+
+} // releaseImage
+
+
+
+/**
+  \fn static void own(void (*release)(void*), void *ptr)
+
+  \param[in] release  function to release buffer
+  \param[in] ptr      buffer or memory image
+
+  register buffer for release by Error(), see ownBuffer() and ownImage()
+*/
+static void own(void (*release)(void*), void *ptr) {
+
+  // avoid overflow -> release immediately and terminate
+  if (s_numOwned >= OWNED_MAX) {
+    release(ptr);
+    Error("in 'own()': too many owned buffers (max %d)", OWNED_MAX);
+  }
+
+  s_owned[s_numOwned].release = release;
+  s_owned[s_numOwned].ptr     = ptr;
+  s_numOwned++;
+
+} // own
+
+
+
+/**
+  \fn void ownBuffer(void *buf)
+
+  \param[in] buf      buffer allocated with malloc()
+
+  Register buffer of calling thread. If Error() returns to an error trap set before,
+  it frees the buffer before calling longjmp(), which would skip the regular free().
+  After regular release unregister buffer via disown()
+*/
+void ownBuffer(void *buf) {
+
+  own(free, buf);
+
+} // ownBuffer
+
+
+
+/**
+  \fn void ownImage(MemoryImage_s *image)
+
+  \param[in] image    initialized memory image
+
+  Register memory image of calling thread, see ownBuffer()
+*/
+void ownImage(MemoryImage_s *image) {
+
+  own(releaseImage, image);
+
+} // ownImage
+
+
+
+/**
+  \fn void disown(void *ptr)
+
+  \param[in] ptr      buffer or memory image registered via ownBuffer() or ownImage()
+
+  Unregister buffer or memory image of calling thread after regular release
+*/
+void disown(void *ptr) {
+
+  for (int i = s_numOwned-1; i >= 0; i--) {
+    if (s_owned[i].ptr == ptr) {
+      memmove(&(s_owned[i]), &(s_owned[i+1]), (s_numOwned-1-i) * sizeof(Owned_s));
+      s_numOwned--;
+      return;
+    }
+  }
+
+} // disown
+
+
+
 /**
   \fn void stripPath(char *in, char *out)
 
@@ -471,12 +626,12 @@ void setConsoleColor(uint8_t color) {
 
       #if defined(__APPLE__) || defined(__unix__)
 
-      // get current time
-      struct timeval  te;
-      gettimeofday(&te, NULL);
+      // get current time. Use monotonic clock, as it is used for timeouts
+      struct timespec te;
+      clock_gettime(CLOCK_MONOTONIC, &te);
 
-      // calculate milliseconds
-      microsCurr = te.tv_sec*1000000LL + te.tv_usec;
+      // calculate microseconds
+      microsCurr = te.tv_sec*1000000LL + te.tv_nsec/1000LL;
 
       #endif // __APPLE__ || __unix__
 
@@ -17,6 +17,1191 @@
 #if defined(__ARMEL__) && defined(USE_WIRING)
   #include <wiringPi.h>       // for reset via GPIO
 #endif // __ARMEL__ && USE_WIRING
+#if defined(__linux__)
+  #include <limits.h>
+  #include <linux/serial.h>   // for ASYNC_LOW_LATENCY
+#endif // __linux__
+#if defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>        // for I/O thread
+  #include <stdatomic.h>      // for lock-free ring buffers
+  #include <sys/socket.h>     // for network ports
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #if !defined(MSG_NOSIGNAL)
+    #define MSG_NOSIGNAL  0         // e.g. macOS, uses socket option SO_NOSIGPIPE instead, see port_openTcp()
+  #endif
+#endif // __APPLE__ || __unix__
+
+
+#if defined(USE_TERMIOS2)
+
+// termios2 from <asm/termbits.h>, which conflicts with <termios.h>. TCGETS2/TCSETS2 are defined via <sys/ioctl.h>
+struct termios2 {
+  tcflag_t  c_iflag;          //< input mode flags
+  tcflag_t  c_oflag;          //< output mode flags
+  tcflag_t  c_cflag;          //< control mode flags
+  tcflag_t  c_lflag;          //< local mode flags
+  cc_t      c_line;           //< line discipline
+  cc_t      c_cc[19];         //< control characters
+  speed_t   c_ispeed;         //< input speed [Baud]
+  speed_t   c_ospeed;         //< output speed [Baud]
+};
+#ifndef BOTHER
+  #define BOTHER  0010000     // speed in c_ispeed/c_ospeed instead of Bxxx constant
+#endif
+#ifndef IBSHIFT
+  #define IBSHIFT 16          // shift from output to input speed bits in c_cflag
+#endif
+
+
+/**
+  \fn static void port_setBaudrate2(HANDLE fpCom, uint32_t baudrate)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] baudrate   comm port speed in Baud
+
+  Set arbitrary baudrate via termios2 and BOTHER, and read back actual baudrate
+  of driver. Error if it deviates by more than PORT_BAUD_TOL
+*/
+static void port_setBaudrate2(HANDLE fpCom, uint32_t baudrate) {
+
+  struct termios2   toptions2;
+
+  // set baudrate as number instead of Bxxx constant
+  if (ioctl(fpCom, TCGETS2, &toptions2) < 0)
+    Error("in 'set_port_attribute()': get port attributes (termios2) failed");
+  toptions2.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+  toptions2.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+  toptions2.c_ispeed = baudrate;
+  toptions2.c_ospeed = baudrate;
+  if (ioctl(fpCom, TCSETS2, &toptions2) < 0)
+    Error("in 'set_port_attribute()': unsupported baudrate %d Baud", (int) baudrate);
+
+  // read back actual baudrate. Drivers store the closest supported rate
+  if (ioctl(fpCom, TCGETS2, &toptions2) < 0)
+    Error("in 'set_port_attribute()': get port attributes (termios2) failed");
+  if ((uint64_t) abs((int) toptions2.c_ospeed - (int) baudrate) * 100 > (uint64_t) baudrate * PORT_BAUD_TOL)
+    Error("in 'set_port_attribute()': baudrate %d Baud not supported by port (actual %d Baud)", (int) baudrate, (int) toptions2.c_ospeed);
+
+} // port_setBaudrate2
+
+#endif // USE_TERMIOS2
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+/// lock-free single-producer/single-consumer ring buffer. Size is power of 2, indices run freely
+typedef struct {
+  char           *buf;        //< data buffer
+  size_t         size;        //< size of buffer [B]
+  atomic_size_t  head;        //< write index, only modified by producer
+  atomic_size_t  tail;        //< read index, only modified by consumer
+} PortRing_s;
+
+/// state of optional I/O thread of a port (see port_startIo())
+typedef struct {
+  pthread_t      thread;      //< I/O thread
+  int            fd;          //< port descriptor
+  bool           network;     //< port is a socket, see port_writeFd()
+  PortRing_s     rx;          //< received data. Producer: I/O thread, consumer: protocol thread
+  PortRing_s     tx;          //< data to send. Producer: protocol thread, consumer: I/O thread
+  int            wake[2];     //< pipe to wake up I/O thread
+  int            notify[2];   //< pipe to wake up protocol thread waiting for data
+  atomic_bool    rxWaiting;   //< protocol thread waits for data -> notify
+  atomic_bool    stop;        //< request I/O thread to terminate
+  atomic_int     error;       //< errno of I/O thread, or 0
+} PortIo_s;
+
+/// port attributes and low-latency state per file descriptor. Avoids termios calls in receive_port()
+typedef struct {
+  bool      valid;            //< attributes were set via set_port_attribute()
+  uint32_t  baudrate;         //< comm port speed in Baud
+  uint32_t  timeout;          //< timeout between chars in ms
+  uint8_t   numBits;          //< number of data bits per byte
+  uint8_t   parity;           //< parity (0=none, 1=odd, 2=even)
+  uint8_t   numStop;          //< number of stop bits
+  uint8_t   RTS;              //< static RTS status
+  uint8_t   DTR;              //< static DTR status
+  bool      asyncLowLatency;  //< ASYNC_LOW_LATENCY was set by init_port()
+  int       latency;          //< original latency timer [ms] of USB-serial adapter, or 0 if not changed (static contexts of unused descriptors)
+  char      latencyFile[100]; //< sysfs file of latency timer
+  uint32_t  numEcho;          //< number of pending 1-wire echo bytes, consumed by next receive_port()
+  uint32_t  replyBytes;       //< number of bytes received in UART reply mode
+  uint64_t  replyTime;        //< duration [us] of receive in UART reply mode
+  char      echo[PORT_ECHO_MAX]; //< sent bytes, compared with 1-wire echo
+  PortIo_s  *io;              //< I/O thread with ring buffers, or NULL for direct access
+  uint8_t   transport;        //< PORT_SERIAL, PORT_TCP or PORT_RFC2217
+  uint8_t   telnetState;      //< state of telnet command parser for PORT_RFC2217, see port_telnetFilter()
+} PortContext_s;
+
+/// port contexts, indexed by file descriptor. Each descriptor is only used by one protocol thread. An I/O thread only accesses PortIo_s
+static PortContext_s  s_portContext[PORT_CONTEXT_MAX];
+
+#if defined(__linux__)
+  /// register port_restoreAllLatency() only once, see port_setLowLatency()
+  static pthread_once_t s_latencyOnce = PTHREAD_ONCE_INIT;
+#endif
+
+
+/**
+  \fn static PortContext_s* port_context(HANDLE fpCom)
+
+  \param[in] fpCom      handle to comm port
+
+  \return context of port, or NULL if descriptor exceeds PORT_CONTEXT_MAX
+
+  get cached context of comm port
+*/
+static PortContext_s* port_context(HANDLE fpCom) {
+
+  if ((fpCom < 0) || (fpCom >= PORT_CONTEXT_MAX))
+    return(NULL);
+  return(&(s_portContext[fpCom]));
+
+} // port_context
+
+
+
+/**
+  \fn static void port_restoreLatency(HANDLE fpCom, PortContext_s *ctx)
+
+  \param[in] fpCom      handle to comm port
+  \param[in,out] ctx    context of port
+
+  Revert changes of port_setLowLatency(), as latency timer and driver flags outlive the port handle
+*/
+static void port_restoreLatency(HANDLE fpCom, PortContext_s *ctx) {
+
+#if defined(__linux__)
+
+  struct serial_struct  serial;
+  FILE                  *fp;
+
+  // clear low latency flag of tty driver
+  if ((ctx->asyncLowLatency) && (ioctl(fpCom, TIOCGSERIAL, &serial) == 0)) {
+    serial.flags &= ~ASYNC_LOW_LATENCY;
+    ioctl(fpCom, TIOCSSERIAL, &serial);
+  }
+
+  // restore latency timer of USB-serial adapter
+  if (ctx->latency > 0) {
+    fp = fopen(ctx->latencyFile, "w");
+    if (fp != NULL) {
+      fprintf(fp, "%d", ctx->latency);
+      fclose(fp);
+    }
+  }
+
+#else
+  (void) fpCom;
+#endif // __linux__
+
+  ctx->asyncLowLatency = false;
+  ctx->latency = 0;
+
+} // port_restoreLatency
+
+
+
+#if defined(__linux__)
+
+/**
+  \fn static void port_restoreAllLatency(void)
+
+  Revert changes of port_setLowLatency() for all ports still open at program termination.
+  Called via atexit(), e.g. after Error()
+*/
+static void port_restoreAllLatency(void) {
+
+  for (int fd = 0; fd < PORT_CONTEXT_MAX; fd++) {
+    if ((s_portContext[fd].asyncLowLatency) || (s_portContext[fd].latency > 0))
+      port_restoreLatency(fd, &(s_portContext[fd]));
+  }
+
+} // port_restoreAllLatency
+
+
+
+/**
+  \fn static void port_registerRestore(void)
+
+  Register port_restoreAllLatency() for program termination. Called once via pthread_once()
+*/
+static void port_registerRestore(void) {
+
+  atexit(port_restoreAllLatency);
+
+} // port_registerRestore
+
+#endif // __linux__
+
+
+
+/**
+  \fn static void port_setLowLatency(HANDLE fpCom, const char *port, PortContext_s *ctx)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] port       name of port
+  \param[in,out] ctx    context of port
+
+  Request low latency from tty driver (ASYNC_LOW_LATENCY) and lower the latency
+  timer of USB-serial adapters (e.g. FTDI, default 16ms) via sysfs. Both are
+  optional, i.e. failures (e.g. no permission) are ignored. Linux only.
+  Changes are reverted by close_port() or on program termination, see port_restoreAllLatency()
+*/
+static void port_setLowLatency(HANDLE fpCom, const char *port, PortContext_s *ctx) {
+
+  ctx->asyncLowLatency = false;
+  ctx->latency = 0;
+
+#if defined(__linux__)
+
+  struct serial_struct  serial;
+  char                  real[PATH_MAX];
+  const char            *name;
+  FILE                  *fp;
+
+  // revert changes also if program terminates without close_port(), e.g. via Error()
+  pthread_once(&s_latencyOnce, port_registerRestore);
+
+  // set low latency flag of tty driver
+  if ((ioctl(fpCom, TIOCGSERIAL, &serial) == 0) && (!(serial.flags & ASYNC_LOW_LATENCY))) {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(fpCom, TIOCSSERIAL, &serial) == 0)
+      ctx->asyncLowLatency = true;
+  }
+
+  // get tty name, also for links like /dev/serial/by-id/...
+  if (realpath(port, real) == NULL)
+    return;
+  name = strrchr(real, '/');
+  name = (name != NULL) ? name+1 : real;
+
+  // lower latency timer of USB-serial adapter, if supported and permitted. Remember old value for close_port()
+  snprintf(ctx->latencyFile, sizeof(ctx->latencyFile), "/sys/class/tty/%.60s/device/latency_timer", name);
+  fp = fopen(ctx->latencyFile, "r");
+  if (fp == NULL)
+    return;
+  if ((fscanf(fp, "%d", &(ctx->latency)) != 1) || (ctx->latency <= PORT_LATENCY)) {
+    fclose(fp);
+    ctx->latency = 0;
+    return;
+  }
+  fclose(fp);
+  fp = fopen(ctx->latencyFile, "w");
+  if ((fp == NULL) || (fprintf(fp, "%d", PORT_LATENCY) < 0) || (fclose(fp) != 0))
+    ctx->latency = 0;
+
+#else
+  (void) fpCom;
+  (void) port;
+#endif // __linux__
+
+} // port_setLowLatency
+
+
+/**
+  \fn static size_t ring_used(PortRing_s *ring)
+
+  \param[in] ring       ring buffer
+
+  \return number of bytes in ring buffer. Valid for producer and consumer
+*/
+static size_t ring_used(PortRing_s *ring) {
+
+  size_t tail = atomic_load_explicit(&(ring->tail), memory_order_acquire);
+  return(atomic_load_explicit(&(ring->head), memory_order_acquire) - tail);
+
+} // ring_used
+
+
+
+/**
+  \fn static size_t ring_put(PortRing_s *ring, const char *data, size_t len)
+
+  \param[in,out] ring   ring buffer
+  \param[in] data       data to add
+  \param[in] len        number of bytes to add
+
+  \return number of bytes added, limited by free space. Producer only
+*/
+static size_t ring_put(PortRing_s *ring, const char *data, size_t len) {
+
+  size_t head = atomic_load_explicit(&(ring->head), memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&(ring->tail), memory_order_acquire);
+  size_t num  = ring->size - (head - tail);
+
+  if (len < num)
+    num = len;
+  for (size_t i = 0; i < num; i++)
+    ring->buf[(head + i) & (ring->size - 1)] = data[i];
+  atomic_store_explicit(&(ring->head), head + num, memory_order_release);
+  return(num);
+
+} // ring_put
+
+
+
+/**
+  \fn static size_t ring_peek(PortRing_s *ring, char *data, size_t len)
+
+  \param[in] ring       ring buffer
+  \param[out] data      buffer for data
+  \param[in] len        size of buffer
+
+  \return number of bytes copied without removing them. Consumer only
+*/
+static size_t ring_peek(PortRing_s *ring, char *data, size_t len) {
+
+  size_t tail = atomic_load_explicit(&(ring->tail), memory_order_relaxed);
+  size_t num  = atomic_load_explicit(&(ring->head), memory_order_acquire) - tail;
+
+  if (len < num)
+    num = len;
+  for (size_t i = 0; i < num; i++)
+    data[i] = ring->buf[(tail + i) & (ring->size - 1)];
+  return(num);
+
+} // ring_peek
+
+
+
+/**
+  \fn static void ring_skip(PortRing_s *ring, size_t len)
+
+  \param[in,out] ring   ring buffer
+  \param[in] len        number of bytes to remove, max. ring_used(). Consumer only
+*/
+static void ring_skip(PortRing_s *ring, size_t len) {
+
+  atomic_fetch_add_explicit(&(ring->tail), len, memory_order_release);
+
+} // ring_skip
+
+
+
+/**
+  \fn static void port_signal(int fd)
+
+  \param[in] fd         write end of wake-up pipe
+
+  wake up thread waiting in poll() on the read end of a pipe. A full pipe is ok
+*/
+static void port_signal(int fd) {
+
+  char  c = 0;
+  if (write(fd, &c, 1) < 0) {
+    // ignore, pipe is full -> wake-up pending anyway
+  }
+
+} // port_signal
+
+
+
+/**
+  \fn static ssize_t port_writeFd(int fd, bool network, const char *data, size_t len)
+
+  \param[in] fd         port descriptor
+  \param[in] network    port is a socket (PORT_TCP or PORT_RFC2217)
+  \param[in] data       data to send
+  \param[in] len        number of bytes to send
+
+  \return number of bytes sent, or -1 on error (see write())
+
+  write to port descriptor. For sockets use send() with MSG_NOSIGNAL, i.e. a closed
+  connection is reported as EPIPE instead of terminating the process via SIGPIPE
+*/
+static ssize_t port_writeFd(int fd, bool network, const char *data, size_t len) {
+
+  if (network)
+    return(send(fd, data, len, MSG_NOSIGNAL));
+  return(write(fd, data, len));
+
+} // port_writeFd
+
+
+
+/**
+  \fn static void port_drainPipe(int fd)
+
+  \param[in] fd         read end of non-blocking wake-up pipe
+
+  remove pending wake-ups from pipe
+*/
+static void port_drainPipe(int fd) {
+
+  char  buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0)
+    ;
+
+} // port_drainPipe
+
+
+
+/**
+  \fn static void* port_ioThread(void *arg)
+
+  \param[in] arg        I/O state of port
+
+  \return NULL
+
+  I/O thread of port. Continuously drains the port into the receive ring and
+  transmits from the transmit ring. Sleeps in poll() on the port and a wake-up
+  pipe. Terminates on stop request or on a port error, which is reported via
+  PortIo_s.error
+*/
+static void* port_ioThread(void *arg) {
+
+  PortIo_s        *io = (PortIo_s*) arg;
+  char            buf[PORT_IO_CHUNK];
+  struct pollfd   pfd[2];
+  ssize_t         num;
+
+  while (!atomic_load(&(io->stop))) {
+
+    // wait for port or wake-up. If receive ring is full, let kernel buffer data and retry after 1ms
+    size_t rxFree = io->rx.size - ring_used(&(io->rx));
+    size_t txUsed = ring_used(&(io->tx));
+    pfd[0].fd      = io->fd;
+    pfd[0].events  = ((rxFree > 0) ? POLLIN : 0) | ((txUsed > 0) ? POLLOUT : 0);
+    pfd[0].revents = 0;
+    pfd[1].fd      = io->wake[0];
+    pfd[1].events  = POLLIN;
+    pfd[1].revents = 0;
+    if (poll(pfd, 2, (rxFree > 0) ? -1 : 1) < 0) {
+      if (errno == EINTR)
+        continue;
+      atomic_store(&(io->error), errno);
+      break;
+    }
+    if (pfd[1].revents & POLLIN)
+      port_drainPipe(io->wake[0]);
+
+    // receive into ring and wake up waiting protocol thread
+    if ((rxFree > 0) && (pfd[0].revents & (POLLIN | POLLERR | POLLHUP))) {
+      num = read(io->fd, buf, (rxFree < sizeof(buf)) ? rxFree : sizeof(buf));
+      if (num > 0)
+        ring_put(&(io->rx), buf, (size_t) num);
+      else if ((num == 0) || ((errno != EAGAIN) && (errno != EINTR))) {
+        atomic_store(&(io->error), (num == 0) ? EIO : errno);
+        port_signal(io->notify[1]);
+        break;
+      }
+      if (atomic_load(&(io->rxWaiting)))
+        port_signal(io->notify[1]);
+    }
+
+    // transmit from ring. Remove only sent bytes
+    if ((txUsed > 0) && (pfd[0].revents & POLLOUT)) {
+      num = port_writeFd(io->fd, io->network, buf, ring_peek(&(io->tx), buf, sizeof(buf)));
+      if (num > 0)
+        ring_skip(&(io->tx), (size_t) num);
+      else if ((num < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+        atomic_store(&(io->error), errno);
+        port_signal(io->notify[1]);
+        break;
+      }
+    }
+
+  } // while (!stop)
+
+  return(NULL);
+
+} // port_ioThread
+
+
+
+/**
+  \fn static void port_freeIo(PortIo_s *io)
+
+  \param[in] io         I/O state of port, thread not running
+
+  close pipes and release ring buffers and I/O state. Also for partly initialized state
+*/
+static void port_freeIo(PortIo_s *io) {
+
+  for (int i = 0; i < 2; i++) {
+    if (io->wake[i] >= 0)
+      close(io->wake[i]);
+    if (io->notify[i] >= 0)
+      close(io->notify[i]);
+  }
+  free(io->rx.buf);
+  free(io->tx.buf);
+  free(io);
+
+} // port_freeIo
+
+
+
+/**
+  \fn static const char* port_startIo(HANDLE fpCom, PortContext_s *ctx)
+
+  \param[in] fpCom      handle to comm port
+  \param[in,out] ctx    context of port
+
+  \return NULL on success, else error description. Resources are released on error
+
+  allocate ring buffers and start I/O thread of port
+*/
+static const char* port_startIo(HANDLE fpCom, PortContext_s *ctx) {
+
+  PortIo_s  *io;
+
+  // allocate I/O state and ring buffers
+  io = (PortIo_s*) calloc(1, sizeof(PortIo_s));
+  if (io == NULL)
+    return("cannot allocate I/O thread state");
+  io->fd      = fpCom;
+  io->wake[0] = io->wake[1] = io->notify[0] = io->notify[1] = -1;
+  io->network = (ctx->transport != PORT_SERIAL);
+  io->rx.size = PORT_IO_RX_SIZE;
+  io->tx.size = PORT_IO_TX_SIZE;
+  io->rx.buf  = (char*) malloc(PORT_IO_RX_SIZE);
+  io->tx.buf  = (char*) malloc(PORT_IO_TX_SIZE);
+  atomic_init(&(io->rx.head), 0);
+  atomic_init(&(io->rx.tail), 0);
+  atomic_init(&(io->tx.head), 0);
+  atomic_init(&(io->tx.tail), 0);
+  atomic_init(&(io->rxWaiting), false);
+  atomic_init(&(io->stop), false);
+  atomic_init(&(io->error), 0);
+  if ((io->rx.buf == NULL) || (io->tx.buf == NULL)) {
+    port_freeIo(io);
+    return("cannot allocate I/O ring buffers");
+  }
+
+  // non-blocking pipes to wake up I/O thread and waiting protocol thread
+  if ((pipe(io->wake) != 0) || (pipe(io->notify) != 0)) {
+    port_freeIo(io);
+    return("cannot create I/O pipes");
+  }
+  for (int i = 0; i < 2; i++) {
+    fcntl(io->wake[i], F_SETFL, O_NONBLOCK);
+    fcntl(io->notify[i], F_SETFL, O_NONBLOCK);
+  }
+
+  // start thread
+  if (pthread_create(&(io->thread), NULL, port_ioThread, io) != 0) {
+    port_freeIo(io);
+    return("cannot start I/O thread");
+  }
+  ctx->io = io;
+  return(NULL);
+
+} // port_startIo
+
+
+
+/**
+  \fn static void port_stopIo(PortContext_s *ctx)
+
+  \param[in,out] ctx    context of port
+
+  stop I/O thread of port and release ring buffers. Pending transmit data is sent first
+*/
+static void port_stopIo(PortContext_s *ctx) {
+
+  PortIo_s  *io = ctx->io;
+
+  if (io == NULL)
+    return;
+
+  // wait until transmit ring is empty (max. 1s), then stop thread
+  for (int i = 0; (i < 1000) && (ring_used(&(io->tx)) != 0) && (atomic_load(&(io->error)) == 0); i++)
+    SLEEP(1);
+  atomic_store(&(io->stop), true);
+  port_signal(io->wake[1]);
+  pthread_join(io->thread, NULL);
+
+  // release resources
+  port_freeIo(io);
+  ctx->io = NULL;
+
+} // port_stopIo
+
+
+
+/**
+  \fn static void port_drainTx(PortContext_s *ctx)
+
+  \param[in] ctx        context of port
+
+  wait until I/O thread has sent all queued data (max. 1s), e.g. before flushing or changing attributes
+*/
+static void port_drainTx(PortContext_s *ctx) {
+
+  if ((ctx == NULL) || (ctx->io == NULL))
+    return;
+  for (int i = 0; (i < 1000) && (ring_used(&(ctx->io->tx)) != 0) && (atomic_load(&(ctx->io->error)) == 0); i++)
+    SLEEP(1);
+
+} // port_drainTx
+
+
+
+// telnet codes (RFC 854, 856, 858) and COM port control (RFC 2217) for PORT_RFC2217
+#define TELNET_IAC            255     //< interpret as command
+#define TELNET_DONT           254     //< refuse option
+#define TELNET_DO             253     //< request option
+#define TELNET_WONT           252     //< refuse option
+#define TELNET_WILL           251     //< offer option
+#define TELNET_SB             250     //< start of subnegotiation
+#define TELNET_SE             240     //< end of subnegotiation
+#define TELNET_BINARY         0       //< option binary transmission
+#define TELNET_SGA            3       //< option suppress go-ahead
+#define TELNET_COMPORT        44      //< option COM port control
+#define COMPORT_SET_BAUDRATE  1       //< set baudrate (4 bytes, big endian)
+#define COMPORT_SET_DATASIZE  2       //< set number of data bits
+#define COMPORT_SET_PARITY    3       //< set parity: 1=none, 2=odd, 3=even
+#define COMPORT_SET_STOPSIZE  4       //< set stop bits: 1=1, 2=2, 3=1.5
+#define COMPORT_SET_CONTROL   5       //< set flow control or modem lines
+#define COMPORT_FLOW_NONE     1       //< no flow control
+#define COMPORT_DTR_ON        8       //< assert DTR
+#define COMPORT_DTR_OFF       9       //< release DTR
+#define COMPORT_RTS_ON        11      //< assert RTS
+#define COMPORT_RTS_OFF       12      //< release RTS
+
+/// telnet parser states for receive
+enum {TELNET_DATA=0, TELNET_CMD, TELNET_OPTION, TELNET_SUB, TELNET_SUB_IAC};
+
+
+
+/**
+  \fn static ssize_t port_telnetFilter(PortContext_s *ctx, char *data, ssize_t len)
+
+  \param[in,out] ctx    context of port with parser state
+  \param[in,out] data   received bytes, replaced by contained data bytes
+  \param[in] len        number of received bytes
+
+  \return number of data bytes
+
+  remove telnet commands and RFC 2217 notifications from received bytes and
+  un-escape IAC IAC. Option requests of the server are ignored
+*/
+static ssize_t port_telnetFilter(PortContext_s *ctx, char *data, ssize_t len) {
+
+  ssize_t   num = 0;
+
+  for (ssize_t i = 0; i < len; i++) {
+    uint8_t c = (uint8_t) data[i];
+    switch (ctx->telnetState) {
+      case TELNET_DATA:
+        if (c == TELNET_IAC)
+          ctx->telnetState = TELNET_CMD;
+        else
+          data[num++] = (char) c;
+        break;
+      case TELNET_CMD:
+        if (c == TELNET_IAC) {
+          data[num++] = (char) c;
+          ctx->telnetState = TELNET_DATA;
+        }
+        else if (c == TELNET_SB)
+          ctx->telnetState = TELNET_SUB;
+        else if ((c >= TELNET_WILL) && (c <= TELNET_DONT))
+          ctx->telnetState = TELNET_OPTION;
+        else
+          ctx->telnetState = TELNET_DATA;
+        break;
+      case TELNET_OPTION:
+        ctx->telnetState = TELNET_DATA;
+        break;
+      case TELNET_SUB:
+        if (c == TELNET_IAC)
+          ctx->telnetState = TELNET_SUB_IAC;
+        break;
+      case TELNET_SUB_IAC:
+        ctx->telnetState = (c == TELNET_SE) ? TELNET_DATA : TELNET_SUB;
+        break;
+    }
+  }
+
+  return(num);
+
+} // port_telnetFilter
+
+
+
+/**
+  \fn static ssize_t port_writeRaw(HANDLE fpCom, PortContext_s *ctx, const char *data, size_t len)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] ctx        context of port, or NULL
+  \param[in] data       data to send
+  \param[in] len        number of bytes to send
+
+  \return number of bytes sent or queued, or -1 on error
+
+  send data directly or via I/O thread. If nothing is queued, write directly for
+  lowest latency. This is safe, as the I/O thread only writes queued data. Queue
+  the rest and wake up the I/O thread
+*/
+static ssize_t port_writeRaw(HANDLE fpCom, PortContext_s *ctx, const char *data, size_t len) {
+
+  PortIo_s  *io;
+  size_t    done = 0;
+  ssize_t   num;
+
+  // no I/O thread
+  if (ctx == NULL)
+    return(write(fpCom, data, len));
+  if (ctx->io == NULL)
+    return(port_writeFd(fpCom, ctx->transport != PORT_SERIAL, data, len));
+  io = ctx->io;
+  if (atomic_load(&(io->error)) != 0) {
+    errno = atomic_load(&(io->error));
+    return(-1);
+  }
+
+  // direct write, if transmit ring is empty
+  if (ring_used(&(io->tx)) == 0) {
+    num = port_writeFd(fpCom, io->network, data, len);
+    if (num > 0)
+      done = (size_t) num;
+    else if ((num < 0) && (errno != EAGAIN) && (errno != EINTR))
+      return(-1);
+  }
+
+  // queue remaining data. If ring is full, wait for I/O thread
+  while ((done < len) && (atomic_load(&(io->error)) == 0)) {
+    num = (ssize_t) ring_put(&(io->tx), data + done, len - done);
+    done += (size_t) num;
+    port_signal(io->wake[1]);
+    if (num == 0)
+      SLEEP(1);
+  }
+
+  return((ssize_t) done);
+
+} // port_writeRaw
+
+
+
+/**
+  \fn static ssize_t port_writeAll(HANDLE fpCom, PortContext_s *ctx, const char *data, size_t len)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] ctx        context of port, or NULL
+  \param[in] data       data to send
+  \param[in] len        number of bytes to send
+
+  \return number of bytes sent, or -1 on error
+
+  send all data via port_writeRaw(), retry if port is busy. Used for network ports
+*/
+static ssize_t port_writeAll(HANDLE fpCom, PortContext_s *ctx, const char *data, size_t len) {
+
+  size_t    done = 0;
+  ssize_t   num;
+
+  while (done < len) {
+    num = port_writeRaw(fpCom, ctx, data + done, len - done);
+    if (num > 0)
+      done += (size_t) num;
+    else if ((num < 0) && (errno != EAGAIN) && (errno != EINTR))
+      return(-1);
+    else
+      SLEEP(1);
+  }
+
+  return((ssize_t) done);
+
+} // port_writeAll
+
+
+
+/**
+  \fn static ssize_t port_write(HANDLE fpCom, PortContext_s *ctx, const char *data, size_t len)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] ctx        context of port, or NULL
+  \param[in] data       data to send
+  \param[in] len        number of bytes to send
+
+  \return number of bytes sent or queued, or -1 on error
+
+  send data via port_writeRaw(). For RFC 2217 escape IAC bytes and send all data
+*/
+static ssize_t port_write(HANDLE fpCom, PortContext_s *ctx, const char *data, size_t len) {
+
+  char    buf[512];
+  size_t  i = 0, num;
+
+  // serial port or raw TCP
+  if ((ctx == NULL) || (ctx->transport != PORT_RFC2217))
+    return(port_writeRaw(fpCom, ctx, data, len));
+
+  // RFC 2217: double IAC bytes
+  while (i < len) {
+    for (num = 0; (i < len) && (num < sizeof(buf)-1); i++) {
+      buf[num++] = data[i];
+      if ((uint8_t) data[i] == TELNET_IAC)
+        buf[num++] = data[i];
+    }
+    if (port_writeAll(fpCom, ctx, buf, num) != (ssize_t) num)
+      return(-1);
+  }
+
+  return((ssize_t) len);
+
+} // port_write
+
+
+
+/**
+  \fn static ssize_t port_read(HANDLE fpCom, PortContext_s *ctx, char *data, size_t len)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] ctx        context of port, or NULL
+  \param[out] data      buffer for received data
+  \param[in] len        size of buffer
+
+  \return number of bytes read, or -1 with errno=EAGAIN if no data is available
+
+  non-blocking read from port or from receive ring of I/O thread. For RFC 2217 remove
+  telnet commands. If only commands were received, return -1 with errno=EAGAIN
+*/
+static ssize_t port_read(HANDLE fpCom, PortContext_s *ctx, char *data, size_t len) {
+
+  PortIo_s  *io;
+  ssize_t   num;
+
+  // no I/O thread
+  if ((ctx == NULL) || (ctx->io == NULL))
+    num = read(fpCom, data, len);
+
+  // get data from receive ring
+  else {
+    io  = ctx->io;
+    num = (ssize_t) ring_peek(&(io->rx), data, len);
+    if (num > 0)
+      ring_skip(&(io->rx), (size_t) num);
+    else {
+      errno = (atomic_load(&(io->error)) != 0) ? atomic_load(&(io->error)) : EAGAIN;
+      return(-1);
+    }
+  }
+
+  // RFC 2217: remove telnet commands
+  if ((num > 0) && (ctx != NULL) && (ctx->transport == PORT_RFC2217)) {
+    num = port_telnetFilter(ctx, data, num);
+    if (num == 0) {
+      errno = EAGAIN;
+      return(-1);
+    }
+  }
+
+  return(num);
+
+} // port_read
+
+
+
+/**
+  \fn static int port_poll(HANDLE fpCom, PortContext_s *ctx, int timeout)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] ctx        context of port, or NULL
+  \param[in] timeout    max. wait time [ms]
+
+  \return 1 if data is available (or I/O thread failed), 0 on timeout, -1 on error (see poll())
+
+  wait until data is available from port or in receive ring of I/O thread
+*/
+static int port_poll(HANDLE fpCom, PortContext_s *ctx, int timeout) {
+
+  struct pollfd   pfd;
+  PortIo_s        *io;
+  uint64_t        deadline, now;
+
+  // no I/O thread -> wait for port
+  if ((ctx == NULL) || (ctx->io == NULL)) {
+    pfd.fd      = fpCom;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    return(poll(&pfd, 1, timeout));
+  }
+  io = ctx->io;
+
+  // wait for notification from I/O thread. Re-check after setting flag to avoid lost wake-up
+  deadline = micros() + (uint64_t) timeout * 1000LL;
+  while ((ring_used(&(io->rx)) == 0) && (atomic_load(&(io->error)) == 0)) {
+    atomic_store(&(io->rxWaiting), true);
+    if ((ring_used(&(io->rx)) == 0) && (atomic_load(&(io->error)) == 0)) {
+      now = micros();
+      if (now >= deadline) {
+        atomic_store(&(io->rxWaiting), false);
+        return(0);
+      }
+      pfd.fd      = io->notify[0];
+      pfd.events  = POLLIN;
+      pfd.revents = 0;
+      if (poll(&pfd, 1, (int) ((deadline - now + 999LL) / 1000LL)) > 0)
+        port_drainPipe(io->notify[0]);
+    }
+    atomic_store(&(io->rxWaiting), false);
+  }
+
+  return(1);
+
+} // port_poll
+
+
+
+/**
+  \fn static HANDLE port_openTcp(const char *port, uint8_t *transport)
+
+  \param[in]  port       'tcp://host:port' or 'rfc2217://host:port'. IPv6 host in brackets
+  \param[out] transport  PORT_TCP or PORT_RFC2217
+
+  \return non-blocking socket
+
+  connect to network serial server, e.g. ser2net. Disable Nagle algorithm, as
+  the BSL protocol exchanges small frames and waits for each response
+*/
+static HANDLE port_openTcp(const char *port, uint8_t *transport) {
+
+  char              host[256], service[32];
+  const char        *addr, *end, *sep;
+  struct addrinfo   hints, *res, *ai;
+  struct pollfd     pfd;
+  int               fd = -1, flag = 1, err;
+  socklen_t         len;
+
+  // split name into host and port
+  *transport = (!strncmp(port, "tcp://", 6)) ? PORT_TCP : PORT_RFC2217;
+  addr = strstr(port, "://") + 3;
+  if (addr[0] == '[') {
+    addr++;
+    end = strchr(addr, ']');
+    sep = (end != NULL) ? end+1 : NULL;
+  }
+  else {
+    end = sep = strrchr(addr, ':');
+  }
+  if ((sep == NULL) || (*sep != ':') || (end - addr >= (int) sizeof(host)))
+    Error("in 'init_port(%s)': expect host:port", port);
+  snprintf(host, sizeof(host), "%.*s", (int) (end - addr), addr);
+  snprintf(service, sizeof(service), "%s", sep+1);
+
+  // resolve host
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, service, &hints, &res) != 0)
+    Error("in 'init_port(%s)': cannot resolve host '%s'", port, host);
+
+  // connect to first reachable address with timeout
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    if (errno == EINPROGRESS) {
+      pfd.fd      = fd;
+      pfd.events  = POLLOUT;
+      pfd.revents = 0;
+      len = sizeof(err);
+      if ((poll(&pfd, 1, PORT_TCP_CONNECT) == 1) && (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0) && (err == 0))
+        break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0)
+    Error("in 'init_port(%s)': connect failed", port);
+
+  // send small frames immediately. Report closed connection via EPIPE instead of SIGPIPE, see port_writeFd()
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  #if defined(SO_NOSIGPIPE)
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &flag, sizeof(flag));
+  #endif
+
+  return(fd);
+
+} // port_openTcp
+
+
+
+/**
+  \fn static void port_comPortOption(HANDLE fpCom, PortContext_s *ctx, uint8_t cmd, uint32_t value, int len)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] ctx        context of port
+  \param[in] cmd        COM port command, e.g. COMPORT_SET_BAUDRATE
+  \param[in] value      parameter
+  \param[in] len        size of parameter [B] (1 or 4), big endian
+
+  send RFC 2217 command to network serial server. Responses are removed by port_telnetFilter()
+*/
+static void port_comPortOption(HANDLE fpCom, PortContext_s *ctx, uint8_t cmd, uint32_t value, int len) {
+
+  char  buf[20];
+  int   num = 0;
+
+  buf[num++] = (char) TELNET_IAC;
+  buf[num++] = (char) TELNET_SB;
+  buf[num++] = (char) TELNET_COMPORT;
+  buf[num++] = (char) cmd;
+  for (int i = len-1; i >= 0; i--) {
+    buf[num++] = (char) ((value >> (8*i)) & 0xFF);
+    if ((uint8_t) buf[num-1] == TELNET_IAC)
+      buf[num++] = (char) TELNET_IAC;
+  }
+  buf[num++] = (char) TELNET_IAC;
+  buf[num++] = (char) TELNET_SE;
+  if (port_writeAll(fpCom, ctx, buf, num) != num)
+    Error("in 'port_comPortOption()': send to server failed");
+
+} // port_comPortOption
+
+
+
+/**
+  \fn static void port_setComPort(HANDLE fpCom, PortContext_s *ctx, uint32_t baudrate, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR)
+
+  \param[in] fpCom      handle to comm port
+  \param[in] ctx        context of port with previous settings
+  \param[in] baudrate   comm port speed in Baud
+  \param[in] numBits    number of data bits per byte (7 or 8)
+  \param[in] parity     parity (0=none, 1=odd, 2=even)
+  \param[in] numStop    number of stop bits (1=1; 2=2; other=1.5)
+  \param[in] RTS        static RTS status
+  \param[in] DTR        static DTR status
+
+  send changed port settings to RFC 2217 server. On first call negotiate options and send all settings
+*/
+static void port_setComPort(HANDLE fpCom, PortContext_s *ctx, uint32_t baudrate, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR) {
+
+  const char  negotiate[] = {(char) TELNET_IAC, (char) TELNET_WILL, TELNET_COMPORT, (char) TELNET_IAC, (char) TELNET_WILL, TELNET_BINARY,
+                             (char) TELNET_IAC, (char) TELNET_DO, TELNET_BINARY, (char) TELNET_IAC, (char) TELNET_WILL, TELNET_SGA,
+                             (char) TELNET_IAC, (char) TELNET_DO, TELNET_SGA};
+  bool        all = !(ctx->valid);
+
+  // after connect offer COM port control and request 8-bit transparent channel
+  if (all) {
+    if (port_writeAll(fpCom, ctx, negotiate, sizeof(negotiate)) != sizeof(negotiate))
+      Error("in 'port_setComPort()': send to server failed");
+    port_comPortOption(fpCom, ctx, COMPORT_SET_CONTROL, COMPORT_FLOW_NONE, 1);
+  }
+
+  // send changed settings
+  if (all || (ctx->baudrate != baudrate))
+    port_comPortOption(fpCom, ctx, COMPORT_SET_BAUDRATE, baudrate, 4);
+  if (all || (ctx->numBits != numBits))
+    port_comPortOption(fpCom, ctx, COMPORT_SET_DATASIZE, numBits, 1);
+  if (all || (ctx->parity != parity))
+    port_comPortOption(fpCom, ctx, COMPORT_SET_PARITY, (parity == 1) ? 2 : ((parity == 2) ? 3 : 1), 1);
+  if (all || (ctx->numStop != numStop))
+    port_comPortOption(fpCom, ctx, COMPORT_SET_STOPSIZE, ((numStop == 1) || (numStop == 2)) ? numStop : 3, 1);
+  if (all || (ctx->RTS != RTS))
+    port_comPortOption(fpCom, ctx, COMPORT_SET_CONTROL, (RTS == 1) ? COMPORT_RTS_ON : COMPORT_RTS_OFF, 1);
+  if (all || (ctx->DTR != DTR))
+    port_comPortOption(fpCom, ctx, COMPORT_SET_CONTROL, (DTR == 1) ? COMPORT_DTR_ON : COMPORT_DTR_OFF, 1);
+
+} // port_setComPort
+
+
+
+/**
+  \fn static void port_consumeEcho(HANDLE fpCom, PortContext_s *ctx)
+
+  \param[in] fpCom      handle to comm port
+  \param[in,out] ctx    context of port
+
+  Read and check pending 1-wire echo without waiting for a response, e.g. before flushing the port
+*/
+static void port_consumeEcho(HANDLE fpCom, PortContext_s *ctx) {
+
+  char  dummy;
+
+  if ((ctx != NULL) && (ctx->numEcho != 0))
+    receive_port(fpCom, 0, 0, &dummy);
+
+} // port_consumeEcho
+
+
+
+/**
+  \fn static uint32_t port_receiveReply(HANDLE fpCom, PortContext_s *ctx, uint32_t lenRx, char *Rx, uint32_t timeout)
+
+  \param[in]  fpCom      handle to comm port
+  \param[in,out] ctx     context of port for statistics, or NULL
+  \param[in]  lenRx      number of bytes to receive
+  \param[out] Rx         array containing bytes received
+  \param[in]  timeout    timeout between chars in ms
+
+  \return number of received bytes
+
+  receive data in UART reply mode (2-wire). The STM8 only sends the next byte after
+  the host has echoed the previous one, i.e. the transfer is limited by the round
+  trip per byte. Therefore minimize syscalls per byte: one poll() with ms deadline
+  on monotonic clock, one read() of all available bytes and one write() echoing
+  them, instead of send_port(). Port stays non-blocking, i.e. no termios or fcntl() calls
+*/
+static uint32_t port_receiveReply(HANDLE fpCom, PortContext_s *ctx, uint32_t lenRx, char *Rx, uint32_t timeout) {
+
+  uint32_t        received = 0;
+  uint64_t        tStart, now, deadline;
+  ssize_t         got, sent;
+  bool            failed = false;
+
+  tStart   = micros();
+  deadline = tStart + (uint64_t) timeout * 1000LL;
+  while (received < lenRx) {
+
+    // wait for next byte until deadline. Next byte is only sent after echo -> no read() before poll()
+    now = micros();
+    if (now >= deadline)
+      break;
+    int result = port_poll(fpCom, ctx, (int) ((deadline - now + 999LL) / 1000LL));
+    if ((result < 0) && (errno == EINTR))
+      continue;
+    if (result != 1)
+      break;
+
+    // read available bytes (normally 1). No data after successful poll() -> port closed
+    got = port_read(fpCom, ctx, Rx + received, lenRx - received);
+    if ((got < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+      continue;
+    if (got <= 0)
+      break;
+
+    // echo received bytes, which triggers next byte from STM8
+    for (ssize_t done = 0; (done < got) && (!failed); ) {
+      sent = port_write(fpCom, ctx, Rx + received + done, got - done);
+      if (sent > 0)
+        done += sent;
+      else if ((sent < 0) && (errno != EAGAIN) && (errno != EINTR))
+        failed = true;
+    }
+    if (failed)
+      break;
+    received += got;
+    deadline = micros() + (uint64_t) timeout * 1000LL;
+
+  } // while (received < lenRx)
+
+  // echo failed
+  if (failed)
+    Error("in 'receive_port()': send reply failed");
+
+  // update statistics for get_reply_stats()
+  if (ctx != NULL) {
+    ctx->replyBytes += received;
+    ctx->replyTime  += micros() - tStart;
+  }
+
+  return(received);
+
+} // port_receiveReply
+
+#endif // __APPLE__ || __unix__
 
 
 
@@ -139,6 +1324,8 @@ void list_ports(void) {
   \return           handle to comm port
 
   open comm port for communication, set properties (baudrate, timeout,...).
+  Under Posix also connect to network serial server via 'tcp://host:port' (raw)
+  or 'rfc2217://host:port' (with remote baudrate and DTR/RTS control)
 */
 HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR) {
 
@@ -150,6 +1337,10 @@ HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t
   char          port_tmp[100];
   HANDLE        fpCom = NULL;
 
+  // network ports are only supported under Posix
+  if ((!strncmp(port, "tcp://", 6)) || (!strncmp(port, "rfc2217://", 10)))
+    Error("in 'init_port(%s)': network ports not supported under Windows", port);
+
   // required to allow COM ports >COM9
   sprintf(port_tmp,"\\\\.\\%s", port);
 
@@ -177,17 +1368,56 @@ HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t
 #if defined(__APPLE__) || defined(__unix__)
 
   HANDLE          fpCom;
+  PortContext_s   *ctx;
+  uint8_t         transport = PORT_SERIAL;
 
-  // open port
-  fpCom = open(port, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
+  // connect to network serial server or open local port
+  if ((!strncmp(port, "tcp://", 6)) || (!strncmp(port, "rfc2217://", 10)))
+    fpCom = port_openTcp(port, &transport);
+  else
+    fpCom = open(port, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
   if (fpCom == -1)
     Error("in 'init_port(%s)': open port failed", port);
 
+  // reset context of descriptor and optionally reduce USB latency
+  ctx = port_context(fpCom);
+  if (ctx != NULL) {
+    ctx->valid = false;
+    ctx->asyncLowLatency = false;
+    ctx->latency = 0;
+    ctx->numEcho = 0;
+    ctx->replyBytes = 0;
+    ctx->replyTime = 0;
+    ctx->io = NULL;
+    ctx->transport = transport;
+    ctx->telnetState = TELNET_DATA;
+    if ((g_lowLatency) && (transport == PORT_SERIAL))
+      port_setLowLatency(fpCom, port, ctx);
+  }
+
+  // network ports require context for telnet state and port settings
+  else if (transport != PORT_SERIAL) {
+    close(fpCom);
+    Error("in 'init_port(%s)': too many open ports", port);
+  }
+
 #endif // __APPLE__ || __unix__
 
   // set port attributes
   set_port_attribute(fpCom, baudrate, timeout, numBits, parity, numStop, RTS, DTR);
 
+  // optionally start I/O thread with ring buffers (Posix only)
+#if defined(__APPLE__) || defined(__unix__)
+  if ((g_ioThread) && (ctx != NULL)) {
+    const char *msg = port_startIo(fpCom, ctx);
+    if (msg != NULL) {
+      port_restoreLatency(fpCom, ctx);
+      close(fpCom);
+      Error("in 'init_port(%s)': %s", port, msg);
+    }
+  }
+#endif // __APPLE__ || __unix__
+
   // return comm port handle
   return fpCom;
 
@@ -226,8 +1456,18 @@ void close_port(HANDLE *fpCom) {
 /////////
 #if defined(__APPLE__) || defined(__unix__)
 
-  // if open, close port
+  // if open, restore latency settings and close port
   if (*fpCom != 0) {
+    PortContext_s *ctx = port_context(*fpCom);
+    if (ctx != NULL) {
+      port_stopIo(ctx);
+      port_restoreLatency(*fpCom, ctx);
+      ctx->valid = false;
+      ctx->numEcho = 0;
+      ctx->replyBytes = 0;
+      ctx->replyTime = 0;
+      ctx->transport = PORT_SERIAL;
+    }
     if (close(*fpCom) != 0)
       Error("in 'close_port': close port failed");
   }
@@ -273,6 +1513,17 @@ void pulse_DTR(HANDLE fpCom, uint32_t duration) {
 
   int status;
 
+  // network port: set DTR via RFC 2217
+  PortContext_s *ctx = port_context(fpCom);
+  if ((ctx != NULL) && (ctx->transport != PORT_SERIAL)) {
+    if (ctx->transport != PORT_RFC2217)
+      Error("in 'pulse_DTR()': raw TCP port has no DTR control, use 'rfc2217://'");
+    port_comPortOption(fpCom, ctx, COMPORT_SET_CONTROL, COMPORT_DTR_ON, 1);
+    SLEEP(duration);
+    port_comPortOption(fpCom, ctx, COMPORT_SET_CONTROL, COMPORT_DTR_OFF, 1);
+    return;
+  }
+
   ioctl(fpCom, TIOCMGET, &status);
 
   // set DTR
@@ -328,6 +1579,17 @@ void pulse_RTS(HANDLE fpCom, uint32_t duration)
 
     int status;
 
+    // network port: set RTS via RFC 2217
+    PortContext_s *ctx = port_context(fpCom);
+    if ((ctx != NULL) && (ctx->transport != PORT_SERIAL)) {
+        if (ctx->transport != PORT_RFC2217)
+            Error("in 'pulse_RTS()': raw TCP port has no RTS control, use 'rfc2217://'");
+        port_comPortOption(fpCom, ctx, COMPORT_SET_CONTROL, COMPORT_RTS_ON, 1);
+        SLEEP(duration);
+        port_comPortOption(fpCom, ctx, COMPORT_SET_CONTROL, COMPORT_RTS_OFF, 1);
+        return;
+    }
+
     ioctl(fpCom, TIOCMGET, &status);
 
     // set RTS
@@ -441,6 +1703,19 @@ void get_port_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uin
 
   struct termios  toptions;
   int             status;
+  PortContext_s   *ctx = port_context(fpCom);
+
+  // use cached attributes, if available
+  if ((ctx != NULL) && (ctx->valid)) {
+    *baudrate = ctx->baudrate;
+    *timeout  = ctx->timeout;
+    *numBits  = ctx->numBits;
+    *parity   = ctx->parity;
+    *numStop  = ctx->numStop;
+    *RTS      = ctx->RTS;
+    *DTR      = ctx->DTR;
+    return;
+  }
 
   // get attributes
   if (tcgetattr(fpCom, &toptions) < 0)
@@ -479,6 +1754,13 @@ void get_port_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uin
     default: *baudrate = UINT32_MAX;
   } // switch (brate)
 
+  // arbitrary baudrate set via termios2
+  #if defined(USE_TERMIOS2)
+    struct termios2 toptions2;
+    if ((ioctl(fpCom, TCGETS2, &toptions2) == 0) && ((toptions2.c_cflag & CBAUD) == BOTHER))
+      *baudrate = toptions2.c_ospeed;
+  #endif // USE_TERMIOS2
+
 
   // get timeout (see: http://unixwiz.net/techtips/termios-vmin-vtime.html)
   *timeout = toptions.c_cc[VTIME] * 100;   // convert 0.1s to ms
@@ -607,7 +1889,31 @@ void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8
 
   struct termios  toptions;
   int             status;
-
+  PortContext_s   *ctx = port_context(fpCom);
+
+  // skip if attributes are unchanged, e.g. repeated set_timeout() in bsl_sync()
+  if ((ctx != NULL) && (ctx->valid) && (ctx->baudrate == baudrate) && (ctx->timeout == timeout) && (ctx->numBits == numBits) &&
+    (ctx->parity == parity) && (ctx->numStop == numStop) && (ctx->RTS == RTS) && (ctx->DTR == DTR))
+    return;
+
+  // pending 1-wire echo was sent with old attributes, and queued data is sent with old attributes
+  port_consumeEcho(fpCom, ctx);
+  port_drainTx(ctx);
+
+  // network port has no termios. Send changed settings to RFC 2217 server. Raw TCP server uses fixed settings
+  if ((ctx != NULL) && (ctx->transport != PORT_SERIAL)) {
+    if (ctx->transport == PORT_RFC2217)
+      port_setComPort(fpCom, ctx, baudrate, numBits, parity, numStop, RTS, DTR);
+    ctx->baudrate = baudrate;
+    ctx->timeout  = timeout;
+    ctx->numBits  = numBits;
+    ctx->parity   = parity;
+    ctx->numStop  = numStop;
+    ctx->RTS      = RTS;
+    ctx->DTR      = DTR;
+    ctx->valid    = true;
+    return;
+  }
 
   // get attributes
   if (tcgetattr(fpCom, &toptions) < 0)
@@ -644,7 +1950,11 @@ void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8
     case 230400: brate=B230400; break;
 #endif
     default:
-      Error("in 'set_port_attribute()': unsupported baudrate %d Baud", (int) baudrate);
+      #if defined(USE_TERMIOS2)
+        brate = B38400;               // placeholder, is replaced via termios2 below
+      #else
+        Error("in 'set_port_attribute()': unsupported baudrate %d Baud", (int) baudrate);
+      #endif
   }
   cfmakeraw(&toptions);
   cfsetispeed(&toptions, brate);    // receive
@@ -688,14 +1998,21 @@ void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8
   toptions.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG); // make raw
   toptions.c_oflag &= ~OPOST; // make raw
 
-  // set timeout (see: http://unixwiz.net/techtips/termios-vmin-vtime.html)
-  toptions.c_cc[VMIN]  = 255;
+  // set timeout (see: http://unixwiz.net/techtips/termios-vmin-vtime.html). Port is non-blocking and receive_port() polls
+  // with timeout from port context. VMIN=0, else poll() waits for VMIN bytes if VTIME=0
+  toptions.c_cc[VMIN]  = 0;
   toptions.c_cc[VTIME] = timeout/100;   // convert ms to 0.1s
 
   // set term properties
   if (tcsetattr(fpCom, TCSANOW, &toptions) < 0)
     Error("in 'set_port_attribute()': set port attributes failed");
 
+  // non-standard baudrate, e.g. 1MBaud or matched to STM8 clock
+  #if defined(USE_TERMIOS2)
+    if ((brate == B38400) && (baudrate != 38400))
+      port_setBaudrate2(fpCom, baudrate);
+  #endif // USE_TERMIOS2
+
 
   // set static RTS and DTR status (required for some multimeter optocouplers)
   ioctl(fpCom, TIOCMGET, &status);
@@ -710,6 +2027,18 @@ void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8
   if (ioctl(fpCom, TIOCMSET, &status))
     Error("in 'set_port_attribute()': cannot set RTS status");
 
+  // cache attributes for get_port_attribute() and receive_port()
+  if (ctx != NULL) {
+    ctx->baudrate = baudrate;
+    ctx->timeout  = timeout;
+    ctx->numBits  = numBits;
+    ctx->parity   = parity;
+    ctx->numStop  = numStop;
+    ctx->RTS      = RTS;
+    ctx->DTR      = DTR;
+    ctx->valid    = true;
+  }
+
 #endif // __APPLE__ || __unix__
 
 
@@ -749,13 +2078,22 @@ void set_baudrate(HANDLE fpCom, uint32_t Baudrate) {
   \param[in] fpCom      handle to comm port
   \param[in] Timeout    new timeout in ms
 
-  set new timeout for an already open comm port
+  set new timeout for an already open comm port. Under Posix timeout has 1ms resolution
 */
 void set_timeout(HANDLE fpCom, uint32_t Timeout) {
 
   uint32_t   baudrate, timeout;
   uint8_t    numBits, parity, numStop, RTS, DTR;
 
+  // Posix: receive_port() uses timeout from port context, VTIME has no effect on non-blocking port -> no termios call
+#if defined(__APPLE__) || defined(__unix__)
+  PortContext_s *ctx = port_context(fpCom);
+  if ((ctx != NULL) && (ctx->valid)) {
+    ctx->timeout = Timeout;
+    return;
+  }
+#endif // __APPLE__ || __unix__
+
   // read port setting
   get_port_attribute(fpCom, &baudrate, &timeout, &numBits, &parity, &numStop, &RTS, &DTR);
 
@@ -807,7 +2145,8 @@ void set_parity(HANDLE fpCom, uint8_t Parity) {
 
   send data via comm port. Use this function to facilitate serial communication
   on different platforms, e.g. Windows and Posix.
-  If uartMode==1 (1-wire interface), read back LIN echo
+  If uartMode==1 (1-wire interface), read back LIN echo. Under Posix the echo is
+  only recorded and read together with the next response in receive_port()
 */
 uint32_t send_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenTx, char *Tx) {
 
@@ -835,10 +2174,20 @@ uint32_t send_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenTx, char *Tx) {
 /////////
 #if defined(__APPLE__) || defined(__unix__)
 
-  uint32_t  numChars;
+  uint32_t      numChars;
+  PortContext_s *ctx = port_context(fpCom);
 
-  // send data & return number of sent bytes
-  numChars = write(fpCom, Tx, lenTx);
+  // send data (directly or via I/O thread) & return number of sent bytes
+  numChars = port_write(fpCom, ctx, Tx, lenTx);
+
+  // for 1-wire UART interface record LIN echo. Is read and checked with next response in receive_port()
+  if ((uartMode == 1) && (ctx != NULL) && (numChars <= PORT_ECHO_MAX)) {
+    if (ctx->numEcho + numChars > PORT_ECHO_MAX)
+      port_consumeEcho(fpCom, ctx);
+    memcpy(ctx->echo + ctx->numEcho, Tx, numChars);
+    ctx->numEcho += numChars;
+    return(numChars);
+  }
 
 #endif // __APPLE__ || __unix__
 
@@ -871,6 +2220,7 @@ uint32_t send_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenTx, char *Tx) {
   receive data via comm port. Use this function to facilitate serial communication
   on different platforms, e.g. Windows and Posix
   If uartMode==2 (UART reply mode with 2-wire interface), reply each byte from STM8 -> SLOW
+  Under Posix first read and check pending 1-wire echo of send_port(), in the same read() as the response
 */
 uint32_t receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx) {
 
@@ -886,13 +2236,13 @@ uint32_t receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx)
   // for UART reply mode with 2-wire interface echo each received bytes -> SLOW
   if (uartMode==2) {
 
-    // echo each byte as it is received
+    // echo each byte as it is received. Use WriteFile() directly, as send_port() purges the buffers
     numChars = 0;
     for (i=0; i<lenRx; i++) {
       ReadFile(fpCom, Rx+i, 1, &numTmp, NULL);
       if (numTmp == 1) {
         numChars++;
-        send_port(fpCom, uartMode, 1, Rx+i);
+        WriteFile(fpCom, Rx+i, 1, &numTmp, NULL);
       }
       else
         break;
@@ -918,42 +2268,78 @@ uint32_t receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx)
 #if defined(__APPLE__) || defined(__unix__)
 
   char            *dest = Rx;
-  uint32_t        remaining = lenRx, got = 0, received = 0;
-  struct          timeval tv;
-  fd_set          fdr;
+  uint32_t        remaining = lenRx, received = 0;
+  ssize_t         got;
+  char            buf[PORT_ECHO_MAX];
+  uint32_t        numEcho = 0, echoDone = 0;
   struct termios  toptions;
   uint32_t        timeout;
+  uint64_t        deadline, now;
+  PortContext_s   *ctx = port_context(fpCom);
 
-  // get terminal attributes
-  if (tcgetattr(fpCom, &toptions) < 0)
-    Error("in 'receive_port': get port attributes failed");
+  // get timeout from port context -> no syscall
+  if ((ctx != NULL) && (ctx->valid))
+    timeout = ctx->timeout;
 
   // get terminal timeout (see: http://unixwiz.net/techtips/termios-vmin-vtime.html)
-  timeout = toptions.c_cc[VTIME] * 100;        // convert 0.1s to ms
+  else {
+    if (tcgetattr(fpCom, &toptions) < 0)
+      Error("in 'receive_port': get port attributes failed");
+    timeout = toptions.c_cc[VTIME] * 100;        // convert 0.1s to ms
+  }
 
-  // while there are bytes left to read...
-  while (remaining != 0) {
+  // UART reply mode with 2-wire interface -> dedicated loop
+  if ((uartMode == 2) && ((ctx == NULL) || (ctx->numEcho == 0)))
+    return(port_receiveReply(fpCom, ctx, lenRx, Rx, timeout));
+
+  // pending 1-wire echo of send_port()
+  if (ctx != NULL) {
+    numEcho = ctx->numEcho;
+    ctx->numEcho = 0;
+  }
 
-    // reinit timeval structure each time through loop
-    tv.tv_sec  = (timeout / 1000L);
-    tv.tv_usec = (timeout % 1000L) * 1000L;
+  // deadline for next byte on monotonic clock [us]
+  deadline = micros() + (uint64_t) timeout * 1000LL;
 
-    // wait for data to come in using select
-    FD_ZERO(&fdr);
-    FD_SET(fpCom, &fdr);
-    if (select(fpCom + 1, &fdr, NULL, NULL, &tv) != 1) {
-      return(received);
+  // while there are bytes left to read...
+  while ((remaining != 0) || (echoDone < numEcho)) {
+
+    // wait for data until deadline. Round up to full ms for poll()
+    now = micros();
+    if (now >= deadline)
+      break;
+    int result = port_poll(fpCom, ctx, (int) ((deadline - now + 999LL) / 1000LL));
+    if ((result < 0) && (errno == EINTR))
+      continue;
+    if (result != 1)
+      break;
+
+    // read rest of echo together with response. Check echo and copy response
+    if (echoDone < numEcho) {
+      uint32_t  lenBuf = numEcho - echoDone + remaining;
+      got = port_read(fpCom, ctx, buf, (lenBuf < PORT_ECHO_MAX) ? lenBuf : PORT_ECHO_MAX);
+      if (got > 0) {
+        uint32_t numCheck = ((uint32_t) got < numEcho - echoDone) ? (uint32_t) got : numEcho - echoDone;
+        if (memcmp(buf, ctx->echo + echoDone, numCheck) != 0)
+          Error("in 'receive_port()': 1-wire echo mismatch");
+        echoDone += numCheck;
+        got -= numCheck;
+        memcpy(dest, buf + numCheck, got);
+        if (got == 0)
+          deadline = micros() + (uint64_t) timeout * 1000LL;
+      }
     }
 
     // read a response, we know there's data waiting
-    got = read(fpCom, dest, remaining);
+    else
+      got = port_read(fpCom, ctx, dest, remaining);
 
     // handle errors. retry on EAGAIN, fail on anything else, ignore if no bytes read
     if (got == -1) {
       if (errno == EAGAIN)
         continue;
       else
-        return(received);
+        break;
     }
     else if (got > 0) {
 
@@ -968,10 +2354,17 @@ uint32_t receive_port(HANDLE fpCom, uint8_t uartMode, uint32_t lenRx, char *Rx)
       remaining -= got;
       received += got;
 
+      // timeout is between chars -> restart deadline
+      deadline = micros() + (uint64_t) timeout * 1000LL;
+
     } // received bytes
 
   } // while (remaining != 0)
 
+  // check 1-wire echo
+  if (echoDone < numEcho)
+    Error("in 'receive_port()': read 1-wire echo failed");
+
   // return number of received bytes
   return(received);
 
@@ -1007,9 +2400,23 @@ void flush_port(HANDLE fpCom) {
 /////////
 #if defined(__APPLE__) || defined(__unix__)
 
+  // pending 1-wire echo was sent before flush, and queued data is sent before flush
+  PortContext_s *ctx = port_context(fpCom);
+  port_consumeEcho(fpCom, ctx);
+  port_drainTx(ctx);
+
   // required for some reason (https://stackoverflow.com/questions/13013387/clearing-the-serial-ports-buffer)
   SLEEP(5);
 
+  // network port has no kernel buffer flush -> read and discard received data
+  if ((ctx != NULL) && (ctx->transport != PORT_SERIAL)) {
+    char  buf[256];
+    SLEEP(50);
+    while (port_read(fpCom, ctx, buf, sizeof(buf)) > 0)
+      ;
+    return;
+  }
+
   // purge all port buffers (see http://linux.die.net/man/3/tcflush)
   //tcflush(fpCom, TCIOFLUSH);
 
@@ -1019,6 +2426,10 @@ void flush_port(HANDLE fpCom) {
   //options.c_cflag |= (CLOCAL | CREAD);
   tcsetattr(fpCom, TCSAFLUSH, &options);
 
+  // also discard data already moved to receive ring by I/O thread
+  if ((ctx != NULL) && (ctx->io != NULL))
+    ring_skip(&(ctx->io->rx), ring_used(&(ctx->io->rx)));
+
   SLEEP(50);              // seems to be required for some reason
 
 
@@ -1026,4 +2437,99 @@ void flush_port(HANDLE fpCom) {
 
 } // flush_port
 
+
+
+/**
+  \fn uint32_t drain_port(HANDLE fpCom, uint32_t quiet, uint32_t maxTime)
+
+  \param[in]  fpCom     handle to comm port
+  \param[in]  quiet     port is quiet if no data is received for this time [ms]
+  \param[in]  maxTime   max. duration [ms], e.g. for continuous noise
+
+  \return number of discarded bytes
+
+  read and discard received data until the port is quiet. Unlike flush_port() this
+  takes only as long as data is arriving, e.g. after reset of the STM8
+*/
+uint32_t drain_port(HANDLE fpCom, uint32_t quiet, uint32_t maxTime) {
+
+  char      buf[64];
+  uint32_t  baudrate, timeout, len, num = 0;
+  uint8_t   numBits, parity, numStop, RTS, DTR;
+  uint64_t  deadline;
+
+  // receive with short timeout until nothing is received
+  get_port_attribute(fpCom, &baudrate, &timeout, &numBits, &parity, &numStop, &RTS, &DTR);
+  set_timeout(fpCom, quiet);
+  deadline = millis() + maxTime;
+  do {
+    len = receive_port(fpCom, 0, sizeof(buf), buf);
+    num += len;
+  } while ((len != 0) && (millis() < deadline));
+
+  // restore timeout
+  set_timeout(fpCom, timeout);
+
+  return(num);
+
+} // drain_port
+
+
+
+/**
+  \fn uint32_t get_port_latency(HANDLE fpCom)
+
+  \param[in]  fpCom      handle to comm port
+
+  \return additional round trip time [ms]
+
+  get additional round trip time of port for very short timeouts, e.g. SYNCH interval in bsl_syncFast()
+  and probe timeouts. Returns PORT_TCP_LATENCY for network ports, else 0
+*/
+uint32_t get_port_latency(HANDLE fpCom) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  PortContext_s *ctx = port_context(fpCom);
+  if ((ctx != NULL) && (ctx->transport != PORT_SERIAL))
+    return(PORT_TCP_LATENCY);
+
+#else
+  (void) fpCom;
+#endif // __APPLE__ || __unix__
+
+  return(0);
+
+} // get_port_latency
+
+
+
+/**
+  \fn void get_reply_stats(HANDLE fpCom, uint32_t *numBytes, uint64_t *duration)
+
+  \param[in]  fpCom      handle to comm port
+  \param[out] numBytes   number of bytes received in UART reply mode since port was opened
+  \param[out] duration   time [us] spent receiving these bytes
+
+  get statistics of UART reply mode for comparing the achieved throughput. Posix only, else 0
+*/
+void get_reply_stats(HANDLE fpCom, uint32_t *numBytes, uint64_t *duration) {
+
+  *numBytes = 0;
+  *duration = 0;
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  PortContext_s *ctx = port_context(fpCom);
+  if (ctx != NULL) {
+    *numBytes = ctx->replyBytes;
+    *duration = ctx->replyTime;
+  }
+
+#else
+  (void) fpCom;
+#endif // __APPLE__ || __unix__
+
+} // get_reply_stats
+
 // end of file
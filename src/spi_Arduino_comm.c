@@ -140,6 +140,68 @@ void setPin_Arduino(HANDLE fp, uint8_t pin, uint8_t state) {
 
 
 
+/**
+  \fn uint32_t waitReady_Arduino(HANDLE fp)
+
+  \param[in] fp     handle to Arduino port
+
+  \return time [ms] until Arduino SPI bridge responded
+
+  Opening the port resets the Arduino, which then runs its bootloader before the
+  SPI bridge sketch starts. Instead of waiting a fixed time, repeatedly set the
+  chip select pin high until the bridge acknowledges. Discard partial responses
+  in between. Chip select is high afterwards.
+  For serial protocol see https://github.com/gicking/Arduino_SPI_bridge/protocol.ods
+*/
+uint32_t waitReady_Arduino(HANDLE fp) {
+
+  uint8_t   Tx[150], Rx[150];
+  uint8_t   lenRx, num;
+  uint32_t  baudrate, timeout;
+  uint8_t   numBits, parity, numStop, RTS, DTR;
+  uint64_t  tStart = millis();
+
+  // assemble frame to set chip select high
+  Tx[0] = 5;                    // frame length
+  Tx[1] = ARDUINO_CMD_SET_PIN;  // command code
+  Tx[2] = ARDUINO_CSN_PIN;      // pin number
+  Tx[3] = 1;                    // new state
+  Tx[4] = checksum_Arduino(Tx); // frame checksum
+
+  // use short timeout for polling
+  get_port_attribute(fp, &baudrate, &timeout, &numBits, &parity, &numStop, &RTS, &DTR);
+  set_timeout(fp, ARDUINO_PING_TIMEOUT);
+
+  // send command until valid acknowledge is received
+  lenRx = 3;
+  while (1) {
+
+    // send command and get response from Arduino
+    send_port(fp, 0, Tx[0], (char*) Tx);
+    num = receive_port(fp, 0, lenRx, (char*) Rx);
+
+    // check response
+    if ((num == lenRx) && (Rx[0] == lenRx) && (Rx[lenRx-1] == checksum_Arduino(Rx)) && (Rx[1] == ARDUINO_SUCCESS))
+      break;
+
+    // check timeout
+    if (millis() - tStart > ARDUINO_BOOT_MAX)
+      Error("in 'waitReady_Arduino()': no response from Arduino within %dms", ARDUINO_BOOT_MAX);
+
+    // discard rest of response, e.g. from Arduino bootloader
+    drain_port(fp, 5, ARDUINO_PING_TIMEOUT);
+
+  } // while (1)
+
+  // restore timeout
+  set_timeout(fp, timeout);
+
+  return((uint32_t) (millis() - tStart));
+
+} // waitReady_Arduino
+
+
+
 /**
   \fn uint32_t sendReceiveSPI_Arduino(HANDLE fpSPI, uint8_t CSN, uint32_t lenFrame, char *Tx, char *Rx)
 
@@ -282,6 +282,65 @@ void spi_transfer(HANDLE fp, int len, uint8_t *Tx, uint8_t *Rx) {
 #endif // __APPLE__ || __unix__
 
 } // receive_spi_spidev
+
+
+
+/**
+  \fn uint32_t transfer_spi_spidev(HANDLE fp, int numSeg, const SpidevSegment_s *seg)
+   
+  \param[in]  fp      handle to SPI port
+  \param[in]  numSeg  number of segments (1..SPIDEV_SEGMENTS_MAX)
+  \param[in]  seg     segments to send and/or receive
+  
+  \return number of transferred bytes, or 0 on error
+  
+  send & receive several segments, e.g. BSL frames and ACK reads, in a single SPI_IOC_MESSAGE.
+  Like separate write() and read() calls chip select is released between segments, but the kernel
+  driver inserts the specified delays without syscall overhead and scheduling jitter
+*/
+uint32_t transfer_spi_spidev(HANDLE fp, int numSeg, const SpidevSegment_s *seg) {
+
+  
+/////////
+// Windows
+/////////
+#if defined(WIN32) || defined(WIN64)
+  #error Windows not yet supported (which API?)
+
+#endif // WIN32 || WIN64
+
+
+/////////
+// Posix
+/////////
+#if defined(__APPLE__) || defined(__unix__) 
+
+  struct spi_ioc_transfer   tr[SPIDEV_SEGMENTS_MAX];
+  int                       i, ret;
+
+  // check number of segments
+  if ((numSeg < 1) || (numSeg > SPIDEV_SEGMENTS_MAX))
+    Error("in 'transfer_spi_spidev': invalid number of segments (%d)", numSeg);
+
+  // fill SPI data structures. Toggle chip select between segments, keep it released after last segment
+  memset(tr, 0, sizeof(tr));
+  for (i=0; i<numSeg; i++) {
+    tr[i].tx_buf      = (unsigned long) seg[i].Tx;
+    tr[i].rx_buf      = (unsigned long) seg[i].Rx;
+    tr[i].len         = seg[i].len;
+    tr[i].delay_usecs = seg[i].delay;
+    tr[i].cs_change   = (i < numSeg-1);
+  }
+
+  // send & receive all segments
+  ret = ioctl(fp, SPI_IOC_MESSAGE(numSeg), tr);
+  
+  // return number of transferred bytes
+  return((ret < 0) ? 0 : (uint32_t) ret);
+  
+#endif // __APPLE__ || __unix__
+
+} // transfer_spi_spidev
   
 #endif // USE_SPIDEV
 
@@ -0,0 +1,438 @@
+/**
+  \file stage2.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of second-stage RAM loader protocol
+
+  implementation of routines to upload a second-stage loader to STM8 RAM via
+  the ROM bootloader and to program flash via this loader. The ROM bootloader
+  accepts max. 128B per WRITE with 3 acknowledged phases at the auto-bauded
+  rate. The loader instead switches to a higher baudrate and accepts frames of
+  up to 256B protected by CRC16, of which 2 may be in flight. Each frame is
+  read back by the loader after programming, i.e. it is only acknowledged if
+  the flash content matches.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "main.h"
+#include "bootloader.h"
+#include "hexfile.h"
+#include "misc.h"
+#include "lz.h"
+#include "stage2.h"
+
+
+/// update CRC16-CCITT (polynomial 0x1021, MSB first) as calculated by loader
+static uint16_t stage2_crc16(uint16_t crc, const char *buf, int len)
+{
+  for (int i = 0; i < len; i++)
+  {
+    crc ^= (uint16_t) ((uint8_t) buf[i]) << 8;
+    for (int j = 0; j < 8; j++)
+      crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+  }
+
+  return crc;
+
+} // stage2_crc16()
+
+
+/// build frame in buffer. Return frame length
+static int stage2_frame(char *Tx, uint8_t seq, uint8_t cmd, MEMIMAGE_ADDR_T addr, const uint8_t *data, int len)
+{
+  uint16_t    crc;
+
+  // header
+  Tx[0] = (char) S2_SOF;
+  Tx[1] = (char) seq;
+  Tx[2] = (char) cmd;
+  Tx[3] = (char) (addr >> 16);
+  Tx[4] = (char) (addr >> 8);
+  Tx[5] = (char) (addr);
+  Tx[6] = (char) (len >> 8);
+  Tx[7] = (char) (len);
+
+  // data
+  for (int i = 0; i < len; i++)
+    Tx[8+i] = (char) (data[i]);
+
+  // CRC over sequence number to data
+  crc = stage2_crc16(0xFFFF, Tx+1, 7+len);
+  Tx[8+len] = (char) (crc >> 8);
+  Tx[9+len] = (char) (crc);
+
+  return S2_OVERHEAD + len;
+
+} // stage2_frame()
+
+
+/// send handshake byte and check loader reply. Return true on success
+static bool stage2_sync(Stage2_s *stage2)
+{
+  char    Tx[1], Rx[2];
+  int     len;
+
+  flush_port(stage2->port);
+  Tx[0] = (char) S2_SYNC;
+  send_port(stage2->port, stage2->uartMode, 1, Tx);
+  len = receive_port(stage2->port, stage2->uartMode, 2, Rx);
+
+  return ((len == 2) && ((uint8_t) Rx[0] == S2_ACK) && ((uint8_t) Rx[1] == S2_VERSION));
+
+} // stage2_sync()
+
+
+/// complete pending frame with filler bytes, discard responses and re-synchronize to loader
+static void stage2_resync(Stage2_s *stage2)
+{
+  char    Tx[S2_FRAME_MAX+S2_OVERHEAD];
+
+  // filler completes a partially received frame. 0xFF in the command, address MSB or length MSB is
+  // always rejected by the loader, and 0xFF is neither SOF nor SYNC, i.e. it is ignored between frames
+  memset(Tx, 0xFF, sizeof(Tx));
+  send_port(stage2->port, stage2->uartMode, sizeof(Tx), Tx);
+  SLEEP(50);
+
+  // handshake only succeeds if loader waits for next frame
+  for (int i = 0; i < S2_SYNC_RETRY; i++)
+  {
+    if (stage2_sync(stage2))
+      return;
+  }
+  Error("in 'stage2_resync()': no response from stage-2 loader");
+
+} // stage2_resync()
+
+
+/// upload stage-2 loader from IHX file, start it and switch to its baudrate
+uint8_t stage2_start(Stage2_s *stage2, HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const char *filename, uint32_t baudrate, uint8_t family, int flashsize, uint8_t verbose)
+{
+  MemoryImage_s   image;              // memory image of loader
+  uint32_t        div;                // UART baudrate divider
+  int             i;
+
+  // init session
+  stage2->active   = false;
+  stage2->port     = ptrPort;
+  stage2->uartMode = uartMode;
+  stage2->baudrate = baudrate;
+  stage2->seq      = 0;
+  stage2->window   = (uartMode == 0) ? S2_WINDOW : 1;    // 1-wire: loader must not reply while host is sending
+
+  // print message
+  if (verbose == INFORM)
+    printf("  start stage-2 loader ... ");
+  else if (verbose == CHATTY)
+    printf("  start stage-2 loader '%s' ... ", filename);
+  fflush(stdout);
+
+  // loader requires UART with direct response
+  if ((physInterface != UART) || (uartMode == 2))
+    Error("stage-2 loader only supported via UART in duplex or 1-wire mode");
+
+  // calculate UART divider. Must be representable by STM8 BRR registers
+  if (baudrate == 0)
+    Error("in 'stage2_start()': invalid baudrate 0");
+  div = (S2_FMASTER + baudrate/2) / baudrate;
+  if ((div < 16) || (div > 0xFFFF) || (abs((int) (S2_FMASTER/div) - (int) baudrate) > (int) (baudrate/100*S2_BAUD_TOL)))
+    Error("stage-2 baudrate %d not supported (divider %d)", (int) baudrate, (int) div);
+
+  // import loader. Must reside in RAM after parameter block
+  MemoryImage_init(&image);
+  ownImage(&image);
+  import_file_ihx(filename, &image, MUTE);
+  if ((image.numEntries == 0) || (image.memoryEntries[0].address < S2_ADDR_START) || (image.memoryEntries[image.numEntries-1].address > RAM_END))
+    Error("stage-2 loader '%s' must be located in RAM 0x%04X - 0x%04X", filename, (int) S2_ADDR_START, (int) RAM_END);
+
+  // add parameter block: BRR1=div[11:4], BRR2=div[15:12]|div[3:0], family, flash block size
+  MemoryImage_addData(&image, S2_ADDR_PARAM,   (uint8_t) (div >> 4));
+  MemoryImage_addData(&image, S2_ADDR_PARAM+1, (uint8_t) (((div >> 8) & 0xF0) | (div & 0x0F)));
+  MemoryImage_addData(&image, S2_ADDR_PARAM+2, family);
+  MemoryImage_addData(&image, S2_ADDR_PARAM+3, (flashsize <= 8) ? 64 : 128);
+
+  // upload loader and start it. ROM bootloader is no longer available afterwards
+  bsl_memWrite(ptrPort, physInterface, uartMode, &image, WRITE_LOCKSTEP, MUTE);
+  bsl_jumpTo(ptrPort, physInterface, uartMode, S2_ADDR_START, MUTE);
+  MemoryImage_free(&image);
+  disown(&image);
+
+  // switch to loader baudrate and synchronize
+  SLEEP(10);
+  set_baudrate(ptrPort, baudrate);
+  set_timeout(ptrPort, 100);
+  for (i = 0; i < S2_SYNC_RETRY; i++)
+  {
+    if (stage2_sync(stage2))
+      break;
+  }
+  set_timeout(ptrPort, TIMEOUT);
+  if (i == S2_SYNC_RETRY)
+    Error("in 'stage2_start()': no response from stage-2 loader at %d Baud", (int) baudrate);
+  stage2->active = true;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done (%1.1fkBaud)\n", (float) baudrate/1000.0);
+  fflush(stdout);
+
+  // avoid compiler warnings
+  return 0;
+
+} // stage2_start()
+
+
+/// get frame payload from image. Optionally compress if this reduces size. Return payload length
+static int stage2_payload(const MemoryImage_s *image, size_t idx, int len, bool compress, uint8_t *payload, uint8_t *cmd)
+{
+  uint8_t   raw[S2_FRAME_MAX], check[S2_FRAME_MAX];
+  int       lenPacked;
+
+  // raw data from consecutive image entries
+  for (int i = 0; i < len; i++)
+    raw[i] = image->memoryEntries[idx+i].data;
+
+  // compressed frame if smaller. Assert that loader can restore data
+  if (compress)
+  {
+    lenPacked = lz_compress(raw, len, payload, len-1);
+    if (lenPacked > 0)
+    {
+      if ((lz_decompress(payload, lenPacked, check, S2_FRAME_MAX) != len) || (memcmp(raw, check, len) != 0))
+        Error("in 'stage2_payload()': decompression of frame 0x%04" PRIX64 " failed", (uint64_t) image->memoryEntries[idx].address);
+      *cmd = S2_CMD_WRITE_LZ;
+      return lenPacked;
+    }
+  }
+
+  // uncompressed frame
+  memcpy(payload, raw, len);
+  *cmd = S2_CMD_WRITE;
+  return len;
+
+} // stage2_payload()
+
+
+/// upload memory image to flash or EEPROM via stage-2 loader
+uint8_t stage2_memWrite(Stage2_s *stage2, const MemoryImage_s *image, bool compress, uint8_t verbose)
+{
+  size_t            *idxFrame;                          // start index of frames in image
+  int               *lenFrame;                          // data length of frames
+  int               numFrames, base, head, numRetry;
+  int               countBytes, lenTx, len;
+  int               countWire, numSent;                 // payload bytes and number of frames sent at least once
+  uint8_t           payload[S2_FRAME_MAX], cmd;
+  char              Tx[S2_WINDOW*(S2_FRAME_MAX+S2_OVERHEAD)], Rx[2];
+  uint64_t          tStart, tStop;                      // measure time [ms] for write
+
+  // check if loader is running
+  if (!stage2->active)
+    Error("in 'stage2_memWrite()': stage-2 loader not started");
+
+  // print message
+  if (image->numEntries == 0)
+  {
+    if (verbose != MUTE)
+      printf("  no data to write\n");
+    return 0;
+  }
+  if (verbose != MUTE)
+  {
+    if (image->numEntries > 1024)
+      printf("  write %1.1fkB ", (float) image->numEntries/1024.0);
+    else
+      printf("  write %dB ", (int) image->numEntries);
+  }
+  fflush(stdout);
+
+  // split image into consecutive frames. Frames don't cross a multiple of S2_FRAME_MAX, i.e. flash blocks
+  idxFrame = malloc(image->numEntries * sizeof(size_t));
+  lenFrame = malloc(image->numEntries * sizeof(int));
+  ownBuffer(idxFrame);
+  ownBuffer(lenFrame);
+  if ((idxFrame == NULL) || (lenFrame == NULL))
+    Error("in 'stage2_memWrite()': cannot allocate frame list");
+  numFrames = 0;
+  for (size_t i = 0; i < image->numEntries; i++)
+  {
+    MEMIMAGE_ADDR_T addr = image->memoryEntries[i].address;
+
+    // loader only programs flash and EEPROM in 16-bit range. RAM contains loader, option bytes require special sequence
+    if ((addr <= RAM_END) || (addr > S2_ADDR_MAX) || ((addr >= S2_OPT_START) && (addr <= S2_OPT_END)))
+      Error("address 0x%04" PRIX64 " not supported by stage-2 loader (flash and EEPROM only)", (uint64_t) addr);
+
+    // start new frame or append to current
+    if ((numFrames == 0) || (addr != image->memoryEntries[i-1].address + 1) || (addr % S2_FRAME_MAX == 0))
+    {
+      idxFrame[numFrames] = i;
+      lenFrame[numFrames] = 1;
+      numFrames++;
+    }
+    else
+      lenFrame[numFrames-1]++;
+  }
+
+  // measure time for write
+  tStart = millis();
+
+  // send frames with max. window frames in flight. On failure resend from oldest unacknowledged frame (go-back-N)
+  set_timeout(stage2->port, S2_DEADLINE);
+  countBytes = 0;
+  countWire = 0;
+  numSent = 0;
+  numRetry = 0;
+  base = head = 0;
+  while (base < numFrames)
+  {
+    // fill window
+    lenTx = 0;
+    while ((head < numFrames) && (head - base < stage2->window))
+    {
+      len = stage2_payload(image, idxFrame[head], lenFrame[head], compress, payload, &cmd);
+      lenTx += stage2_frame(Tx+lenTx, (uint8_t) (stage2->seq + (head - base)), cmd, image->memoryEntries[idxFrame[head]].address, payload, len);
+      if (head == numSent)
+      {
+        countWire += len;
+        numSent++;
+      }
+      head++;
+    }
+    if ((lenTx > 0) && (send_port(stage2->port, stage2->uartMode, lenTx, Tx) != (uint32_t) lenTx))
+      Error("in 'stage2_memWrite()': sending frames failed");
+
+    // wait for response to oldest frame
+    len = receive_port(stage2->port, stage2->uartMode, 2, Rx);
+    if ((len == 2) && ((uint8_t) Rx[0] == S2_ACK) && ((uint8_t) (Rx[1] - stage2->seq) < head - base))
+    {
+      // acknowledge is cumulative, as loader processes frames in order. Covers lost acknowledge of previous frame
+      for (int n = (uint8_t) (Rx[1] - stage2->seq); n >= 0; n--)
+      {
+        countBytes += lenFrame[base];
+        base++;
+        stage2->seq++;
+      }
+      numRetry = 0;
+
+      // print progress
+      if ((verbose == CHATTY) && ((base % 8 == 0) || (base == numFrames)))
+      {
+        if (image->numEntries > 1024)
+          printf("%c  write %1.1fkB / %1.1fkB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ", '\r', (float) countBytes/1024.0, (float) image->numEntries/1024.0,
+            (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address);
+        else
+          printf("%c  write %dB / %dB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ", '\r', (int) countBytes, (int) image->numEntries,
+            (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address);
+        fflush(stdout);
+      }
+    }
+
+    // repeated acknowledge of resent frame -> ignore
+    else if ((len == 2) && ((uint8_t) Rx[0] == S2_ACK) && ((uint8_t) (stage2->seq - Rx[1]) <= S2_WINDOW))
+      ;
+
+    // NACK, timeout or corrupted response -> re-synchronize and resend window
+    else
+    {
+      if (numRetry++ >= g_retryMax)
+      {
+        MEMIMAGE_ADDR_T addr = image->memoryEntries[idxFrame[base]].address;
+        if ((len == 2) && ((uint8_t) Rx[0] == S2_NACK))
+          Error("in 'stage2_memWrite()': frame 0x%04" PRIX64 " rejected by stage-2 loader", (uint64_t) addr);
+        else
+          Error("in 'stage2_memWrite()': frame 0x%04" PRIX64 " timeout (received %d bytes)", (uint64_t) addr, len);
+      }
+      stage2_resync(stage2);
+      set_timeout(stage2->port, S2_DEADLINE);
+      head = base;
+    }
+
+  } // loop over frames
+  set_timeout(stage2->port, TIMEOUT);
+
+  // measure time for write
+  tStop = millis();
+
+  // release frame list
+  disown(idxFrame);
+  disown(lenFrame);
+  free(idxFrame);
+  free(lenFrame);
+
+  // print message
+  if (verbose == SILENT)
+    printf(" done\n");
+  else if (verbose == INFORM)
+  {
+    if (image->numEntries > 1024)
+      printf("%c  write %1.1fkB / %1.1fkB ... done   \n", '\r', (float) countBytes/1024.0, (float) image->numEntries/1024.0);
+    else
+      printf("%c  write %dB / %dB ... done   \n", '\r', (int) countBytes, (int) image->numEntries);
+  }
+  else if (verbose == CHATTY)
+  {
+    if (image->numEntries > 1024)
+      printf("%c  write %1.1fkB / %1.1fkB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ... done, stage-2 %1.1fkB/s", '\r', (float) countBytes/1024.0, (float) image->numEntries/1024.0,
+        (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address, (float) countBytes/1.024/(float) (tStop-tStart+1));
+    else
+      printf("%c  write %dB / %dB in 0x%04" PRIX64 " to 0x%04" PRIX64 " ... done, stage-2 %1.1fkB/s", '\r', (int) countBytes, (int) image->numEntries,
+        (uint64_t) image->memoryEntries[0].address, (uint64_t) image->memoryEntries[image->numEntries-1].address, (float) countBytes/1.024/(float) (tStop-tStart+1));
+    if (compress)
+      printf(", compressed to %d%%", (int) (100.0 * (float) countWire / (float) (countBytes+1) + 0.5));
+    printf("   \n");
+  }
+  fflush(stdout);
+
+  // avoid compiler warnings
+  return 0;
+
+} // stage2_memWrite()
+
+
+/// jump to flash or RAM via stage-2 loader
+uint8_t stage2_jumpTo(Stage2_s *stage2, MEMIMAGE_ADDR_T addr, uint8_t verbose)
+{
+  char      Tx[S2_OVERHEAD], Rx[2];
+  int       len;
+
+  // print message
+  if (verbose == INFORM)
+    printf("  jump to 0x%04" PRIX64 " ... ", (uint64_t) addr);
+  else if (verbose == CHATTY)
+    printf("  jump to address 0x%04" PRIX64 " ... ", (uint64_t) addr);
+  fflush(stdout);
+
+  // check if loader is running
+  if (!stage2->active)
+    Error("in 'stage2_jumpTo()': stage-2 loader not started");
+
+  // send GO frame and wait for acknowledge
+  len = stage2_frame(Tx, stage2->seq, S2_CMD_GO, addr, NULL, 0);
+  if (send_port(stage2->port, stage2->uartMode, len, Tx) != (uint32_t) len)
+    Error("in 'stage2_jumpTo()': sending frame failed");
+  len = receive_port(stage2->port, stage2->uartMode, 2, Rx);
+  if (len != 2)
+    Error("in 'stage2_jumpTo()': ACK timeout (expect 2, received %d)", len);
+  if (((uint8_t) Rx[0] != S2_ACK) || ((uint8_t) Rx[1] != stage2->seq))
+    Error("in 'stage2_jumpTo()': ACK failure (expect 0x%02" PRIX8 ", received 0x%02" PRIX8 ")", (uint8_t) S2_ACK, (uint8_t) Rx[0]);
+  stage2->seq++;
+
+  // application is running
+  stage2->active = false;
+
+  // print message
+  if ((verbose == INFORM) || (verbose == CHATTY))
+    printf("done\n");
+  fflush(stdout);
+
+  // avoid compiler warnings
+  return 0;
+
+} // stage2_jumpTo()
+
+
+// end of file
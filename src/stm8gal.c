@@ -0,0 +1,739 @@
+/**
+  \file stm8gal.c
+
+  \author G. Icking-Konert
+
+  \brief implementation of stm8gal library API
+
+  implementation of a reentrant API for embedding STM8 bootloader access into other
+  applications. Each API call sets an error trap for the calling thread (see
+  setErrorTrap()), so that Error() in the underlying modules returns an error code
+  instead of terminating the process. Calls on a session are serialized by a mutex.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "main.h"
+#include "misc.h"
+#include "serial_comm.h"
+#include "spi_spidev_comm.h"
+#include "spi_Arduino_comm.h"
+#include "hexfile.h"
+#include "bootloader.h"
+#include "verify_CRC32.h"
+#include "erase_plan.h"
+#include "delta.h"
+#include "stm8gal.h"
+
+
+/// session state (opaque for library users)
+struct stm8gal_session_s {
+  stm8gal_config_s    config;             //< session parameters
+  char                portname[STRLEN];   //< name of communication port
+  HANDLE              ptrPort;            //< handle to communication port
+  bool                connected;          //< bootloader synchronized and w/e routines uploaded
+  uint8_t             uartMode;           //< actual UART mode (0=duplex, 1=1-wire, 2=2-wire reply)
+  int                 flashsize;          //< size of flash [kB]
+  uint8_t             versBSL;            //< BSL version
+  uint8_t             family;             //< device family
+  pthread_mutex_t     lock;               //< serialize calls on session
+  stm8gal_progress_t  progress;           //< optional progress callback
+  void                *progressArg;       //< user argument for progress callback
+  stm8gal_error_t     errCode;            //< error code returned if current step fails
+  char                errMsg[ERRMSG_LEN]; //< message of last error
+  MemoryImage_s       file;               //< imported file, see stm8gal_writeFile()
+  MemoryImage_s       image;              //< modified copy of image for align and delta
+};
+
+
+
+/**
+  \fn static stm8gal_error_t session_begin(stm8gal_session_s *session, bool needPort, stm8gal_error_t errCode)
+
+  \param[in,out] session  session to use
+  \param[in]  needPort    require synchronized bootloader
+  \param[in]  errCode     error code if first step fails
+
+  \return STM8GAL_OK if session is ready, else error code
+
+  Lock session and set per-thread parameters. Must be followed by setErrorTrap(), setjmp() and session_end()
+*/
+static stm8gal_error_t session_begin(stm8gal_session_s *session, bool needPort, stm8gal_error_t errCode)
+{
+  // check session
+  if (session == NULL)
+    return STM8GAL_ERR_PARAM;
+
+  // serialize calls on session
+  pthread_mutex_lock(&(session->lock));
+  if (needPort && (!session->connected))
+  {
+    snprintf(session->errMsg, ERRMSG_LEN, "port '%.150s' not connected", session->portname);
+    pthread_mutex_unlock(&(session->lock));
+    return STM8GAL_ERR_PORT;
+  }
+
+  // set per-thread parameters
+  session->errCode = errCode;
+  g_retryMax   = session->config.retry;
+  g_lowLatency = session->config.lowLatency;
+  g_ioThread   = session->config.ioThread;
+  g_fastConnect = session->config.fastConnect;
+  bsl_setProgress(session->progress, session->progressArg);
+
+  return STM8GAL_OK;
+
+} // session_begin
+
+
+
+/**
+  \fn static stm8gal_error_t session_end(stm8gal_session_s *session, ErrorTrap_s *prevTrap, const ErrorTrap_s *trap)
+
+  \param[in,out] session  session to release
+  \param[in]  prevTrap    error trap of caller, as returned by setErrorTrap()
+  \param[in]  trap        error trap if Error() was called, else NULL
+
+  \return STM8GAL_OK on success, else error code of failed step
+
+  Restore error trap and progress callback of caller, release temporary images and unlock session
+*/
+static stm8gal_error_t session_end(stm8gal_session_s *session, ErrorTrap_s *prevTrap, const ErrorTrap_s *trap)
+{
+  stm8gal_error_t   result = STM8GAL_OK;
+
+  // restore state of calling thread
+  setErrorTrap(prevTrap);
+  bsl_setProgress(NULL, NULL);
+
+  // store error message
+  if (trap != NULL)
+  {
+    result = session->errCode;
+    strncpy(session->errMsg, trap->msg, ERRMSG_LEN-1);
+    session->errMsg[ERRMSG_LEN-1] = '\0';
+  }
+  else
+    session->errMsg[0] = '\0';
+
+  // release temporary images and unlock session
+  MemoryImage_free(&(session->file));
+  MemoryImage_free(&(session->image));
+  pthread_mutex_unlock(&(session->lock));
+
+  return result;
+
+} // session_end
+
+
+
+/**
+  \fn static void session_closePort(stm8gal_session_s *session)
+
+  \param[in,out] session  session to close port of
+
+  Close port of session and ignore errors
+*/
+static void session_closePort(stm8gal_session_s *session)
+{
+  ErrorTrap_s   trap;
+  ErrorTrap_s   *prev;
+
+  prev = setErrorTrap(&trap);
+  if (setjmp(trap.env) == 0)
+    close_port(&(session->ptrPort));
+  session->ptrPort   = 0;
+  session->connected = false;
+  setErrorTrap(prev);
+
+} // session_closePort
+
+
+
+/**
+  \fn static void session_connect(stm8gal_session_s *session)
+
+  \param[in,out] session  session to connect
+
+  Reset STM8, open port, synchronize with bootloader, identify device and upload
+  RAM routines for flash write & erase (see main.c). Output is muted
+*/
+static void session_connect(stm8gal_session_s *session)
+{
+  const stm8gal_config_s  *config = &(session->config);
+
+  // optional reset via DTR, RTS or 'Re5eT!' command (UART only). Arduino pin 8 see below. For fast connect DTR and RTS see below
+  session->errCode = STM8GAL_ERR_PORT;
+  if ((config->physInterface == UART) && ((config->resetSTM8 == 3) || ((!config->fastConnect) && ((config->resetSTM8 == 2) || (config->resetSTM8 == 6)))))
+  {
+    session->ptrPort = init_port(session->portname, 115200, 100, 8, 0, 1, 0, 0);
+    if (config->resetSTM8 == 2)
+      pulse_DTR(session->ptrPort, 10);
+    else if (config->resetSTM8 == 6)
+      pulse_RTS(session->ptrPort, 10);
+    else {
+      char buf[10] = "Re5eT!";
+      for (int i=0; i<6; i++) {
+        send_port(session->ptrPort, 0, 1, buf+i);
+        SLEEP(10);
+      }
+    }
+    close_port(&(session->ptrPort));
+    if (!config->fastConnect)
+      SLEEP(20);                      // allow BSL to initialize
+  }
+
+  // open UART port. Start without parity, may be changed in bsl_sync()
+  if (config->physInterface == UART) {
+    session->ptrPort = init_port(session->portname, config->baudrate, TIMEOUT, 8, 0, 1, 0, 0);
+
+    // fast connect: reset via DTR or RTS without re-opening port
+    if ((config->fastConnect) && (config->resetSTM8 == 2))
+      pulse_DTR(session->ptrPort, 10);
+    else if ((config->fastConnect) && (config->resetSTM8 == 6))
+      pulse_RTS(session->ptrPort, 10);
+  }
+
+  // SPI via Arduino
+  else if (config->physInterface == SPI_ARDUINO)
+  {
+    session->ptrPort = init_port(session->portname, ARDUINO_BAUDRATE, 100, 8, 0, 1, 0, 0);
+    if (config->fastConnect)
+      waitReady_Arduino(session->ptrPort);
+    else
+      SLEEP(2000);                    // wait until after Arduino bootloader
+    setPin_Arduino(session->ptrPort, ARDUINO_CSN_PIN, 1);
+    configSPI_Arduino(session->ptrPort, config->baudrate, ARDUINO_MSBFIRST, ARDUINO_SPI_MODE0);
+    if (config->resetSTM8 == 4) {
+      setPin_Arduino(session->ptrPort, ARDUINO_RESET_PIN, 0);
+      SLEEP(1);
+      setPin_Arduino(session->ptrPort, ARDUINO_RESET_PIN, 1);
+      if (!config->fastConnect)
+        SLEEP(20);                    // allow BSL to initialize
+    }
+  }
+
+  // SPI via spidev
+  #if defined(USE_SPIDEV)
+    else if (config->physInterface == SPI_SPIDEV)
+      session->ptrPort = init_spi_spidev(session->portname, config->baudrate);
+  #endif // USE_SPIDEV
+
+  // unknown interface
+  else {
+    session->errCode = STM8GAL_ERR_PARAM;
+    Error("interface %d not supported", (int) config->physInterface);
+  }
+
+  // synchronize with bootloader. For UART also sync baudrate
+  session->errCode = STM8GAL_ERR_SYNC;
+  if (config->fastConnect)
+    bsl_syncFast(session->ptrPort, config->physInterface, MUTE);
+  else {
+    SLEEP(200);
+    flush_port(session->ptrPort);
+    bsl_sync(session->ptrPort, config->physInterface, MUTE);
+  }
+
+  // for UART set or auto-detect UART mode (0=duplex, 1=1-wire, 2=2-wire reply, others=auto-detect)
+  session->errCode = STM8GAL_ERR_COMM;
+  session->uartMode = 0;
+  if (config->physInterface == UART) {
+    if (config->uartMode == 0) {
+      session->uartMode = 0;
+      set_parity(session->ptrPort, 2);
+    }
+    else if (config->uartMode == 1) {
+      session->uartMode = 1;
+      set_parity(session->ptrPort, 0);
+    }
+    else if (config->uartMode == 2) {
+      char c = ACK;      // need to reply ACK first to revert bootloader
+      session->uartMode = 2;
+      set_parity(session->ptrPort, 0);
+      send_port(session->ptrPort, 0, 1, &c);
+    }
+    else
+      session->uartMode = bsl_getUartMode(session->ptrPort, MUTE);
+  }
+
+  // identify device and upload RAM routines for flash write & erase. On reconnect first confirm known identity with fewer probes (see stm8gal_reconnect())
+  if ((session->flashsize == 0) ||
+      (bsl_checkInfo(session->ptrPort, config->physInterface, session->uartMode, session->flashsize, session->versBSL, session->family, MUTE) != 0))
+    bsl_getInfo(session->ptrPort, config->physInterface, session->uartMode, &(session->flashsize), &(session->versBSL), &(session->family), MUTE);
+  bsl_uploadWriteErase(session->ptrPort, config->physInterface, session->uartMode, session->flashsize, session->versBSL, session->family, MUTE);
+  session->connected = true;
+
+} // session_connect
+
+
+
+/**
+  \fn static void session_write(stm8gal_session_s *session, const MemoryImage_s *image)
+
+  \param[in,out] session  session to use
+  \param[in]  image       memory image to write
+
+  Optionally align, filter and erase, then write image and optionally verify (see main.c)
+*/
+static void session_write(stm8gal_session_s *session, const MemoryImage_s *image)
+{
+  const stm8gal_config_s  *config = &(session->config);
+  HANDLE                  ptrPort = session->ptrPort;
+  uint8_t                 physInterface = config->physInterface;
+
+  // nothing to do
+  if (MemoryImage_isEmpty(image))
+    return;
+
+  // align and delta modify the image -> work on copy
+  if ((config->alignMode != ALIGN_NONE) || (config->deltaBlock != DELTA_OFF))
+  {
+    if (!MemoryImage_clone(image, &(session->image)))
+      Error("cannot copy memory image");
+    bsl_memAlign(ptrPort, physInterface, session->uartMode, &(session->image), config->alignMode, config->alignPad, MUTE);
+    delta_filter(ptrPort, session->family, session->flashsize, session->versBSL, physInterface, session->uartMode, &(session->image),
+      ((config->deltaBlock != DELTA_OFF) && (config->erasePlan != ERASE_PLAN_OFF)) ? DELTA_SECTOR : config->deltaBlock, MUTE);
+    image = &(session->image);
+  }
+
+  // optionally erase flash sectors, then write
+  erase_plan(ptrPort, session->family, session->flashsize, session->versBSL, physInterface, session->uartMode, image, config->erasePlan, MUTE);
+  bsl_memWrite(ptrPort, physInterface, session->uartMode, image, config->writeMode, MUTE);
+
+  // optionally verify. CRC32 requires re-uploading w/e routines, which are cleared by ROM-BL by "GO" command
+  session->errCode = STM8GAL_ERR_VERIFY;
+  if (config->verifyUpload == 1) {
+    verify_crc32(ptrPort, session->family, session->flashsize, session->versBSL, physInterface, session->uartMode, image, MUTE);
+    session->errCode = STM8GAL_ERR_COMM;
+    bsl_uploadWriteErase(ptrPort, physInterface, session->uartMode, session->flashsize, session->versBSL, session->family, MUTE);
+  }
+  else if (config->verifyUpload == 2)
+    bsl_memVerifyRead(ptrPort, physInterface, session->uartMode, image, MUTE);
+
+} // session_write
+
+
+
+/**
+  \fn void stm8gal_defaultConfig(stm8gal_config_s *config)
+
+  \param[out] config      session parameters
+
+  Set default session parameters, identical to stm8gal command line defaults
+*/
+void stm8gal_defaultConfig(stm8gal_config_s *config)
+{
+  config->physInterface = UART;
+  config->baudrate      = 115200;
+  config->uartMode      = 255;              // auto-detect
+  config->resetSTM8     = 0;                // skip reset
+  config->writeMode     = WRITE_LOCKSTEP;
+  config->verifyUpload  = 2;                // read back
+  config->alignMode     = ALIGN_NONE;
+  config->alignPad      = 0x00;
+  config->erasePlan     = ERASE_PLAN_OFF;
+  config->deltaBlock    = DELTA_OFF;
+  config->retry         = RETRY_DEFAULT;
+  config->lowLatency    = false;            // keep USB-serial latency (system-wide setting)
+  config->ioThread      = false;            // access port directly
+  config->fastConnect   = false;            // fixed delays after reset
+
+} // stm8gal_defaultConfig
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_open(stm8gal_session_s **session, const char *port, const stm8gal_config_s *config)
+
+  \param[out] session     new session. Release with stm8gal_close(), also on error
+  \param[in]  port        name of communication port
+  \param[in]  config      session parameters, or NULL for defaults
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+
+  Open port, synchronize with bootloader, identify device and upload RAM routines for flash write & erase
+*/
+stm8gal_error_t stm8gal_open(stm8gal_session_s **session, const char *port, const stm8gal_config_s *config)
+{
+  stm8gal_session_s   *s;
+  ErrorTrap_s         trap, *prevTrap;
+  stm8gal_error_t     result;
+
+  // check parameters
+  if ((session == NULL) || (port == NULL))
+    return STM8GAL_ERR_PARAM;
+
+  // allocate and initialize session
+  *session = s = (stm8gal_session_s*) calloc(1, sizeof(stm8gal_session_s));
+  if (s == NULL)
+    return STM8GAL_ERR_MEMORY;
+  if (config != NULL)
+    s->config = *config;
+  else
+    stm8gal_defaultConfig(&(s->config));
+  strncpy(s->portname, port, STRLEN-1);
+  MemoryImage_init(&(s->file));
+  MemoryImage_init(&(s->image));
+  pthread_mutex_init(&(s->lock), NULL);
+
+  // connect to bootloader. On error Error() returns here with setjmp() != 0
+  session_begin(s, false, STM8GAL_ERR_PORT);
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0) {
+    result = session_end(s, prevTrap, &trap);
+    session_closePort(s);
+    return result;
+  }
+  session_connect(s);
+
+  return session_end(s, prevTrap, NULL);
+
+} // stm8gal_open
+
+
+
+/**
+  \fn void stm8gal_close(stm8gal_session_s *session)
+
+  \param[in]  session     session to release
+
+  Close port and release session
+*/
+void stm8gal_close(stm8gal_session_s *session)
+{
+  if (session == NULL)
+    return;
+
+  pthread_mutex_lock(&(session->lock));
+  session_closePort(session);
+  MemoryImage_free(&(session->file));
+  MemoryImage_free(&(session->image));
+  pthread_mutex_unlock(&(session->lock));
+  pthread_mutex_destroy(&(session->lock));
+  free(session);
+
+} // stm8gal_close
+
+
+
+/**
+  \fn const char* stm8gal_errorMessage(const stm8gal_session_s *session)
+
+  \param[in]  session     session to query
+
+  \return message of last error, or empty string
+*/
+const char* stm8gal_errorMessage(const stm8gal_session_s *session)
+{
+  if (session == NULL)
+    return "invalid session";
+  return session->errMsg;
+
+} // stm8gal_errorMessage
+
+
+
+/**
+  \fn void stm8gal_setProgress(stm8gal_session_s *session, stm8gal_progress_t callback, void *arg)
+
+  \param[in,out] session  session to use
+  \param[in]  callback    function called periodically during read and write, or NULL
+  \param[in]  arg         user argument passed to callback
+*/
+void stm8gal_setProgress(stm8gal_session_s *session, stm8gal_progress_t callback, void *arg)
+{
+  if (session == NULL)
+    return;
+
+  pthread_mutex_lock(&(session->lock));
+  session->progress    = callback;
+  session->progressArg = arg;
+  pthread_mutex_unlock(&(session->lock));
+
+} // stm8gal_setProgress
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_getInfo(stm8gal_session_s *session, uint8_t *family, int *flashsize, uint8_t *versBSL)
+
+  \param[in]  session     session to query
+  \param[out] family      device family (STM8S or STM8L, see bootloader.h), or NULL
+  \param[out] flashsize   size of flash [kB], or NULL
+  \param[out] versBSL     BSL version, or NULL
+
+  \return STM8GAL_OK on success, else error code
+
+  Get device info from stm8gal_open(). Remains valid after stm8gal_jump()
+*/
+stm8gal_error_t stm8gal_getInfo(stm8gal_session_s *session, uint8_t *family, int *flashsize, uint8_t *versBSL)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+
+  // check session and trap errors
+  result = session_begin(session, false, STM8GAL_ERR_PARAM);
+  if (result != STM8GAL_OK)
+    return result;
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    return session_end(session, prevTrap, &trap);
+
+  // copy device info from connect
+  if (family != NULL)
+    *family = session->family;
+  if (flashsize != NULL)
+    *flashsize = session->flashsize;
+  if (versBSL != NULL)
+    *versBSL = session->versBSL;
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_getInfo
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_writeImage(stm8gal_session_s *session, const MemoryImage_s *image)
+
+  \param[in,out] session  session to use
+  \param[in]  image       memory image to write
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+*/
+stm8gal_error_t stm8gal_writeImage(stm8gal_session_s *session, const MemoryImage_s *image)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+
+  // check parameters and trap errors
+  if (image == NULL)
+    return STM8GAL_ERR_PARAM;
+  result = session_begin(session, true, STM8GAL_ERR_COMM);
+  if (result != STM8GAL_OK)
+    return result;
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    return session_end(session, prevTrap, &trap);
+
+  session_write(session, image);
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_writeImage
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_writeFile(stm8gal_session_s *session, const char *filename, uint64_t addrOffset)
+
+  \param[in,out] session  session to use
+  \param[in]  filename    file to import. Format is selected by extension
+  \param[in]  addrOffset  address offset for binary file (*.bin)
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+*/
+stm8gal_error_t stm8gal_writeFile(stm8gal_session_s *session, const char *filename, uint64_t addrOffset)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+  const char        *p;
+
+  // check parameters and trap errors
+  if (filename == NULL)
+    return STM8GAL_ERR_PARAM;
+  result = session_begin(session, true, STM8GAL_ERR_FILE);
+  if (result != STM8GAL_OK)
+    return result;
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    return session_end(session, prevTrap, &trap);
+
+  // import file to memory image, depending on type
+  p = strrchr(filename, '.');
+  if ((p != NULL ) && ((!strcmp(p, ".s19")) || (!strcmp(p, ".S19"))))
+    import_file_s19(filename, &(session->file), MUTE);
+  else if ((p != NULL ) && (!strcmp(p, ".hex") || (!strcmp(p, ".HEX")) || (!strcmp(p, ".ihx")) || (!strcmp(p, ".IHX"))))
+    import_file_ihx(filename, &(session->file), MUTE);
+  else if ((p != NULL ) && ((!strcmp(p, ".txt")) || (!strcmp(p, ".TXT"))))
+    import_file_txt(filename, &(session->file), MUTE);
+  else if ((p != NULL ) && ((!strcmp(p, ".bin")) || (!strcmp(p, ".BIN"))))
+    import_file_bin(filename, (MEMIMAGE_ADDR_T) addrOffset, &(session->file), MUTE);
+  else
+    Error("Input file %s has unsupported format (*.s19, *.hex, *.ihx, *.txt, *.bin)", filename);
+
+  // write imported image
+  session->errCode = STM8GAL_ERR_COMM;
+  session_write(session, &(session->file));
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_writeFile
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_read(stm8gal_session_s *session, uint64_t addrStart, uint64_t addrStop, MemoryImage_s *image)
+
+  \param[in,out] session  session to use
+  \param[in]  addrStart   first address to read
+  \param[in]  addrStop    last address to read
+  \param[out] image       memory image to add read data to
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+*/
+stm8gal_error_t stm8gal_read(stm8gal_session_s *session, uint64_t addrStart, uint64_t addrStop, MemoryImage_s *image)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+
+  // check parameters and trap errors
+  if (image == NULL)
+    return STM8GAL_ERR_PARAM;
+  result = session_begin(session, true, STM8GAL_ERR_COMM);
+  if (result != STM8GAL_OK)
+    return result;
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    return session_end(session, prevTrap, &trap);
+
+  bsl_memRead(session->ptrPort, session->config.physInterface, session->uartMode, (MEMIMAGE_ADDR_T) addrStart, (MEMIMAGE_ADDR_T) addrStop, image, MUTE);
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_read
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_eraseSector(stm8gal_session_s *session, uint64_t addr)
+
+  \param[in,out] session  session to use
+  \param[in]  addr        address within flash sector to erase
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+*/
+stm8gal_error_t stm8gal_eraseSector(stm8gal_session_s *session, uint64_t addr)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+
+  // check session and trap errors
+  result = session_begin(session, true, STM8GAL_ERR_COMM);
+  if (result != STM8GAL_OK)
+    return result;
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    return session_end(session, prevTrap, &trap);
+
+  bsl_flashSectorErase(session->ptrPort, session->config.physInterface, session->uartMode, (MEMIMAGE_ADDR_T) addr, MUTE);
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_eraseSector
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_eraseMass(stm8gal_session_s *session)
+
+  \param[in,out] session  session to use
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+*/
+stm8gal_error_t stm8gal_eraseMass(stm8gal_session_s *session)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+
+  // check session and trap errors
+  result = session_begin(session, true, STM8GAL_ERR_COMM);
+  if (result != STM8GAL_OK)
+    return result;
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    return session_end(session, prevTrap, &trap);
+
+  bsl_flashMassErase(session->ptrPort, session->config.physInterface, session->uartMode, MUTE);
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_eraseMass
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_jump(stm8gal_session_s *session, uint64_t addr)
+
+  \param[in,out] session  session to use
+  \param[in]  addr        address to jump to, e.g. PFLASH_START
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+
+  Jump to address. Afterwards the bootloader is no longer active, i.e. session is disconnected until stm8gal_reconnect()
+*/
+stm8gal_error_t stm8gal_jump(stm8gal_session_s *session, uint64_t addr)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+
+  // check session and trap errors
+  result = session_begin(session, true, STM8GAL_ERR_COMM);
+  if (result != STM8GAL_OK)
+    return result;
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0)
+    return session_end(session, prevTrap, &trap);
+
+  // don't know why, but seems to be required for SPI (see main.c)
+  if (session->config.physInterface != UART)
+    SLEEP(500);
+
+  bsl_jumpTo(session->ptrPort, session->config.physInterface, session->uartMode, (MEMIMAGE_ADDR_T) addr, MUTE);
+  session->connected = false;
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_jump
+
+
+
+/**
+  \fn stm8gal_error_t stm8gal_reconnect(stm8gal_session_s *session)
+
+  \param[in,out] session  session to reconnect
+
+  \return STM8GAL_OK on success, else error code (see stm8gal_errorMessage())
+
+  Close port, then reset and connect as in stm8gal_open(), e.g. after stm8gal_jump() or to
+  program the next device on the same port. The device identity of the previous connect is
+  confirmed with fewer probes than a full identification (see bsl_checkInfo())
+*/
+stm8gal_error_t stm8gal_reconnect(stm8gal_session_s *session)
+{
+  ErrorTrap_s       trap, *prevTrap;
+  stm8gal_error_t   result;
+
+  // check session and trap errors
+  result = session_begin(session, false, STM8GAL_ERR_PORT);
+  if (result != STM8GAL_OK)
+    return result;
+  session_closePort(session);
+  prevTrap = setErrorTrap(&trap);
+  if (setjmp(trap.env) != 0) {
+    session_closePort(session);
+    return session_end(session, prevTrap, &trap);
+  }
+  session_connect(session);
+
+  return session_end(session, prevTrap, NULL);
+
+} // stm8gal_reconnect
+
+
+// end of file
@@ -14,111 +14,77 @@
 #include <string.h>
 #include <assert.h>
 #include "main.h"
-#include "hexfile.h"
 #include "bootloader.h"
 #include "misc.h"
 #include "verify_CRC32.h"
 
-// include RAM routines for supported devices
-#include "verify_CRC32_STM8L_8k_v1.0.h"
-#include "verify_CRC32_STM8L_32k_v1.1.h"
-#include "verify_CRC32_STM8L_32k_v1.2.h"
-#include "verify_CRC32_STM8L_64k_v1.1.h"
+// include RAM routines for supported devices. Generated at build time by tools/ram_blobs.py
+#include "ram_verify_crc32.h"
+
+// CRC32 RAM routines per device
+static const RamDevice_s crcTable[] = {
+  { STM8L,   8, 0x10, &ram_verify_CRC32_STM8L_8k_v1_0 },
+  { STM8L,  16, 0x11, &ram_verify_CRC32_STM8L_32k_v1_1 },
+  { STM8L,  32, 0x11, &ram_verify_CRC32_STM8L_32k_v1_1 },
+  { STM8L,  16, 0x12, &ram_verify_CRC32_STM8L_32k_v1_2 },
+  { STM8L,  32, 0x12, &ram_verify_CRC32_STM8L_32k_v1_2 },
+  { STM8L,  64, 0x11, &ram_verify_CRC32_STM8L_64k_v1_1 },
+  { STM8S,  32, 0x12, &ram_verify_CRC32_STM8S_32k_v1_2 },
+  { STM8S,  32, 0x13, &ram_verify_CRC32_STM8S_32k_v1_3 },
+  { STM8S,  64, 0x21, &ram_verify_CRC32_STM8S_128k_v2_1 },
+  { STM8S, 128, 0x21, &ram_verify_CRC32_STM8S_128k_v2_1 },
+  { STM8S,  64, 0x22, &ram_verify_CRC32_STM8S_128k_v2_2 },
+  { STM8S, 128, 0x22, &ram_verify_CRC32_STM8S_128k_v2_2 },
+};
+
+
+/// get device dependent CRC32 RAM routine. Return NULL if device is not supported
+static const RamRoutine_s* get_crc32_code(uint8_t family, int flashsize, uint8_t versBSL)
+{
+  const RamRoutine_s  *routine;
+
+  routine = bsl_findRoutine(crcTable, sizeof(crcTable)/sizeof(crcTable[0]), family, flashsize, versBSL);
+  #ifdef DEBUG
+    if (routine != NULL)
+      printf("RAM routine %s\n", routine->name);
+  #endif
+
+  return routine;
+
+} // get_crc32_code()
+
+
+/// check if CRC32 RAM routine is available for device
+bool support_crc32(uint8_t family, int flashsize, uint8_t versBSL)
+{
+  return (get_crc32_code(family, flashsize, versBSL) != NULL);
 
-#include "verify_CRC32_STM8S_32k_v1.2.h"
-#include "verify_CRC32_STM8S_32k_v1.3.h"
-#include "verify_CRC32_STM8S_128k_v2.1.h"
-#include "verify_CRC32_STM8S_128k_v2.2.h"
+} // support_crc32()
 
 
 uint8_t upload_crc32_code(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode)
 {
-  char            *ptrRAM = NULL;     // pointer to array with RAM routines
-  int             lenRAM;             // length of RAM array
+  const RamRoutine_s  *routine;       // precompiled RAM routines
   MemoryImage_s   image;              // memory image for RAM routines
 
   // initialize memory image
   MemoryImage_init(&image);
+  ownImage(&image);
 
   // identify device dependent CRC32 RAM ihx file
-  if ((family == STM8L) && (flashsize==8) && (versBSL==0x10))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8L_8k_v1_0_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8L_8k_v1_0_ihx;
-    lenRAM = bin_verify_CRC32_STM8L_8k_v1_0_ihx_len;
-  }
-  else if ((family == STM8L) && ((flashsize==16) || (flashsize==32)) && (versBSL==0x11))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8L_32k_v1_1_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8L_32k_v1_1_ihx;
-    lenRAM = bin_verify_CRC32_STM8L_32k_v1_1_ihx_len;
-  }
-  else if ((family == STM8L) && ((flashsize==16) || (flashsize==32)) && (versBSL==0x12))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8L_32k_v1_2_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8L_32k_v1_2_ihx;
-    lenRAM = bin_verify_CRC32_STM8L_32k_v1_2_ihx_len;
-  }
-  else if ((family == STM8L) && (flashsize==64) && (versBSL==0x11))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8L_64k_v1_1_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8L_64k_v1_1_ihx;
-    lenRAM = bin_verify_CRC32_STM8L_64k_v1_1_ihx_len;
-  }
-  else if ((family == STM8S) && (flashsize==32) && (versBSL==0x12))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8S_32k_v1_2_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8S_32k_v1_2_ihx;
-    lenRAM = bin_verify_CRC32_STM8S_32k_v1_2_ihx_len;
-  }
-  else if ((family == STM8S) && (flashsize==32) && (versBSL==0x13))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8S_32k_v1_3_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8S_32k_v1_3_ihx;
-    lenRAM = bin_verify_CRC32_STM8S_32k_v1_3_ihx_len;
-  }
-  else if ((family == STM8S) && ((flashsize==64) || (flashsize==128)) && (versBSL==0x21))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8S_128k_v2_1_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8S_128k_v2_1_ihx;
-    lenRAM = bin_verify_CRC32_STM8S_128k_v2_1_ihx_len;
-  }
-  else if ((family == STM8S) && ((flashsize==64) || (flashsize==128)) && (versBSL==0x22))
-  {
-    #ifdef DEBUG
-      printf("header verify_CRC32_STM8S_128k_v2_2_ihx\n");
-    #endif
-    ptrRAM = (char*) bin_verify_CRC32_STM8S_128k_v2_2_ihx;
-    lenRAM = bin_verify_CRC32_STM8S_128k_v2_2_ihx_len;
-  }
-  else
-  {
+  routine = get_crc32_code(family, flashsize, versBSL);
+  if (routine == NULL)
     Error("bootloader does not support CRC32 verify, use read-out instead (family=%d, flash=%dkB, BL v%d)", (int) family, (int) flashsize, (int) versBSL);
-  }
 
-  // convert matching RAM array containing ihx file to RAM image. Assert C-string termination
-  ptrRAM[lenRAM] = '\0';
-  import_buffer_ihx((uint8_t*) ptrRAM, &image, MUTE);
+  // convert precompiled RAM routines to RAM image
+  bsl_routineImage(routine, &image);
 
   // upload RAM routines to STM8
-  bsl_memWrite(ptrPort, physInterface, uartMode, &image, MUTE);
+  bsl_memWrite(ptrPort, physInterface, uartMode, &image, WRITE_LOCKSTEP, MUTE);
 
   // release memory image
   MemoryImage_free(&image);
+  disown(&image);
 
   // avoid compiler warnings
   return(0);
@@ -132,6 +98,7 @@ uint8_t upload_crc32_address(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
 
   // initialize memory image
   MemoryImage_init(&image);
+  ownImage(&image);
 
   // store start addresses for CRC32 at fixed RAM address (STM8 = big endian = MSB first)
   assert(MemoryImage_addData(&image, (MEMIMAGE_ADDR_T) ADDR_START_CRC32+0, (uint8_t) (addrStart >> 24)));
@@ -146,10 +113,11 @@ uint8_t upload_crc32_address(HANDLE ptrPort, uint8_t physInterface, uint8_t uart
   assert(MemoryImage_addData(&image, (MEMIMAGE_ADDR_T) ADDR_STOP_CRC32+3, (uint8_t) (addrStop >>  0)));
 
   // upload RAM routines to STM8
-  bsl_memWrite(ptrPort, physInterface, uartMode, &image, MUTE);
+  bsl_memWrite(ptrPort, physInterface, uartMode, &image, WRITE_LOCKSTEP, MUTE);
 
   // release memory image
   MemoryImage_free(&image);
+  disown(&image);
 
   // avoid compiler warnings
   return(0);
@@ -164,6 +132,7 @@ uint8_t read_crc32(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint
 
   // initialize memory image
   MemoryImage_init(&image);
+  ownImage(&image);
 
   // read back CRC32 result (4B)
   bsl_memRead(ptrPort, physInterface, uartMode, RESULT_CRC32, RESULT_CRC32+3, &image, MUTE);
@@ -176,6 +145,7 @@ uint8_t read_crc32(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint
 
   // release memory image
   MemoryImage_free(&image);
+  disown(&image);
 
   // avoid compiler warnings
   return(0);
@@ -183,6 +153,69 @@ uint8_t read_crc32(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint
 } // read_crc32()
 
 
+/// calculate CRC32 over microcontroller memory range via RAM routine. Code must be uploaded before
+uint8_t calc_crc32(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, uint32_t *CRC32)
+{
+  // upload address range for STM8 CRC32 calculation
+  upload_crc32_address(ptrPort, physInterface, uartMode, addrStart, addrStop);
+
+  // jump to CRC32 routine in RAM
+  bsl_jumpTo(ptrPort, physInterface, uartMode, (MEMIMAGE_ADDR_T) START_CODE_CRC32, MUTE);
+
+  // for SPI interface (1=SPI_ARDUINO, 2=SPI_SPIDEV) wait sufficiently long (measured empirically)
+  if ((physInterface == 1) || (physInterface == 2))
+  {
+    //fprintf(stderr,"\ntest: %d\n", (int) (25L*(addrStop - addrStart)/1024L));
+    SLEEP(500L + 25L*(addrStop - addrStart)/1024L);
+  }
+
+  // re-synchronize after re-start of ROM-BSL
+  bsl_sync(ptrPort, physInterface, MUTE);
+
+  // For UART reset command state machine sending 0x00 until a NACK is received
+  // Procedure depends on UART mode (0=duplex, 1=1-wire, 2=2-wire reply). Tested empirically and ugly...
+  if (physInterface == 0)
+  {
+    char      Tx[2] = {0x00, 0x00}, Rx;
+    int       lenRx;
+
+    // send (wrong) GET command until NACK is received. Then state machine is ready to receive next command
+    set_timeout(ptrPort, PROBE_TIMEOUT + get_port_latency(ptrPort));
+    for (int i=0; i<5; i++)
+    {
+      if ((uartMode == 0) || (uartMode == 2))
+        send_port(ptrPort, 0, 1, Tx);         // duplex and 2-wire reply
+      else
+        send_port(ptrPort, 0, 2, Tx);         // 1-wire
+      lenRx = receive_port(ptrPort, 0, 1, &Rx);
+      SLEEP(10);
+      if ((lenRx == 1) && (Rx == NACK))
+        break;
+    }
+    set_timeout(ptrPort, TIMEOUT);
+
+    // for UART 2-wire reply mode reply NACK echo
+    if (uartMode == 2)
+      send_port(ptrPort, 0, 1, &Rx);
+
+    // required for 1-wire reply mode
+    if (uartMode == 1)
+    {
+      SLEEP(10);
+      flush_port(ptrPort);
+    }
+
+  } // UART interface
+
+  // read out CRC32 checksum from STM8
+  read_crc32(ptrPort, physInterface, uartMode, CRC32);
+
+  // avoid compiler warnings
+  return(0);
+
+} // calc_crc32()
+
+
 /// compare CRC32-IEEE over microcontroller memory vs. CRC32 over memory image
 uint8_t verify_crc32(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode, const MemoryImage_s *image, uint8_t verbose)
 {
@@ -213,59 +246,8 @@ uint8_t verify_crc32(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t vers
       printf("  CRC32 check 0x%" PRIX64 " to 0x%" PRIX64 " ... ", (uint64_t) addrStart, (uint64_t) addrEnd);
     fflush(stdout);
 
-    // upload address range for STM8 CRC32 calculation
-    upload_crc32_address(ptrPort, physInterface, uartMode, addrStart, addrEnd);
-
-    // jump to CRC32 routine in RAM
-    bsl_jumpTo(ptrPort, physInterface, uartMode, (MEMIMAGE_ADDR_T) START_CODE_CRC32, MUTE);
-
-    // for SPI interface (1=SPI_ARDUINO, 2=SPI_SPIDEV) wait sufficiently long (measured empirically)
-    if ((physInterface == 1) || (physInterface == 2))
-    {
-      //fprintf(stderr,"\ntest: %d\n", (int) (25L*(addrEnd - addrStart)/1024L));
-      SLEEP(500L + 25L*(addrEnd - addrStart)/1024L);
-    }
-
-    // re-synchronize after re-start of ROM-BSL
-    bsl_sync(ptrPort, physInterface, MUTE);
-
-    // For UART reset command state machine sending 0x00 until a NACK is received
-    // Procedure depends on UART mode (0=duplex, 1=1-wire, 2=2-wire reply). Tested empirically and ugly...
-    if (physInterface == 0)
-    {
-      char      Tx[2] = {0x00, 0x00}, Rx;
-      int       lenRx;
-
-      // send (wrong) GET command until NACK is received. Then state machine is ready to receive next command
-      set_timeout(ptrPort, 100);
-      for (int i=0; i<5; i++)
-      {
-        if ((uartMode == 0) || (uartMode == 2))
-          send_port(ptrPort, 0, 1, Tx);         // duplex and 2-wire reply
-        else
-          send_port(ptrPort, 0, 2, Tx);         // 1-wire
-        lenRx = receive_port(ptrPort, 0, 1, &Rx);
-        SLEEP(10);
-        if ((lenRx == 1) && (Rx == NACK))
-          break;
-      }
-      set_timeout(ptrPort, TIMEOUT);
-
-      // for UART 2-wire reply mode reply NACK echo
-      if (uartMode == 2)
-        send_port(ptrPort, 0, 1, &Rx);
-
-      // required for 1-wire reply mode
-      if (uartMode == 1)
-      {
-        SLEEP(10);
-        flush_port(ptrPort);
-      }
-
-    } // UART interface
-
-    // read out CRC32 checksum from STM8
-    read_crc32(ptrPort, physInterface, uartMode, &crc32_uC);
+    // calculate CRC32 checksum over range in STM8 memory
+    calc_crc32(ptrPort, physInterface, uartMode, addrStart, addrEnd, &crc32_uC);
     //printf("\nuC CRC = 0x%08" PRIX32 "\n", crc32_uC);
 
     // calculate CRC32 checksum over range memory image
@@ -0,0 +1,106 @@
+/**
+  \file fake_bsl.h
+
+  \author G. Icking-Konert
+
+  \brief emulated STM8 memory for unit tests
+
+  Replaces the bootloader and CRC32 routines used by erase_plan.c, delta.c and
+  journal.c with an emulated device memory, which counts READ, CRC32 and
+  ERASE transactions. Include once per test, together with the tested source.
+  Memory image and misc routines (incl. Error() with error trap) are compiled
+  into the test as well.
+*/
+
+#ifndef _FAKE_BSL_H_
+#define _FAKE_BSL_H_
+
+#include <string.h>
+#include "../src/memory_image.c"
+#include "../src/misc.c"
+#include "bootloader.h"
+#include "verify_CRC32.h"
+
+#define FAKE_MEM_SIZE   (PFLASH_START + 256*1024)
+
+// emulated device memory and statistics
+uint8_t   fake_mem[FAKE_MEM_SIZE];        //< device memory
+bool      fake_useCRC32 = true;           //< device supports CRC32 RAM routine
+int       fake_numRead, fake_numCRC32;    //< number of READ and CRC32 transactions
+int       fake_numSectors;                //< number of erased sectors
+uint8_t   fake_sectors[256];              //< codes of erased sectors
+bool      fake_massErase;                 //< mass erase was issued
+
+
+/// reset emulated device to given memory content
+static void fake_reset(uint8_t value)
+{
+  memset(fake_mem, value, sizeof(fake_mem));
+  fake_numRead = fake_numCRC32 = fake_numSectors = 0;
+  fake_massErase = false;
+}
+
+
+uint8_t bsl_memRead(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrStop, MemoryImage_s *image, uint8_t verbose)
+{
+  (void) ptrPort; (void) physInterface; (void) uartMode; (void) verbose;
+  fake_numRead++;
+  for (MEMIMAGE_ADDR_T addr = addrStart; addr <= addrStop; addr++)
+    MemoryImage_addData(image, addr, fake_mem[addr]);
+  return 0;
+}
+
+bool support_crc32(uint8_t family, int flashsize, uint8_t versBSL)
+{
+  (void) family; (void) flashsize; (void) versBSL;
+  return fake_useCRC32;
+}
+
+uint8_t upload_crc32_code(HANDLE ptrPort, uint8_t family, int flashsize, uint8_t versBSL, uint8_t physInterface, uint8_t uartMode)
+{
+  (void) ptrPort; (void) family; (void) flashsize; (void) versBSL; (void) physInterface; (void) uartMode;
+  return 0;
+}
+
+uint8_t calc_crc32(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint64_t addrStart, uint64_t addrStop, uint32_t *CRC32)
+{
+  MemoryImage_s   image;
+
+  (void) ptrPort; (void) physInterface; (void) uartMode;
+  fake_numCRC32++;
+  MemoryImage_init(&image);
+  for (uint64_t addr = addrStart; addr <= addrStop; addr++)
+    MemoryImage_addData(&image, (MEMIMAGE_ADDR_T) addr, fake_mem[addr]);
+  *CRC32 = MemoryImage_checksum_crc32(&image, 0, image.numEntries-1);
+  MemoryImage_free(&image);
+  return 0;
+}
+
+uint8_t bsl_uploadWriteErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, int flashsize, uint8_t versBSL, uint8_t family, uint8_t verbose)
+{
+  (void) ptrPort; (void) physInterface; (void) uartMode; (void) flashsize; (void) versBSL; (void) family; (void) verbose;
+  return 0;
+}
+
+uint8_t bsl_flashSectorsErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, const uint8_t *sectors, int numSectors, uint8_t verbose)
+{
+  (void) ptrPort; (void) physInterface; (void) uartMode; (void) verbose;
+  for (int i = 0; i < numSectors; i++)
+  {
+    fake_sectors[fake_numSectors++] = sectors[i];
+    memset(fake_mem + PFLASH_START + sectors[i]*PFLASH_BLOCKSIZE, 0x00, PFLASH_BLOCKSIZE);
+  }
+  return 0;
+}
+
+uint8_t bsl_flashMassErase(HANDLE ptrPort, uint8_t physInterface, uint8_t uartMode, uint8_t verbose)
+{
+  (void) ptrPort; (void) physInterface; (void) uartMode; (void) verbose;
+  fake_massErase = true;
+  memset(fake_mem + PFLASH_START, 0x00, 256*1024);
+  return 0;
+}
+
+#endif // _FAKE_BSL_H_
+
+// end of file
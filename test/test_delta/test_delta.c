@@ -0,0 +1,157 @@
+/**
+  \file test_delta.c
+
+  \author G. Icking-Konert
+
+  \brief unit tests of delta flashing
+
+  Tests of delta_filter() against an emulated device (see fake_bsl.h).
+  Unchanged flash blocks must be removed from the image, changed blocks,
+  RAM/EEPROM and data beyond the flash size must be kept. The CRC32
+  bisection must find changed blocks with a logarithmic number of checks.
+*/
+
+#include <unity.h>
+#include "../fake_bsl.h"
+#include "../../src/delta.c"
+
+
+/// add range with counter pattern to memory image and device
+static void add_range(MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd)
+{
+  for (MEMIMAGE_ADDR_T addr = addrStart; addr <= addrEnd; addr++)
+  {
+    MemoryImage_addData(image, addr, (uint8_t) (addr + 1));
+    fake_mem[addr] = (uint8_t) (addr + 1);
+  }
+}
+
+
+/// check that image contains exactly the given range
+static void check_range(const MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd)
+{
+  TEST_ASSERT_EQUAL(addrEnd - addrStart + 1, image->numEntries);
+  TEST_ASSERT_EQUAL(addrStart, image->memoryEntries[0].address);
+  TEST_ASSERT_EQUAL(addrEnd, image->memoryEntries[image->numEntries-1].address);
+}
+
+
+MemoryImage_s   image;
+
+void setUp(void) {
+  MemoryImage_init(&image);
+  fake_reset(0x00);
+  fake_useCRC32 = true;
+}
+
+void tearDown(void) {
+  MemoryImage_free(&image);
+}
+
+
+/// identical content -> single CRC32 check, nothing to write
+void test_unchanged(void)
+{
+  add_range(&image, 0x8000, 0x9FFF);
+  delta_filter(0, STM8S, 32, 0x22, UART, 0, &image, DELTA_PAGE, MUTE);
+  TEST_ASSERT_EQUAL(1, fake_numCRC32);
+  TEST_ASSERT_EQUAL(0, image.numEntries);
+
+} // test_unchanged()
+
+
+/// single changed byte is found via bisection
+void test_bisection(void)
+{
+  // 64 pages, 1 changed -> 1 + 2*log2(64) checks
+  add_range(&image, 0x8000, 0x9FFF);
+  fake_mem[0x8555] ^= 0xFF;
+  delta_filter(0, STM8S, 32, 0x22, UART, 0, &image, DELTA_PAGE, MUTE);
+  TEST_ASSERT_EQUAL(13, fake_numCRC32);
+  check_range(&image, 0x8500, 0x857F);
+
+  // same with sectors
+  MemoryImage_free(&image);
+  fake_reset(0x00);
+  add_range(&image, 0x8000, 0x9FFF);
+  fake_mem[0x8555] ^= 0xFF;
+  delta_filter(0, STM8S, 32, 0x22, UART, 0, &image, DELTA_SECTOR, MUTE);
+  TEST_ASSERT_EQUAL(7, fake_numCRC32);
+  check_range(&image, 0x8400, 0x87FF);
+
+} // test_bisection()
+
+
+/// changes in first and last page, unaligned range
+void test_unaligned(void)
+{
+  add_range(&image, 0x8010, 0x82EF);
+  fake_mem[0x8010] ^= 0xFF;
+  fake_mem[0x82EF] ^= 0xFF;
+  delta_filter(0, STM8S, 32, 0x22, UART, 0, &image, DELTA_PAGE, MUTE);
+  TEST_ASSERT_EQUAL(0x8010, image.memoryEntries[0].address);
+  TEST_ASSERT_EQUAL(0x807F, image.memoryEntries[0x6F].address);
+  TEST_ASSERT_EQUAL(0x8280, image.memoryEntries[0x70].address);
+  TEST_ASSERT_EQUAL(0x70 + 0x70, image.numEntries);
+
+  // short range across page boundary
+  MemoryImage_free(&image);
+  fake_reset(0x00);
+  add_range(&image, 0x8070, 0x808F);
+  fake_mem[0x8071] ^= 0xFF;
+  delta_filter(0, STM8S, 32, 0x22, UART, 0, &image, DELTA_PAGE, MUTE);
+  check_range(&image, 0x8070, 0x807F);
+
+} // test_unaligned()
+
+
+/// RAM, EEPROM and data beyond flash size are always written
+void test_outside_flash(void)
+{
+  add_range(&image, 0x0100, 0x010F);
+  add_range(&image, 0x4000, 0x400F);
+  add_range(&image, 0x8000, 0x83FF);
+  add_range(&image, 0xA000, 0xA00F);
+  delta_filter(0, STM8S, 8, 0x22, UART, 0, &image, DELTA_PAGE, MUTE);
+  TEST_ASSERT_EQUAL(3*16, image.numEntries);
+  TEST_ASSERT_EQUAL(0x4000, image.memoryEntries[16].address);
+  TEST_ASSERT_EQUAL(0xA000, image.memoryEntries[32].address);
+
+  // no flash data -> no device access
+  MemoryImage_free(&image);
+  fake_reset(0x00);
+  add_range(&image, 0x0100, 0x010F);
+  delta_filter(0, STM8S, 8, 0x22, UART, 0, &image, DELTA_PAGE, MUTE);
+  TEST_ASSERT_EQUAL(0, fake_numCRC32 + fake_numRead);
+  TEST_ASSERT_EQUAL(16, image.numEntries);
+
+} // test_outside_flash()
+
+
+/// without CRC32 routine compare via single read per range
+void test_read_back(void)
+{
+  fake_useCRC32 = false;
+  add_range(&image, 0x8000, 0x87FF);
+  add_range(&image, 0x9000, 0x907F);
+  fake_mem[0x8123] ^= 0xFF;
+  fake_mem[0x8780] ^= 0xFF;
+  delta_filter(0, STM8S, 32, 0x22, UART, 0, &image, DELTA_PAGE, MUTE);
+  TEST_ASSERT_EQUAL(2, fake_numRead);
+  TEST_ASSERT_EQUAL(0, fake_numCRC32);
+  TEST_ASSERT_EQUAL(2*128, image.numEntries);
+  TEST_ASSERT_EQUAL(0x8100, image.memoryEntries[0].address);
+  TEST_ASSERT_EQUAL(0x8780, image.memoryEntries[128].address);
+
+} // test_read_back()
+
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unchanged);
+  RUN_TEST(test_bisection);
+  RUN_TEST(test_unaligned);
+  RUN_TEST(test_outside_flash);
+  RUN_TEST(test_read_back);
+  return UNITY_END();
+}
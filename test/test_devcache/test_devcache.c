@@ -0,0 +1,166 @@
+/**
+  \file test_devcache.c
+
+  \author G. Icking-Konert
+
+  \brief unit tests of device identity cache
+
+  Tests of devcache_load() and devcache_store(): lookup by port name, update
+  of existing entries, robustness against malformed lines and replacement of
+  the oldest entry if the cache is full.
+*/
+
+#include <unity.h>
+#include "../../src/memory_image.c"
+#include "../../src/misc.c"
+#include "../../src/devcache.c"
+
+#define CACHE_FILE    "test_devcache.tmp"
+
+
+/// count lines in cache file
+static int count_lines(void)
+{
+  FILE    *fp;
+  char    line[300];
+  int     num = 0;
+
+  fp = fopen(CACHE_FILE, "r");
+  TEST_ASSERT_NOT_NULL(fp);
+  while (fgets(line, sizeof(line), fp) != NULL)
+    num++;
+  fclose(fp);
+
+  return num;
+
+} // count_lines()
+
+
+void setUp(void) {
+  remove(CACHE_FILE);
+}
+
+void tearDown(void) {
+  remove(CACHE_FILE);
+}
+
+
+/// missing file or port -> not found
+void test_not_found(void)
+{
+  int       flashsize = -1;
+  uint8_t   versBSL = 0, family = 0;
+
+  TEST_ASSERT_FALSE(devcache_load(CACHE_FILE, "/dev/ttyUSB0", &flashsize, &versBSL, &family));
+  devcache_store(CACHE_FILE, "/dev/ttyUSB0", 32, 0x13, STM8S);
+  TEST_ASSERT_FALSE(devcache_load(CACHE_FILE, "/dev/ttyUSB1", &flashsize, &versBSL, &family));
+  TEST_ASSERT_FALSE(devcache_load(CACHE_FILE, "/dev/ttyUSB", &flashsize, &versBSL, &family));
+  TEST_ASSERT_EQUAL(-1, flashsize);
+
+} // test_not_found()
+
+
+/// stored identity is found per port
+void test_store_load(void)
+{
+  int       flashsize;
+  uint8_t   versBSL, family;
+
+  devcache_store(CACHE_FILE, "/dev/ttyUSB0", 32, 0x13, STM8S);
+  devcache_store(CACHE_FILE, "COM12", 64, 0x11, STM8L);
+
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "/dev/ttyUSB0", &flashsize, &versBSL, &family));
+  TEST_ASSERT_EQUAL(32, flashsize);
+  TEST_ASSERT_EQUAL_HEX8(0x13, versBSL);
+  TEST_ASSERT_EQUAL(STM8S, family);
+
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "COM12", &flashsize, &versBSL, &family));
+  TEST_ASSERT_EQUAL(64, flashsize);
+  TEST_ASSERT_EQUAL_HEX8(0x11, versBSL);
+  TEST_ASSERT_EQUAL(STM8L, family);
+
+} // test_store_load()
+
+
+/// changed device replaces entry of port
+void test_update(void)
+{
+  int       flashsize;
+  uint8_t   versBSL, family;
+
+  devcache_store(CACHE_FILE, "/dev/ttyUSB0", 32, 0x13, STM8S);
+  devcache_store(CACHE_FILE, "/dev/ttyUSB1", 8, 0x10, STM8L);
+  devcache_store(CACHE_FILE, "/dev/ttyUSB0", 128, 0x22, STM8S);
+  TEST_ASSERT_EQUAL(1 + 2, count_lines());
+
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "/dev/ttyUSB0", &flashsize, &versBSL, &family));
+  TEST_ASSERT_EQUAL(128, flashsize);
+  TEST_ASSERT_EQUAL_HEX8(0x22, versBSL);
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "/dev/ttyUSB1", &flashsize, &versBSL, &family));
+  TEST_ASSERT_EQUAL(8, flashsize);
+
+} // test_update()
+
+
+/// comments and malformed lines are skipped and dropped on next store
+void test_malformed(void)
+{
+  FILE      *fp;
+  int       flashsize;
+  uint8_t   versBSL, family;
+
+  fp = fopen(CACHE_FILE, "w");
+  TEST_ASSERT_NOT_NULL(fp);
+  fprintf(fp, "# comment\n");
+  fprintf(fp, "/dev/ttyUSB0 STM8X 32 0x13\n");
+  fprintf(fp, "/dev/ttyUSB1 STM8S 32\n");
+  fprintf(fp, "\n");
+  fprintf(fp, "/dev/ttyUSB2 STM8S 32 0x13\n");
+  fclose(fp);
+
+  TEST_ASSERT_FALSE(devcache_load(CACHE_FILE, "/dev/ttyUSB0", &flashsize, &versBSL, &family));
+  TEST_ASSERT_FALSE(devcache_load(CACHE_FILE, "/dev/ttyUSB1", &flashsize, &versBSL, &family));
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "/dev/ttyUSB2", &flashsize, &versBSL, &family));
+
+  devcache_store(CACHE_FILE, "/dev/ttyUSB3", 8, 0x10, STM8L);
+  TEST_ASSERT_EQUAL(1 + 2, count_lines());
+
+} // test_malformed()
+
+
+/// full cache replaces oldest entry
+void test_full(void)
+{
+  char      name[20];
+  int       flashsize;
+  uint8_t   versBSL, family;
+
+  for (int i = 0; i <= DEVCACHE_MAX; i++)
+  {
+    snprintf(name, sizeof(name), "port%d", i);
+    devcache_store(CACHE_FILE, name, 32, 0x13, STM8S);
+  }
+  TEST_ASSERT_EQUAL(1 + DEVCACHE_MAX, count_lines());
+  TEST_ASSERT_FALSE(devcache_load(CACHE_FILE, "port0", &flashsize, &versBSL, &family));
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "port1", &flashsize, &versBSL, &family));
+  snprintf(name, sizeof(name), "port%d", DEVCACHE_MAX);
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, name, &flashsize, &versBSL, &family));
+
+  // update in full cache keeps all other entries
+  devcache_store(CACHE_FILE, "port1", 64, 0x22, STM8S);
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "port2", &flashsize, &versBSL, &family));
+  TEST_ASSERT_TRUE(devcache_load(CACHE_FILE, "port1", &flashsize, &versBSL, &family));
+  TEST_ASSERT_EQUAL(64, flashsize);
+
+} // test_full()
+
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_not_found);
+  RUN_TEST(test_store_load);
+  RUN_TEST(test_update);
+  RUN_TEST(test_malformed);
+  RUN_TEST(test_full);
+  return UNITY_END();
+}
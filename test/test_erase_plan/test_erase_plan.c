@@ -0,0 +1,158 @@
+/**
+  \file test_erase_plan.c
+
+  \author G. Icking-Konert
+
+  \brief unit tests of flash erase planner
+
+  Tests of the sector selection in erase_plan.c against an emulated device
+  (see fake_bsl.h). Only sectors completely covered by the image may be
+  erased, partly covered sectors must keep their other bytes.
+*/
+
+#include <unity.h>
+#include "../fake_bsl.h"
+#include "../../src/erase_plan.c"
+
+
+/// add range with counter pattern to memory image
+static void add_range(MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd)
+{
+  for (MEMIMAGE_ADDR_T addr = addrStart; addr <= addrEnd; addr++)
+    MemoryImage_addData(image, addr, (uint8_t) (addr + 1));
+}
+
+
+MemoryImage_s   image;
+
+void setUp(void) {
+  MemoryImage_init(&image);
+  fake_reset(0x55);
+  fake_useCRC32 = true;
+}
+
+void tearDown(void) {
+  MemoryImage_free(&image);
+}
+
+
+/// single byte, e.g. via -W, covers no sector
+void test_single_byte(void)
+{
+  bool    plan[256];
+  int     numPartial;
+
+  MemoryImage_addData(&image, 0x8123, 0xAA);
+  TEST_ASSERT_EQUAL(0, erase_plan_sectors(&image, 32, plan, &numPartial));
+  TEST_ASSERT_EQUAL(1, numPartial);
+
+  // other bytes of sector are kept
+  erase_plan(0, STM8S, 32, 0x22, UART, 0, &image, ERASE_PLAN_SECTORS, MUTE);
+  TEST_ASSERT_EQUAL(0, fake_numSectors);
+  TEST_ASSERT_EQUAL_HEX8(0x55, fake_mem[0x8000]);
+  TEST_ASSERT_EQUAL_HEX8(0x55, fake_mem[0x83FF]);
+
+} // test_single_byte()
+
+
+/// only completely covered sectors are erased
+void test_partial_sectors(void)
+{
+  bool    plan[256];
+  int     numPartial;
+
+  // 0x8200-0x8DFF: sector 0 and 3 partly, 1 and 2 completely covered
+  add_range(&image, 0x8200, 0x8DFF);
+  TEST_ASSERT_EQUAL(2, erase_plan_sectors(&image, 32, plan, &numPartial));
+  TEST_ASSERT_EQUAL(2, numPartial);
+  TEST_ASSERT_FALSE(plan[0]);
+  TEST_ASSERT_TRUE(plan[1]);
+  TEST_ASSERT_TRUE(plan[2]);
+  TEST_ASSERT_FALSE(plan[3]);
+
+  erase_plan(0, STM8S, 32, 0x22, UART, 0, &image, ERASE_PLAN_SECTORS, MUTE);
+  TEST_ASSERT_EQUAL(2, fake_numSectors);
+  TEST_ASSERT_EQUAL(1, fake_sectors[0]);
+  TEST_ASSERT_EQUAL(2, fake_sectors[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x55, fake_mem[0x81FF]);
+  TEST_ASSERT_EQUAL_HEX8(0x55, fake_mem[0x8E00]);
+
+  // sector with a gap of 1 byte is not covered
+  MemoryImage_deleteData(&image, 0x8500);
+  TEST_ASSERT_EQUAL(1, erase_plan_sectors(&image, 32, plan, &numPartial));
+  TEST_ASSERT_FALSE(plan[1]);
+
+} // test_partial_sectors()
+
+
+/// RAM, EEPROM and addresses beyond flash size are ignored
+void test_outside_flash(void)
+{
+  bool    plan[256];
+  int     numPartial;
+
+  add_range(&image, 0x0000, 0x03FF);
+  add_range(&image, 0x4000, 0x43FF);
+  add_range(&image, 0x8000 + 8*1024, 0x8000 + 9*1024 - 1);
+  TEST_ASSERT_EQUAL(0, erase_plan_sectors(&image, 8, plan, &numPartial));
+  TEST_ASSERT_EQUAL(0, numPartial);
+  TEST_ASSERT_EQUAL(1, erase_plan_sectors(&image, 32, plan, &numPartial));
+  TEST_ASSERT_TRUE(plan[8]);
+
+} // test_outside_flash()
+
+
+/// blank sectors are skipped, checked via CRC32 or read-back
+void test_skip_blank(void)
+{
+  add_range(&image, 0x8000, 0x8FFF);
+  memset(fake_mem + 0x8400, 0x00, 0x800);       // sectors 1+2 blank
+
+  erase_plan(0, STM8S, 32, 0x22, UART, 0, &image, ERASE_PLAN_BLANK, MUTE);
+  TEST_ASSERT_EQUAL(1, fake_numCRC32);          // single run of 4 sectors
+  TEST_ASSERT_EQUAL(4, fake_numSectors);        // run not blank -> erase all
+
+  // separate runs: sectors 0 and 2, of which 2 is blank
+  MemoryImage_free(&image);
+  fake_reset(0x55);
+  add_range(&image, 0x8000, 0x83FF);
+  add_range(&image, 0x8800, 0x8BFF);
+  memset(fake_mem + 0x8800, 0x00, 0x400);
+  fake_useCRC32 = false;
+  erase_plan(0, STM8S, 32, 0x22, UART, 0, &image, ERASE_PLAN_BLANK, MUTE);
+  TEST_ASSERT_EQUAL(2, fake_numRead);
+  TEST_ASSERT_EQUAL(1, fake_numSectors);
+  TEST_ASSERT_EQUAL(0, fake_sectors[0]);
+
+} // test_skip_blank()
+
+
+/// mass erase only if faster and allowed
+void test_mass_erase(void)
+{
+  add_range(&image, 0x8000, 0x8000 + 8*1024 - 1);
+
+  erase_plan(0, STM8S, 8, 0x22, UART, 0, &image, ERASE_PLAN_MASS, MUTE);
+  TEST_ASSERT_TRUE(fake_massErase);
+  TEST_ASSERT_EQUAL(0, fake_numSectors);
+
+  // 1 sector of 32kB -> sector erase
+  MemoryImage_free(&image);
+  fake_reset(0x55);
+  add_range(&image, 0x8000, 0x83FF);
+  erase_plan(0, STM8S, 32, 0x22, UART, 0, &image, ERASE_PLAN_MASS, MUTE);
+  TEST_ASSERT_FALSE(fake_massErase);
+  TEST_ASSERT_EQUAL(1, fake_numSectors);
+
+} // test_mass_erase()
+
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_byte);
+  RUN_TEST(test_partial_sectors);
+  RUN_TEST(test_outside_flash);
+  RUN_TEST(test_skip_blank);
+  RUN_TEST(test_mass_erase);
+  return UNITY_END();
+}
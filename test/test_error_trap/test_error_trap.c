@@ -0,0 +1,159 @@
+/**
+  \file test_error_trap.c
+
+  \author G. Icking-Konert
+
+  \brief unit tests of error traps
+
+  Tests of setErrorTrap(), Error() and owned buffers in misc.c. Error() must
+  return to the innermost active trap and release only the buffers owned
+  since that trap was set. Restoring an enclosing trap, also across several
+  levels, must not modify the stack of active traps.
+*/
+
+#include <unity.h>
+#include "../../src/memory_image.c"
+#include "../../src/misc.c"
+
+
+/// add single byte to memory image and register image for release on error
+static void own_image(MemoryImage_s *image)
+{
+  MemoryImage_init(image);
+  MemoryImage_addData(image, 0x8000, 0xAA);
+  ownImage(image);
+}
+
+
+// failed test may leave traps of its (released) stack frame -> reset directly
+void setUp(void) {
+  s_errorTrap = NULL;
+  s_numOwned = 0;
+}
+
+void tearDown(void) {
+}
+
+
+/// Error() returns to trap with message
+void test_single(void)
+{
+  ErrorTrap_s       trap;
+  volatile int      numErrors = 0;
+
+  TEST_ASSERT_NULL(setErrorTrap(&trap));
+  if (setjmp(trap.env) == 0)
+    Error("code %d", 42);
+  else
+    numErrors++;
+  TEST_ASSERT_EQUAL(1, numErrors);
+  TEST_ASSERT_EQUAL_STRING("code 42", trap.msg);
+  TEST_ASSERT_NULL(trap.prev);
+  setErrorTrap(NULL);
+
+} // test_single()
+
+
+/// nested traps, Error() returns to innermost trap and releases its buffers only
+void test_nested(void)
+{
+  ErrorTrap_s       outer, inner, *prev;
+  MemoryImage_s     imgOuter, imgInner;
+  volatile int      numOuter = 0, numInner = 0;
+
+  setErrorTrap(&outer);
+  if (setjmp(outer.env) != 0)
+    numOuter++;
+  else
+  {
+    own_image(&imgOuter);
+    prev = setErrorTrap(&inner);
+    TEST_ASSERT_TRUE(prev == &outer);
+    TEST_ASSERT_TRUE(inner.prev == &outer);
+    if (setjmp(inner.env) == 0)
+    {
+      own_image(&imgInner);
+      Error("inner");
+    }
+    numInner++;
+    TEST_ASSERT_EQUAL(0, imgInner.numEntries);      // released
+    TEST_ASSERT_EQUAL(1, imgOuter.numEntries);      // kept
+    TEST_ASSERT_EQUAL(1, s_numOwned);
+
+    // restore enclosing trap -> next error returns there
+    TEST_ASSERT_TRUE(setErrorTrap(prev) == &inner);
+    Error("outer");
+  }
+  TEST_ASSERT_EQUAL(1, numInner);
+  TEST_ASSERT_EQUAL(1, numOuter);
+  TEST_ASSERT_EQUAL_STRING("outer", outer.msg);
+  TEST_ASSERT_EQUAL(0, imgOuter.numEntries);
+  TEST_ASSERT_EQUAL(0, s_numOwned);
+  setErrorTrap(NULL);
+
+} // test_nested()
+
+
+/// retry pattern: trap stays set after Error() and is re-entered
+void test_retry(void)
+{
+  ErrorTrap_s       outer, inner;
+  volatile int      numRetry = 0;
+
+  setErrorTrap(&outer);
+  setErrorTrap(&inner);
+  if (setjmp(inner.env) != 0)
+    numRetry++;
+  if (numRetry < 3)
+    Error("retry %d", numRetry);
+
+  // setting the active trap again doesn't change the stack
+  setErrorTrap(&inner);
+  TEST_ASSERT_TRUE(inner.prev == &outer);
+  TEST_ASSERT_TRUE(setErrorTrap(&outer) == &inner);
+  TEST_ASSERT_NULL(outer.prev);
+  TEST_ASSERT_EQUAL(3, numRetry);
+  setErrorTrap(NULL);
+
+} // test_retry()
+
+
+/// restore trap across several levels, then push same traps again
+void test_skip_levels(void)
+{
+  ErrorTrap_s       a, b, c;
+  volatile int      numA = 0;
+
+  setErrorTrap(&a);
+  setErrorTrap(&b);
+  setErrorTrap(&c);
+
+  // restore a, skipping b -> a must not become enclosed by c
+  TEST_ASSERT_TRUE(setErrorTrap(&a) == &c);
+  TEST_ASSERT_NULL(a.prev);
+  if (setjmp(a.env) == 0)
+    Error("a");
+  else
+    numA++;
+  TEST_ASSERT_EQUAL(1, numA);
+
+  // b and c are no longer active -> pushed again with new enclosing trap
+  setErrorTrap(&c);
+  TEST_ASSERT_TRUE(c.prev == &a);
+  setErrorTrap(&b);
+  TEST_ASSERT_TRUE(b.prev == &c);
+
+  // clear all traps
+  TEST_ASSERT_TRUE(setErrorTrap(NULL) == &b);
+
+} // test_skip_levels()
+
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_single);
+  RUN_TEST(test_nested);
+  RUN_TEST(test_retry);
+  RUN_TEST(test_skip_levels);
+  return UNITY_END();
+}
@@ -0,0 +1,264 @@
+/**
+  \file test_journal.c
+
+  \author G. Icking-Konert
+
+  \brief unit tests of progress journal
+
+  Tests of journal header parsing, resume trimming and recorded erase against
+  an emulated device (see fake_bsl.h). A resume must only skip pages which are
+  confirmed in the journal and verified on the device, and must be refused if
+  the erase or alignment options changed, as these could destroy confirmed pages.
+*/
+
+#include <unity.h>
+#include "../fake_bsl.h"
+#include "../../src/erase_plan.c"
+#include "../../src/journal.c"
+
+#define JOURNAL_FILE    "test_journal.tmp"
+
+
+/// add range with counter pattern to memory image
+static void add_range(MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd)
+{
+  for (MEMIMAGE_ADDR_T addr = addrStart; addr <= addrEnd; addr++)
+    MemoryImage_addData(image, addr, (uint8_t) (addr + 1));
+}
+
+
+/// simulate interrupted upload: copy image to device and confirm pages of range in journal
+static void interrupted(const MemoryImage_s *image, MEMIMAGE_ADDR_T addrStart, MEMIMAGE_ADDR_T addrEnd, uint8_t erasePlan)
+{
+  Journal_s   journal;
+
+  journal_begin(&journal, JOURNAL_FILE, image, erasePlan, ALIGN_NONE, 0x00, MUTE);
+  if (erasePlan != ERASE_PLAN_OFF)
+    journal_erased(&journal, image, 32);
+  for (MEMIMAGE_ADDR_T addr = addrStart; addr <= addrEnd; addr += 128)
+  {
+    for (int i = 0; i < 128; i++)
+      fake_mem[addr+i] = (uint8_t) (addr + i + 1);
+    journal_pageDone(&journal, addr, 128);
+  }
+  journal_end(&journal, false);
+
+} // interrupted()
+
+
+/// call journal_begin() and return true if it reports an error
+static bool begin_fails(Journal_s *journal, const MemoryImage_s *image, uint8_t erasePlan, uint8_t alignMode, uint8_t alignPad)
+{
+  ErrorTrap_s     trap;
+  volatile bool   failed = false;
+
+  setErrorTrap(&trap);
+  if (setjmp(trap.env) == 0)
+    journal_begin(journal, JOURNAL_FILE, image, erasePlan, alignMode, alignPad, MUTE);
+  else
+    failed = true;
+  setErrorTrap(NULL);
+
+  return failed;
+
+} // begin_fails()
+
+
+/// read journal file
+static const char *read_journal(void)
+{
+  static char   buf[4096];
+  FILE          *fp;
+  size_t        len;
+
+  fp = fopen(JOURNAL_FILE, "r");
+  TEST_ASSERT_NOT_NULL(fp);
+  len = fread(buf, 1, sizeof(buf)-1, fp);
+  buf[len] = '\0';
+  fclose(fp);
+
+  return buf;
+
+} // read_journal()
+
+
+MemoryImage_s   image;
+
+void setUp(void) {
+  MemoryImage_init(&image);
+  add_range(&image, 0x8000, 0x8FFF);
+  fake_reset(0x00);
+  fake_useCRC32 = true;
+  remove(JOURNAL_FILE);
+}
+
+void tearDown(void) {
+  MemoryImage_free(&image);
+  remove(JOURNAL_FILE);
+}
+
+
+/// new journal records image checksum and options
+void test_header(void)
+{
+  Journal_s   journal;
+  char        expect[100];
+
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_BLANK, ALIGN_PAD, 0xAB, MUTE);
+  TEST_ASSERT_EQUAL(0, journal.confirmed.numEntries);
+  TEST_ASSERT_FALSE(journal.erased);
+  journal_end(&journal, false);
+
+  snprintf(expect, sizeof(expect), "image %08X 4096\noptions erase 2 align 1 AB\n", MemoryImage_checksum_crc32(&image, 0, 4095));
+  TEST_ASSERT_NOT_NULL(strstr(read_journal(), expect));
+
+  // completed upload deletes journal
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_BLANK, ALIGN_PAD, 0xAB, MUTE);
+  journal_end(&journal, true);
+  TEST_ASSERT_NULL(fopen(JOURNAL_FILE, "r"));
+
+} // test_header()
+
+
+/// progress of same image is loaded, of different image discarded
+void test_load(void)
+{
+  Journal_s   journal;
+
+  interrupted(&image, 0x8000, 0x85FF, ERASE_PLAN_SECTORS);
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_SECTORS, ALIGN_NONE, 0x00, MUTE);
+  TEST_ASSERT_EQUAL(0x600, journal.confirmed.numEntries);
+  TEST_ASSERT_TRUE(journal.erased);
+  journal_end(&journal, false);
+
+  // different image -> start new journal
+  MemoryImage_addData(&image, 0x9000, 0x00);
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_SECTORS, ALIGN_NONE, 0x00, MUTE);
+  TEST_ASSERT_EQUAL(0, journal.confirmed.numEntries);
+  TEST_ASSERT_FALSE(journal.erased);
+  journal_end(&journal, false);
+  TEST_ASSERT_NULL(strstr(read_journal(), "page"));
+
+} // test_load()
+
+
+/// resume with different erase or align options is refused
+void test_options(void)
+{
+  Journal_s   journal;
+
+  interrupted(&image, 0x8000, 0x85FF, ERASE_PLAN_OFF);
+  TEST_ASSERT_TRUE(begin_fails(&journal, &image, ERASE_PLAN_SECTORS, ALIGN_NONE, 0x00));
+  TEST_ASSERT_TRUE(begin_fails(&journal, &image, ERASE_PLAN_OFF, ALIGN_READ, 0x00));
+
+  // pad value only matters with ALIGN_PAD
+  TEST_ASSERT_FALSE(begin_fails(&journal, &image, ERASE_PLAN_OFF, ALIGN_NONE, 0x55));
+  journal_end(&journal, false);
+
+  // journal is kept for resume with original options
+  TEST_ASSERT_FALSE(begin_fails(&journal, &image, ERASE_PLAN_OFF, ALIGN_NONE, 0x00));
+  TEST_ASSERT_EQUAL(0x600, journal.confirmed.numEntries);
+  journal_end(&journal, false);
+
+} // test_options()
+
+
+/// confirmed pages are removed from image only if device content matches
+void test_resume(void)
+{
+  Journal_s   journal;
+
+  interrupted(&image, 0x8000, 0x85FF, ERASE_PLAN_OFF);
+
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_OFF, ALIGN_NONE, 0x00, MUTE);
+  journal_resume(&journal, 0, STM8S, 32, 0x22, UART, 0, &image, MUTE);
+  journal_end(&journal, false);
+  TEST_ASSERT_EQUAL(1, fake_numCRC32);
+  TEST_ASSERT_EQUAL(0x1000 - 0x600, image.numEntries);
+  TEST_ASSERT_EQUAL(0x8600, image.memoryEntries[0].address);
+
+  // same via read-back
+  MemoryImage_free(&image);
+  add_range(&image, 0x8000, 0x8FFF);
+  fake_useCRC32 = false;
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_OFF, ALIGN_NONE, 0x00, MUTE);
+  journal_resume(&journal, 0, STM8S, 32, 0x22, UART, 0, &image, MUTE);
+  journal_end(&journal, false);
+  TEST_ASSERT_EQUAL(1, fake_numRead);
+  TEST_ASSERT_EQUAL(0x1000 - 0x600, image.numEntries);
+
+} // test_resume()
+
+
+/// confirmed range with device mismatch is written again
+void test_resume_mismatch(void)
+{
+  Journal_s   journal;
+
+  interrupted(&image, 0x8000, 0x85FF, ERASE_PLAN_OFF);
+  fake_mem[0x8281] ^= 0xFF;
+
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_OFF, ALIGN_NONE, 0x00, MUTE);
+  journal_resume(&journal, 0, STM8S, 32, 0x22, UART, 0, &image, MUTE);
+  journal_end(&journal, false);
+  TEST_ASSERT_EQUAL(0x1000, image.numEntries);
+
+} // test_resume_mismatch()
+
+
+/// erase is recorded for covered sectors only and not repeated on resume
+void test_erase(void)
+{
+  Journal_s   journal;
+  const char  *text;
+
+  // 0x8000-0x8FFF and 1 byte in sector 5
+  MemoryImage_addData(&image, 0x9400, 0x00);
+  interrupted(&image, 0x8000, 0x83FF, ERASE_PLAN_SECTORS);
+  text = read_journal();
+  TEST_ASSERT_NOT_NULL(strstr(text, "erase 0\nerase 1\nerase 2\nerase 3\npage"));
+  TEST_ASSERT_NULL(strstr(text, "erase 5"));
+
+  // resume: sector 0 confirmed, erase not repeated
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_SECTORS, ALIGN_NONE, 0x00, MUTE);
+  journal_resume(&journal, 0, STM8S, 32, 0x22, UART, 0, &image, MUTE);
+  TEST_ASSERT_TRUE(journal.erased);
+  TEST_ASSERT_EQUAL(0x8400, image.memoryEntries[0].address);
+  journal_end(&journal, false);
+
+} // test_erase()
+
+
+/// erase on resume keeps confirmed pages
+void test_erase_after_resume(void)
+{
+  Journal_s   journal;
+
+  // pages 0x8000-0x85FF confirmed, erase of previous run not recorded
+  interrupted(&image, 0x8000, 0x85FF, ERASE_PLAN_SECTORS);
+  journal_begin(&journal, JOURNAL_FILE, &image, ERASE_PLAN_SECTORS, ALIGN_NONE, 0x00, MUTE);
+  journal.erased = false;
+
+  // trimmed image partly covers sector 1 -> only sectors 2+3 are erased
+  journal_resume(&journal, 0, STM8S, 32, 0x22, UART, 0, &image, MUTE);
+  erase_plan(0, STM8S, 32, 0x22, UART, 0, &image, ERASE_PLAN_SECTORS, MUTE);
+  journal_end(&journal, false);
+  TEST_ASSERT_EQUAL(2, fake_numSectors);
+  TEST_ASSERT_EQUAL(2, fake_sectors[0]);
+  TEST_ASSERT_EQUAL(3, fake_sectors[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x86, fake_mem[0x8585]);
+
+} // test_erase_after_resume()
+
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_header);
+  RUN_TEST(test_load);
+  RUN_TEST(test_options);
+  RUN_TEST(test_resume);
+  RUN_TEST(test_resume_mismatch);
+  RUN_TEST(test_erase);
+  RUN_TEST(test_erase_after_resume);
+  return UNITY_END();
+}
@@ -0,0 +1,235 @@
+/**
+  \file test_lz.c
+
+  \author G. Icking-Konert
+
+  \brief unit tests of LZ compression for stage-2 frames
+
+  Round-trip and golden vector tests of lz_compress() and lz_decompress(),
+  incl. corner cases of the format (see lz.h). The golden vectors also
+  specify the input of the STM8 decompressor in the stage-2 loader.
+*/
+
+#include <unity.h>
+#include <string.h>
+#include "lz.h"
+
+// lz.c is pure C without dependencies -> compile into test (no test_build_src)
+#include "../../src/lz.c"
+
+#define BUF_SIZE  2048
+
+
+/// compress and decompress buffer, check result and return compressed length
+static int round_trip(const uint8_t *src, int len)
+{
+  uint8_t   packed[BUF_SIZE], unpacked[BUF_SIZE];
+  int       lenPacked;
+
+  lenPacked = lz_compress(src, len, packed, sizeof(packed));
+  TEST_ASSERT_GREATER_OR_EQUAL(0, lenPacked);
+  TEST_ASSERT_EQUAL(len, lz_decompress(packed, lenPacked, unpacked, sizeof(unpacked)));
+  if (len > 0)
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(src, unpacked, len);
+
+  return lenPacked;
+
+} // round_trip()
+
+
+/// compress buffer and compare with expected result, then decompress
+static void golden(const uint8_t *src, int len, const uint8_t *expect, int lenExpect)
+{
+  uint8_t   packed[BUF_SIZE];
+
+  TEST_ASSERT_EQUAL(lenExpect, lz_compress(src, len, packed, sizeof(packed)));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expect, packed, lenExpect);
+  TEST_ASSERT_EQUAL(lenExpect, round_trip(src, len));
+
+} // golden()
+
+
+/// fill buffer with pseudo-random data (LCG)
+static void random_fill(uint8_t *buf, int len, uint32_t seed)
+{
+  for (int i = 0; i < len; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    buf[i] = (uint8_t) (seed >> 16);
+  }
+
+} // random_fill()
+
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+
+/// empty input compresses and decompresses to nothing
+void test_empty(void)
+{
+  uint8_t   buf[4] = {0};
+
+  TEST_ASSERT_EQUAL(0, lz_compress(buf, 0, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL(0, lz_decompress(buf, 0, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL(0, lz_compress(buf, 0, NULL, 0));
+
+} // test_empty()
+
+
+/// fixed encodings of short inputs
+void test_golden(void)
+{
+  const uint8_t   lit[]        = {'a', 'b'};
+  const uint8_t   litPack[]    = {0x01, 'a', 'b'};
+  const uint8_t   rep[]        = {'a', 'b', 'c', 'a', 'b', 'c', 'a', 'b', 'c'};
+  const uint8_t   repPack[]    = {0x02, 'a', 'b', 'c', 0x83, 0x02};
+  const uint8_t   fill[]       = {'a', 'a', 'a', 'a', 'a', 'a', 'a', 'a'};
+  const uint8_t   fillPack[]   = {0x00, 'a', 0x84, 0x00};
+  const uint8_t   mix[]        = {'x', 'y', 'x', 'y', 'x', 'y', 'z'};
+  const uint8_t   mixPack[]    = {0x01, 'x', 'y', 0x81, 0x01, 0x00, 'z'};
+  const uint8_t   short2[]     = {'a', 'b', 'a', 'b'};
+  const uint8_t   short2Pack[] = {0x03, 'a', 'b', 'a', 'b'};
+  const uint8_t   near[]       = {'a', 'b', 'c', 'X', 'a', 'b', 'c', 'Y', 'a', 'b', 'c'};
+  const uint8_t   nearPack[]   = {0x03, 'a', 'b', 'c', 'X', 0x80, 0x03, 0x00, 'Y', 0x80, 0x03};
+
+  golden(lit, sizeof(lit), litPack, sizeof(litPack));
+  golden(rep, sizeof(rep), repPack, sizeof(repPack));
+  golden(fill, sizeof(fill), fillPack, sizeof(fillPack));
+  golden(mix, sizeof(mix), mixPack, sizeof(mixPack));
+  golden(short2, sizeof(short2), short2Pack, sizeof(short2Pack));   // match of 2 is coded as literals
+  golden(near, sizeof(near), nearPack, sizeof(nearPack));           // nearest of equal matches
+
+} // test_golden()
+
+
+/// incompressible data expands by 1 control byte per 128 literals
+void test_incompressible(void)
+{
+  uint8_t   src[256], packed[BUF_SIZE];
+  int       lenPacked;
+
+  for (int i = 0; i < 256; i++)
+    src[i] = (uint8_t) i;
+  lenPacked = lz_compress(src, sizeof(src), packed, sizeof(packed));
+  TEST_ASSERT_EQUAL(258, lenPacked);
+  TEST_ASSERT_EQUAL_HEX8(LZ_MAX_LITERAL-1, packed[0]);
+  TEST_ASSERT_EQUAL_HEX8(LZ_MAX_LITERAL-1, packed[1+LZ_MAX_LITERAL]);
+  TEST_ASSERT_EQUAL(258, round_trip(src, sizeof(src)));
+
+  // output buffer too small
+  TEST_ASSERT_EQUAL(-1, lz_compress(src, sizeof(src), packed, 257));
+
+  // random data doesn't expand more
+  random_fill(src, sizeof(src), 1);
+  TEST_ASSERT_LESS_OR_EQUAL(258, round_trip(src, sizeof(src)));
+
+} // test_incompressible()
+
+
+/// long runs are split into matches of max. length with offset 1
+void test_long_run(void)
+{
+  uint8_t   src[1000], packed[BUF_SIZE];
+
+  // 1 literal + 7 matches of 130 + 1 match of 89
+  memset(src, 0xFF, sizeof(src));
+  TEST_ASSERT_EQUAL(18, lz_compress(src, sizeof(src), packed, sizeof(packed)));
+  TEST_ASSERT_EQUAL_HEX8(0x00, packed[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, packed[1]);
+  for (int i = 0; i < 7; i++)
+  {
+    TEST_ASSERT_EQUAL_HEX8(0x80 | (LZ_MAX_MATCH-LZ_MIN_MATCH), packed[2+2*i]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, packed[3+2*i]);
+  }
+  TEST_ASSERT_EQUAL_HEX8(0x80 | (89-LZ_MIN_MATCH), packed[16]);
+  TEST_ASSERT_EQUAL(18, round_trip(src, sizeof(src)));
+
+  // run of max. match length + 1 literal
+  TEST_ASSERT_EQUAL(4, round_trip(src, LZ_MAX_MATCH+1));
+
+} // test_long_run()
+
+
+/// match with max. offset, and no match beyond window
+void test_max_offset(void)
+{
+  uint8_t   src[300], packed[BUF_SIZE];
+
+  // 0..255, then 0..3 -> only match has offset 256
+  for (int i = 0; i < 256; i++)
+    src[i] = (uint8_t) i;
+  for (int i = 0; i < 4; i++)
+    src[256+i] = (uint8_t) i;
+  TEST_ASSERT_EQUAL(260, lz_compress(src, 260, packed, sizeof(packed)));
+  TEST_ASSERT_EQUAL_HEX8(0x80 | (4-LZ_MIN_MATCH), packed[258]);
+  TEST_ASSERT_EQUAL_HEX8(LZ_WINDOW-1, packed[259]);
+  TEST_ASSERT_EQUAL(260, round_trip(src, 260));
+
+  // 'abc' + 254x 0x00 + 'abc' -> offset 257 is outside window, i.e. 'abc' is coded as literals
+  memcpy(src, "abc", 3);
+  memset(src+3, 0x00, 254);
+  memcpy(src+257, "abc", 3);
+  TEST_ASSERT_EQUAL(13, lz_compress(src, 260, packed, sizeof(packed)));
+  TEST_ASSERT_EQUAL_HEX8(0x02, packed[9]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY("abc", packed+10, 3);
+  TEST_ASSERT_EQUAL(13, round_trip(src, 260));
+
+} // test_max_offset()
+
+
+/// random data with runs and repetitions of all frame sizes
+void test_round_trip(void)
+{
+  uint8_t   src[600];
+
+  for (int len = 0; len <= (int) sizeof(src); len += 7)
+  {
+    random_fill(src, len, len);
+    for (int i = 0; i < len; i++)
+    {
+      if (src[i] < 0x40)                          // runs
+        src[i] = 0xFF;
+      else if ((src[i] < 0x80) && (i >= 16))      // repetitions
+        src[i] = src[i-16];
+    }
+    round_trip(src, len);
+  }
+
+} // test_round_trip()
+
+
+/// corrupt or truncated data and too small output buffer are rejected
+void test_corrupt(void)
+{
+  uint8_t         dst[BUF_SIZE];
+  const uint8_t   noData[]    = {0x80, 0x00};               // copy from empty output
+  const uint8_t   badOffset[] = {0x00, 'a', 0x80, 0x01};    // offset 2 after 1 byte
+  const uint8_t   truncLit[]  = {0x02, 'a', 'b'};           // 3 literals announced
+  const uint8_t   truncCopy[] = {0x00, 'a', 0x80};          // offset missing
+  const uint8_t   fill[]      = {0x00, 'a', 0xFF, 0x00};    // 1 + 130 bytes
+
+  TEST_ASSERT_EQUAL(-1, lz_decompress(noData, sizeof(noData), dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL(-1, lz_decompress(badOffset, sizeof(badOffset), dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL(-1, lz_decompress(truncLit, sizeof(truncLit), dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL(-1, lz_decompress(truncCopy, sizeof(truncCopy), dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL(131, lz_decompress(fill, sizeof(fill), dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL(-1, lz_decompress(fill, sizeof(fill), dst, 130));
+
+} // test_corrupt()
+
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_golden);
+  RUN_TEST(test_incompressible);
+  RUN_TEST(test_long_run);
+  RUN_TEST(test_max_offset);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_corrupt);
+  return UNITY_END();
+}
@@ -0,0 +1,163 @@
+/**
+  \file test_ram_routines.c
+
+  \author G. Icking-Konert
+
+  \brief unit tests of precompiled RAM routines
+
+  Checks the block tables generated at build time by tools/ram_blobs.py
+  (ram_write_erase.h, ram_verify_crc32.h) against the IHX text headers they
+  are generated from, parsed at runtime via import_buffer_ihx() as before.
+  Also checks size and CRC32 fields, which identify the uploaded routine.
+*/
+
+#include <unity.h>
+#include "../../src/memory_image.c"
+#include "../../src/misc.c"
+#include "../../src/hexfile.c"
+#include "bootloader.h"
+
+// generated block tables
+#include "ram_write_erase.h"
+#include "ram_verify_crc32.h"
+
+// IHX text sources
+#include "erase_write_verL_8k_1.0_inc.h"
+#include "erase_write_ver_32k_1.0_inc.h"
+#include "erase_write_ver_32k_1.2_inc.h"
+#include "erase_write_ver_32k_1.3_inc.h"
+#include "erase_write_ver_128k_2.0_inc.h"
+#include "erase_write_ver_128k_2.1_inc.h"
+#include "erase_write_ver_128k_2.2_inc.h"
+#include "verify_CRC32_STM8L_8k_v1.0.h"
+#include "verify_CRC32_STM8L_32k_v1.1.h"
+#include "verify_CRC32_STM8L_32k_v1.2.h"
+#include "verify_CRC32_STM8L_64k_v1.1.h"
+#include "verify_CRC32_STM8S_32k_v1.2.h"
+#include "verify_CRC32_STM8S_32k_v1.3.h"
+#include "verify_CRC32_STM8S_128k_v2.1.h"
+#include "verify_CRC32_STM8S_128k_v2.2.h"
+
+
+/// generated routine and IHX text it is generated from
+typedef struct {
+  const RamRoutine_s    *routine;
+  const unsigned char   *ihx;
+  unsigned int          lenIhx;
+} Source_s;
+
+#define SOURCE(routine, ihx)    { &(routine), ihx, sizeof(ihx) }
+
+static const Source_s sources[] = {
+  SOURCE(ram_erase_write_verL_8k_1_0,       bin_erase_write_verL_8k_1_0_ihx),
+  SOURCE(ram_erase_write_ver_32k_1_0,       bin_erase_write_ver_32k_1_0_ihx),
+  SOURCE(ram_erase_write_ver_32k_1_2,       bin_erase_write_ver_32k_1_2_ihx),
+  SOURCE(ram_erase_write_ver_32k_1_3,       bin_erase_write_ver_32k_1_3_ihx),
+  SOURCE(ram_erase_write_ver_128k_2_0,      bin_erase_write_ver_128k_2_0_ihx),
+  SOURCE(ram_erase_write_ver_128k_2_1,      bin_erase_write_ver_128k_2_1_ihx),
+  SOURCE(ram_erase_write_ver_128k_2_2,      bin_erase_write_ver_128k_2_2_ihx),
+  SOURCE(ram_verify_CRC32_STM8L_8k_v1_0,    bin_verify_CRC32_STM8L_8k_v1_0_ihx),
+  SOURCE(ram_verify_CRC32_STM8L_32k_v1_1,   bin_verify_CRC32_STM8L_32k_v1_1_ihx),
+  SOURCE(ram_verify_CRC32_STM8L_32k_v1_2,   bin_verify_CRC32_STM8L_32k_v1_2_ihx),
+  SOURCE(ram_verify_CRC32_STM8L_64k_v1_1,   bin_verify_CRC32_STM8L_64k_v1_1_ihx),
+  SOURCE(ram_verify_CRC32_STM8S_32k_v1_2,   bin_verify_CRC32_STM8S_32k_v1_2_ihx),
+  SOURCE(ram_verify_CRC32_STM8S_32k_v1_3,   bin_verify_CRC32_STM8S_32k_v1_3_ihx),
+  SOURCE(ram_verify_CRC32_STM8S_128k_v2_1,  bin_verify_CRC32_STM8S_128k_v2_1_ihx),
+  SOURCE(ram_verify_CRC32_STM8S_128k_v2_2,  bin_verify_CRC32_STM8S_128k_v2_2_ihx),
+};
+#define NUM_SOURCES   (int) (sizeof(sources)/sizeof(sources[0]))
+
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+
+/// blocks are ascending, separated by gaps and add up to size
+void test_blocks(void)
+{
+  for (int i = 0; i < NUM_SOURCES; i++)
+  {
+    const RamRoutine_s  *routine = sources[i].routine;
+    int                 numBytes = 0;
+
+    TEST_ASSERT_GREATER_OR_EQUAL(1, routine->numBlocks);
+    for (int j = 0; j < routine->numBlocks; j++)
+    {
+      TEST_ASSERT_GREATER_OR_EQUAL(1, routine->blocks[j].length);
+      TEST_ASSERT_LESS_OR_EQUAL(RAM_END, routine->blocks[j].address + routine->blocks[j].length - 1);
+      if (j > 0)
+        TEST_ASSERT_TRUE(routine->blocks[j].address > routine->blocks[j-1].address + routine->blocks[j-1].length);
+      numBytes += routine->blocks[j].length;
+    }
+    TEST_ASSERT_EQUAL(routine->numBytes, numBytes);
+  }
+
+} // test_blocks()
+
+
+/// blocks are identical to runtime parsed IHX text, CRC32 matches data
+void test_content(void)
+{
+  for (int i = 0; i < NUM_SOURCES; i++)
+  {
+    const RamRoutine_s  *routine = sources[i].routine;
+    MemoryImage_s       image;
+    char                *text;
+    size_t              idx = 0;
+
+    // parse IHX text (not 0-terminated)
+    text = calloc(sources[i].lenIhx + 1, 1);
+    TEST_ASSERT_NOT_NULL(text);
+    memcpy(text, sources[i].ihx, sources[i].lenIhx);
+    MemoryImage_init(&image);
+    import_buffer_ihx((uint8_t*) text, &image, MUTE);
+    free(text);
+
+    // compare with blocks
+    TEST_ASSERT_EQUAL(routine->numBytes, image.numEntries);
+    for (int j = 0; j < routine->numBlocks; j++)
+    {
+      for (int k = 0; k < routine->blocks[j].length; k++, idx++)
+      {
+        TEST_ASSERT_EQUAL(routine->blocks[j].address + k, image.memoryEntries[idx].address);
+        TEST_ASSERT_EQUAL_HEX8(routine->blocks[j].data[k], image.memoryEntries[idx].data);
+      }
+    }
+    TEST_ASSERT_EQUAL_HEX32(routine->crc32, MemoryImage_checksum_crc32(&image, 0, image.numEntries-1));
+    MemoryImage_free(&image);
+  }
+
+} // test_content()
+
+
+/// routines are distinguished by CRC32
+void test_unique_crc32(void)
+{
+  for (int i = 0; i < NUM_SOURCES; i++)
+  {
+    for (int j = i+1; j < NUM_SOURCES; j++)
+    {
+      if (sources[i].routine->numBytes != sources[j].routine->numBytes)
+        continue;
+      bool same = true;
+      for (int k = 0; (k < sources[i].routine->numBlocks) && same; k++)
+        same = (sources[i].routine->blocks[k].address == sources[j].routine->blocks[k].address) &&
+               (!memcmp(sources[i].routine->blocks[k].data, sources[j].routine->blocks[k].data, sources[i].routine->blocks[k].length));
+      if (!same)
+        TEST_ASSERT_TRUE(sources[i].routine->crc32 != sources[j].routine->crc32);
+    }
+  }
+
+} // test_unique_crc32()
+
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_blocks);
+  RUN_TEST(test_content);
+  RUN_TEST(test_unique_crc32);
+  return UNITY_END();
+}
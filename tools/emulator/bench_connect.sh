@@ -0,0 +1,35 @@
+#!/bin/bash
+#
+# benchmark of connect time with fixed delays vs. fast connect (-F 0/1, see bsl_syncFast()) via emulator
+#
+# Resets the emulated STM8 via DTR (-R 2) and prints the time from reset to
+# synchronization reported by stm8gal -v 3, for different response latencies
+# of the USB-serial adapter. Each value is the mean of several runs.
+#
+# usage: bench_connect.sh [path to stm8gal] [latencies in ms] [runs]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+STM8GAL=${1:-$DIR/../../stm8gal}
+LATENCIES=${2:-0 1 4 16}
+RUNS=${3:-5}
+TMP=$(mktemp -d)
+PTY=$TMP/stm8pty
+trap 'kill $(jobs -p) 2>/dev/null; rm -rf $TMP' EXIT
+
+gcc -shared -fPIC -o $TMP/pty_shim.so $DIR/pty_shim.c -ldl || exit 1
+
+# connect repeatedly and print mean connect time. Arguments: latency [ms], fast connect
+bench() {
+  python3 $DIR/bsl_emu.py --link $PTY --latency-ms $1 2>/dev/null & local pid=$!
+  sleep 0.5
+  for i in $(seq $RUNS); do
+    LD_PRELOAD=$TMP/pty_shim.so timeout 30 $STM8GAL -p $PTY -R 2 -B -u 0 -v 3 -F $2 2>&1 | grep -o 'connect time: [0-9.]*' | grep -o '[0-9.]*$'
+  done > $TMP/times.txt
+  kill $pid 2>/dev/null; wait $pid 2>/dev/null
+  awk '{ sum += $1 } END { if (NR) printf "%.1fms", sum/NR; else printf "failed" }' $TMP/times.txt
+}
+
+printf "%-12s %14s %14s\n" "latency" "fixed delays" "fast connect"
+for lat in $LATENCIES; do
+  printf "%-12s %14s %14s\n" "${lat}ms" "$(bench $lat 0)" "$(bench $lat 1)"
+done
@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# benchmark of lock-step vs. pipelined write (-m 0/1, see bsl_memWrite()) via emulator
+#
+# Uploads 8kB to flash and 1kB to RAM at 115.2kBaud wire time and 3ms flash
+# programming time per page, for different response latencies of the
+# USB-serial adapter. Prints the write throughput reported by stm8gal -v 3.
+#
+# usage: bench_write.sh [path to stm8gal] [latencies in ms]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+STM8GAL=${1:-$DIR/../../stm8gal}
+LATENCIES=${2:-0 1 4 16}
+TMP=$(mktemp -d)
+PTY=$TMP/stm8pty
+trap 'kill $(jobs -p) 2>/dev/null; rm -rf $TMP' EXIT
+
+gcc -shared -fPIC -o $TMP/pty_shim.so $DIR/pty_shim.c -ldl || exit 1
+
+# create test images: 8kB counter pattern in flash, 1kB in RAM
+python3 - $TMP <<'EOF'
+import sys
+for name, start, size in (('flash', 0x8000, 0x2000), ('ram', 0x0400, 0x0400)):
+    with open('%s/%s.s19' % (sys.argv[1], name), 'w') as f:
+        for addr in range(start, start + size, 32):
+            rec = bytes([35, addr >> 8, addr & 0xFF]) + bytes((addr + i) & 0xFF for i in range(32))
+            print('S1' + rec.hex().upper() + '%02X' % (~sum(rec) & 0xFF), file=f)
+EOF
+
+# upload image and print throughput. Arguments: latency [ms], write mode, image
+bench() {
+  python3 $DIR/bsl_emu.py --link $PTY --byte-us 86.8 --latency-ms $1 2>/dev/null & local pid=$!
+  sleep 0.5
+  LD_PRELOAD=$TMP/pty_shim.so timeout 300 $STM8GAL -p $PTY -R 0 -B -u 0 -v 3 -V 0 -m $2 -w $TMP/$3.s19 > $TMP/out.txt 2>&1
+  kill $pid 2>/dev/null; wait $pid 2>/dev/null
+  grep -o '[0-9.]*kB/s' $TMP/out.txt | tail -1
+}
+
+printf "%-12s %-8s %12s %12s\n" "latency" "memory" "lock-step" "pipelined"
+for lat in $LATENCIES; do
+  for mem in flash ram; do
+    printf "%-12s %-8s %12s %12s\n" "${lat}ms" $mem "$(bench $lat 0 $mem)" "$(bench $lat 1 $mem)"
+  done
+done
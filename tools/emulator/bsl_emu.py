@@ -0,0 +1,364 @@
+#!/usr/bin/env python3
+"""
+  \file bsl_emu.py
+
+  \author G. Icking-Konert
+
+  \brief STM8 UART bootloader emulator for host tests
+
+  Emulates the STM8 ROM bootloader (UART duplex, 1-wire and reply mode) on a
+  pseudo terminal, including the CRC32 RAM routine and the stage-2 loader
+  protocol (see stage2.c). Errors can be injected to test retries, resync and
+  go-back-N retransmit. On exit, statistics are printed to stderr.
+
+  stm8gal requires modem control lines, which a pty doesn't provide. Therefore
+  run stm8gal with LD_PRELOAD=pty_shim.so, see README.
+
+  usage: bsl_emu.py [--link /tmp/stm8pty] [--mode 0..2] [--flash kB] [options]
+"""
+
+import argparse
+import json
+import os
+import pty
+import select
+import signal
+import sys
+import time
+import tty
+import zlib
+
+ACK  = 0x79
+NACK = 0x1F
+
+# RAM addresses of CRC32 routine (see verify_CRC32.h) and stage-2 loader (see stage2.h)
+CRC32_START  = 0x210
+CRC32_ADDR   = 0x2F4
+CRC32_RESULT = 0x2FC
+STAGE2_START = 0xA4
+
+
+def parse_args():
+    """ parse commandline """
+    num = lambda x: int(x, 0)
+    ap = argparse.ArgumentParser(description='STM8 UART bootloader emulator on a pty')
+    ap.add_argument('--link', default='/tmp/stm8pty', help='symlink to pty slave (default: /tmp/stm8pty)')
+    ap.add_argument('--mode', type=int, default=0, help='UART mode: 0=duplex, 1=1-wire echo, 2=reply (default: 0)')
+    ap.add_argument('--flash', type=int, default=32, help='flash size [kB] (default: 32)')
+    ap.add_argument('--vers', type=num, default=0x13, help='bootloader version (default: 0x13)')
+    ap.add_argument('--byte-us', type=float, default=0, help='simulated wire time per byte [us] (default: 0)')
+    ap.add_argument('--latency-ms', type=float, default=0, help='simulated delay of responses [ms], like USB-serial adapters. Duplex only (default: 0)')
+    ap.add_argument('--nack-at', type=num, default=-1, help='NACK WRITE to this address')
+    ap.add_argument('--rnack-at', type=num, default=-1, help='NACK READ from this address')
+    ap.add_argument('--nack-count', type=int, default=1000000, help='number of NACKs for --nack-at/--rnack-at')
+    ap.add_argument('--s2-nack-at', type=num, default=-1, help='stage-2: NACK frame to this address, like CRC failure')
+    ap.add_argument('--s2-drop-at', type=num, default=-1, help='stage-2: program but drop ACK of frame to this address')
+    ap.add_argument('--s2-cut-at', type=num, default=-1, help='stage-2: lose 4 bytes of frame to this address, like UART noise')
+    ap.add_argument('--s2-count', type=int, default=1, help='number of errors for --s2-nack-at/--s2-drop-at/--s2-cut-at')
+    ap.add_argument('--log', default=None, help='log file of write, erase and go commands')
+    ap.add_argument('--state', default=None, help='JSON file to load and store flash content')
+    return ap.parse_args()
+
+
+class Emulator:
+    """ bootloader state and pty access """
+
+    def __init__(self, args):
+        self.args   = args
+        self.mem    = {ad: 0x00 for ad in range(0x8000, 0x8000 + args.flash*1024)}
+        self.buf    = bytearray()
+        self.queue  = []            # delayed responses (due time, data), see --latency-ms
+        self.synced = False
+        self.log    = open(args.log, 'w') if args.log else None
+        self.stats  = {'rx': 0, 'tx': 0, 'cmd': {}}
+        if args.state and os.path.exists(args.state):
+            for k, v in json.load(open(args.state)).items():
+                self.mem[int(k)] = v
+
+        # create pty and link slave to fixed name
+        self.fd, slave = pty.openpty()
+        tty.setraw(slave)
+        try:
+            os.unlink(args.link)
+        except FileNotFoundError:
+            pass
+        os.symlink(os.ttyname(slave), args.link)
+
+
+    def valid(self, addr):
+        """ check if address exists: RAM, EEPROM, option bytes, registers, flash """
+        return (addr <= 0x7FF) or (0x4000 <= addr <= 0x43FF) or (0x4800 <= addr <= 0x48FF) or \
+            (0x5000 <= addr <= 0x57FF) or (0x8000 <= addr < 0x8000 + self.args.flash*1024)
+
+
+    def rd(self, num, timeout=2.0):
+        """ receive num bytes. In 1-wire mode echo them like the shared wire """
+        end = time.time() + timeout
+        while len(self.buf) < num:
+            self.deliver()
+            wait = end - time.time()
+            if self.queue:
+                wait = min(wait, self.queue[0][0] - time.time())
+            r, _, _ = select.select([self.fd], [], [], max(0, wait))
+            if not r:
+                if time.time() < end:
+                    continue
+                raise TimeoutError
+            data = os.read(self.fd, 4096)
+            self.stats['rx'] += len(data)
+            if self.args.mode == 1:
+                os.write(self.fd, data)
+            self.buf.extend(data)
+        out = bytes(self.buf[:num])
+        del self.buf[:num]
+        if self.args.byte_us:
+            time.sleep(self.args.byte_us * num * 1e-6)
+        return out
+
+
+    def deliver(self):
+        """ send delayed responses which are due """
+        while self.queue and (self.queue[0][0] <= time.time()):
+            os.write(self.fd, self.queue.pop(0)[1])
+
+
+    def wr(self, data):
+        """ send bytes. In reply mode wait for echo of each byte. With --latency-ms delay response in duplex mode """
+        if self.args.latency_ms and (self.args.mode == 0):
+            self.queue.append((time.time() + self.args.latency_ms * 1e-3, bytes(data)))
+            self.stats['tx'] += len(data)
+            return
+        for x in data:
+            os.write(self.fd, bytes([x]))
+            self.stats['tx'] += 1
+            if self.args.mode == 2:
+                self.rd(1)
+
+
+    def addr_frame(self):
+        """ receive 4B address with checksum. Return address or None """
+        f = self.rd(5)
+        if f[4] != (f[0] ^ f[1] ^ f[2] ^ f[3]):
+            return None
+        return (f[0] << 24) | (f[1] << 16) | (f[2] << 8) | f[3]
+
+
+    def write_log(self, text):
+        if self.log:
+            self.log.write(text + '\n')
+            self.log.flush()
+
+
+    def cmd_read(self):
+        self.wr([ACK])
+        ad = self.addr_frame()
+        if (ad is None) or (not self.valid(ad)):
+            return self.wr([NACK])
+        self.wr([ACK])
+        n = self.rd(2)
+        if n[1] != (n[0] ^ 0xFF):
+            return self.wr([NACK])
+        if (ad == self.args.rnack_at) and (self.args.nack_count > 0):
+            self.args.nack_count -= 1
+            return self.wr([NACK])
+        self.wr([ACK] + [self.mem.get(ad + i, 0) for i in range(n[0] + 1)])
+
+
+    def cmd_write(self):
+        self.wr([ACK])
+        ad = self.addr_frame()
+        if (ad is None) or (not self.valid(ad)):
+            return self.wr([NACK])
+        self.wr([ACK])
+        n = self.rd(1)[0]
+        data = self.rd(n + 1)
+        chk = n
+        for b in data:
+            chk ^= b
+        if chk != self.rd(1)[0]:
+            return self.wr([NACK])
+        if (ad == self.args.nack_at) and (self.args.nack_count > 0):
+            self.args.nack_count -= 1
+            return self.wr([NACK])
+        if (ad >= 0x8000) and self.args.byte_us:
+            time.sleep(0.003)       # flash programming time
+        for i, b in enumerate(data):
+            self.mem[ad + i] = b
+        self.write_log('W %06X %d' % (ad, n + 1))
+        self.wr([ACK])
+
+
+    def cmd_erase(self):
+        self.wr([ACK])
+        n = self.rd(1)[0]
+        if n == 0xFF:
+            self.rd(1)
+            for ad in range(0x8000, 0x8000 + self.args.flash*1024):
+                self.mem[ad] = 0
+            self.write_log('E mass')
+        else:
+            codes = self.rd(n + 2)
+            for code in codes[:n + 1]:
+                for ad in range(0x8000 + code*1024, 0x8000 + (code+1)*1024):
+                    self.mem[ad] = 0
+                self.write_log('E %d' % code)
+        self.wr([ACK])
+
+
+    def cmd_go(self):
+        self.wr([ACK])
+        ad = self.addr_frame()
+        if ad is None:
+            return self.wr([NACK])
+        self.wr([ACK])
+        self.write_log('G %06X' % ad)
+
+        # CRC32 RAM routine -> calculate CRC32 over range, then restart
+        if ad == CRC32_START:
+            start = int.from_bytes(bytes(self.mem.get(CRC32_ADDR + i, 0) for i in range(4)), 'big')
+            stop  = int.from_bytes(bytes(self.mem.get(CRC32_ADDR + 4 + i, 0) for i in range(4)), 'big')
+            crc = zlib.crc32(bytes(self.mem.get(x, 0) for x in range(start, stop + 1))) & 0xFFFFFFFF
+            for i, b in enumerate(crc.to_bytes(4, 'big')):
+                self.mem[CRC32_RESULT + i] = b
+            self.synced = False
+
+        # stage-2 loader or application -> bootloader is left
+        elif ad == STAGE2_START:
+            self.stage2()
+            self.synced = False
+        elif ad >= 0x8000:
+            self.synced = False
+
+
+    def stage2(self):
+        """ stage-2 loader: frames 0xA5, seq, cmd, addr[3], len[2], data, CRC16. Answer ACK/NACK + seq """
+        args   = self.args
+        expect = 0
+        stats  = self.stats['s2'] = {'frames': 0, 'nack': 0, 'dup': 0, 'lz': 0}
+        while True:
+            try:
+                c = self.rd(1, 3600)[0]
+                if c == 0x7F:
+                    self.wr([ACK, 0x10])
+                    continue
+                if c != 0xA5:
+                    continue
+                h = self.rd(7, 10)
+                seq, cmd, ad = h[0], h[1], (h[2] << 16) | (h[3] << 8) | h[4]
+                if (ad == args.s2_cut_at) and (args.s2_count > 0):
+                    args.s2_count -= 1
+                    self.rd(4, 10)
+                n = (h[5] << 8) | h[6]
+                bad = (n > 256)
+                data = self.rd(0 if bad else n, 10)
+                crc = self.rd(2, 10)
+            except TimeoutError:
+                continue
+
+            # corrupted frame or invalid length -> NACK with expected sequence. Repeated frame -> ACK again
+            if bad or (crc16(0xFFFF, h + data) != ((crc[0] << 8) | crc[1])):
+                stats['nack'] += 1
+                self.wr([NACK, expect])
+                continue
+            if seq == (expect - 1) & 0xFF:
+                stats['dup'] += 1
+                self.wr([ACK, seq])
+                continue
+            if seq != expect:
+                continue
+
+            # compressed write -> decompress (see lz.c)
+            if cmd == 0x32:
+                data = lz_decompress(data)
+                stats['lz'] += 1
+                cmd = 0x31
+
+            if cmd == 0x31:
+                if (ad == args.s2_nack_at) and (args.s2_count > 0):
+                    args.s2_count -= 1
+                    stats['nack'] += 1
+                    self.wr([NACK, expect])
+                    continue
+                for i, b in enumerate(data):
+                    self.mem[ad + i] = b
+                self.write_log('S %06X %d' % (ad, len(data)))
+                stats['frames'] += 1
+                expect = (expect + 1) & 0xFF
+                if (ad == args.s2_drop_at) and (args.s2_count > 0):
+                    args.s2_count -= 1
+                    continue
+                self.wr([ACK, seq])
+            elif cmd == 0x21:
+                self.wr([ACK, seq])
+                self.write_log('G %06X' % ad)
+                return
+            else:
+                self.wr([NACK, expect])
+
+
+    def run(self):
+        """ ROM bootloader command loop """
+        commands = {0x11: self.cmd_read, 0x31: self.cmd_write, 0x43: self.cmd_erase, 0x21: self.cmd_go}
+        while True:
+            try:
+                c = self.rd(1, 3600)[0]
+            except TimeoutError:
+                continue
+            if not self.synced:
+                if c == 0x7F:
+                    self.synced = True
+                    self.wr([ACK])
+                continue
+            if (c == 0x7F) or (self.rd(1)[0] != (c ^ 0xFF)):
+                self.wr([NACK])
+                continue
+            self.stats['cmd'][c] = self.stats['cmd'].get(c, 0) + 1
+            if c == 0x00:
+                self.wr([ACK, 5, self.args.vers, 0x00, 0x11, 0x21, 0x31, 0x43, ACK])
+            elif c in commands:
+                commands[c]()
+            else:
+                self.wr([NACK])
+
+
+def crc16(crc, data):
+    """ CRC16-CCITT of stage-2 frames """
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def lz_decompress(data):
+    """ literal run 0x00..0x7F + n+1 bytes, or match 0x80..0xFF (length-3) + offset-1 """
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        c = data[i]
+        i += 1
+        if c < 0x80:
+            out += data[i:i + c + 1]
+            i += c + 1
+        else:
+            off = data[i] + 1
+            i += 1
+            for _ in range((c & 0x7F) + 3):
+                out.append(out[-off])
+    return bytes(out)
+
+
+def main():
+    args = parse_args()
+    emu = Emulator(args)
+    signal.signal(signal.SIGTERM, lambda *x: sys.exit(0))
+    try:
+        emu.run()
+    finally:
+        if args.state:
+            json.dump({k: v for k, v in emu.mem.items() if k >= 0x8000}, open(args.state, 'w'))
+        sys.stderr.write('emu stats %r\n' % emu.stats)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+  \file net_bridge.py
+
+  \author G. Icking-Konert
+
+  \brief minimal network serial server for host tests
+
+  Bridges TCP connections to a serial port or pty, like ser2net. In RFC 2217
+  mode telnet commands are removed, COM-PORT-OPTION requests are acknowledged
+  and 0xFF data bytes are escaped. Connections are served one after another.
+  On SIGTERM, statistics are printed to stderr.
+
+  usage: net_bridge.py [--port 7000] [--dev /tmp/stm8pty] [--rfc2217]
+"""
+
+import argparse
+import os
+import select
+import signal
+import socket
+import sys
+import tty
+
+IAC  = 255
+SB   = 250
+SE   = 240
+WILL = 251
+DONT = 254
+COM_PORT_OPTION = 44
+
+
+def parse_args():
+    """ parse commandline """
+    ap = argparse.ArgumentParser(description='TCP / RFC 2217 to serial bridge')
+    ap.add_argument('--port', type=int, default=7000, help='TCP port on localhost (default: 7000)')
+    ap.add_argument('--dev', default='/tmp/stm8pty', help='serial port or pty (default: /tmp/stm8pty)')
+    ap.add_argument('--rfc2217', action='store_true', help='telnet with RFC 2217 instead of raw TCP')
+    return ap.parse_args()
+
+
+class Telnet:
+    """ telnet parser for data from client """
+
+    def __init__(self, conn, stats):
+        self.conn  = conn
+        self.stats = stats
+        self.state = 'data'
+        self.sub   = bytearray()
+
+    def filter(self, data):
+        """ return payload of data. Answer COM-PORT-OPTION subnegotiations like a server (code + 100) """
+        out = bytearray()
+        for b in data:
+            if self.state == 'data':
+                if b == IAC:
+                    self.state = 'iac'
+                else:
+                    out.append(b)
+            elif self.state == 'iac':
+                if b == IAC:
+                    out.append(b)
+                    self.state = 'data'
+                elif b == SB:
+                    self.sub = bytearray()
+                    self.state = 'sb'
+                elif WILL <= b <= DONT:
+                    self.state = 'option'
+                else:
+                    self.state = 'data'
+            elif self.state == 'option':
+                self.state = 'data'
+            elif self.state == 'sb':
+                if b == IAC:
+                    self.state = 'sb_iac'
+                else:
+                    self.sub.append(b)
+            elif self.state == 'sb_iac':
+                if b == SE:
+                    self.subnegotiation(bytes(self.sub))
+                    self.state = 'data'
+                else:
+                    self.sub.append(b)
+                    self.state = 'sb'
+        return bytes(out)
+
+    def subnegotiation(self, sub):
+        self.stats['sb'] += 1
+        if (len(sub) >= 2) and (sub[0] == COM_PORT_OPTION):
+            value = sub[2:].replace(b'\xff', b'\xff\xff')
+            self.conn.sendall(bytes([IAC, SB, COM_PORT_OPTION, sub[1] + 100]) + value + bytes([IAC, SE]))
+
+
+def serve(conn, fd, rfc2217, stats):
+    """ forward data until client closes connection """
+    telnet = Telnet(conn, stats)
+    while True:
+        r, _, _ = select.select([conn, fd], [], [])
+        if conn in r:
+            data = conn.recv(4096)
+            if not data:
+                return
+            if rfc2217:
+                data = telnet.filter(data)
+            os.write(fd, data)
+            stats['tx'] += len(data)
+        if fd in r:
+            data = os.read(fd, 4096)
+            stats['rx'] += len(data)
+            if rfc2217:
+                data = data.replace(b'\xff', b'\xff\xff')
+            conn.sendall(data)
+
+
+def main():
+    args  = parse_args()
+    stats = {'conn': 0, 'sb': 0, 'tx': 0, 'rx': 0}
+    signal.signal(signal.SIGTERM, lambda *x: (sys.stderr.write('bridge stats %r\n' % stats), os._exit(0)))
+
+    fd = os.open(args.dev, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    server = socket.socket()
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(('127.0.0.1', args.port))
+    server.listen(1)
+    while True:
+        conn, _ = server.accept()
+        stats['conn'] += 1
+        try:
+            serve(conn, fd, args.rfc2217, stats)
+        except OSError:
+            pass
+        conn.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,79 @@
+/**
+  \file pty_shim.c
+
+  \author G. Icking-Konert
+
+  \brief LD_PRELOAD shim for running stm8gal on a pty
+
+  A pseudo terminal has no modem control lines and may reject termios settings
+  of real UARTs. Emulate successful modem control and retry tcsetattr() with
+  relaxed settings, so that stm8gal can talk to bsl_emu.py.
+
+  build: gcc -shared -fPIC -o pty_shim.so pty_shim.c -ldl
+*/
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+
+
+/// modem control and serial driver requests, which are not supported by a pty
+static int unsupported(unsigned long req) {
+
+  return((req == TIOCMGET) || (req == TIOCMSET) || (req == TIOCMBIS) || (req == TIOCMBIC) || (req == TIOCGSERIAL) || (req == TIOCSSERIAL));
+
+} // unsupported
+
+
+/// ioctl() wrapper: pretend success of unsupported requests
+int ioctl(int fd, unsigned long req, ...) {
+
+  static int (*real)(int, unsigned long, ...) = NULL;
+  va_list   ap;
+  void      *arg;
+  int       result;
+
+  va_start(ap, req);
+  arg = va_arg(ap, void*);
+  va_end(ap);
+  if (real == NULL)
+    real = dlsym(RTLD_NEXT, "ioctl");
+
+  result = real(fd, req, arg);
+  if ((result < 0) && unsupported(req)) {
+    if ((req == TIOCMGET) && (arg != NULL))
+      *(int*) arg = 0;
+    return(0);
+  }
+  return(result);
+
+} // ioctl
+
+
+/// tcsetattr() wrapper: retry with input speed = output speed and without parity
+int tcsetattr(int fd, int act, const struct termios *t) {
+
+  static int (*real)(int, int, const struct termios*) = NULL;
+  struct termios  relaxed;
+  int             result;
+
+  if (real == NULL)
+    real = dlsym(RTLD_NEXT, "tcsetattr");
+
+  result = real(fd, act, t);
+  if (result < 0) {
+    relaxed = *t;
+    cfsetispeed(&relaxed, cfgetospeed(&relaxed));
+    result = real(fd, act, &relaxed);
+  }
+  if (result < 0) {
+    relaxed = *t;
+    relaxed.c_cflag &= ~(PARENB | PARODD);
+    result = real(fd, act, &relaxed);
+  }
+  return(result);
+
+} // tcsetattr
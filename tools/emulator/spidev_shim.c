@@ -0,0 +1,301 @@
+/**
+  \file spidev_shim.c
+
+  \author G. Icking-Konert
+
+  \brief LD_PRELOAD spidev emulator with STM8 SPI bootloader
+
+  Opening a path starting with /tmp/spidev returns a dummy descriptor. write(),
+  read() and SPI_IOC_MESSAGE on it are handled by an emulated STM8 SPI bootloader
+  (GET, READ, WRITE, ERASE, GO) with busy bytes during flash programming and
+  erase. On exit, the number of syscalls and SPI segments is printed to stderr,
+  e.g. for comparing lock-step and batched transfers (see spi_spidev_comm.c).
+  cs_change must be set for all but the last segment of a message.
+
+  build: gcc -shared -fPIC -o spidev_shim.so spidev_shim.c -ldl
+*/
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#define ACK         0x79
+#define NACK        0x1F
+#define BUSY        0xAA      // returned instead of ACK while flash is busy
+#define QUEUE_SIZE  4096
+
+// bootloader state
+static int        s_fd = -1;                    // emulated spidev descriptor
+static uint8_t    s_mem[0x10000+256];           // memory up to 32kB flash, plus max. frame
+static uint8_t    s_queue[QUEUE_SIZE];          // response bytes
+static int        s_head, s_tail;
+static int        s_busy;                       // number of busy bytes before next response
+static uint8_t    s_frame[512];                 // received frame
+static int        s_len;
+static int        s_state;                      // 0=command, 1=address, 2=read count or write data, 3=erase codes
+static uint8_t    s_cmd;
+static uint32_t   s_addr;
+
+// statistics
+static long       s_numIoctl, s_numSegment, s_numWrite, s_numRead, s_numCsBad, s_numFrames;
+
+
+/// queue response byte
+static void push(uint8_t b) {
+
+  s_queue[s_tail++ % QUEUE_SIZE] = b;
+
+} // push
+
+
+/// get next response byte. Busy bytes are inserted before the final ACK of write and erase
+static uint8_t pop(void) {
+
+  if ((s_busy > 0) && (s_tail - s_head == 1)) {
+    s_busy--;
+    return(BUSY);
+  }
+  if (s_head == s_tail)
+    return(0x00);
+  return(s_queue[s_head++ % QUEUE_SIZE]);
+
+} // pop
+
+
+/// check if address exists: RAM, EEPROM, option bytes, registers, flash
+static int valid(uint32_t addr) {
+
+  return((addr <= 0x7FF) || ((addr >= 0x4000) && (addr <= 0x43FF)) || ((addr >= 0x4800) && (addr <= 0x48FF)) ||
+    ((addr >= 0x5000) && (addr <= 0x57FF)) || ((addr >= 0x8000) && (addr < 0x10000)));
+
+} // valid
+
+
+/// process byte received by bootloader
+static void feed(uint8_t b) {
+
+  uint8_t   chk;
+
+  s_frame[s_len++] = b;
+  switch (s_state) {
+
+    // synchronization or command with complement
+    case 0:
+      if ((s_len == 1) && (b == 0x7F)) {
+        push(ACK);
+        s_len = 0;
+        return;
+      }
+      if (s_len < 2)
+        return;
+      s_len = 0;
+      s_cmd = s_frame[0];
+      if ((uint8_t) (s_frame[0] ^ 0xFF) != s_frame[1]) {
+        push(NACK);
+        return;
+      }
+      if (s_cmd == 0x00) {
+        const uint8_t resp[] = {ACK, 5, 0x13, 0x00, 0x11, 0x21, 0x31, 0x43, ACK};
+        for (size_t i = 0; i < sizeof(resp); i++)
+          push(resp[i]);
+        return;
+      }
+      push(ACK);
+      s_state = (s_cmd == 0x43) ? 3 : 1;
+      return;
+
+    // address with checksum
+    case 1:
+      if (s_len < 5)
+        return;
+      s_len = 0;
+      s_addr = ((uint32_t) s_frame[0] << 24) | ((uint32_t) s_frame[1] << 16) | ((uint32_t) s_frame[2] << 8) | s_frame[3];
+      if (((s_frame[0] ^ s_frame[1] ^ s_frame[2] ^ s_frame[3]) != s_frame[4]) || ((s_cmd != 0x21) && (!valid(s_addr)))) {
+        push(NACK);
+        s_state = 0;
+        return;
+      }
+      push(ACK);
+      s_state = (s_cmd == 0x21) ? 0 : 2;
+      return;
+
+    // number of bytes to read, or data to write with checksum
+    case 2:
+      if (s_cmd == 0x11) {
+        if (s_len < 2)
+          return;
+        s_len = 0;
+        s_state = 0;
+        push(ACK);
+        for (int i = 0; i <= s_frame[0]; i++)
+          push(s_mem[(s_addr + i) & 0xFFFF]);
+        return;
+      }
+      if (s_len < s_frame[0] + 3)
+        return;
+      chk = 0;
+      for (int i = 0; i < s_len - 1; i++)
+        chk ^= s_frame[i];
+      if (chk != s_frame[s_len-1])
+        push(NACK);
+      else {
+        memcpy(s_mem + s_addr, s_frame + 1, s_frame[0] + 1);
+        s_busy = (s_addr >= 0x8000) ? 3 : 0;
+        push(ACK);
+        s_numFrames++;
+      }
+      s_len = 0;
+      s_state = 0;
+      return;
+
+    // erase: mass erase (0xFF 0x00) or list of sector codes with checksum
+    case 3:
+      if ((s_frame[0] == 0xFF) && (s_len < 2))
+        return;
+      if ((s_frame[0] != 0xFF) && (s_len < s_frame[0] + 3))
+        return;
+      s_len = 0;
+      s_state = 0;
+      s_busy = 2;
+      push(ACK);
+      return;
+
+  } // switch (s_state)
+
+} // feed
+
+
+/// print statistics
+static void print_stats(void) {
+
+  fprintf(stderr, "spidev_shim: ioctl %ld, segments %ld, write %ld, read %ld, frames %ld, cs_change errors %ld\n",
+    s_numIoctl, s_numSegment, s_numWrite, s_numRead, s_numFrames, s_numCsBad);
+
+} // print_stats
+
+
+/// open() wrapper: emulate /tmp/spidev*
+int open(const char *path, int flags, ...) {
+
+  static int (*real)(const char*, int, ...) = NULL;
+  va_list   ap;
+  int       mode;
+
+  va_start(ap, flags);
+  mode = va_arg(ap, int);
+  va_end(ap);
+  if (real == NULL)
+    real = dlsym(RTLD_NEXT, "open");
+
+  if (!strncmp(path, "/tmp/spidev", 11)) {
+    s_fd = real("/dev/null", O_RDWR);
+    memset(s_mem, 0, sizeof(s_mem));
+    return(s_fd);
+  }
+  return(real(path, flags, mode));
+
+} // open
+
+
+/// write() wrapper: send to bootloader
+ssize_t write(int fd, const void *buf, size_t len) {
+
+  static ssize_t (*real)(int, const void*, size_t) = NULL;
+
+  if (real == NULL)
+    real = dlsym(RTLD_NEXT, "write");
+  if ((s_fd < 0) || (fd != s_fd))
+    return(real(fd, buf, len));
+
+  s_numWrite++;
+  for (size_t i = 0; i < len; i++)
+    feed(((const uint8_t*) buf)[i]);
+  return(len);
+
+} // write
+
+
+/// read() wrapper: receive from bootloader
+ssize_t read(int fd, void *buf, size_t len) {
+
+  static ssize_t (*real)(int, void*, size_t) = NULL;
+
+  if (real == NULL)
+    real = dlsym(RTLD_NEXT, "read");
+  if ((s_fd < 0) || (fd != s_fd))
+    return(real(fd, buf, len));
+
+  s_numRead++;
+  for (size_t i = 0; i < len; i++)
+    ((uint8_t*) buf)[i] = pop();
+  return(len);
+
+} // read
+
+
+/// close() wrapper: print statistics
+int close(int fd) {
+
+  static int (*real)(int) = NULL;
+
+  if (real == NULL)
+    real = dlsym(RTLD_NEXT, "close");
+  if ((s_fd >= 0) && (fd == s_fd)) {
+    print_stats();
+    s_fd = -1;
+  }
+  return(real(fd));
+
+} // close
+
+
+/// ioctl() wrapper: full-duplex SPI_IOC_MESSAGE. Each segment either sends (tx_buf) or receives
+int ioctl(int fd, unsigned long req, ...) {
+
+  static int (*real)(int, unsigned long, ...) = NULL;
+  struct spi_ioc_transfer   *seg;
+  va_list   ap;
+  void      *arg;
+  int       num, total = 0;
+
+  va_start(ap, req);
+  arg = va_arg(ap, void*);
+  va_end(ap);
+  if (real == NULL)
+    real = dlsym(RTLD_NEXT, "ioctl");
+  if ((s_fd < 0) || (fd != s_fd))
+    return(real(fd, req, arg));
+
+  // SPI settings -> ignore
+  if ((_IOC_TYPE(req) != SPI_IOC_MAGIC) || (_IOC_NR(req) != 0))
+    return(0);
+
+  // transfer segments
+  seg = (struct spi_ioc_transfer*) arg;
+  num = _IOC_SIZE(req) / sizeof(struct spi_ioc_transfer);
+  s_numIoctl++;
+  s_numSegment += num;
+  for (int i = 0; i < num; i++) {
+    if (seg[i].cs_change != (i < num-1))
+      s_numCsBad++;
+    for (uint32_t k = 0; k < seg[i].len; k++) {
+      uint8_t rx = 0;
+      if (seg[i].tx_buf)
+        feed(((const uint8_t*) (uintptr_t) seg[i].tx_buf)[k]);
+      else
+        rx = pop();
+      if (seg[i].rx_buf)
+        ((uint8_t*) (uintptr_t) seg[i].rx_buf)[k] = rx;
+    }
+    total += seg[i].len;
+  }
+  return(total);
+
+} // ioctl
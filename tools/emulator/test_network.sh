@@ -0,0 +1,74 @@
+#!/bin/bash
+#
+# loopback test of network serial ports (tcp:// and rfc2217://, see serial_comm.c)
+#
+# stm8gal <-> TCP <-> bridge <-> pty <-> bsl_emu.py. Raw TCP uses socat if
+# installed, else net_bridge.py. RFC 2217 always uses net_bridge.py.
+#
+# usage: test_network.sh [path to stm8gal]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+STM8GAL=${1:-$DIR/../../stm8gal}
+TMP=$(mktemp -d)
+PTY=$TMP/stm8pty
+PORT=7011
+FAILED=0
+trap 'kill $(jobs -p) 2>/dev/null; rm -rf $TMP' EXIT
+
+# create test image: 8kB counter pattern incl. 0xFF (telnet IAC) at 0x8000
+python3 - > $TMP/image.s19 <<'EOF'
+for addr in range(0x8000, 0xA000, 32):
+    data = bytes((addr + i) & 0xFF for i in range(32))
+    rec = bytes([len(data) + 3, addr >> 8, addr & 0xFF]) + data
+    print('S1' + rec.hex().upper() + '%02X' % (~sum(rec) & 0xFF))
+EOF
+
+# start emulator and bridge, run stm8gal. Arguments: emulator mode, bridge (socat|tcp|rfc2217), URL scheme, stm8gal options
+run() {
+  local mode=$1 bridge=$2 scheme=$3; shift 3
+  python3 $DIR/bsl_emu.py --link $PTY --mode $mode 2>/dev/null & local emu=$!
+  sleep 0.5
+  case $bridge in
+    socat)   socat TCP-LISTEN:$PORT,bind=127.0.0.1,reuseaddr,fork FILE:$PTY,raw,echo=0 & ;;
+    tcp)     python3 $DIR/net_bridge.py --port $PORT --dev $PTY 2>/dev/null & ;;
+    rfc2217) python3 $DIR/net_bridge.py --port $PORT --dev $PTY --rfc2217 2>/dev/null & ;;
+  esac
+  local br=$!
+  sleep 0.3
+  timeout 120 $STM8GAL -p $scheme://127.0.0.1:$PORT -R 0 -B "$@" > $TMP/out.txt 2>&1
+  local rc=$?
+  kill $br $emu 2>/dev/null; wait $br $emu 2>/dev/null
+  PORT=$((PORT+1))
+  return $rc
+}
+
+check() {
+  local name=$1; shift
+  if "$@"; then
+    echo "passed: $name"
+  else
+    echo "FAILED: $name"; cat $TMP/out.txt; FAILED=1
+  fi
+}
+
+RAW=tcp
+which socat > /dev/null && RAW=socat
+
+for mode in 0 1 2; do
+  check "raw TCP ($RAW), UART mode $mode, write + verify"   run $mode $RAW tcp -u $mode -w $TMP/image.s19 -V 2
+  check "RFC 2217, UART mode $mode, write + CRC32 verify"   run $mode rfc2217 rfc2217 -u $mode -w $TMP/image.s19 -V 1
+done
+check "RFC 2217, fast connect and I/O thread"               run 0 rfc2217 rfc2217 -F 1 -I 1 -w $TMP/image.s19 -V 2
+
+# closed connection must be reported as error (EPIPE), not terminate stm8gal via SIGPIPE
+python3 $DIR/bsl_emu.py --link $PTY 2>/dev/null & EMU=$!
+sleep 0.5
+python3 $DIR/net_bridge.py --port $PORT --dev $PTY 2>/dev/null & BR=$!
+sleep 0.3
+(sleep 1; kill $BR) &
+timeout 120 $STM8GAL -p tcp://127.0.0.1:$PORT -R 0 -B -t 3 -w $TMP/image.s19 -w $TMP/image.s19 -w $TMP/image.s19 > $TMP/out.txt 2>&1
+RC=$?
+kill $EMU 2>/dev/null; wait $EMU 2>/dev/null
+check "closed connection reported as error" [ $RC -eq 1 ]
+
+exit $FAILED
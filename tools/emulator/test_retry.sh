@@ -0,0 +1,85 @@
+#!/bin/bash
+#
+# test of retry after failed WRITE/READ/ERASE transactions (-t, see bsl_retryNext())
+#
+# stm8gal <-> pty <-> bsl_emu.py. The emulator NACKs selected transactions, and
+# stm8gal must resync the BSL and repeat them. After each upload the flash
+# content stored by the emulator is compared with the image.
+#
+# usage: test_retry.sh [path to stm8gal]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+STM8GAL=${1:-$DIR/../../stm8gal}
+TMP=$(mktemp -d)
+PTY=$TMP/stm8pty
+FAILED=0
+trap 'kill $(jobs -p) 2>/dev/null; rm -rf $TMP' EXIT
+
+gcc -shared -fPIC -o $TMP/pty_shim.so $DIR/pty_shim.c -ldl || exit 1
+
+# create test image: 4kB counter pattern at 0x8000
+python3 - > $TMP/image.s19 <<'EOF'
+for addr in range(0x8000, 0x9000, 32):
+    rec = bytes([35, addr >> 8, addr & 0xFF]) + bytes((addr + i + 1) & 0xFF for i in range(32))
+    print('S1' + rec.hex().upper() + '%02X' % (~sum(rec) & 0xFF))
+EOF
+
+# start emulator, run stm8gal. Arguments: emulator mode, emulator options, stm8gal options
+run() {
+  local mode=$1 emu=$2; shift 2
+  rm -f $TMP/state.json
+  python3 $DIR/bsl_emu.py --link $PTY --mode $mode --state $TMP/state.json $emu 2>/dev/null & local pid=$!
+  sleep 0.5
+  LD_PRELOAD=$TMP/pty_shim.so timeout 120 $STM8GAL -p $PTY -R 0 -B -u $mode "$@" > $TMP/out.txt 2>&1
+  local rc=$?
+  kill $pid 2>/dev/null; wait $pid 2>/dev/null
+  return $rc
+}
+
+# compare flash content of emulator with image
+flash_ok() {
+  python3 - $TMP <<'EOF'
+import json, sys
+mem = {int(k): v for k, v in json.load(open(sys.argv[1] + '/state.json')).items()}
+for line in open(sys.argv[1] + '/image.s19'):
+    rec = bytes.fromhex(line.strip()[2:])
+    addr = (rec[1] << 8) | rec[2]
+    for i, b in enumerate(rec[3:-1]):
+        if mem.get(addr + i) != b:
+            sys.exit(1)
+EOF
+}
+
+# upload with read-back verify, compare flash and check number of retries. Arguments: emulator mode, emulator options, retries, stm8gal options
+upload() {
+  local mode=$1 emu=$2 num=$3; shift 3
+  run $mode "$emu" -w $TMP/image.s19 -V 2 "$@" && flash_ok && grep -q "recovered from $num failed" $TMP/out.txt
+}
+
+# run must fail with message. Arguments: emulator mode, emulator options, message, stm8gal options
+fails() {
+  local mode=$1 emu=$2 msg=$3; shift 3
+  ! run $mode "$emu" "$@" && grep -q "$msg" $TMP/out.txt
+}
+
+check() {
+  local name=$1; shift
+  if "$@"; then
+    echo "passed: $name"
+  else
+    echo "FAILED: $name"; cat $TMP/out.txt; FAILED=1
+  fi
+}
+
+for mode in 0 1 2; do
+  check "UART mode $mode, NACK of WRITE"                  upload $mode "--nack-at 0x8400 --nack-count 2"  2
+  check "UART mode $mode, NACK of READ"                   upload $mode "--rnack-at 0x8000 --nack-count 1" 1
+done
+check "NACK of WRITE in pipelined burst"                  upload 0 "--nack-at 0x8400 --nack-count 1"      1 -m 1
+check "NACK of WRITE with sector erase"                   upload 0 "--nack-at 0x8400 --nack-count 1"      1 -P 1
+
+# no retry with -t 0, persistent NACK is reported after retries
+check "-t 0 aborts on first NACK"                         fails 0 "--nack-at 0x8400 --nack-count 1"   "0x8400" -w $TMP/image.s19 -t 0
+check "persistent NACK reported as error"                 fails 0 "--nack-at 0x8400"                  "0x8400" -w $TMP/image.s19 -t 2
+
+exit $FAILED
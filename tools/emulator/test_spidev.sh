@@ -0,0 +1,32 @@
+#!/bin/bash
+#
+# test of spidev interface (-i 2) with emulated SPI bootloader, see spidev_shim.c
+#
+# Uploads 16kB with read-back verify and prints the number of syscalls and SPI
+# segments. stm8gal must be built with -DUSE_SPIDEV.
+#
+# usage: test_spidev.sh [path to stm8gal]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+STM8GAL=${1:-$DIR/../../stm8gal}
+TMP=$(mktemp -d)
+trap 'rm -rf $TMP' EXIT
+
+gcc -shared -fPIC -o $TMP/spidev_shim.so $DIR/spidev_shim.c -ldl || exit 1
+
+# create test image: 16kB counter pattern at 0x8000
+python3 - > $TMP/image.s19 <<'PY'
+for addr in range(0x8000, 0xC000, 32):
+    data = bytes((addr + i + (addr >> 8)) & 0xFF for i in range(32))
+    rec = bytes([len(data) + 3, addr >> 8, addr & 0xFF]) + data
+    print('S1' + rec.hex().upper() + '%02X' % (~sum(rec) & 0xFF))
+PY
+
+LD_PRELOAD=$TMP/spidev_shim.so timeout 120 $STM8GAL -i 2 -p /tmp/spidev0.0 -R 0 -B -w $TMP/image.s19 -V 2 > $TMP/out.txt 2>&1
+RC=$?
+grep "spidev_shim:" $TMP/out.txt
+if [ $RC -eq 0 ] && grep -q "cs_change errors 0" $TMP/out.txt; then
+  echo "passed: spidev upload + read-back verify"
+else
+  echo "FAILED: spidev upload + read-back verify"; cat $TMP/out.txt; exit 1
+fi
@@ -0,0 +1,98 @@
+#!/bin/bash
+#
+# upload test via stage-2 loader (see stage2.c) incl. go-back-N retransmit and CRC failures
+#
+# stm8gal <-> pty <-> bsl_emu.py. The emulator implements the loader protocol,
+# so a dummy loader image in RAM is sufficient. After each upload the flash
+# content stored by the emulator is compared with the image.
+#
+# usage: test_stage2.sh [path to stm8gal]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+STM8GAL=${1:-$DIR/../../stm8gal}
+TMP=$(mktemp -d)
+PTY=$TMP/stm8pty
+FAILED=0
+trap 'kill $(jobs -p) 2>/dev/null; rm -rf $TMP' EXIT
+
+gcc -shared -fPIC -o $TMP/pty_shim.so $DIR/pty_shim.c -ldl || exit 1
+
+# create test image: 8kB at 0x8000, first half counter pattern, second half compressible
+# records. Dummy loader with 64B in RAM at 0xA4
+python3 - $TMP <<'EOF'
+import sys
+def s19(addr, data):
+    rec = bytes([len(data) + 3, addr >> 8, addr & 0xFF]) + data
+    return 'S1' + rec.hex().upper() + '%02X' % (~sum(rec) & 0xFF)
+with open(sys.argv[1] + '/image.s19', 'w') as f:
+    for addr in range(0x8000, 0xA000, 32):
+        if addr < 0x9000:
+            data = bytes((addr + i) & 0xFF for i in range(32))
+        else:
+            data = b'stm8gal ' * 4
+        print(s19(addr, data), file=f)
+with open(sys.argv[1] + '/loader.ihx', 'w') as f:
+    rec = bytes([64, 0x00, 0xA4, 0x00]) + bytes(range(64))
+    print(':' + rec.hex().upper() + '%02X' % (-sum(rec) & 0xFF), file=f)
+    print(':00000001FF', file=f)
+EOF
+
+# start emulator, run stm8gal. Arguments: emulator mode, emulator options, stm8gal options
+run() {
+  local mode=$1 emu=$2; shift 2
+  rm -f $TMP/state.json
+  python3 $DIR/bsl_emu.py --link $PTY --mode $mode --state $TMP/state.json $emu 2> $TMP/emu.txt & local pid=$!
+  sleep 0.5
+  LD_PRELOAD=$TMP/pty_shim.so timeout 120 $STM8GAL -p $PTY -R 0 -B -u $mode "$@" > $TMP/out.txt 2>&1
+  local rc=$?
+  kill $pid 2>/dev/null; wait $pid 2>/dev/null
+  return $rc
+}
+
+# compare flash content of emulator with image
+flash_ok() {
+  python3 - $TMP <<'EOF'
+import json, sys
+mem = {int(k): v for k, v in json.load(open(sys.argv[1] + '/state.json')).items()}
+for line in open(sys.argv[1] + '/image.s19'):
+    rec = bytes.fromhex(line.strip()[2:])
+    addr = (rec[1] << 8) | rec[2]
+    for i, b in enumerate(rec[3:-1]):
+        if mem.get(addr + i) != b:
+            sys.exit(1)
+EOF
+}
+
+# upload, compare flash and check emulator statistics. Arguments: emulator mode, emulator options, regex for statistics, stm8gal options
+upload() {
+  local mode=$1 emu=$2 stats=$3; shift 3
+  run $mode "$emu" -S $TMP/loader.ihx 230400 -w $TMP/image.s19 "$@" && flash_ok && grep -Eq "$stats" $TMP/emu.txt
+}
+
+check() {
+  local name=$1; shift
+  if "$@"; then
+    echo "passed: $name"
+  else
+    echo "FAILED: $name"; cat $TMP/out.txt $TMP/emu.txt; FAILED=1
+  fi
+}
+
+for mode in 0 1; do
+  check "UART mode $mode, upload"                          upload $mode ""                                "'frames': 32, 'nack': 0"
+  check "UART mode $mode, compressed upload"               upload $mode ""                                "'lz': [1-9]"    -z
+  check "UART mode $mode, NACK after CRC failure"          upload $mode "--s2-nack-at 0x8100 --s2-count 2" "'nack': 2"
+  check "UART mode $mode, lost bytes, filler and resync"   upload $mode "--s2-cut-at 0x8300"              "'nack': [1-9]"
+  check "UART mode $mode, lost ACK, go-back-N"             upload $mode "--s2-drop-at 0x9F00"             "'dup': [1-9]"
+done
+check "lost ACK followed by cumulative ACK"                upload 0 "--s2-drop-at 0x8400"                 "'frames': 32, 'nack': 0"
+
+# persistent CRC failure must be reported after retries
+run 0 "--s2-nack-at 0x8100 --s2-count 1000" -S $TMP/loader.ihx 230400 -w $TMP/image.s19
+check "persistent NACK reported as error" grep -q "frame 0x8100 rejected" $TMP/out.txt
+
+# verify via ROM bootloader is not possible after upload via stage-2 loader
+run 0 "" -S $TMP/loader.ihx 230400 -w $TMP/image.s19 -V 2
+check "-V 2 with -S rejected" grep -q "not possible with '-S/-stage2'" $TMP/out.txt
+
+exit $FAILED
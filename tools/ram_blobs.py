@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+  \file ram_blobs.py
+
+  \author G. Icking-Konert
+
+  \brief convert RAM routines to precompiled block tables
+
+  Build step for Makefile and PlatformIO (see extra_script.py). Reads RAM routine
+  headers (IHX text as C array, e.g. from 'xxd -i') and writes a C header with the
+  consecutive memory blocks of each routine and a CRC32 over all data. This avoids
+  parsing the IHX text at runtime, see RamRoutine_s in bootloader.h.
+
+  usage: ram_blobs.py -o output.h input1.h [input2.h ...]
+"""
+
+import argparse
+import os
+import re
+import sys
+import zlib
+
+
+def read_ihx(path):
+    """ extract IHX text from C array in header. Return (array name, text) """
+    text = open(path, encoding='latin-1').read()
+    m = re.search(r'unsigned\s+char\s+(\w+)\s*\[\s*\]\s*=\s*\{([^}]*)\}', text)
+    if m is None:
+        sys.exit("error: no C array found in '%s'" % path)
+    data = bytes(int(x, 16) for x in re.findall(r'0x([0-9a-fA-F]{2})', m.group(2)))
+    return m.group(1), data.decode('ascii')
+
+
+def parse_ihx(name, text):
+    """ parse IHX records. Return dict address -> value """
+    mem = {}
+    offset = 0
+    for num, line in enumerate(text.splitlines(), 1):
+        line = line.strip()
+        if not line:
+            continue
+        if line[0] != ':':
+            sys.exit("error: %s line %d: missing ':'" % (name, num))
+        rec = bytes.fromhex(line[1:])
+        if (len(rec) < 5) or (len(rec) != rec[0] + 5) or (sum(rec) & 0xFF):
+            sys.exit("error: %s line %d: wrong length or checksum" % (name, num))
+        length, addr, kind, data = rec[0], (rec[1] << 8) | rec[2], rec[3], rec[4:-1]
+        if kind == 0x00:                    # data
+            for i, val in enumerate(data):
+                mem[offset + addr + i] = val
+        elif kind == 0x01:                  # end of file
+            break
+        elif kind == 0x04:                  # extended linear address
+            offset = ((data[0] << 8) | data[1]) << 16
+        elif kind == 0x02:                  # extended segment address
+            offset = ((data[0] << 8) | data[1]) << 4
+    return mem
+
+
+def to_blocks(mem):
+    """ merge addresses into consecutive blocks. Return list of (address, bytes) """
+    blocks = []
+    for addr in sorted(mem):
+        if blocks and (blocks[-1][0] + len(blocks[-1][1]) == addr):
+            blocks[-1][1].append(mem[addr])
+        else:
+            blocks.append((addr, bytearray([mem[addr]])))
+    return blocks
+
+
+def c_bytes(data, indent='  '):
+    """ format bytes as C initializer lines """
+    lines = []
+    for i in range(0, len(data), 12):
+        lines.append(indent + ', '.join('0x%02X' % b for b in data[i:i+12]) + ',')
+    return '\n'.join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='convert RAM routines to precompiled block tables')
+    ap.add_argument('-o', dest='output', required=True, help='generated C header')
+    ap.add_argument('inputs', nargs='+', help='RAM routine headers with IHX text')
+    args = ap.parse_args()
+
+    guard = '_' + re.sub(r'\W', '_', os.path.basename(args.output)).upper() + '_'
+    out = []
+    out.append('/**')
+    out.append('  \\file %s' % os.path.basename(args.output))
+    out.append('')
+    out.append('  \\brief precompiled RAM routines')
+    out.append('')
+    out.append('  generated by tools/ram_blobs.py from IHX text headers. Do not edit!')
+    out.append('*/')
+    out.append('')
+    out.append('// for including file only once')
+    out.append('#ifndef %s' % guard)
+    out.append('#define %s' % guard)
+    out.append('')
+
+    for path in args.inputs:
+        array, text = read_ihx(path)
+        name = re.sub(r'^bin_', '', re.sub(r'_ihx$', '', array))
+        blocks = to_blocks(parse_ihx(path, text))
+        data = b''.join(bytes(b) for _, b in blocks)
+        crc32 = zlib.crc32(data) & 0xFFFFFFFF
+
+        out.append('// %s: %d blocks, %dB' % (os.path.basename(path), len(blocks), len(data)))
+        for idx, (addr, blk) in enumerate(blocks):
+            out.append('static const uint8_t ram_%s_%d[] = {' % (name, idx))
+            out.append(c_bytes(blk))
+            out.append('};')
+        out.append('static const RamBlock_s ram_%s_blocks[] = {' % name)
+        for idx, (addr, blk) in enumerate(blocks):
+            out.append('  { 0x%06X, %d, ram_%s_%d },' % (addr, len(blk), name, idx))
+        out.append('};')
+        out.append('static const RamRoutine_s ram_%s = { "%s", %d, ram_%s_blocks, %d, 0x%08X };'
+            % (name, name, len(blocks), name, len(data), crc32))
+        out.append('')
+
+    out.append('#endif // %s' % guard)
+    out.append('')
+    out.append('// end of file')
+
+    with open(args.output, 'w', newline='\n') as f:
+        f.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()